@@ -0,0 +1,651 @@
+//============================================================================
+// Name        : AnalyserCommands.cpp
+// Author      : pgo
+// Analyser command helpers (configuration, status, capture and readback)
+//============================================================================
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+#include "console.h"
+#include "MyException.h"
+#include "stringFormatter.h"
+#include "EncodeLuts.h"
+#include "ByteSwap.h"
+#include "CommandBuilder.h"
+#include "Trace.h"
+#include "PackedSamples.h"
+#include "Lfsr16.h"
+#include "AnalyserCommands.h"
+
+using namespace Analyser;
+
+void writePreTrigger(FT2232 &ft2232, uint32_t pretrigValue) {
+   traceLog.record(TraceEvent::WritePreTrigger, &ft2232, pretrigValue);
+   ActivityTimer timer(ft2232.getStatistics(), Activity::WritePreTrigger);
+   CommandBuilder().writePreTrigger(pretrigValue).execute(ft2232);
+}
+
+void writeCaptureLength(FT2232 &ft2232, uint32_t captureLength) {
+   traceLog.record(TraceEvent::WriteCaptureLength, &ft2232, captureLength);
+   ActivityTimer timer(ft2232.getStatistics(), Activity::WriteCaptureLength);
+   CommandBuilder().writeCaptureLength(captureLength).execute(ft2232);
+}
+
+const char *getControlNames(uint8_t controlValue) {
+   using namespace USBDM;
+
+   static USBDM::StringFormatter_T<100> sf;
+   sf.clear();
+   sf.write((controlValue & C_CONTROL_START_ACQ)?"C_CONTROL_START_ACQ|":"");
+   sf.write((controlValue & C_CONTROL_CLEAR)?"C_CONTROL_CLEAR|":"");
+   sf.write((controlValue & C_CONTROL_NOTIFY)?"C_CONTROL_NOTIFY|":"");
+   sf.write((controlValue & C_CONTROL_STREAM)?"C_CONTROL_STREAM|":"");
+
+   static const unsigned divs[]   = {1,2,5,10};
+   static const unsigned div_xs[] = {1,10,10,1000};
+
+   unsigned divisor =
+         divs[((controlValue&C_CONTROL_DIV_MASK)>>C_CONTROL_DIV_OFFSET)] *
+         div_xs[((controlValue&C_CONTROL_DIVx_MASK)>>C_CONTROL_DIVx_OFFSET)];
+
+   sf.write("x").write(divisor);
+
+   return sf.toString();
+}
+
+const char *getModeNames(uint8_t modeValue) {
+   using namespace USBDM;
+
+   static StringFormatter_T<40> sf;
+   sf.clear();
+
+   static const char *captureNames[] = {
+         "C_MODE_RAW",
+         "C_MODE_RLE",
+         "C_MODE_TRANSITION",
+         "C_MODE_?",
+   };
+   sf.write(captureNames[modeValue&C_MODE_CAPTURE_MASK]);
+   sf.write((modeValue & C_MODE_PACK)?"|C_MODE_PACK":"");
+   return sf.toString();
+}
+
+const char *getStatuslNames(uint8_t statusValue) {
+   using namespace USBDM;
+
+   static StringFormatter_T<100> sf;
+   sf.clear();
+
+   static const char *stateNames[]  = {
+         "C_STATUS_STATE_IDLE   ",
+         "C_STATUS_STATE_PRETRIG",
+         "C_STATUS_STATE_ARMED  ",
+         "C_STATUS_STATE_RUN    ",
+         "C_STATUS_STATE_DONE   ",
+         "C_STATUS_STATE_STREAM ",
+         "C_STATUS_STATE_ILLEGAL",
+         "C_STATUS_STATE_ILLEGAL",
+   };
+   sf.write(stateNames[(statusValue&C_STATUS_STATE_MASK)>>C_STATUS_STATE_OFFSET]);
+   sf.write((statusValue & C_STATUS_OVERRUN)?"|C_STATUS_OVERRUN":"");
+   return sf.toString();
+}
+
+void writeControl(FT2232 &ft2232, uint8_t controlValue) {
+   traceLog.record(TraceEvent::WriteControl, &ft2232, controlValue);
+   ActivityTimer timer(ft2232.getStatistics(), Activity::WriteControl);
+   CommandBuilder().writeControl(controlValue).execute(ft2232);
+}
+
+void writeMode(AnalyserSession &analyser, uint8_t modeValue) {
+   FT2232 &ft2232 = analyser.getTransport();
+   traceLog.record(TraceEvent::WriteMode, &ft2232, modeValue);
+   ActivityTimer timer(ft2232.getStatistics(), Activity::WriteMode);
+   CommandBuilder().writeMode(modeValue).execute(ft2232);
+   analyser.setModeRegister(modeValue);
+}
+
+void writeChannels(AnalyserSession &analyser, uint32_t channelMask) {
+   FT2232 &ft2232 = analyser.getTransport();
+   traceLog.record(TraceEvent::WriteChannels, &ft2232, channelMask);
+   ActivityTimer timer(ft2232.getStatistics(), Activity::WriteChannels);
+   CommandBuilder().writeChannels(channelMask).execute(ft2232);
+   analyser.setChannelRegister(channelMask);
+}
+
+void writeReadOffset(FT2232 &ft2232, uint32_t offset) {
+   traceLog.record(TraceEvent::WriteReadOffset, &ft2232, offset);
+   ActivityTimer timer(ft2232.getStatistics(), Activity::WriteReadOffset);
+   CommandBuilder().writeReadOffset(offset).execute(ft2232);
+}
+
+uint8_t readStatus(FT2232 &ft2232) {
+   uint8_t data[] = {0};
+   {
+      ActivityTimer timer(ft2232.getStatistics(), Activity::ReadStatus);
+      CommandBuilder().readStatus().execute(ft2232, data, sizeof(data));
+   }
+   traceLog.record(TraceEvent::ReadStatus, &ft2232, data[0]);
+   return data[0];
+}
+
+uint8_t readVersion(FT2232 &ft2232) {
+   uint8_t data[] = {0};
+   {
+      ActivityTimer timer(ft2232.getStatistics(), Activity::ReadVersion);
+      CommandBuilder().readVersion().execute(ft2232, data, sizeof(data));
+   }
+   traceLog.record(TraceEvent::ReadVersion, &ft2232, data[0]);
+   return data[0];
+}
+
+AnalyserConfig readConfig(FT2232 &ft2232) {
+   uint8_t data[C_CONFIG_SIZE];
+   {
+      ActivityTimer timer(ft2232.getStatistics(), Activity::ReadConfig);
+      CommandBuilder().readConfig().execute(ft2232, data, sizeof(data));
+   }
+   if (memcmp(data, C_CONFIG_KEY, sizeof(C_CONFIG_KEY)) != 0) {
+      fprintf(stderr, "readConfig() - configuration key not found\n");
+      throw MyException("readConfig() - configuration key not found");
+   }
+   unsigned index = sizeof(C_CONFIG_KEY);
+   AnalyserConfig config;
+   config.sampleWidth        = data[index++];
+   config.maxTriggerSteps    = data[index++];
+   config.maxTriggerPatterns = data[index++];
+   config.matchCounterBits   = data[index++];
+   traceLog.record(TraceEvent::ReadConfig, &ft2232,
+         config.sampleWidth|(config.maxTriggerSteps<<8)|(config.maxTriggerPatterns<<16)|(config.matchCounterBits<<24));
+   return config;
+}
+
+uint32_t readFill(FT2232 &ft2232, uint8_t &status) {
+   uint8_t data[C_FILL_SIZE+1];
+   {
+      ActivityTimer timer(ft2232.getStatistics(), Activity::ReadFill);
+      CommandBuilder().readFill().readStatus().execute(ft2232, data, sizeof(data));
+   }
+   uint32_t written = data[0]|(data[1]<<8)|(data[2]<<16);
+   status = data[C_FILL_SIZE];
+   traceLog.record(TraceEvent::ReadFill, &ft2232, written, status);
+   return written;
+}
+
+StatusSnapshot readSnapshot(FT2232 &ft2232) {
+   uint8_t data[C_SNAPSHOT_SIZE];
+   {
+      ActivityTimer timer(ft2232.getStatistics(), Activity::ReadSnapshot);
+      CommandBuilder().readSnapshot().execute(ft2232, data, sizeof(data));
+   }
+   auto get24 = [&](unsigned index) {
+      return (uint32_t)(data[index]|(data[index+1]<<8)|(data[index+2]<<16));
+   };
+   StatusSnapshot snapshot;
+   snapshot.status         = data[C_SNAPSHOT_STATUS];
+   snapshot.state          = (snapshot.status&C_STATUS_STATE_MASK)>>C_STATUS_STATE_OFFSET;
+   snapshot.overrun        = (snapshot.status&C_STATUS_OVERRUN) != 0;
+   snapshot.triggerStep    = data[C_SNAPSHOT_STEP];
+   snapshot.matchCounter   = data[C_SNAPSHOT_MATCH]|(data[C_SNAPSHOT_MATCH+1]<<8);
+   snapshot.captureCounter = get24(C_SNAPSHOT_CAPTURE);
+   snapshot.preTriggerFill = get24(C_SNAPSHOT_PRETRIG);
+   snapshot.written        = get24(C_SNAPSHOT_WRITTEN);
+
+   // The match counter starts at the first LFSR state (0 is invalid)
+   const uint16_t position = Lfsr16::decode(snapshot.matchCounter);
+   snapshot.matchCount     = (position != 0)?position-1:0;
+
+   traceLog.record(TraceEvent::ReadSnapshot, &ft2232,
+         snapshot.status|(snapshot.triggerStep<<8)|(snapshot.matchCounter<<16), snapshot.captureCounter, snapshot.written);
+   return snapshot;
+}
+
+uint8_t identifyAnalyser(AnalyserSession &analyser) {
+   FT2232 &ft2232  = analyser.getTransport();
+   uint8_t version = readVersion(ft2232);
+
+   analyser.getLutCache().setDifferential(version >= LUT_UPDATE_MIN_VERSION);
+   AnalyserConfig config = (version >= CONFIG_MIN_VERSION)?readConfig(ft2232):DEFAULT_ANALYSER_CONFIG;
+   if (config.isEmulatorOnly() && !ft2232.isEmulated()) {
+      fprintf(stderr, "identifyAnalyser() - %u inputs exceed %u-bit SDRAM\n", config.sampleWidth, C_SDRAM_WIDTH);
+      throw MyException("identifyAnalyser() - %u inputs exceed %u-bit SDRAM", config.sampleWidth, C_SDRAM_WIDTH);
+   }
+   analyser.setAnalyserConfig(config);
+   return version;
+}
+
+/**
+ * Send C_RD_BUFFER commands for a range of blocks in a single transfer
+ *
+ * @param ft2232        Interface to analyser
+ * @param firstBlock    First block to request
+ * @param numBlocks     Number of blocks to request
+ * @param maxBlockSize  Size of each block in bytes (except last)
+ * @param sizeInBytes   Total size of capture in bytes
+ */
+static void requestCaptureBlocks(
+      FT2232   &ft2232,
+      unsigned  firstBlock,
+      unsigned  numBlocks,
+      unsigned  maxBlockSize,
+      unsigned  sizeInBytes) {
+
+   traceLog.record(TraceEvent::RequestBlocks, &ft2232, firstBlock, numBlocks, maxBlockSize);
+
+   std::vector<uint8_t> commands;
+   for (unsigned block=firstBlock; block<firstBlock+numBlocks; block++) {
+      unsigned blockSize = std::min(maxBlockSize, sizeInBytes-(block*maxBlockSize));
+      commands.push_back(C_RD_BUFFER);
+      commands.push_back((uint8_t)(blockSize));
+      commands.push_back((uint8_t)((blockSize)>>8));
+   }
+   ft2232.transmitData(commands.data(), commands.size());
+}
+
+/**
+ * Read captured samples with pipelined C_RD_BUFFER commands
+ *
+ * Up to queueDepth read commands are kept outstanding so the analyser is
+ * already sending the following blocks while the current block is received.
+ * Data is received directly into the sample buffer unless packed (C_MODE_PACK)
+ * in which case each block is unpacked into the sample buffer as it arrives.
+ *
+ * If a callback is provided, reception is done on a separate thread and the callback
+ * is called on this thread for each block, in order, as it arrives.
+ * Reception runs at most queueDepth blocks ahead of the callback.
+ *
+ * @tparam Sample     Sample type matching the analyser sample width
+ *
+ * @param analyser    Interface to analyser
+ * @param data        Buffer for samples
+ * @param size        Number of samples to read
+ * @param callback    Called for each block received (may be empty)
+ * @param queueDepth  Number of read commands kept outstanding
+ */
+template<typename Sample>
+void readCaptureData(
+      AnalyserSession                    &analyser,
+      Sample                             *data,
+      const unsigned                      size,
+      const SampleBlockCallback<Sample>  &callback,
+      unsigned                            queueDepth) {
+
+   constexpr unsigned bytesPerSample = sizeof(Sample);
+
+   FT2232 &ft2232 = analyser.getTransport();
+
+   if (bytesPerSample != analyser.getAnalyserConfig().getBytesPerSample()) {
+      fprintf(stderr, "readCaptureData() - %u-byte samples do not match analyser (%u inputs)\n",
+            bytesPerSample, analyser.getAnalyserConfig().sampleWidth);
+      throw MyException("readCaptureData() - %u-byte samples do not match analyser (%u inputs)",
+            bytesPerSample, analyser.getAnalyserConfig().sampleWidth);
+   }
+   if (queueDepth == 0) {
+      queueDepth = 1;
+   }
+   // Block size from transfer profile (whole samples)
+   const unsigned maxBlockSize    = ft2232.getTransferProfile().blockSize&~(bytesPerSample-1);
+
+   // Packed readback sends fewer bits for each sample
+   const unsigned sampleBits      = analyser.getReadbackSampleBits();
+   const bool     packed          = sampleBits < 8*bytesPerSample;
+   const unsigned samplesPerBlock = (8*maxBlockSize)/sampleBits;
+   const unsigned sizeInBytes     = getPackedSize(size, sampleBits, bytesPerSample);
+   const unsigned numBlocks       = (sizeInBytes+maxBlockSize-1)/maxBlockSize;
+
+   std::vector<uint8_t> packedData(packed?sizeInBytes:0);
+   uint8_t *const       receiveBuffer = packed?packedData.data():reinterpret_cast<uint8_t *>(data);
+
+   ActivityTimer timer(ft2232.getStatistics(), Activity::ReadCaptureData, sizeInBytes);
+   traceLog.record(TraceEvent::ReadCaptureData, &ft2232, size, numBlocks, queueDepth);
+
+   // Synchronisation between reception and callback
+   std::mutex              mutex;
+   std::condition_variable blockChanged;
+   unsigned                blocksReceived = 0;
+   unsigned                blocksConsumed = 0;
+   bool                    abandon        = false;
+   std::exception_ptr      receiveError   = nullptr;
+
+   auto receiveBlocks = [&]() {
+      unsigned blocksRequested = std::min(queueDepth, numBlocks);
+      requestCaptureBlocks(ft2232, 0, blocksRequested, maxBlockSize, sizeInBytes);
+
+      for (unsigned block=0; block<numBlocks; block++) {
+         unsigned offset    = block*maxBlockSize;
+         unsigned blockSize = std::min(maxBlockSize, sizeInBytes-offset);
+
+         ft2232.receiveData(receiveBuffer+offset, blockSize);
+         traceLog.record(TraceEvent::ReceiveBlock, &ft2232, block, blockSize);
+
+         if (blocksRequested < numBlocks) {
+            // Keep queue full
+            requestCaptureBlocks(ft2232, blocksRequested++, 1, maxBlockSize, sizeInBytes);
+         }
+         const unsigned firstSample = block*samplesPerBlock;
+         if (packed) {
+            unpackSamples(receiveBuffer+offset, data+firstSample, std::min(samplesPerBlock, size-firstSample), sampleBits);
+         }
+         else {
+            // Samples are sent low byte first
+            samplesToHostOrder(data+firstSample, blockSize/bytesPerSample);
+         }
+
+         if (callback) {
+            std::unique_lock<std::mutex> lock(mutex);
+            blocksReceived++;
+            blockChanged.notify_all();
+            blockChanged.wait(lock, [&]{ return abandon || ((blocksReceived-blocksConsumed) < queueDepth); });
+            if (abandon) {
+               return;
+            }
+         }
+      }
+   };
+
+   if (!callback) {
+      receiveBlocks();
+      return;
+   }
+
+   std::thread receiver([&]() {
+      try {
+         receiveBlocks();
+      } catch (...) {
+         std::lock_guard<std::mutex> lock(mutex);
+         receiveError = std::current_exception();
+         blockChanged.notify_all();
+      }
+   });
+
+   try {
+      for (unsigned block=0; block<numBlocks; block++) {
+         {
+            std::unique_lock<std::mutex> lock(mutex);
+            blockChanged.wait(lock, [&]{ return (receiveError != nullptr) || (blocksReceived > block); });
+            if (blocksReceived <= block) {
+               break;
+            }
+         }
+         unsigned offset = block*samplesPerBlock;
+         callback(data+offset, offset, std::min(samplesPerBlock, size-offset));
+         {
+            std::lock_guard<std::mutex> lock(mutex);
+            blocksConsumed++;
+            blockChanged.notify_all();
+         }
+      }
+   } catch (...) {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         abandon = true;
+         blockChanged.notify_all();
+      }
+      receiver.join();
+      throw;
+   }
+   receiver.join();
+   if (receiveError != nullptr) {
+      std::rethrow_exception(receiveError);
+   }
+}
+
+/**
+ * Read captured samples
+ * Data is received directly into the sample buffer
+ *
+ * @tparam Sample  Sample type matching the analyser sample width
+ *
+ * @param analyser Interface to analyser
+ * @param data     Buffer for samples
+ * @param size     Number of samples to read
+ */
+template<typename Sample>
+void readCaptureData(AnalyserSession &analyser, Sample *data, const unsigned size) {
+   readCaptureData(analyser, data, size, nullptr, DEFAULT_READ_QUEUE_DEPTH);
+}
+
+template<typename Sample>
+void readWindow(AnalyserSession &analyser, Sample *data, uint32_t captureSize, uint32_t sampleOffset, unsigned count) {
+   if ((sampleOffset > captureSize) || (count > captureSize-sampleOffset)) {
+      fprintf(stderr, "readWindow() - window %u+%u is outside capture of %u samples\n", sampleOffset, count, captureSize);
+      throw MyException("readWindow() - window %u+%u is outside capture of %u samples", sampleOffset, count, captureSize);
+   }
+   writeReadOffset(analyser.getTransport(), sampleOffset);
+   readCaptureData(analyser, data, count);
+}
+
+/// Shortest and longest interval between status polls (ms)
+static constexpr unsigned MIN_POLL_INTERVAL_ms = 1;
+static constexpr unsigned MAX_POLL_INTERVAL_ms = 100;
+
+/// Longest time between checks for cancellation (ms)
+static constexpr unsigned CANCEL_CHECK_INTERVAL_ms = 10;
+
+/**
+ * Sleep until a given time
+ *
+ * @param wakeTime   Time to wake
+ * @param deadline   Give up at this time
+ * @param cancel     Give up when this becomes true (may be nullptr)
+ *
+ * @return true  => Woke at wakeTime
+ * @return false => Deadline reached or cancelled
+ */
+static bool sleepUntil(
+      std::chrono::steady_clock::time_point  wakeTime,
+      std::chrono::steady_clock::time_point  deadline,
+      const std::atomic<bool>               *cancel) {
+   using namespace std::chrono;
+
+   for(;;) {
+      if ((cancel != nullptr) && *cancel) {
+         return false;
+      }
+      auto now = steady_clock::now();
+      if (now >= wakeTime) {
+         return true;
+      }
+      if (now >= deadline) {
+         return false;
+      }
+      std::this_thread::sleep_for(std::min({
+         duration_cast<nanoseconds>(wakeTime-now),
+         duration_cast<nanoseconds>(deadline-now),
+         duration_cast<nanoseconds>(milliseconds(CANCEL_CHECK_INTERVAL_ms))}));
+   }
+}
+
+/**
+ * Wait for capture to complete
+ *
+ * WaitMode::Notify - The capture must have been started with C_CONTROL_NOTIFY.
+ *    Blocks on the driver receive event until the analyser sends the completion status.
+ * WaitMode::Poll - The status is first read when the capture could have completed
+ *    (sample count x sample period) and then polled with increasing interval.
+ *
+ * On timeout or cancellation the capture is still running.
+ * In notify mode the completion status may still be sent later so the caller
+ * should disable notification and purge the receive buffer.
+ *
+ * @param ft2232      Interface to analyser
+ * @param sampleSize  Number of samples in capture
+ * @param sampleRate  Sample rate of capture
+ * @param mode        How to wait
+ * @param timeout_ms  Maximum time to wait in ms (0 => no limit)
+ * @param cancel      Stop waiting when this becomes true (may be nullptr)
+ *
+ * @return true  => Capture complete
+ * @return false => Timeout or cancelled
+ *
+ * @throw MyException on unexpected status
+ */
+static bool waitForCompletion(
+      FT2232                  &ft2232,
+      unsigned                 sampleSize,
+      SampleRate               sampleRate,
+      WaitMode                 mode,
+      unsigned                 timeout_ms,
+      const std::atomic<bool> *cancel) {
+   using namespace std::chrono;
+
+   const auto startTime = steady_clock::now();
+   const auto deadline  = (timeout_ms == 0)?steady_clock::time_point::max():startTime+milliseconds(timeout_ms);
+
+   if (mode == WaitMode::Notify) {
+      for(;;) {
+         if ((cancel != nullptr) && *cancel) {
+            return false;
+         }
+         auto now = steady_clock::now();
+         if (now >= deadline) {
+            return false;
+         }
+         unsigned waitTime = MAX_POLL_INTERVAL_ms;
+         if (deadline != steady_clock::time_point::max()) {
+            waitTime = std::min(waitTime, (unsigned)duration_cast<milliseconds>(deadline-now).count()+1);
+         }
+         if (ft2232.waitForData(waitTime)) {
+            uint8_t status;
+            ft2232.receiveData(&status, 1);
+            traceLog.record(TraceEvent::Notify, &ft2232, status);
+            if (status != (C_STATUS_NOTIFY|C_STATUS_STATE_DONE)) {
+               fprintf(stderr, "waitForCompletion() - unexpected status 0x%02X\n", status);
+               throw MyException("waitForCompletion() - unexpected status 0x%02X", status);
+            }
+            return true;
+         }
+      }
+   }
+
+   // Capture cannot complete before all samples are taken
+   const nanoseconds captureTime(
+         (uint64_t)sampleSize*getSamplePeriodIn_nanoseconds(sampleRate));
+
+   milliseconds interval = duration_cast<milliseconds>(captureTime/8);
+   interval = std::max(interval, milliseconds(MIN_POLL_INTERVAL_ms));
+   interval = std::min(interval, milliseconds(MAX_POLL_INTERVAL_ms));
+
+   auto pollTime = startTime+captureTime;
+   for(;;) {
+      if (!sleepUntil(pollTime, deadline, cancel)) {
+         return false;
+      }
+      if ((readStatus(ft2232)&C_STATUS_STATE_MASK) == C_STATUS_STATE_DONE) {
+         return true;
+      }
+      pollTime = steady_clock::now()+interval;
+      interval = std::min(2*interval, milliseconds(MAX_POLL_INTERVAL_ms));
+   }
+}
+
+template<typename Setup>
+bool waitForCaptureComplete(
+      FT2232                  &ft2232,
+      Setup                   &setup,
+      WaitMode                 mode,
+      unsigned                 timeout_ms,
+      const std::atomic<bool> *cancel) {
+
+   ActivityTimer timer(ft2232.getStatistics(), Activity::WaitForCapture);
+   bool complete = waitForCompletion(ft2232, setup.getSampleSize(), setup.getSampleRate(), mode, timeout_ms, cancel);
+   if (!complete) {
+      timer.timeout();
+   }
+   traceLog.record(TraceEvent::CaptureComplete, &ft2232, complete);
+   return complete;
+}
+
+/**
+ * Configure analyser, do capture and read data
+ *
+ * @tparam Setup       TriggerSetup of one of the FPGA variants
+ *
+ * @param analyser    Interface to analyser
+ * @param setup       Trigger setup
+ * @param buffer      Buffer for samples (setup.getSampleSize())
+ * @param mode        How to wait for capture completion
+ * @param timeout_ms  Maximum time to wait for capture in ms (0 => no limit)
+ * @param cancel      Abandon capture when this becomes true (may be nullptr)
+ *
+ * @return true  => Capture complete and data read
+ * @return false => Timeout or cancelled
+ */
+template<typename Setup>
+bool doCapture(
+      AnalyserSession                   &analyser,
+      Setup                             &setup,
+      typename Setup::Encoding::Sample   buffer[],
+      WaitMode                           mode,
+      unsigned                           timeout_ms,
+      const std::atomic<bool>           *cancel) {
+
+   FT2232    &ft2232 = analyser.getTransport();
+   const bool notify = (mode == WaitMode::Notify);
+
+   if (!analyser.getAnalyserConfig().template matches<typename Setup::Encoding>()) {
+      fprintf(stderr, "doCapture() - trigger setup does not match analyser hardware\n");
+      throw MyException("doCapture() - trigger setup does not match analyser hardware");
+   }
+   // Configure and start capture in a single transfer
+   uint8_t status[2];
+   {
+      ActivityTimer timer(ft2232.getStatistics(), Activity::StartCapture);
+      CommandBuilder builder;
+      builder.startCapture(setup, notify, ft2232.getTransferProfile().blockSize, &analyser.getLutCache());
+      traceLog.record(TraceEvent::StartCapture, &ft2232,
+            setup.getSampleRate()|C_CONTROL_START_ACQ|(notify?C_CONTROL_NOTIFY:0), setup.getSampleSize(), setup.getPreTrigSize());
+      timer.addBytes(builder.size());
+      try {
+         builder.execute(ft2232, status, builder.getResponseSize());
+      } catch (...) {
+         analyser.getLutCache().invalidate();
+         throw;
+      }
+   }
+
+   // Check idle before start
+   if ((status[0]&C_STATUS_STATE_MASK) != C_STATUS_STATE_IDLE) {
+      fprintf(stderr, "doCapture() - unexpected status 0x%02X\n", status[0]);
+      throw MyException("doCapture() - unexpected status 0x%02X", status[0]);
+   }
+   bool complete = !notify && ((status[1]&C_STATUS_STATE_MASK) == C_STATUS_STATE_DONE);
+   if (!complete) {
+      complete = waitForCaptureComplete(ft2232, setup, mode, timeout_ms, cancel);
+   }
+   if (!complete) {
+      if (notify) {
+         // Discard late completion status
+         writeControl(ft2232, setup.getSampleRate());
+         ft2232.purgeRx();
+      }
+      return false;
+   }
+   readCaptureData(analyser, buffer, setup.getSampleSize());
+   return true;
+}
+
+// Sample widths
+template void readCaptureData(AnalyserSession &, uint16_t *, const unsigned, const SampleBlockCallback<uint16_t> &, unsigned);
+template void readCaptureData(AnalyserSession &, uint32_t *, const unsigned, const SampleBlockCallback<uint32_t> &, unsigned);
+template void readCaptureData(AnalyserSession &, uint16_t *, const unsigned);
+template void readCaptureData(AnalyserSession &, uint32_t *, const unsigned);
+template void readWindow(AnalyserSession &, uint16_t *, uint32_t, uint32_t, unsigned);
+template void readWindow(AnalyserSession &, uint32_t *, uint32_t, uint32_t, unsigned);
+
+// FPGA variants (see EncodeLuts.cpp)
+template bool waitForCaptureComplete(FT2232 &, TriggerEncoding<16, 16, 2, 16>::TriggerSetup &, WaitMode, unsigned, const std::atomic<bool> *);
+template bool waitForCaptureComplete(FT2232 &, TriggerEncoding<16, 16, 4, 16>::TriggerSetup &, WaitMode, unsigned, const std::atomic<bool> *);
+template bool waitForCaptureComplete(FT2232 &, TriggerEncoding<32, 16, 2, 16>::TriggerSetup &, WaitMode, unsigned, const std::atomic<bool> *);
+template bool waitForCaptureComplete(FT2232 &, TriggerEncoding<32, 16, 4, 16>::TriggerSetup &, WaitMode, unsigned, const std::atomic<bool> *);
+template bool doCapture(AnalyserSession &, TriggerEncoding<16, 16, 2, 16>::TriggerSetup &, TriggerEncoding<16, 16, 2, 16>::Sample [], WaitMode, unsigned, const std::atomic<bool> *);
+template bool doCapture(AnalyserSession &, TriggerEncoding<16, 16, 4, 16>::TriggerSetup &, TriggerEncoding<16, 16, 4, 16>::Sample [], WaitMode, unsigned, const std::atomic<bool> *);
+template bool doCapture(AnalyserSession &, TriggerEncoding<32, 16, 2, 16>::TriggerSetup &, TriggerEncoding<32, 16, 2, 16>::Sample [], WaitMode, unsigned, const std::atomic<bool> *);
+template bool doCapture(AnalyserSession &, TriggerEncoding<32, 16, 4, 16>::TriggerSetup &, TriggerEncoding<32, 16, 4, 16>::Sample [], WaitMode, unsigned, const std::atomic<bool> *);
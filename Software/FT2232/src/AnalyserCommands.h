@@ -0,0 +1,376 @@
+/*
+ * AnalyserCommands.h
+ *
+ *  Created on: 7 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_ANALYSERCOMMANDS_H_
+#define SOURCES_ANALYSERCOMMANDS_H_
+
+#include <stdint.h>
+#include <functional>
+#include <atomic>
+
+#include "EncodeLuts.h"
+#include "FT2232.h"
+#include "AnalyserSession.h"
+
+
+/// Default number of C_RD_BUFFER commands kept outstanding during readback
+static constexpr unsigned DEFAULT_READ_QUEUE_DEPTH = 4;
+
+/// First analyser version supporting C_CONTROL_NOTIFY
+static constexpr uint8_t NOTIFY_MIN_VERSION = 0b00000011;
+
+/// First analyser version supporting C_LUT_UPDATE
+static constexpr uint8_t LUT_UPDATE_MIN_VERSION = 0b00000100;
+
+/// First analyser version supporting C_RD_CONFIG
+static constexpr uint8_t CONFIG_MIN_VERSION = 0b00000101;
+
+/// First analyser version supporting C_CONTROL_STREAM and C_RD_FILL
+static constexpr uint8_t STREAM_MIN_VERSION = 0b00000110;
+
+/// First analyser version supporting C_WR_MODE (C_MODE_RLE)
+static constexpr uint8_t RLE_MIN_VERSION = 0b00000111;
+
+/// First analyser version supporting C_MODE_TRANSITION and C_WR_CHANNELS
+static constexpr uint8_t TRANSITION_MIN_VERSION = 0b00001000;
+
+/// First analyser version supporting C_MODE_PACK
+static constexpr uint8_t PACK_MIN_VERSION = 0b00001001;
+
+/// First analyser version supporting C_WR_READ_OFFSET
+static constexpr uint8_t WINDOW_MIN_VERSION = 0b00001010;
+
+/// First analyser version supporting C_RD_SNAPSHOT
+static constexpr uint8_t SNAPSHOT_MIN_VERSION = 0b00001011;
+
+/**
+ * Called as each block of capture data becomes available
+ *
+ * @param samples  Start of block (within capture buffer)
+ * @param offset   Offset of block from start of capture in samples
+ * @param count    Number of samples in block
+ */
+template<typename Sample>
+struct SampleBlockCallbackType {
+   using type = std::function<void(const Sample samples[], unsigned offset, unsigned count)>;
+};
+
+/// Block callback for a given sample type (not used to deduce the sample type)
+template<typename Sample>
+using SampleBlockCallback = typename SampleBlockCallbackType<Sample>::type;
+
+/// Block callback for 16-bit samples
+using BlockCallback = SampleBlockCallback<uint16_t>;
+
+/**
+ * How to wait for capture completion
+ */
+enum class WaitMode {
+   Notify,  //!< Wait on driver receive event for status sent by analyser on completion
+   Poll,    //!< Poll status with adaptive back-off
+};
+
+/**
+ * Write pre-trigger length (C_WR_PRETRIG)
+ *
+ * @param ft2232        Interface to analyser
+ * @param pretrigValue  Number of samples to capture before looking for trigger
+ */
+void writePreTrigger(FT2232 &ft2232, uint32_t pretrigValue);
+
+/**
+ * Write capture length (C_WR_CAPTURE)
+ *
+ * @param ft2232        Interface to analyser
+ * @param captureLength Total number of samples to capture
+ */
+void writeCaptureLength(FT2232 &ft2232, uint32_t captureLength);
+
+/**
+ * Write control register (C_WR_CONTROL)
+ *
+ * @param ft2232        Interface to analyser
+ * @param controlValue  Value to write
+ */
+void writeControl(FT2232 &ft2232, uint8_t controlValue);
+
+/**
+ * Write capture mode register (C_WR_MODE)
+ * Only supported from RLE_MIN_VERSION
+ * The value is recorded so readback can allow for C_MODE_PACK
+ *
+ * @param analyser      Interface to analyser
+ * @param modeValue     Value to write e.g. C_MODE_RLE
+ */
+void writeMode(AnalyserSession &analyser, uint8_t modeValue);
+
+/**
+ * Write channel enable mask (C_WR_CHANNELS)
+ * Only supported from TRANSITION_MIN_VERSION
+ * The value is recorded so readback can allow for C_MODE_PACK
+ *
+ * @param analyser      Interface to analyser
+ * @param channelMask   Enabled channels (bit n = channel n)
+ */
+void writeChannels(AnalyserSession &analyser, uint32_t channelMask);
+
+/**
+ * Move readback position (C_WR_READ_OFFSET)
+ * Only supported from WINDOW_MIN_VERSION
+ *
+ * @param ft2232        Interface to analyser
+ * @param offset        Offset from start of capture in SDRAM words
+ */
+void writeReadOffset(FT2232 &ft2232, uint32_t offset);
+
+/**
+ * Read status (C_RD_STATUS)
+ *
+ * @param ft2232   Interface to analyser
+ *
+ * @return Status value
+ */
+uint8_t readStatus(FT2232 &ft2232);
+
+/**
+ * Read version (C_RD_VERSION)
+ *
+ * @param ft2232   Interface to analyser
+ *
+ * @return Version value
+ */
+uint8_t readVersion(FT2232 &ft2232);
+
+/**
+ * Read size of trigger hardware (C_RD_CONFIG)
+ * Only supported from CONFIG_MIN_VERSION
+ *
+ * @param ft2232   Interface to analyser
+ *
+ * @return Hardware configuration
+ *
+ * @throw MyException if the response does not start with C_CONFIG_KEY
+ */
+Analyser::AnalyserConfig readConfig(FT2232 &ft2232);
+
+/**
+ * Read streaming ring buffer write count and status (C_RD_FILL, C_RD_STATUS)
+ * Both are read in a single transfer.
+ * Only supported from STREAM_MIN_VERSION
+ *
+ * @param ft2232   Interface to analyser
+ * @param status   Status value (C_STATUS_OVERRUN indicates samples were discarded)
+ *
+ * @return Number of samples written to the ring buffer (modulo 2^24, see C_FILL_MASK)
+ */
+uint32_t readFill(FT2232 &ft2232, uint8_t &status);
+
+/**
+ * Capture progress from C_RD_SNAPSHOT
+ */
+struct StatusSnapshot {
+   uint8_t  status;           //!< Status value (as readStatus())
+   uint8_t  state;            //!< Capture state (C_STATUS_STATE_...)
+   bool     overrun;          //!< Streaming samples have been discarded
+   unsigned triggerStep;      //!< Current trigger step
+   uint16_t matchCounter;     //!< Match counter as read (LFSR value)
+   unsigned matchCount;       //!< Matches counted in current trigger step
+   uint32_t captureCounter;   //!< Capture counter
+   uint32_t preTriggerFill;   //!< Pre-trigger samples held
+   uint32_t written;          //!< Samples written to SDRAM (modulo 2^24, see C_FILL_MASK)
+};
+
+/**
+ * Read status snapshot (C_RD_SNAPSHOT)
+ * All values are taken at the same instant and read in a single transfer.
+ * Only supported from SNAPSHOT_MIN_VERSION
+ *
+ * @param ft2232   Interface to analyser
+ *
+ * @return Snapshot with the match counter converted to a count
+ */
+StatusSnapshot readSnapshot(FT2232 &ft2232);
+
+/**
+ * Identify analyser on connection.
+ * The version and hardware configuration are read and the session is set up to match:
+ *  - The LUT cache uses C_LUT_UPDATE if available
+ *  - The hardware configuration is recorded in the session (AnalyserSession::getAnalyserConfig()).
+ *    Analysers before CONFIG_MIN_VERSION are assumed to be DEFAULT_ANALYSER_CONFIG.
+ *
+ * The trigger encoding and sample type to use with the analyser can then be
+ * selected with withTriggerEncoding().
+ *
+ * @param analyser Interface to analyser
+ *
+ * @return Version value
+ *
+ * @throw MyException if a device other than the emulator reports an emulator-only configuration
+ */
+uint8_t identifyAnalyser(AnalyserSession &analyser);
+
+/**
+ * Get readable description of control register value
+ *
+ * @param controlValue Control register value
+ *
+ * @return Description (static buffer)
+ */
+const char *getControlNames(uint8_t controlValue);
+
+/**
+ * Get readable description of capture mode register value
+ *
+ * @param modeValue Mode register value
+ *
+ * @return Description (static buffer)
+ */
+const char *getModeNames(uint8_t modeValue);
+
+/**
+ * Get readable description of status value
+ *
+ * @param statusValue Status value
+ *
+ * @return Description (static buffer)
+ */
+const char *getStatuslNames(uint8_t statusValue);
+
+/**
+ * Read captured samples with pipelined C_RD_BUFFER commands
+ *
+ * Up to queueDepth read commands are kept outstanding so the analyser is
+ * already sending the following blocks while the current block is received.
+ * Data is received directly into the sample buffer.
+ * The block size is taken from the transfer profile.
+ *
+ * If a callback is provided, reception is done on a separate thread and the callback
+ * is called on this thread for each block, in order, as it arrives.
+ * Reception runs at most queueDepth blocks ahead of the callback.
+ *
+ * The sample type must match the analyser sample width
+ * (uint16_t for <=16 inputs, uint32_t for <=32 inputs).
+ *
+ * If C_MODE_PACK is in use only the enabled channels are transferred
+ * and they are unpacked to samples as each block arrives (see PackedSamples.h).
+ *
+ * @tparam Sample     uint16_t or uint32_t
+ *
+ * @param analyser    Interface to analyser
+ * @param data        Buffer for samples
+ * @param size        Number of samples to read
+ * @param callback    Called for each block received (may be empty)
+ * @param queueDepth  Number of read commands kept outstanding
+ *
+ * @throw MyException if the sample type does not match the analyser
+ */
+template<typename Sample>
+void readCaptureData(
+      AnalyserSession                    &analyser,
+      Sample                             *data,
+      const unsigned                      size,
+      const SampleBlockCallback<Sample>  &callback,
+      unsigned                            queueDepth = DEFAULT_READ_QUEUE_DEPTH);
+
+/**
+ * Read captured samples
+ * Data is received directly into the sample buffer
+ *
+ * @tparam Sample  uint16_t or uint32_t
+ *
+ * @param analyser Interface to analyser
+ * @param data     Buffer for samples
+ * @param size     Number of samples to read
+ *
+ * @throw MyException if the sample type does not match the analyser
+ */
+template<typename Sample>
+void readCaptureData(AnalyserSession &analyser, Sample *data, const unsigned size);
+
+/**
+ * Read part of a completed capture (C_WR_READ_OFFSET then C_RD_BUFFER)
+ * Only supported from WINDOW_MIN_VERSION
+ *
+ * The capture may be read in any order and more than once.
+ *
+ * @tparam Sample        uint16_t or uint32_t
+ *
+ * @param analyser       Interface to analyser
+ * @param data           Buffer for samples
+ * @param captureSize    Size of the completed capture (as used for readCaptureData())
+ * @param sampleOffset   Offset of first sample from start of capture
+ * @param count          Number of samples to read
+ *
+ * @throw MyException if the sample type does not match the analyser
+ * @throw MyException if the window is not within the capture
+ */
+template<typename Sample>
+void readWindow(AnalyserSession &analyser, Sample *data, uint32_t captureSize, uint32_t sampleOffset, unsigned count);
+
+/**
+ * Wait for capture to complete
+ *
+ * WaitMode::Notify - The capture must have been started with C_CONTROL_NOTIFY.
+ *    Blocks on the driver receive event until the analyser sends the completion status.
+ * WaitMode::Poll - The status is first read when the capture could have completed
+ *    (sample count x sample period) and then polled with increasing interval.
+ *
+ * On timeout or cancellation the capture is still running.
+ * In notify mode the completion status may still be sent later so the caller
+ * should disable notification and purge the receive buffer.
+ *
+ * @tparam Setup       TriggerSetup of one of the FPGA variants
+ *
+ * @param ft2232      Interface to analyser
+ * @param setup       Setup used for capture
+ * @param mode        How to wait
+ * @param timeout_ms  Maximum time to wait in ms (0 => no limit)
+ * @param cancel      Stop waiting when this becomes true (may be nullptr)
+ *
+ * @return true  => Capture complete
+ * @return false => Timeout or cancelled
+ *
+ * @throw MyException on unexpected status
+ */
+template<typename Setup>
+bool waitForCaptureComplete(
+      FT2232                  &ft2232,
+      Setup                   &setup,
+      WaitMode                 mode,
+      unsigned                 timeout_ms = 0,
+      const std::atomic<bool> *cancel     = nullptr);
+
+/**
+ * Configure analyser, do capture and read data
+ *
+ * The setup must belong to the trigger encoding matching the analyser
+ * (see withTriggerEncoding()).
+ *
+ * @tparam Setup      TriggerSetup of one of the FPGA variants
+ *
+ * @param analyser    Interface to analyser
+ * @param setup       Trigger setup
+ * @param buffer      Buffer for samples (setup.getSampleSize())
+ * @param mode        How to wait for capture completion
+ * @param timeout_ms  Maximum time to wait for capture in ms (0 => no limit)
+ * @param cancel      Abandon capture when this becomes true (may be nullptr)
+ *
+ * @return true  => Capture complete and data read
+ * @return false => Timeout or cancelled
+ *
+ * @throw MyException if the setup does not match the analyser hardware
+ */
+template<typename Setup>
+bool doCapture(
+      AnalyserSession                   &analyser,
+      Setup                             &setup,
+      typename Setup::Encoding::Sample   buffer[],
+      WaitMode                           mode       = WaitMode::Poll,
+      unsigned                           timeout_ms = 0,
+      const std::atomic<bool>           *cancel     = nullptr);
+
+#endif /* SOURCES_ANALYSERCOMMANDS_H_ */
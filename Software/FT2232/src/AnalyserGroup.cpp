@@ -0,0 +1,199 @@
+//============================================================================
+// Name        : AnalyserGroup.cpp
+// Author      : pgo
+// Several analysers captured together with synchronised arming
+//============================================================================
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+#include "console.h"
+#include "MyException.h"
+#include "EncodeLuts.h"
+#include "CommandBuilder.h"
+#include "Barrier.h"
+#include "Trace.h"
+#include "AnalyserGroup.h"
+
+using namespace Analyser;
+
+IoThread::IoThread() : thread(&IoThread::run, this) {
+}
+
+IoThread::~IoThread() {
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+   }
+   taskAdded.notify_one();
+   thread.join();
+}
+
+std::future<bool> IoThread::submit(std::function<bool()> task) {
+   std::packaged_task<bool()> packagedTask(std::move(task));
+   std::future<bool> result = packagedTask.get_future();
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push_back(std::move(packagedTask));
+   }
+   taskAdded.notify_one();
+   return result;
+}
+
+/**
+ * Execute tasks in order until stopped
+ */
+void IoThread::run() {
+   for(;;) {
+      std::packaged_task<bool()> task;
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         taskAdded.wait(lock, [this]{ return stop || !tasks.empty(); });
+         if (tasks.empty()) {
+            return;
+         }
+         task = std::move(tasks.front());
+         tasks.pop_front();
+      }
+      // Exceptions are captured in the task's future
+      task();
+   }
+}
+
+AnalyserGroup::AnalyserGroup(const std::vector<DeviceSelector> &selectors, bool verbose) {
+   for (const DeviceSelector &selector:selectors) {
+      add(FT2232::open(selector, verbose));
+   }
+}
+
+void AnalyserGroup::add(FT2232Ptr ft2232) {
+   std::unique_ptr<AnalyserSession> analyser(new AnalyserSession(*ft2232));
+   WaitMode waitMode = WaitMode::Poll;
+   uint8_t  version  = identifyAnalyser(*analyser);
+   if (version >= NOTIFY_MIN_VERSION) {
+      waitMode = WaitMode::Notify;
+   }
+   if (!members.empty() && (analyser->getAnalyserConfig() != getAnalyserConfig())) {
+      fprintf(stderr, "AnalyserGroup::add() - analyser hardware differs from other members\n");
+      throw MyException("AnalyserGroup::add() - analyser hardware differs from other members");
+   }
+   members.push_back(Member{std::move(ft2232), std::move(analyser), waitMode, std::unique_ptr<IoThread>(new IoThread())});
+}
+
+const AnalyserConfig &AnalyserGroup::getAnalyserConfig() const {
+   if (members.empty()) {
+      fprintf(stderr, "AnalyserGroup::getAnalyserConfig() - group is empty\n");
+      throw MyException("AnalyserGroup::getAnalyserConfig() - group is empty");
+   }
+   return members[0].analyser->getAnalyserConfig();
+}
+
+template<typename Setup>
+bool AnalyserGroup::doCapture(
+      Setup *const                              setups[],
+      typename Setup::Encoding::Sample *const   buffers[],
+      unsigned                                  timeout_ms) {
+
+   using Clock = std::chrono::steady_clock;
+
+   const unsigned numMembers = members.size();
+
+   if ((numMembers > 0) && !getAnalyserConfig().template matches<typename Setup::Encoding>()) {
+      fprintf(stderr, "AnalyserGroup::doCapture() - trigger setup does not match analyser hardware\n");
+      throw MyException("AnalyserGroup::doCapture() - trigger setup does not match analyser hardware");
+   }
+
+   Barrier                        barrier(numMembers);
+   std::atomic<bool>              cancel{false};
+   std::vector<Clock::time_point> armTimes(numMembers);
+   std::vector<std::future<bool>> results;
+
+   for (unsigned index=0; index<numMembers; index++) {
+      results.push_back(members[index].ioThread->submit([&, index]() {
+         AnalyserSession &analyser = *members[index].analyser;
+         FT2232          &ft2232   = *members[index].ft2232;
+         Setup           &setup    = *setups[index];
+         WaitMode         mode     = members[index].waitMode;
+         const bool       notify   = (mode == WaitMode::Notify);
+
+         // Start command is prepared before the barrier so nothing else is done between release and arming
+         CommandBuilder arm;
+         arm.armCapture(setup, notify);
+
+         try {
+            uint8_t status;
+            {
+               ActivityTimer timer(ft2232.getStatistics(), Activity::StartCapture);
+               CommandBuilder configure;
+               configure.configureCapture(setup, ft2232.getTransferProfile().blockSize, &analyser.getLutCache());
+               timer.addBytes(configure.size()+arm.size());
+               configure.execute(ft2232, &status, 1);
+            }
+            if ((status&C_STATUS_STATE_MASK) != C_STATUS_STATE_IDLE) {
+               fprintf(stderr, "Unexpected analyser state in AnalyserGroup::doCapture\n");
+               throw MyException("Unexpected analyser state in AnalyserGroup::doCapture");
+            }
+         } catch (...) {
+            analyser.getLutCache().invalidate();
+            barrier.abandon();
+            cancel = true;
+            throw;
+         }
+         if (!barrier.arriveAndWait()) {
+            return false;
+         }
+         try {
+            armTimes[index] = Clock::now();
+            traceLog.record(TraceEvent::ArmCapture, &ft2232,
+                  setup.getSampleRate()|C_CONTROL_START_ACQ|(notify?C_CONTROL_NOTIFY:0));
+            uint8_t status[1];
+            arm.execute(ft2232, status, arm.getResponseSize());
+
+            bool complete = !notify && ((status[0]&C_STATUS_STATE_MASK) == C_STATUS_STATE_DONE);
+            if (!complete) {
+               complete = waitForCaptureComplete(ft2232, setup, mode, timeout_ms, &cancel);
+            }
+            if (!complete) {
+               if (notify) {
+                  // Discard late completion status
+                  writeControl(ft2232, setup.getSampleRate());
+                  ft2232.purgeRx();
+               }
+               return false;
+            }
+            readCaptureData(analyser, buffers[index], setup.getSampleSize());
+            return true;
+         } catch (...) {
+            cancel = true;
+            throw;
+         }
+      }));
+   }
+
+   bool               complete = true;
+   std::exception_ptr error    = nullptr;
+   for (std::future<bool> &result:results) {
+      try {
+         complete = result.get() && complete;
+      } catch (...) {
+         if (error == nullptr) {
+            error = std::current_exception();
+         }
+         complete = false;
+      }
+   }
+   if (error != nullptr) {
+      std::rethrow_exception(error);
+   }
+   if (numMembers > 0) {
+      auto range = std::minmax_element(armTimes.begin(), armTimes.end());
+      armSkew = std::chrono::duration_cast<std::chrono::nanoseconds>(*range.second-*range.first);
+   }
+   return complete;
+}
+
+template bool AnalyserGroup::doCapture(TriggerEncoding<16, 16, 2, 16>::TriggerSetup *const [], TriggerEncoding<16, 16, 2, 16>::Sample *const [], unsigned);
+template bool AnalyserGroup::doCapture(TriggerEncoding<16, 16, 4, 16>::TriggerSetup *const [], TriggerEncoding<16, 16, 4, 16>::Sample *const [], unsigned);
+template bool AnalyserGroup::doCapture(TriggerEncoding<32, 16, 2, 16>::TriggerSetup *const [], TriggerEncoding<32, 16, 2, 16>::Sample *const [], unsigned);
+template bool AnalyserGroup::doCapture(TriggerEncoding<32, 16, 4, 16>::TriggerSetup *const [], TriggerEncoding<32, 16, 4, 16>::Sample *const [], unsigned);
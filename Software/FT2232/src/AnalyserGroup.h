@@ -0,0 +1,187 @@
+/*
+ * AnalyserGroup.h
+ *
+ *  Created on: 10 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_ANALYSERGROUP_H_
+#define SOURCES_ANALYSERGROUP_H_
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <chrono>
+
+#include "FT2232.h"
+#include "AnalyserSession.h"
+#include "AnalyserCommands.h"
+
+/**
+ * Thread that executes tasks for a single device in order
+ */
+class IoThread {
+private:
+   std::mutex                              mutex;
+   std::condition_variable                 taskAdded;
+   std::deque<std::packaged_task<bool()>>  tasks;
+   bool                                    stop = false;
+   std::thread                             thread;
+
+   void run();
+
+public:
+   IoThread();
+
+   /**
+    * Completes queued tasks then stops thread
+    */
+   ~IoThread();
+
+   /**
+    * Queue task for execution on this thread
+    *
+    * @param task Task to execute
+    *
+    * @return Result of task (exceptions are passed through)
+    */
+   std::future<bool> submit(std::function<bool()> task);
+
+   IoThread(const IoThread &) = delete;
+   IoThread &operator=(const IoThread &) = delete;
+};
+
+/**
+ * Several analysers captured together to provide more channels.
+ *
+ * Each analyser has its own I/O thread.
+ * For a capture all analysers are configured in parallel, then armed
+ * (C_CONTROL_START_ACQ) together after a barrier and read back in parallel.
+ */
+class AnalyserGroup {
+private:
+   struct Member {
+      FT2232Ptr                        ft2232;
+      std::unique_ptr<AnalyserSession> analyser;
+      WaitMode                         waitMode;
+      std::unique_ptr<IoThread>        ioThread;
+   };
+
+   std::vector<Member> members;
+
+   /// Spread of arm times in last capture
+   std::chrono::nanoseconds armSkew{0};
+
+public:
+   AnalyserGroup() {
+   }
+
+   /**
+    * Open analysers
+    *
+    * @param selectors  Devices to open (in group order)
+    * @param verbose    Print device information while opening
+    *
+    * @throw MyException if any device cannot be opened
+    */
+   AnalyserGroup(const std::vector<DeviceSelector> &selectors, bool verbose = false);
+
+   /**
+    * Add analyser to group
+    * The analyser is identified (identifyAnalyser()) to select how capture completion is detected.
+    * All members must be the same FPGA variant so they share a trigger encoding.
+    *
+    * @param ft2232 Analyser (ownership is taken)
+    *
+    * @throw MyException if the analyser hardware differs from the existing members
+    */
+   void add(FT2232Ptr ft2232);
+
+   /**
+    * Get hardware configuration shared by all members
+    * Used to select the trigger encoding (withTriggerEncoding())
+    *
+    * @return Configuration
+    *
+    * @throw MyException if the group is empty
+    */
+   const Analyser::AnalyserConfig &getAnalyserConfig() const;
+
+   /**
+    * @return Number of analysers in group
+    */
+   unsigned size() const {
+      return members.size();
+   }
+
+   /**
+    * Get analyser
+    * This should not be used while a capture is in progress
+    *
+    * @param index Index in group
+    *
+    * @return Analyser
+    */
+   AnalyserSession &operator[](unsigned index) {
+      return *members[index].analyser;
+   }
+
+   /**
+    * Configure all analysers, arm them together and read data in parallel
+    *
+    * @tparam Setup      TriggerSetup of the encoding matching the members (see getAnalyserConfig())
+    *
+    * @param setups      Trigger setup for each analyser
+    * @param buffers     Buffer for each analyser (setups[n]->getSampleSize() samples)
+    * @param timeout_ms  Maximum time to wait for capture in ms (0 => no limit)
+    *
+    * @return true  => All captures complete and data read
+    * @return false => Timeout
+    *
+    * @throw MyException if the setup does not match the analyser hardware
+    * @throw MyException if any analyser fails (the others are abandoned)
+    */
+   template<typename Setup>
+   bool doCapture(
+         Setup *const                              setups[],
+         typename Setup::Encoding::Sample *const   buffers[],
+         unsigned                                  timeout_ms = 0);
+
+   /**
+    * Configure all analysers with the same setup, arm them together and read data in parallel
+    *
+    * @tparam Setup      TriggerSetup of the encoding matching the members (see getAnalyserConfig())
+    *
+    * @param setup       Trigger setup
+    * @param buffers     Buffer for each analyser (setup.getSampleSize() samples)
+    * @param timeout_ms  Maximum time to wait for capture in ms (0 => no limit)
+    *
+    * @return true  => All captures complete and data read
+    * @return false => Timeout
+    */
+   template<typename Setup>
+   bool doCapture(
+         Setup                                    &setup,
+         typename Setup::Encoding::Sample *const   buffers[],
+         unsigned                                  timeout_ms = 0) {
+      std::vector<Setup *> setups(members.size(), &setup);
+      return doCapture(setups.data(), buffers, timeout_ms);
+   }
+
+   /**
+    * Get spread between first and last analyser being armed in the last capture
+    * This is measured when the start command was handed to the driver
+    *
+    * @return Spread
+    */
+   std::chrono::nanoseconds getArmSkew() const {
+      return armSkew;
+   }
+};
+
+#endif /* SOURCES_ANALYSERGROUP_H_ */
@@ -0,0 +1,128 @@
+/*
+ * AnalyserSession.h
+ *
+ *  Created on: 12 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_ANALYSERSESSION_H_
+#define SOURCES_ANALYSERSESSION_H_
+
+#include <stdint.h>
+
+#include "EncodeLuts.h"
+#include "FT2232.h"
+#include "LutCache.h"
+
+/**
+ * Analyser protocol state for an analyser reached through a FT2232 transport.
+ *
+ * The transport only moves bytes. What the host knows about the analyser
+ * at the other end is kept here:
+ *  - The hardware configuration (from C_RD_CONFIG, see identifyAnalyser())
+ *  - The trigger LUTs last sent (see LutCache)
+ *  - The capture mode and channel mask registers last written
+ *
+ * The transport must outlive the session.
+ */
+class AnalyserSession {
+
+private:
+   /// Transport used to reach the analyser
+   FT2232 &ft2232;
+
+   /// Trigger LUTs last sent to analyser
+   LutCache lutCache;
+
+   /// Size of trigger hardware (from C_RD_CONFIG)
+   Analyser::AnalyserConfig analyserConfig = Analyser::DEFAULT_ANALYSER_CONFIG;
+
+   /// Capture mode and channel mask registers last written to analyser
+   uint8_t  modeRegister    = Analyser::C_MODE_RAW;
+   uint32_t channelRegister = 0xFFFFFFFF;
+
+public:
+   /**
+    * Create session for analyser
+    * The analyser should be identified (identifyAnalyser()) before use.
+    *
+    * @param ft2232 Transport used to reach the analyser
+    */
+   explicit AnalyserSession(FT2232 &ft2232) : ft2232(ft2232) {
+   }
+
+   /**
+    * Get transport used to reach the analyser
+    *
+    * @return Transport
+    */
+   FT2232 &getTransport() {
+      return ft2232;
+   }
+
+   /**
+    * Get copy of the trigger LUTs last sent to the analyser
+    * This should be invalidated if LUTs are sent without using it
+    *
+    * @return LUT cache for this analyser
+    */
+   LutCache &getLutCache() {
+      return lutCache;
+   }
+
+   /**
+    * Get size of the trigger hardware of the analyser
+    * This is DEFAULT_ANALYSER_CONFIG until set by identifyAnalyser()
+    *
+    * @return Hardware configuration
+    */
+   const Analyser::AnalyserConfig &getAnalyserConfig() const {
+      return analyserConfig;
+   }
+
+   /**
+    * Set size of the trigger hardware of the analyser
+    * The LUT cache is invalidated if this changes
+    *
+    * @param config Hardware configuration
+    */
+   void setAnalyserConfig(const Analyser::AnalyserConfig &config) {
+      if (config != analyserConfig) {
+         lutCache.invalidate();
+      }
+      analyserConfig = config;
+   }
+
+   /**
+    * Record capture mode register written to analyser (see writeMode())
+    *
+    * @param modeValue Value written
+    */
+   void setModeRegister(uint8_t modeValue) {
+      modeRegister = modeValue;
+   }
+
+   /**
+    * Record channel mask written to analyser (see writeChannels())
+    *
+    * @param channelMask Value written
+    */
+   void setChannelRegister(uint32_t channelMask) {
+      channelRegister = channelMask;
+   }
+
+   /**
+    * Get number of bits read back for each captured sample
+    * This is less than the sample size when C_MODE_PACK is in use
+    *
+    * @return Bits per sample (4, 8 or full sample size)
+    */
+   unsigned getReadbackSampleBits() const {
+      return Analyser::getReadbackSampleBits(modeRegister, channelRegister, analyserConfig.getBytesPerSample());
+   }
+
+   AnalyserSession(const AnalyserSession &) = delete;
+   AnalyserSession &operator=(const AnalyserSession &) = delete;
+};
+
+#endif /* SOURCES_ANALYSERSESSION_H_ */
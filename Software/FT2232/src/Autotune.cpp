@@ -0,0 +1,182 @@
+//============================================================================
+// Name        : Autotune.cpp
+// Author      : pgo
+// Finds the USB transfer parameters giving best latency and throughput
+//============================================================================
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include <functional>
+
+#include "console.h"
+#include "EncodeLuts.h"
+#include "CommandBuilder.h"
+#include "AnalyserCommands.h"
+#include "PackedSamples.h"
+#include "Autotune.h"
+
+using namespace Analyser;
+
+/// Candidate values swept
+static const unsigned LATENCY_TIMER_VALUES[]  = {1, 2, 4, 8, 16};
+static const unsigned IN_TRANSFER_SIZES[]     = {512, 4096, 16384, 65536};
+static const unsigned BLOCK_SIZES[]           = {4096, 16384, 30000, 60000, 65532};
+static const unsigned OUT_TRANSFER_SIZES[]    = {512, 4096, 16384};
+
+/// Fraction of best throughput that may be traded for lower latency
+static constexpr double THROUGHPUT_TOLERANCE = 0.9;
+
+TransferMeasurement measureTransferProfile(AnalyserSession &analyser, unsigned repeats, unsigned sampleCount) {
+   using Clock = std::chrono::steady_clock;
+   using us    = std::chrono::duration<double, std::micro>;
+
+   FT2232 &ft2232 = analyser.getTransport();
+
+   TransferMeasurement measurement;
+
+   ft2232.purge();
+
+   // Round trip - single byte responses always wait for the latency timer
+   auto start = Clock::now();
+   for (unsigned count=0; count<repeats; count++) {
+      readStatus(ft2232);
+   }
+   measurement.roundTrip_us = us(Clock::now()-start).count()/repeats;
+
+   // LUT image size and sample type depend on the analyser hardware
+   withTriggerEncoding(analyser.getAnalyserConfig(), [&](auto tag) {
+      using Encoding = typename decltype(tag)::Encoding;
+      using Sample   = typename Encoding::Sample;
+
+      // Setup time - LUT image is the largest command sequence sent to the analyser
+      static const uint32_t lutValues[Encoding::TOTAL_TRIGGER_LUTS] = {0};
+      analyser.getLutCache().invalidate();
+      CommandBuilder builder;
+      builder.writeLuts(lutValues, Encoding::TOTAL_TRIGGER_LUTS, ft2232.getTransferProfile().blockSize).readStatus();
+      uint8_t status;
+      start = Clock::now();
+      for (unsigned count=0; count<repeats; count++) {
+         builder.execute(ft2232, &status, 1);
+      }
+      measurement.setupTime_us = us(Clock::now()-start).count()/repeats;
+
+      // Throughput - contents of SDRAM are irrelevant
+      // Bytes transferred allow for packed readback (C_MODE_PACK)
+      const size_t sizeInBytes = getPackedSize(sampleCount, analyser.getReadbackSampleBits(), sizeof(Sample));
+      std::vector<Sample> buffer(sampleCount);
+      start = Clock::now();
+      readCaptureData(analyser, buffer.data(), sampleCount);
+      measurement.throughput_MBps = sizeInBytes/us(Clock::now()-start).count();
+   });
+
+   return measurement;
+}
+
+/**
+ * Measure each candidate value for one profile field
+ *
+ * @param analyser   Interface to analyser
+ * @param profile    Profile to modify (other fields unchanged)
+ * @param field      Field being swept
+ * @param values     Candidate values
+ * @param count      Number of candidates
+ * @param name       Name of field for reporting
+ * @param verbose    Report measurements
+ *
+ * @return Measurement for each candidate
+ */
+static std::vector<TransferMeasurement> sweep(
+      AnalyserSession  &analyser,
+      TransferProfile   profile,
+      unsigned          TransferProfile::*field,
+      const unsigned    values[],
+      unsigned          count,
+      const char       *name,
+      bool              verbose) {
+
+   std::vector<TransferMeasurement> results;
+   for (unsigned index=0; index<count; index++) {
+      profile.*field = values[index];
+      analyser.getTransport().setTransferProfile(profile);
+      TransferMeasurement m = measureTransferProfile(analyser);
+      if (verbose) {
+         printf("  %-16s = %6u : round trip = %8.1f us, setup = %8.1f us, throughput = %6.2f MB/s\n",
+               name, values[index], m.roundTrip_us, m.setupTime_us, m.throughput_MBps);
+      }
+      results.push_back(m);
+   }
+   return results;
+}
+
+/**
+ * Select the candidate with the lowest cost
+ *
+ * @param results Measurements
+ * @param cost    Cost of a measurement
+ *
+ * @return Index of best candidate
+ */
+static unsigned selectBest(
+      const std::vector<TransferMeasurement>                   &results,
+      const std::function<double(const TransferMeasurement &)> &cost) {
+
+   unsigned best = 0;
+   for (unsigned index=1; index<results.size(); index++) {
+      if (cost(results[index]) < cost(results[best])) {
+         best = index;
+      }
+   }
+   return best;
+}
+
+TransferProfile autotune(AnalyserSession &analyser, bool save, bool verbose) {
+   constexpr unsigned NUM_LATENCY_VALUES = sizeof(LATENCY_TIMER_VALUES)/sizeof(LATENCY_TIMER_VALUES[0]);
+   constexpr unsigned NUM_IN_SIZES       = sizeof(IN_TRANSFER_SIZES)/sizeof(IN_TRANSFER_SIZES[0]);
+   constexpr unsigned NUM_BLOCK_SIZES    = sizeof(BLOCK_SIZES)/sizeof(BLOCK_SIZES[0]);
+   constexpr unsigned NUM_OUT_SIZES      = sizeof(OUT_TRANSFER_SIZES)/sizeof(OUT_TRANSFER_SIZES[0]);
+
+   FT2232 &ft2232 = analyser.getTransport();
+
+   TransferProfile best = ft2232.getTransferProfile();
+
+   if (verbose) {
+      printf("Autotuning '%s'\n", ft2232.getSerialNumber().c_str());
+   }
+
+   // Throughput first so the latency timer is chosen against a representative transfer size
+   std::vector<TransferMeasurement> results =
+         sweep(analyser, best, &TransferProfile::inTransferSize, IN_TRANSFER_SIZES, NUM_IN_SIZES, "inTransferSize", verbose);
+   best.inTransferSize = IN_TRANSFER_SIZES[
+      selectBest(results, [](const TransferMeasurement &m){ return -m.throughput_MBps; })];
+
+   results = sweep(analyser, best, &TransferProfile::blockSize, BLOCK_SIZES, NUM_BLOCK_SIZES, "blockSize", verbose);
+   best.blockSize = BLOCK_SIZES[
+      selectBest(results, [](const TransferMeasurement &m){ return -m.throughput_MBps; })];
+
+   // Lowest latency that does not cost significant throughput
+   results = sweep(analyser, best, &TransferProfile::latencyTimer_ms, LATENCY_TIMER_VALUES, NUM_LATENCY_VALUES, "latencyTimer_ms", verbose);
+   double bestThroughput = results[selectBest(results, [](const TransferMeasurement &m){ return -m.throughput_MBps; })].throughput_MBps;
+   best.latencyTimer_ms = LATENCY_TIMER_VALUES[
+      selectBest(results, [bestThroughput](const TransferMeasurement &m) {
+      if (m.throughput_MBps < THROUGHPUT_TOLERANCE*bestThroughput) {
+         return 1e12;
+      }
+      return m.roundTrip_us;
+   })];
+
+   results = sweep(analyser, best, &TransferProfile::outTransferSize, OUT_TRANSFER_SIZES, NUM_OUT_SIZES, "outTransferSize", verbose);
+   best.outTransferSize = OUT_TRANSFER_SIZES[
+      selectBest(results, [](const TransferMeasurement &m){ return m.setupTime_us; })];
+
+   ft2232.setTransferProfile(best);
+   ft2232.purge();
+
+   if (verbose) {
+      printf("Best profile: latency=%u ms, in=%u, out=%u, block=%u\n",
+            best.latencyTimer_ms, best.inTransferSize, best.outTransferSize, best.blockSize);
+   }
+   if (save) {
+      ft2232.saveTransferProfile();
+   }
+   return best;
+}
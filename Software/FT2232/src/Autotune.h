@@ -0,0 +1,61 @@
+/*
+ * Autotune.h
+ *
+ *  Created on: 8 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_AUTOTUNE_H_
+#define SOURCES_AUTOTUNE_H_
+
+#include "FT2232.h"
+#include "AnalyserSession.h"
+
+/**
+ * Measured performance of a transfer profile
+ */
+struct TransferMeasurement {
+   double roundTrip_us;     //!< Average time for a single status request and response
+   double setupTime_us;     //!< Average time to load trigger LUTs and read status
+   double throughput_MBps;  //!< Capture readback rate in MB/s (10^6 bytes/s)
+};
+
+/**
+ * Measure performance of the current transfer profile
+ *
+ * The analyser should be idle and identified (identifyAnalyser()) so
+ * the LUT image and samples read match its hardware.
+ * The trigger LUTs are overwritten.
+ *
+ * @param analyser    Interface to analyser
+ * @param repeats     Number of requests averaged for latency measurements
+ * @param sampleCount Number of samples read to measure throughput
+ *
+ * @return Measurements
+ */
+TransferMeasurement measureTransferProfile(AnalyserSession &analyser, unsigned repeats = 20, unsigned sampleCount = 1U<<20);
+
+/**
+ * Find the best transfer profile for the analyser.
+ *
+ * Each parameter is swept in turn with the others held at the best value found so far:
+ *  - IN transfer size   - highest throughput
+ *  - Block size         - highest throughput
+ *  - Latency timer      - lowest round trip that keeps 90% of the best throughput
+ *  - OUT transfer size  - lowest setup time
+ *
+ * The best profile is left applied.
+ * The analyser should be idle and identified (identifyAnalyser()).
+ * The trigger LUTs must be re-loaded afterwards.
+ *
+ * @param analyser Interface to analyser
+ * @param save     Save the profile for this device (applied by FT2232::open() in future)
+ * @param verbose  Report measurements
+ *
+ * @return Best profile found
+ *
+ * @throw MyException on communication failure
+ */
+TransferProfile autotune(AnalyserSession &analyser, bool save = true, bool verbose = false);
+
+#endif /* SOURCES_AUTOTUNE_H_ */
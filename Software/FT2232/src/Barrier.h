@@ -0,0 +1,65 @@
+/*
+ * Barrier.h
+ *
+ *  Created on: 10 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_BARRIER_H_
+#define SOURCES_BARRIER_H_
+
+#include <atomic>
+#include <thread>
+
+/**
+ * Single-use barrier for a fixed number of threads.
+ *
+ * Waiting threads spin (yielding) rather than block so all are released
+ * within a scheduling quantum of the last arrival.
+ * The barrier may be abandoned by a thread that cannot arrive (e.g. on error).
+ */
+class Barrier {
+private:
+   const unsigned        count;
+   std::atomic<unsigned> arrived{0};
+   std::atomic<bool>     released{false};
+   std::atomic<bool>     abandoned{false};
+
+public:
+   /**
+    * @param count Number of threads that must arrive
+    */
+   explicit Barrier(unsigned count) : count(count) {
+   }
+
+   /**
+    * Wait until all threads have arrived
+    *
+    * @return true  => All threads arrived
+    * @return false => Barrier was abandoned
+    */
+   bool arriveAndWait() {
+      if ((arrived.fetch_add(1, std::memory_order_acq_rel)+1) == count) {
+         released.store(true, std::memory_order_release);
+      }
+      while (!released.load(std::memory_order_acquire)) {
+         if (abandoned.load(std::memory_order_acquire)) {
+            return false;
+         }
+         std::this_thread::yield();
+      }
+      return !abandoned.load(std::memory_order_acquire);
+   }
+
+   /**
+    * Release waiting threads without completing the barrier
+    */
+   void abandon() {
+      abandoned.store(true, std::memory_order_release);
+   }
+
+   Barrier(const Barrier &) = delete;
+   Barrier &operator=(const Barrier &) = delete;
+};
+
+#endif /* SOURCES_BARRIER_H_ */
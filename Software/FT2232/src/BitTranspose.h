@@ -0,0 +1,240 @@
+/*
+ * BitTranspose.h
+ *
+ *  Created on: 14 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_BITTRANSPOSE_H_
+#define SOURCES_BITTRANSPOSE_H_
+
+#include <stdint.h>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Square bit matrices are held as an array of rows.
+ * Bit c of rows[r] is element (r,c).
+ *
+ * The transpose functions exchange element (r,c) and (c,r) in place i.e.
+ * bit c of rows[r] becomes bit r of rows[c].
+ *
+ * Each size has a portable version that may be evaluated at compile time.
+ * At run time SSE2 or AVX2 is used when available.
+ *
+ * Typical uses:
+ *  - Converting a value per trigger step into a LUT per value bit
+ *  - Converting samples into bit planes (one word per channel)
+ */
+
+/**
+ * Row type large enough for a square bit matrix of the given size
+ *
+ * @tparam bits Size of matrix (<=64)
+ */
+template<unsigned bits>
+using BitMatrixRow =
+      std::conditional_t<(bits<=16), uint16_t,
+      std::conditional_t<(bits<=32), uint32_t, uint64_t>>;
+
+/**
+ * Transpose a square bit matrix (portable)
+ * Swaps successively smaller off-diagonal blocks (log2(N) passes of N/2 row pairs).
+ *
+ * @tparam T     Row type (uint16_t, uint32_t, uint64_t) - matrix is 8*sizeof(T) square
+ *
+ * @param rows   Matrix to transpose in place
+ */
+template<typename T>
+static constexpr void transposeBitsPortable(T rows[]) {
+   constexpr unsigned size = 8*sizeof(T);
+
+   T mask = (T)(~(T)0)>>(size/2);
+   for (unsigned blockSize=size/2; blockSize!=0; blockSize>>=1, mask ^= (T)(mask<<blockSize)) {
+      for (unsigned row=0; row<size; row=(row+blockSize+1)&~blockSize) {
+         // Exchange (row, col+blockSize) with (row+blockSize, col) for col in low half of each block
+         T t = ((rows[row]>>blockSize) ^ rows[row+blockSize]) & mask;
+         rows[row]           ^= (T)(t<<blockSize);
+         rows[row+blockSize] ^= t;
+      }
+   }
+}
+
+#if defined(__SSE2__)
+/**
+ * Transpose 16x16 bit matrix using SSE2
+ * The rows are split into low and high bytes and each output row is collected
+ * by _mm_movemask_epi8() from the top bit of each byte.
+ *
+ * @param rows Matrix to transpose in place
+ */
+static inline void transposeBits16_sse2(uint16_t rows[16]) {
+   const __m128i byteMask = _mm_set1_epi16(0x00FF);
+
+   __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows));
+   __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows+8));
+
+   // Byte n = low/high byte of row n
+   __m128i low  = _mm_packus_epi16(_mm_and_si128(r0, byteMask), _mm_and_si128(r1, byteMask));
+   __m128i high = _mm_packus_epi16(_mm_srli_epi16(r0, 8), _mm_srli_epi16(r1, 8));
+
+   for (unsigned bit=0; bit<8; bit++) {
+      rows[15-bit] = (uint16_t)_mm_movemask_epi8(high);
+      rows[7-bit]  = (uint16_t)_mm_movemask_epi8(low);
+      high = _mm_add_epi8(high, high);
+      low  = _mm_add_epi8(low, low);
+   }
+}
+
+/**
+ * Transpose 32x32 bit matrix using SSE2 (or AVX2 if available)
+ * Each byte plane of the rows is gathered into a vector and each output row
+ * is collected by movemask from the top bit of each byte.
+ *
+ * @param rows Matrix to transpose in place
+ */
+static inline void transposeBits32_simd(uint32_t rows[32]) {
+#if defined(__AVX2__)
+   __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows));
+   __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows+8));
+   __m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows+16));
+   __m256i v3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows+24));
+
+   // Within each 128-bit lane arrange as 4 dwords, dword n = byte n of the 4 rows
+   const __m256i byteGather = _mm256_setr_epi8(
+         0,4,8,12,1,5,9,13,2,6,10,14,3,7,11,15,
+         0,4,8,12,1,5,9,13,2,6,10,14,3,7,11,15);
+   v0 = _mm256_shuffle_epi8(v0, byteGather);
+   v1 = _mm256_shuffle_epi8(v1, byteGather);
+   v2 = _mm256_shuffle_epi8(v2, byteGather);
+   v3 = _mm256_shuffle_epi8(v3, byteGather);
+
+   // Collect the same byte plane from each register
+   __m256i t0 = _mm256_unpacklo_epi32(v0, v1);
+   __m256i t1 = _mm256_unpackhi_epi32(v0, v1);
+   __m256i t2 = _mm256_unpacklo_epi32(v2, v3);
+   __m256i t3 = _mm256_unpackhi_epi32(v2, v3);
+
+   // Lanes hold rows 0-3,8-11,16-19,24-27 | 4-7,12-15,20-23,28-31 - restore row order
+   const __m256i rowOrder = _mm256_setr_epi32(0,4,1,5,2,6,3,7);
+   __m256i planes[4] = {
+         _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(t0, t2), rowOrder),
+         _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(t0, t2), rowOrder),
+         _mm256_permutevar8x32_epi32(_mm256_unpacklo_epi64(t1, t3), rowOrder),
+         _mm256_permutevar8x32_epi32(_mm256_unpackhi_epi64(t1, t3), rowOrder),
+   };
+   for (unsigned bit=0; bit<8; bit++) {
+      for (unsigned plane=0; plane<4; plane++) {
+         rows[8*plane+7-bit] = (uint32_t)_mm256_movemask_epi8(planes[plane]);
+         planes[plane] = _mm256_add_epi8(planes[plane], planes[plane]);
+      }
+   }
+#else
+   const __m128i byteMask = _mm_set1_epi32(0xFF);
+
+   // planes[half][n] = byte n of rows 16*half..16*half+15
+   __m128i planes[2][4];
+   for (unsigned half=0; half<2; half++) {
+      const __m128i *p = reinterpret_cast<const __m128i *>(rows+16*half);
+      __m128i v0 = _mm_loadu_si128(p);
+      __m128i v1 = _mm_loadu_si128(p+1);
+      __m128i v2 = _mm_loadu_si128(p+2);
+      __m128i v3 = _mm_loadu_si128(p+3);
+      for (unsigned plane=0; plane<4; plane++) {
+         // Values are masked to 8 bits so signed saturation has no effect
+         __m128i a = _mm_packs_epi32(_mm_and_si128(v0, byteMask), _mm_and_si128(v1, byteMask));
+         __m128i b = _mm_packs_epi32(_mm_and_si128(v2, byteMask), _mm_and_si128(v3, byteMask));
+         planes[half][plane] = _mm_packus_epi16(a, b);
+         v0 = _mm_srli_epi32(v0, 8);
+         v1 = _mm_srli_epi32(v1, 8);
+         v2 = _mm_srli_epi32(v2, 8);
+         v3 = _mm_srli_epi32(v3, 8);
+      }
+   }
+   for (unsigned bit=0; bit<8; bit++) {
+      for (unsigned plane=0; plane<4; plane++) {
+         rows[8*plane+7-bit] =
+               (uint32_t)(uint16_t)_mm_movemask_epi8(planes[0][plane]) |
+               ((uint32_t)(uint16_t)_mm_movemask_epi8(planes[1][plane])<<16);
+         planes[0][plane] = _mm_add_epi8(planes[0][plane], planes[0][plane]);
+         planes[1][plane] = _mm_add_epi8(planes[1][plane], planes[1][plane]);
+      }
+   }
+#endif
+}
+
+/**
+ * Transpose 64x64 bit matrix as four 32x32 blocks
+ * Block (i,j) of the result is the transpose of block (j,i).
+ *
+ * @param rows Matrix to transpose in place
+ */
+static inline void transposeBits64_simd(uint64_t rows[64]) {
+   uint32_t blocks[2][2][32];
+
+   for (unsigned row=0; row<32; row++) {
+      blocks[0][0][row] = (uint32_t)rows[row];
+      blocks[0][1][row] = (uint32_t)(rows[row]>>32);
+      blocks[1][0][row] = (uint32_t)rows[row+32];
+      blocks[1][1][row] = (uint32_t)(rows[row+32]>>32);
+   }
+   transposeBits32_simd(blocks[0][0]);
+   transposeBits32_simd(blocks[0][1]);
+   transposeBits32_simd(blocks[1][0]);
+   transposeBits32_simd(blocks[1][1]);
+   for (unsigned row=0; row<32; row++) {
+      rows[row]    = blocks[0][0][row] | ((uint64_t)blocks[1][0][row]<<32);
+      rows[row+32] = blocks[0][1][row] | ((uint64_t)blocks[1][1][row]<<32);
+   }
+}
+#endif
+
+/**
+ * Transpose 16x16 bit matrix
+ *
+ * @param rows Matrix to transpose in place
+ */
+static constexpr void transposeBits(uint16_t rows[16]) {
+#if defined(__SSE2__)
+   if (!__builtin_is_constant_evaluated()) {
+      transposeBits16_sse2(rows);
+      return;
+   }
+#endif
+   transposeBitsPortable(rows);
+}
+
+/**
+ * Transpose 32x32 bit matrix
+ *
+ * @param rows Matrix to transpose in place
+ */
+static constexpr void transposeBits(uint32_t rows[32]) {
+#if defined(__SSE2__)
+   if (!__builtin_is_constant_evaluated()) {
+      transposeBits32_simd(rows);
+      return;
+   }
+#endif
+   transposeBitsPortable(rows);
+}
+
+/**
+ * Transpose 64x64 bit matrix
+ *
+ * @param rows Matrix to transpose in place
+ */
+static constexpr void transposeBits(uint64_t rows[64]) {
+#if defined(__SSE2__)
+   if (!__builtin_is_constant_evaluated()) {
+      transposeBits64_simd(rows);
+      return;
+   }
+#endif
+   transposeBitsPortable(rows);
+}
+
+#endif /* SOURCES_BITTRANSPOSE_H_ */
@@ -0,0 +1,106 @@
+/*
+ * ByteSwap.h
+ *
+ *  Created on: 5 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_BYTESWAP_H_
+#define SOURCES_BYTESWAP_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Sample data is transferred from the analyser low byte first
+ */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+static constexpr bool HOST_IS_LITTLE_ENDIAN = false;
+#else
+static constexpr bool HOST_IS_LITTLE_ENDIAN = true;
+#endif
+
+/**
+ * Swap the bytes of each value in a buffer (in place)
+ *
+ * @param data    Values to swap
+ * @param count   Number of values
+ */
+static inline void swapBytes16(uint16_t data[], size_t count) {
+   size_t index = 0;
+
+#if defined(__AVX2__)
+   const __m256i shuffle = _mm256_setr_epi8(
+         1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,
+         1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+   for (; index+16<=count; index+=16) {
+      __m256i *p = reinterpret_cast<__m256i *>(data+index);
+      _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), shuffle));
+   }
+#endif
+#if defined(__SSE2__)
+   for (; index+8<=count; index+=8) {
+      __m128i *p = reinterpret_cast<__m128i *>(data+index);
+      __m128i  v = _mm_loadu_si128(p);
+      _mm_storeu_si128(p, _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+   }
+#endif
+   for (; index<count; index++) {
+      data[index] = (uint16_t)((data[index]<<8)|(data[index]>>8));
+   }
+}
+
+/**
+ * Swap the bytes of each value in a buffer (in place)
+ *
+ * @param data    Values to swap
+ * @param count   Number of values
+ */
+static inline void swapBytes32(uint32_t data[], size_t count) {
+   size_t index = 0;
+
+#if defined(__AVX2__)
+   const __m256i shuffle = _mm256_setr_epi8(
+         3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12,
+         3,2,1,0,7,6,5,4,11,10,9,8,15,14,13,12);
+   for (; index+8<=count; index+=8) {
+      __m256i *p = reinterpret_cast<__m256i *>(data+index);
+      _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), shuffle));
+   }
+#endif
+   for (; index<count; index++) {
+      data[index] = __builtin_bswap32(data[index]);
+   }
+}
+
+/**
+ * Convert sample data received from the analyser (low byte first) to host order (in place)
+ * This does nothing on a little-endian host.
+ *
+ * @param data    Values to convert
+ * @param count   Number of values
+ */
+static inline void samplesToHostOrder(uint16_t data[], size_t count) {
+   if (!HOST_IS_LITTLE_ENDIAN) {
+      swapBytes16(data, count);
+   }
+}
+
+/**
+ * Convert sample data received from the analyser (low byte first) to host order (in place)
+ * This does nothing on a little-endian host.
+ *
+ * @param data    Values to convert
+ * @param count   Number of values
+ */
+static inline void samplesToHostOrder(uint32_t data[], size_t count) {
+   if (!HOST_IS_LITTLE_ENDIAN) {
+      swapBytes32(data, count);
+   }
+}
+
+#endif /* SOURCES_BYTESWAP_H_ */
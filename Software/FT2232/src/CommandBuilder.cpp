@@ -0,0 +1,214 @@
+//============================================================================
+// Name        : CommandBuilder.cpp
+// Author      : pgo
+// Collects analyser commands for transmission in a single transfer
+//============================================================================
+#include <stdio.h>
+#include <algorithm>
+#include "console.h"
+#include "MyException.h"
+#include "EncodeLuts.h"
+#include "CommandBuilder.h"
+#include "LutCache.h"
+
+using namespace Analyser;
+
+CommandBuilder &CommandBuilder::write24(uint8_t command, uint32_t value) {
+   commands.push_back(command);
+   commands.push_back((uint8_t)(value));
+   commands.push_back((uint8_t)(value>>8));
+   commands.push_back((uint8_t)(value>>16));
+   return *this;
+}
+
+template<typename Setup>
+CommandBuilder &CommandBuilder::writeLuts(Setup &setup, unsigned maxBlockSize) {
+   const auto lutImage = setup.getLutImage();
+
+   return writeLutImage(lutImage.data(), lutImage.size(), maxBlockSize);
+}
+
+CommandBuilder &CommandBuilder::writeLutImage(const uint8_t lutImage[], unsigned size, unsigned maxBlockSize) {
+   if ((size%4) != 0) {
+      fprintf(stderr, "CommandBuilder::writeLutImage() - image size %u is not whole LUTs\n", size);
+      throw MyException("CommandBuilder::writeLutImage() - image size %u is not whole LUTs", size);
+   }
+   // Whole LUTs and within 16-bit size field
+   maxBlockSize = std::max(4U, std::min(maxBlockSize, 0xFFFFU)&~3U);
+
+   unsigned bytesRemaining = size;
+   while(bytesRemaining > 0) {
+      unsigned blockSize = bytesRemaining;
+      if (blockSize>maxBlockSize) {
+         blockSize = maxBlockSize;
+      }
+      commands.push_back(C_LUT_CONFIG);
+      commands.push_back((uint8_t)blockSize);
+      commands.push_back((uint8_t)(blockSize>>8));
+      commands.insert(commands.end(), lutImage, lutImage+blockSize);
+      lutImage       += blockSize;
+      bytesRemaining -= blockSize;
+   }
+   return *this;
+}
+
+CommandBuilder &CommandBuilder::writeLuts(const uint32_t lutValues[], unsigned number, unsigned maxBlockSize) {
+   static_assert((MAX_LUT_BLOCK_SIZE%4) == 0, "LUT block must hold whole LUTs");
+
+   // Whole LUTs and within 16-bit size field
+   maxBlockSize = std::max(4U, std::min(maxBlockSize, 0xFFFFU)&~3U);
+
+   unsigned bytesRemaining = 4*number;
+   while(bytesRemaining > 0) {
+      unsigned blockSize = bytesRemaining;
+      if (blockSize>maxBlockSize) {
+         blockSize = maxBlockSize;
+      }
+      commands.push_back(C_LUT_CONFIG);
+      commands.push_back((uint8_t)blockSize);
+      commands.push_back((uint8_t)(blockSize>>8));
+
+      // Each LUT is sent MSB first
+      for (unsigned index=0; index<blockSize/4; index++) {
+         uint32_t value = *lutValues++;
+         commands.push_back((uint8_t)(value>>24));
+         commands.push_back((uint8_t)(value>>16));
+         commands.push_back((uint8_t)(value>>8));
+         commands.push_back((uint8_t)(value));
+      }
+      bytesRemaining -= blockSize;
+   }
+   return *this;
+}
+
+CommandBuilder &CommandBuilder::updateLuts(unsigned recirculateSize, const uint8_t lutImage[], unsigned size) {
+   if ((recirculateSize > 0xFFFF) || (size > 0xFFFF)) {
+      fprintf(stderr, "CommandBuilder::updateLuts() - size too large (%u, %u)\n", recirculateSize, size);
+      throw MyException("CommandBuilder::updateLuts() - size too large (%u, %u)", recirculateSize, size);
+   }
+   commands.push_back(C_LUT_UPDATE);
+   commands.push_back((uint8_t)recirculateSize);
+   commands.push_back((uint8_t)(recirculateSize>>8));
+   commands.push_back((uint8_t)size);
+   commands.push_back((uint8_t)(size>>8));
+   if (size > 0) {
+      commands.insert(commands.end(), lutImage, lutImage+size);
+   }
+   return *this;
+}
+
+CommandBuilder &CommandBuilder::writeControl(uint8_t controlValue) {
+   commands.push_back(C_WR_CONTROL);
+   commands.push_back(controlValue);
+   return *this;
+}
+
+CommandBuilder &CommandBuilder::writeMode(uint8_t modeValue) {
+   commands.push_back(C_WR_MODE);
+   commands.push_back(modeValue);
+   return *this;
+}
+
+CommandBuilder &CommandBuilder::writeChannels(uint32_t channelMask) {
+   commands.push_back(C_WR_CHANNELS);
+   for (unsigned index=0; index<C_CHANNELS_SIZE; index++) {
+      commands.push_back((uint8_t)(channelMask>>(8*index)));
+   }
+   return *this;
+}
+
+CommandBuilder &CommandBuilder::readStatus() {
+   commands.push_back(C_RD_STATUS);
+   commands.push_back(1);
+   responseSize++;
+   return *this;
+}
+
+CommandBuilder &CommandBuilder::readVersion() {
+   commands.push_back(C_RD_VERSION);
+   commands.push_back(1);
+   responseSize++;
+   return *this;
+}
+
+CommandBuilder &CommandBuilder::readConfig() {
+   commands.push_back(C_RD_CONFIG);
+   commands.push_back(C_CONFIG_SIZE);
+   responseSize += C_CONFIG_SIZE;
+   return *this;
+}
+
+CommandBuilder &CommandBuilder::readFill() {
+   commands.push_back(C_RD_FILL);
+   commands.push_back(C_FILL_SIZE);
+   responseSize += C_FILL_SIZE;
+   return *this;
+}
+
+CommandBuilder &CommandBuilder::readSnapshot() {
+   commands.push_back(C_RD_SNAPSHOT);
+   commands.push_back(C_SNAPSHOT_SIZE);
+   responseSize += C_SNAPSHOT_SIZE;
+   return *this;
+}
+
+template<typename Setup>
+CommandBuilder &CommandBuilder::configureCapture(Setup &setup, unsigned maxBlockSize, LutCache *lutCache) {
+   if (lutCache != nullptr) {
+      lutCache->writeLuts(*this, setup, maxBlockSize);
+   }
+   else {
+      writeLuts(setup, maxBlockSize);
+   }
+   return writeCaptureLength(setup.getSampleSize()).
+         writePreTrigger(setup.getPreTrigSize()).
+         writeControl(C_CONTROL_CLEAR).
+         writeControl(setup.getSampleRate()).
+         readStatus();
+}
+
+template<typename Setup>
+CommandBuilder &CommandBuilder::armCapture(Setup &setup, bool notify) {
+   if (notify) {
+      return writeControl(setup.getSampleRate()|C_CONTROL_START_ACQ|C_CONTROL_NOTIFY);
+   }
+   return writeControl(setup.getSampleRate()|C_CONTROL_START_ACQ).
+         readStatus();
+}
+
+template<typename Setup>
+CommandBuilder &CommandBuilder::startCapture(Setup &setup, bool notify, unsigned maxBlockSize, LutCache *lutCache) {
+   return configureCapture(setup, maxBlockSize, lutCache).
+         armCapture(setup, notify);
+}
+
+void CommandBuilder::execute(FT2232 &ft2232, uint8_t response[], unsigned responseSize) {
+   if (responseSize != this->responseSize) {
+      fprintf(stderr, "CommandBuilder::execute() - response size %u != expected %u\n", responseSize, this->responseSize);
+      throw MyException("CommandBuilder::execute() - response size %u != expected %u", responseSize, this->responseSize);
+   }
+   if (commands.size() > 0) {
+      ft2232.transmitData(commands.data(), commands.size());
+   }
+   if (responseSize > 0) {
+      ft2232.receiveData(response, responseSize);
+   }
+}
+
+// FPGA variants (see EncodeLuts.cpp)
+template CommandBuilder &CommandBuilder::writeLuts(TriggerEncoding<16, 16, 2, 16>::TriggerSetup &, unsigned);
+template CommandBuilder &CommandBuilder::configureCapture(TriggerEncoding<16, 16, 2, 16>::TriggerSetup &, unsigned, LutCache *);
+template CommandBuilder &CommandBuilder::armCapture(TriggerEncoding<16, 16, 2, 16>::TriggerSetup &, bool);
+template CommandBuilder &CommandBuilder::startCapture(TriggerEncoding<16, 16, 2, 16>::TriggerSetup &, bool, unsigned, LutCache *);
+template CommandBuilder &CommandBuilder::writeLuts(TriggerEncoding<16, 16, 4, 16>::TriggerSetup &, unsigned);
+template CommandBuilder &CommandBuilder::configureCapture(TriggerEncoding<16, 16, 4, 16>::TriggerSetup &, unsigned, LutCache *);
+template CommandBuilder &CommandBuilder::armCapture(TriggerEncoding<16, 16, 4, 16>::TriggerSetup &, bool);
+template CommandBuilder &CommandBuilder::startCapture(TriggerEncoding<16, 16, 4, 16>::TriggerSetup &, bool, unsigned, LutCache *);
+template CommandBuilder &CommandBuilder::writeLuts(TriggerEncoding<32, 16, 2, 16>::TriggerSetup &, unsigned);
+template CommandBuilder &CommandBuilder::configureCapture(TriggerEncoding<32, 16, 2, 16>::TriggerSetup &, unsigned, LutCache *);
+template CommandBuilder &CommandBuilder::armCapture(TriggerEncoding<32, 16, 2, 16>::TriggerSetup &, bool);
+template CommandBuilder &CommandBuilder::startCapture(TriggerEncoding<32, 16, 2, 16>::TriggerSetup &, bool, unsigned, LutCache *);
+template CommandBuilder &CommandBuilder::writeLuts(TriggerEncoding<32, 16, 4, 16>::TriggerSetup &, unsigned);
+template CommandBuilder &CommandBuilder::configureCapture(TriggerEncoding<32, 16, 4, 16>::TriggerSetup &, unsigned, LutCache *);
+template CommandBuilder &CommandBuilder::armCapture(TriggerEncoding<32, 16, 4, 16>::TriggerSetup &, bool);
+template CommandBuilder &CommandBuilder::startCapture(TriggerEncoding<32, 16, 4, 16>::TriggerSetup &, bool, unsigned, LutCache *);
@@ -0,0 +1,267 @@
+/*
+ * CommandBuilder.h
+ *
+ *  Created on: 6 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_COMMANDBUILDER_H_
+#define SOURCES_COMMANDBUILDER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "EncodeLuts.h"
+#include "FT2232.h"
+
+class LutCache;
+
+/**
+ * Collects a sequence of analyser commands so they can be sent in a single USB transfer
+ *
+ * Example:
+ * @code
+ *    uint8_t status[2];
+ *    CommandBuilder().
+ *       writeLuts(setup).
+ *       writeCaptureLength(setup.getSampleSize()).
+ *       writePreTrigger(setup.getPreTrigSize()).
+ *       writeControl(C_CONTROL_CLEAR).
+ *       readStatus().
+ *       execute(ft2232, status, sizeof(status));
+ * @endcode
+ */
+class CommandBuilder {
+
+private:
+   /// Commands to send
+   std::vector<uint8_t> commands;
+
+   /// Number of bytes the analyser will return in response to the commands
+   unsigned responseSize = 0;
+
+   /**
+    * Add 24-bit register write
+    *
+    * @param command Command
+    * @param value   Value to write
+    */
+   CommandBuilder &write24(uint8_t command, uint32_t value);
+
+public:
+   /// Default maximum LUT bytes in a single C_LUT_CONFIG command
+   static constexpr unsigned MAX_LUT_BLOCK_SIZE = 30000;
+
+   /**
+    * Add LUT configuration for trigger setup (C_LUT_CONFIG)
+    *
+    * @tparam Setup        TriggerSetup of one of the FPGA variants
+    *
+    * @param setup         Trigger setup to encode
+    * @param maxBlockSize  Maximum bytes in each C_LUT_CONFIG command (rounded down to whole LUTs)
+    */
+   template<typename Setup>
+   CommandBuilder &writeLuts(Setup &setup, unsigned maxBlockSize = MAX_LUT_BLOCK_SIZE);
+
+   /**
+    * Add LUT configuration (C_LUT_CONFIG)
+    *
+    * @param lutValues     LUT values (sent MSB first)
+    * @param number        Number of LUTs
+    * @param maxBlockSize  Maximum bytes in each C_LUT_CONFIG command (rounded down to whole LUTs)
+    */
+   CommandBuilder &writeLuts(const uint32_t lutValues[], unsigned number, unsigned maxBlockSize = MAX_LUT_BLOCK_SIZE);
+
+   /**
+    * Add LUT configuration from a prepared image (C_LUT_CONFIG)
+    * The image may be generated at compile time by TriggerSetup::getLutImage()
+    *
+    * @param lutImage      LUT image (each LUT MSB first)
+    * @param size          Size of image in bytes (multiple of 4)
+    * @param maxBlockSize  Maximum bytes in each C_LUT_CONFIG command (rounded down to whole LUTs)
+    *
+    * @throw MyException if size is not a whole number of LUTs
+    */
+   CommandBuilder &writeLutImage(const uint8_t lutImage[], unsigned size, unsigned maxBlockSize = MAX_LUT_BLOCK_SIZE);
+
+   /**
+    * Add partial LUT configuration (C_LUT_UPDATE)
+    *
+    * The analyser first recirculates recirculateSize bytes of the LUT shift chain
+    * (i.e. leaves them unchanged) and then shifts in the given LUT bytes.
+    * A sequence of these commands must shift the entire chain
+    * (total of recirculateSize+size = 4*TOTAL_TRIGGER_LUTS) to leave the LUTs in order.
+    *
+    * @param recirculateSize  Number of bytes to recirculate
+    * @param lutImage         LUT bytes to load (each LUT MSB first, may be nullptr if size = 0)
+    * @param size             Number of LUT bytes to load
+    *
+    * @throw MyException if either size exceeds 0xFFFF
+    */
+   CommandBuilder &updateLuts(unsigned recirculateSize, const uint8_t lutImage[], unsigned size);
+
+   /**
+    * Add write of capture length (C_WR_CAPTURE)
+    *
+    * @param captureLength Total number of samples to capture
+    */
+   CommandBuilder &writeCaptureLength(uint32_t captureLength) {
+      return write24(Analyser::C_WR_CAPTURE, captureLength);
+   }
+
+   /**
+    * Add write of pre-trigger length (C_WR_PRETRIG)
+    *
+    * @param pretrigValue Number of samples to capture before looking for trigger
+    */
+   CommandBuilder &writePreTrigger(uint32_t pretrigValue) {
+      return write24(Analyser::C_WR_PRETRIG, pretrigValue);
+   }
+
+   /**
+    * Add move of readback position (C_WR_READ_OFFSET)
+    *
+    * @param offset Offset from start of capture in SDRAM words
+    */
+   CommandBuilder &writeReadOffset(uint32_t offset) {
+      return write24(Analyser::C_WR_READ_OFFSET, offset);
+   }
+
+   /**
+    * Add write of control register (C_WR_CONTROL)
+    *
+    * @param controlValue Value to write
+    */
+   CommandBuilder &writeControl(uint8_t controlValue);
+
+   /**
+    * Add write of capture mode register (C_WR_MODE)
+    *
+    * @param modeValue Value to write e.g. C_MODE_RLE
+    */
+   CommandBuilder &writeMode(uint8_t modeValue);
+
+   /**
+    * Add write of channel enable mask (C_WR_CHANNELS)
+    *
+    * @param channelMask Enabled channels (bit n = channel n)
+    */
+   CommandBuilder &writeChannels(uint32_t channelMask);
+
+   /**
+    * Add read of status (C_RD_STATUS)
+    * Adds one byte to response
+    */
+   CommandBuilder &readStatus();
+
+   /**
+    * Add read of version (C_RD_VERSION)
+    * Adds one byte to response
+    */
+   CommandBuilder &readVersion();
+
+   /**
+    * Add read of hardware configuration (C_RD_CONFIG)
+    * Adds C_CONFIG_SIZE bytes to response
+    */
+   CommandBuilder &readConfig();
+
+   /**
+    * Add read of ring buffer write count (C_RD_FILL)
+    * Adds C_FILL_SIZE bytes to response
+    */
+   CommandBuilder &readFill();
+
+   /**
+    * Add read of status snapshot (C_RD_SNAPSHOT)
+    * Adds C_SNAPSHOT_SIZE bytes to response
+    */
+   CommandBuilder &readSnapshot();
+
+   /**
+    * Add the sequence to configure a capture without starting it:
+    * LUTs, capture length, pre-trigger, clear.
+    * The status is read after configuration (expected to be idle).
+    * Adds one byte to response
+    *
+    * @tparam Setup        TriggerSetup of one of the FPGA variants
+    *
+    * @param setup         Trigger setup
+    * @param maxBlockSize  Maximum bytes in each C_LUT_CONFIG command
+    * @param lutCache      LUTs already in analyser (only changes are sent), may be nullptr
+    */
+   template<typename Setup>
+   CommandBuilder &configureCapture(Setup &setup, unsigned maxBlockSize = MAX_LUT_BLOCK_SIZE, LutCache *lutCache = nullptr);
+
+   /**
+    * Add start of a capture previously configured by configureCapture()
+    * Without notify the status is read after starting.
+    * Adds one byte (none with notify) to response
+    *
+    * @tparam Setup  TriggerSetup of one of the FPGA variants
+    *
+    * @param setup   Trigger setup
+    * @param notify  Analyser sends status without request when capture completes (C_CONTROL_NOTIFY)
+    */
+   template<typename Setup>
+   CommandBuilder &armCapture(Setup &setup, bool notify = false);
+
+   /**
+    * Add the complete sequence to configure and start a capture:
+    * LUTs, capture length, pre-trigger, clear, start.
+    * The status is read before starting (expected to be idle).
+    * Without notify the status is also read after starting.
+    * Adds two bytes (one with notify) to response
+    *
+    * @tparam Setup        TriggerSetup of one of the FPGA variants
+    *
+    * @param setup         Trigger setup
+    * @param notify        Analyser sends status without request when capture completes (C_CONTROL_NOTIFY)
+    * @param maxBlockSize  Maximum bytes in each C_LUT_CONFIG command
+    * @param lutCache      LUTs already in analyser (only changes are sent), may be nullptr
+    */
+   template<typename Setup>
+   CommandBuilder &startCapture(Setup &setup, bool notify = false, unsigned maxBlockSize = MAX_LUT_BLOCK_SIZE, LutCache *lutCache = nullptr);
+
+   /**
+    * Discard all commands
+    */
+   void clear() {
+      commands.clear();
+      responseSize = 0;
+   }
+
+   /**
+    * Get command bytes
+    */
+   const uint8_t *data() const {
+      return commands.data();
+   }
+
+   /**
+    * Get number of command bytes
+    */
+   unsigned size() const {
+      return commands.size();
+   }
+
+   /**
+    * Get the number of bytes expected in response
+    */
+   unsigned getResponseSize() const {
+      return responseSize;
+   }
+
+   /**
+    * Send commands in a single transfer and receive the response
+    *
+    * @param ft2232        Interface to analyser
+    * @param response      Buffer for response (may be nullptr if no response expected)
+    * @param responseSize  Size of buffer - must equal getResponseSize()
+    *
+    * @throw MyException if response buffer size is incorrect
+    */
+   void execute(FT2232 &ft2232, uint8_t response[] = nullptr, unsigned responseSize = 0);
+};
+
+#endif /* SOURCES_COMMANDBUILDER_H_ */
@@ -7,29 +7,41 @@
  ============================================================================
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <signal.h>
 #include <algorithm>
+#include <vector>
+#include <atomic>
 #include "console.h"
 #include "MyException.h"
 
-#include "Lfsr16.h"
 
 #include "EncodeLuts.h"
 #include "FT2232.h"
+#include "FT2232_Emulator.h"
+#include "CommandBuilder.h"
+#include "AnalyserCommands.h"
+#include "Autotune.h"
+#include "AnalyserGroup.h"
+#include "Trace.h"
+#include "TriggerCompiler.h"
+#include "StreamCapture.h"
+#include "RunLength.h"
 
 using namespace Analyser;
 
-TriggerStep trigger0x7FFFor0x7FFE[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep trigger0x7FFFor0x7FFE[MAX_TRIGGER_STEPS] = {
       //   Pattern 0              Pattern 1            Polarity 0            Polarity 1         Operation        Contiguous  Count
       {   "0111111111111111",    "0111111111111110",   Polarity::Normal,   Polarity::Normal,    Operation::Or,   false,        1},
 };
 
-TriggerStep triggersImmediate[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggersImmediate[MAX_TRIGGER_STEPS] = {
       //   Pattern 0              Pattern 1            Polarity 0            Polarity 1         Operation        Contiguous  Count
       {   "XXXXXXXXXXXXXXXX",    "XXXXXXXXXXXXXXX",    Polarity::Normal,   Polarity::Normal,    Operation::Or,  false,        0},
 };
 
-TriggerStep triggersdontcare[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggersdontcare[MAX_TRIGGER_STEPS] = {
       //   Pattern 0              Pattern 1            Polarity 0            Polarity 1         Operation        Contiguous  Count
       {   "XXXXXXXXXXXXXXX",     "XXXXXXXXXXXXXXX",    Polarity::Normal,   Polarity::Normal,    Operation::And,  false,        1},
       {   "XXXXXXXXXXXXXXX",     "XXXXXXXXXXXXXXX",    Polarity::Normal,   Polarity::Normal,    Operation::And,  false,        2},
@@ -37,7 +49,7 @@ TriggerStep triggersdontcare[MAX_TRIGGER_STEPS] = {
       {   "XXXXXXXXXXXXXXX",     "XXXXXXXXXXXXXXX",    Polarity::Normal,   Polarity::Normal,    Operation::And,  false,        4},
 };
 
-TriggerStep triggers1[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggers1[MAX_TRIGGER_STEPS] = {
       //   Pattern 0              Pattern 1            Polarity 0            Polarity 1         Operation        Contiguous  Count
       {   "XXXXXXXXXXXXXXX",     "XXXXXXXXXXXXXXX",    Polarity::Normal,   Polarity::Disabled,  Operation::And,  false,        4},
       {   "XXXXXXXXXXXXXX0",     "XXXXXXXXXXXXXX0",    Polarity::Normal,   Polarity::Disabled,  Operation::And,  false,        3},
@@ -45,7 +57,7 @@ TriggerStep triggers1[MAX_TRIGGER_STEPS] = {
       {   "XXXXXXXXXXXXXXC",     "XXXXXXXXXXXXXXC",    Polarity::Normal,   Polarity::Disabled,  Operation::And,  false,        7},
 };
 
-TriggerStep triggers2[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggers2[MAX_TRIGGER_STEPS] = {
       //   Pattern 0              Pattern 1            Polarity 0            Polarity 1         Operation        Contiguous  Count
       {   "XXXXXXXXXXXXXXX",     "XXXXXXXXXXXXXXX",    Polarity::Disabled,   Polarity::Normal,  Operation::And,  false,      100},
       {   "XXXXXXXXXXXXXX0",     "XXXXXXXXXXXXXX1",    Polarity::Disabled,   Polarity::Normal,  Operation::And,  false,      100},
@@ -53,7 +65,7 @@ TriggerStep triggers2[MAX_TRIGGER_STEPS] = {
       {   "XXXXXXXXXXXXXXC",     "XXXXXXXXXXXXXXF",    Polarity::Disabled,   Polarity::Normal,  Operation::And,  false,      100},
 };
 
-TriggerStep triggers3[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggers3[MAX_TRIGGER_STEPS] = {
       //   Pattern 0              Pattern 1            Polarity 0            Polarity 1         Operation        Contiguous  Count
       {   "XXXXXXXXXXXXXXX",     "XXXXXXXXXXXXXXX",    Polarity::Normal,     Polarity::Normal,  Operation::And,  false,      100},
       {   "XXXXXXXXXXXXXX0",     "XXXXXXXXXXXXX1X",    Polarity::Normal,     Polarity::Normal,  Operation::And,  false,      100},
@@ -61,7 +73,7 @@ TriggerStep triggers3[MAX_TRIGGER_STEPS] = {
       {   "XXXXXXXXXXXXXXC",     "XXXXXXXXXXXXXFX",    Polarity::Normal,     Polarity::Normal,  Operation::And,  false,      100},
 };
 
-TriggerStep triggers4[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggers4[MAX_TRIGGER_STEPS] = {
       //   Pattern 0              Pattern 1            Polarity 0            Polarity 1         Operation        Contiguous  Count
       {   "XXXXXXXXXXXXXXX",     "XXXXXXXXXXXXXXX",    Polarity::Normal,     Polarity::Normal,  Operation::Or,   false,      100},
       {   "XXXXXXXXXXXXXX0",     "XXXXXXXXXXXXX1X",    Polarity::Normal,     Polarity::Normal,  Operation::Or,   false,      100},
@@ -143,7 +155,7 @@ public:
 
       uint32_t *lutValuePtr;
 
-      setup.printTriggers();
+      setup.printTriggers(USBDM::console);
 
       printLutsAsVhdlArrayPreamble(TOTAL_TRIGGER_LUTS);
       lutValuePtr = lutValues;
@@ -163,256 +175,370 @@ public:
    }
 };
 
-void writeLuts(FT2232 &ft2232, TriggerSetup &setup, bool verbose = false) {
-   static constexpr unsigned MAX_VALUES = 30000;
-
+void writeLuts(AnalyserSession &analyser, TriggerSetup &setup, bool verbose = false) {
+   FT2232   &ft2232 = analyser.getTransport();
    uint32_t  lutValues[TOTAL_TRIGGER_LUTS] = {0};
-   uint32_t *lutValuePtr = lutValues;
 
    if (verbose) {
       PrintLuts::printLutsForSimulation(setup);
    }
-   setup.getTriggerPatternMatcherLutValues(lutValuePtr);
-   setup.getTriggerCombinerLutValues(lutValuePtr);
-   setup.getTriggerCountLutValues(lutValuePtr);
-   setup.getTriggerFlagLutValues(lutValuePtr);
+   setup.getLutValues(lutValues);
 
    if (verbose) {
-      setup.printTriggers();
+      setup.printTriggers(USBDM::console);
       printLuts("Pattern Matchers",    lutValues+START_TRIGGER_PATTERN_LUTS, LUTS_FOR_TRIGGER_PATTERNS);
       printLuts("Trigger Combiners",   lutValues+START_TRIGGER_COMBINER_LUTS, LUTS_FOR_TRIGGER_COMBINERS);
       printLuts("Trigger Counts",      lutValues+START_TRIGGER_COUNT_LUTS, LUTS_FOR_TRIGGER_COUNTS);
       printLuts("Trigger Flags",       lutValues+START_TRIGGER_FLAG_LUTS, LUTS_FOR_TRIGGERS_FLAGS);
    }
 
-   uint8_t *convertedData = setup.formatData(TOTAL_TRIGGER_LUTS, lutValues);
+   ActivityTimer timer(ft2232.getStatistics(), Activity::WriteLuts, 4*TOTAL_TRIGGER_LUTS);
+   analyser.getLutCache().invalidate();
+   CommandBuilder().writeLuts(lutValues, TOTAL_TRIGGER_LUTS, ft2232.getTransferProfile().blockSize).execute(ft2232);
+}
 
-   unsigned bytesRemaining = 4*TOTAL_TRIGGER_LUTS;
-   while(bytesRemaining > 0) {
-      unsigned blockSize = bytesRemaining;
-      if (blockSize>MAX_VALUES) {
-         blockSize = MAX_VALUES;
+/**
+ * Get devices selected on command line
+ *
+ * Command line:
+ *    --serial=sn        Analyser with serial number
+ *    --location=id      Analyser at USB location (e.g. 0x2113)
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return Selected devices in order given
+ */
+static std::vector<DeviceSelector> getSelectors(int argc, char *argv[]) {
+   static const char SERIAL[]   = "--serial=";
+   static const char LOCATION[] = "--location=";
+
+   std::vector<DeviceSelector> selectors;
+   for (int index=1; index<argc; index++) {
+      DeviceSelector selector;
+      if (strncmp(argv[index], SERIAL, sizeof(SERIAL)-1) == 0) {
+         selector.serialNumber = argv[index]+sizeof(SERIAL)-1;
+      }
+      else if (strncmp(argv[index], LOCATION, sizeof(LOCATION)-1) == 0) {
+         selector.locationId = strtoul(argv[index]+sizeof(LOCATION)-1, nullptr, 0);
       }
-      uint8_t loadLutsCommand[] = {
-            C_LUT_CONFIG,
-            (uint8_t)blockSize,
-            (uint8_t)(blockSize>>8),
-      };
-      ft2232.transmitData(loadLutsCommand, sizeof(loadLutsCommand));
-      ft2232.transmitData(convertedData, blockSize);
-      bytesRemaining -= blockSize;
-      convertedData  += blockSize;
+      else {
+         continue;
+      }
+      selectors.push_back(selector);
    }
+   return selectors;
 }
 
-void writePreTrigger(FT2232 &ft2232, uint32_t pretrigValue, bool verbose = false) {
-   using namespace USBDM;
-
-   if (verbose) {
-      USBDM::console.write("PreTrigger(").write(pretrigValue).writeln(")");
+/**
+ * Open the analyser
+ *
+ * Command line:
+ *    --emulate          Use emulated analyser with counter as signal
+ *    --emulate=file     Use emulated analyser with samples from file
+ *    --hardware=w,s,p,c Size of emulated trigger hardware (inputs, steps, patterns, counter bits)
+ *                       More than 16 inputs is emulator-only (see AnalyserConfig::isEmulatorOnly())
+ *    --serial=sn        Analyser with serial number
+ *    --location=id      Analyser at USB location
+ *
+ * The transfer profile saved for the device is applied.
+ *
+ * @param argc
+ * @param argv
+ *
+ * @return Pointer to FT2232 transport
+ *
+ * @throw MyException if --hardware= is used without --emulate
+ */
+static FT2232Ptr openAnalyser(int argc, char *argv[]) {
+   static const char EMULATE[]  = "--emulate";
+   static const char HARDWARE[] = "--hardware=";
+
+   AnalyserConfig config      = DEFAULT_ANALYSER_CONFIG;
+   bool           hardwareSet = false;
+   for (int index=1; index<argc; index++) {
+      unsigned width, steps, patterns, counterBits;
+      if ((strncmp(argv[index], HARDWARE, sizeof(HARDWARE)-1) == 0) &&
+          (sscanf(argv[index]+sizeof(HARDWARE)-1, "%u,%u,%u,%u", &width, &steps, &patterns, &counterBits) == 4)) {
+         config      = AnalyserConfig{(uint8_t)width, (uint8_t)steps, (uint8_t)patterns, (uint8_t)counterBits};
+         hardwareSet = true;
+      }
    }
-   const uint8_t command[] = {
-         C_WR_PRETRIG,
-         (uint8_t)(pretrigValue),
-         (uint8_t)(pretrigValue>>8),
-         (uint8_t)(pretrigValue>>16),
-   };
-   ft2232.transmitData(command, sizeof(command));
-   console.setWidth(2).setPadding(Padding_LeadingZeroes).
-         write("transmitData(C_WR_PRETRIG,").write(command[1],Radix_16).write(",").write(command[2],Radix_16).write(",").write(command[3],Radix_16).writeln(")").resetFormat();
-}
-
-void writeCaptureLength(FT2232 &ft2232, uint32_t captureLength, bool verbose = false) {
-   using namespace USBDM;
-
-   if (verbose) {
-      USBDM::console.write("CaptureLength(").write(captureLength).writeln(")");
+   for (int index=1; index<argc; index++) {
+      if (strncmp(argv[index], EMULATE, sizeof(EMULATE)-1) != 0) {
+         continue;
+      }
+      const char *filename = argv[index]+sizeof(EMULATE)-1;
+      FT2232Ptr ft2232;
+      if (*filename == '=') {
+         ft2232 = FT2232Ptr(new FT2232_Emulator(new FileSignalSource(filename+1, config.getBytesPerSample()), FT2232H_LINK_MODEL, config));
+      }
+      else {
+         ft2232 = FT2232Ptr(new FT2232_Emulator(new CounterSignalSource(), FT2232H_LINK_MODEL, config));
+      }
+      ft2232->loadTransferProfile();
+      return ft2232;
    }
-   static const uint8_t command[] = {
-         C_WR_CAPTURE,
-         (uint8_t)(captureLength),
-         (uint8_t)(captureLength>>8),
-         (uint8_t)(captureLength>>16),
-   };
-   ft2232.transmitData(command, sizeof(command));
-   console.setWidth(2).setPadding(Padding_LeadingZeroes).
-         write("transmitData(C_WR_CAPTURE,").write(command[1],Radix_16).write(",").write(command[2],Radix_16).write(",").write(command[3],Radix_16).writeln(")").resetFormat();
-}
-
-const char *getControlNames(uint8_t controlValue) {
-   using namespace USBDM;
-
-   static USBDM::StringFormatter_T<100> sf;
-   sf.clear();
-   sf.write((controlValue & C_CONTROL_START_ACQ)?"C_CONTROL_START_ACQ|":"");
-   sf.write((controlValue & C_CONTROL_CLEAR)?"C_CONTROL_CLEAR|":"");
-
-   static const unsigned divs[]   = {1,2,5,10};
-   static const unsigned div_xs[] = {1,10,10,1000};
-
-   unsigned divisor =
-         divs[((controlValue&C_CONTROL_DIV_MASK)>>C_CONTROL_DIV_OFFSET)] *
-         div_xs[((controlValue&C_CONTROL_DIVx_MASK)>>C_CONTROL_DIVx_OFFSET)];
-
-   sf.write("x").write(divisor);
-
-   return sf.toString();
+   if (hardwareSet) {
+      // A real analyser reports its own configuration (C_RD_CONFIG)
+      fprintf(stderr, "openAnalyser() - --hardware= requires --emulate\n");
+      throw MyException("openAnalyser() - --hardware= requires --emulate");
+   }
+   std::vector<DeviceSelector> selectors = getSelectors(argc, argv);
+   if (selectors.size() > 0) {
+      return FT2232::open(selectors[0]);
+   }
+   return FT2232::open();
 }
 
-const char *getStatuslNames(uint8_t statusValue) {
-   using namespace USBDM;
-
-   static StringFormatter_T<100> sf;
-   sf.clear();
-
-   static const char *stateNames[]  = {
-         "C_STATUS_STATE_IDLE   ",
-         "C_STATUS_STATE_PRETRIG",
-         "C_STATUS_STATE_ARMED  ",
-         "C_STATUS_STATE_RUN    ",
-         "C_STATUS_STATE_DONE   ",
-         "C_STATUS_STATE_ILLEGAL",
-         "C_STATUS_STATE_ILLEGAL",
-         "C_STATUS_STATE_ILLEGAL",
-   };
-   sf.write(stateNames[(statusValue&C_STATUS_STATE_MASK)>>C_STATUS_STATE_OFFSET]);
-   return sf.toString();
+/**
+ * Check for command line option
+ *
+ * @param argc
+ * @param argv
+ * @param option  Option to look for
+ *
+ * @return true if present
+ */
+static bool hasOption(int argc, char *argv[], const char *option) {
+   for (int index=1; index<argc; index++) {
+      if (strcmp(argv[index], option) == 0) {
+         return true;
+      }
+   }
+   return false;
 }
 
-void writeControl(FT2232 &ft2232, uint8_t controlValue, bool verbose = false) {
-   using namespace USBDM;
-
-   const uint8_t readCommand[] = {
-         C_WR_CONTROL,
-         controlValue,
-   };
-   if (verbose) {
-      console.write("transmitData(C_WR_CONTROL,").write(controlValue, Radix_16).writeln(")");
-      console.write("Control(").write(getControlNames(controlValue)).write(", ").write(controlValue, Radix_16).writeln(")");
+/**
+ * Convert a trigger setup to the trigger encoding of another FPGA variant
+ * Patterns are padded with 'X' for wider samples and additional patterns are disabled.
+ *
+ * @tparam Encoding  Trigger encoding to convert to
+ *
+ * @param setup      Setup to convert
+ *
+ * @return Converted setup
+ */
+template<typename Encoding>
+static typename Encoding::TriggerSetup convertSetup(const TriggerSetup &setup) {
+   using Step = typename Encoding::TriggerStep;
+
+   Step steps[Encoding::MAX_TRIGGER_STEPS];
+   const unsigned lastStep = std::min<unsigned>(setup.getLastActiveTriggerCount(), Encoding::MAX_TRIGGER_STEPS-1);
+   for (unsigned stepNum=0; stepNum<=lastStep; stepNum++) {
+      const TriggerStep step = setup.getTrigger(stepNum);
+      steps[stepNum] = Step{
+         step.getPattern(0).toString(), step.getPattern(1).toString(),
+         step.getPolarities(0),         step.getPolarities(1),
+         step.getOperation(),           step.isContiguous(),           step.getCount()};
    }
-   ft2232.transmitData(readCommand, sizeof(readCommand));
+   return typename Encoding::TriggerSetup{steps, lastStep, setup.getSampleRate(), setup.getSampleSize(), setup.getPreTrigSize()};
 }
 
-uint8_t readStatus(FT2232 &ft2232, bool verbose = false) {
-   using namespace USBDM;
-
-   if (verbose) {
-      USBDM::console.writeln("transmitData(C_RD_STATUS,1)");
-   }
-   const uint8_t readCommand[] = {
-         C_RD_STATUS, 1,
-   };
-   ft2232.transmitData(readCommand, sizeof(readCommand));
-   uint8_t data[] = {0};
-   ft2232.receiveData(data, sizeof(data));
-   if (verbose) {
-      console.write("receiveData(").write(data[0], Radix_16).writeln(")");
-      console.write("readStatus() => ").write(getStatuslNames(data[0])).write(", ").writeln(data[0], Radix_16);
+/**
+ * Get value of an option e.g. --trigger=expression
+ *
+ * @param argc
+ * @param argv
+ * @param option Option including '='
+ *
+ * @return Value or nullptr if option not present
+ */
+static const char *getOption(int argc, char *argv[], const char *option) {
+   const size_t length = strlen(option);
+   for (int index=1; index<argc; index++) {
+      if (strncmp(argv[index], option, length) == 0) {
+         return argv[index]+length;
+      }
    }
-   return data[0];
+   return nullptr;
 }
 
-uint8_t readVersion(FT2232 &ft2232, bool verbose = false) {
-   using namespace USBDM;
+/// Time to wait for a trigger unless changed by --timeout=
+static constexpr unsigned DEFAULT_CAPTURE_TIMEOUT_ms = 10000;
 
-   if (verbose) {
-      USBDM::console.writeln("transmitData(C_RD_VERSION,1)");
-   }
-   uint8_t readCommand[] = {
-         C_RD_VERSION, 1,
-   };
-   ft2232.transmitData(readCommand, sizeof(readCommand));
-   uint8_t data[] = {0};
-   ft2232.receiveData(data, sizeof(data));
-   if (verbose) {
-      console.write("receiveData(").write(data[0], Radix_16).writeln(")");
-      console.write("readVersion() => ").writeln(data[0], Radix_16);
-   }
-   return data[0];
-}
+/// Set by Ctrl-C while waiting for a capture
+static std::atomic<bool> captureCancelled{false};
 
-void readCaptureData(FT2232 &ft2232, uint16_t *data, const unsigned size, bool verbose = false) {
-   using namespace USBDM;
+/**
+ * Cancel the capture in progress (SIGINT handler)
+ */
+static void cancelCapture(int) {
+   captureCancelled = true;
+}
 
-   static constexpr unsigned MAX_VALUES = 60000;
-   if (verbose) {
-      USBDM::console.writeln("readCaptureData() => ");
-   }
-   unsigned sizeInBytes = 2 * size;
-   while (sizeInBytes > 0) {
-      // Size for this transfer in items (2 bytes)
-      unsigned blockSize = sizeInBytes;
-      if (blockSize > MAX_VALUES) {
-         blockSize = MAX_VALUES;
+/**
+ * Capture repeatedly from several analysers armed together
+ *
+ * @param selectors          Analysers to use
+ * @param setup              Trigger setup used for all analysers
+ * @param triggerExpression  Trigger expression replacing the triggers in setup (may be nullptr)
+ * @param timeout_ms         Maximum time to wait for capture in ms (0 => no limit)
+ */
+static void groupCapture(
+      const std::vector<DeviceSelector> &selectors,
+      const TriggerSetup                &setup,
+      const char                        *triggerExpression,
+      unsigned                           timeout_ms) {
+   AnalyserGroup group(selectors, true);
+
+   // Members are the same FPGA variant so the encoding is selected once for the group
+   withTriggerEncoding(group.getAnalyserConfig(), [&](auto tag) {
+      using Encoding = typename decltype(tag)::Encoding;
+      using Sample   = typename Encoding::Sample;
+
+      auto analyserSetup = (triggerExpression != nullptr)?
+            compileTrigger<Encoding>(triggerExpression, setup.getSampleRate(), setup.getSampleSize(), setup.getPreTrigSize()):
+            convertSetup<Encoding>(setup);
+      if (triggerExpression != nullptr) {
+         analyserSetup.printTriggers(USBDM::console);
       }
-      console.write("transmitData(C_RD_BUFFER,(").
-            write(blockSize).write("),").
-            write((uint8_t)blockSize, Radix_16).write(",").write((uint8_t)((blockSize)>>8), Radix_16).writeln(")");
-
-      uint8_t readCommand[] = {
-            C_RD_BUFFER,
-            (uint8_t)(blockSize),
-            (uint8_t)((blockSize)>>8),
-      };
-      ft2232.transmitData(readCommand, sizeof(readCommand));
-      uint8_t buff[MAX_VALUES];
-      ft2232.receiveData(buff, blockSize);
-      for (unsigned index=0; index<blockSize/2; index++) {
-         *data++ = buff[2*index] + (buff[(2*index)+1]<<16);
+      std::vector<std::vector<Sample>> buffers(group.size(), std::vector<Sample>(analyserSetup.getSampleSize()));
+      std::vector<Sample *>            bufferPtrs;
+      for (std::vector<Sample> &buffer:buffers) {
+         bufferPtrs.push_back(buffer.data());
       }
-      sizeInBytes -= blockSize;
-   }
-}
+      int ch;
+      do {
+         if (!group.doCapture(analyserSetup, bufferPtrs.data(), timeout_ms)) {
+            USBDM::console.writeln("Capture did not complete");
+         }
+         USBDM::console.write("Arm skew = ").write((unsigned)(group.getArmSkew().count()/1000)).writeln(" us");
 
-void testLfsr16() {
-   USBDM::console.write("Period = ").writeln(Lfsr16::findPeriod());
+         puts("Again?");
+         ch = getchar();
+      } while (ch != 'n');
+   });
+}
 
-   USBDM::console.setWidth(4).setPadding(USBDM::Padding_LeadingZeroes);
-   USBDM::console.write("Next(").write(0xACE1, USBDM::Radix_16).write(") => ").writeln(Lfsr16::calcNextValue(0xACE1), USBDM::Radix_16);
-   for (uint32_t value=0; value<=65525; value++) {
-      USBDM::console.write("Encode(").write(value, USBDM::Radix_16).write(") => ").writeln(Lfsr16::encode(value), USBDM::Radix_16);
+/**
+ * Stream samples to a file until a key is pressed
+ *
+ * @tparam Sample      Sample type of analyser
+ *
+ * @param analyser     Interface to analyser
+ * @param sampleRate   Sample rate
+ * @param filename     File for raw samples
+ */
+template<typename Sample>
+static void streamToFile(AnalyserSession &analyser, SampleRate sampleRate, const char *filename) {
+   StreamCapture<Sample> stream(analyser);
+   stream.addSink(new RawFileSink<Sample>(filename));
+   stream.start(sampleRate);
+   USBDM::console.write("Streaming to '").write(filename).writeln("', press Enter to stop");
+   getchar();
+   stream.stop();
+
+   StreamStatus status = stream.getStatus();
+   USBDM::console.
+      write("Samples = ").write((unsigned long)status.samplesRead).
+      write(", Max fill = ").writeln(status.maxFill);
+   if (status.overrun) {
+      USBDM::console.write("Overrun after ").write((unsigned long)status.overrunAt).writeln(" samples");
    }
 }
 
 /**
+ * Report run-length encoded capture (C_MODE_RLE)
+ *
+ * @tparam Sample       Sample type of analyser
  *
- * @param ft2232
- * @param setup
- * @param size
- * @param pretrigSize
- * @param buffer
+ * @param words         Captured RLE words
+ * @param preTrigSize   Pre-trigger size in words
  */
-void doCapture(
-      FT2232         &ft2232,
-      TriggerSetup   &setup,
-      uint16_t        buffer[],
-      bool            verbose = false) {
-
-   writeLuts(ft2232, setup, false);
-
-   writeCaptureLength(ft2232, setup.getSampleSize(), verbose);
-
-   writePreTrigger(ft2232, setup.getPreTrigSize(), verbose);
+template<typename Sample>
+static void reportRleCapture(const std::vector<Sample> &words, unsigned preTrigSize) {
+   std::vector<SampleEdge<Sample>> edges;
+   rleToEdges<Sample>(words.data(), words.size(), edges, 1);
+   USBDM::console.
+      write("Runs = ").write((unsigned long)(words.size()/2)).
+      write(", Samples = ").write((unsigned long)getRleSampleCount(words.data(), words.size())).
+      write(", Trigger at ").write((unsigned long)getRleSampleCount(words.data(), preTrigSize)).
+      write(", D0 edges = ").writeln((unsigned long)edges.size());
+}
 
-   writeControl(ft2232, C_CONTROL_CLEAR, verbose);
-   writeControl(ft2232, setup.getSampleRate(), verbose);
+/**
+ * Report transitional capture (C_MODE_TRANSITION)
+ *
+ * @tparam Sample       Sample type of analyser
+ *
+ * @param words         Captured transition words
+ * @param preTrigSize   Pre-trigger size in words
+ * @param sampleRate    Sample rate of capture
+ */
+template<typename Sample>
+static void reportTransitionCapture(const std::vector<Sample> &words, unsigned preTrigSize, SampleRate sampleRate) {
+   std::vector<TimedSample<Sample>> events;
+   decodeTransitions<Sample>(words.data(), words.size(), sampleRate, events);
+   const uint64_t period = getSamplePeriodIn_nanoseconds(sampleRate);
+   USBDM::console.
+      write("Events = ").write((unsigned long)events.size()).
+      write(", Span = ").write((unsigned long)(getTransitionTicks(words.data(), words.size())*period/1000)).write(" us").
+      write(", Trigger at ").write((unsigned long)(getTransitionTicks(words.data(), preTrigSize+2)*period/1000)).writeln(" us");
+}
 
-   // Check idle
-   if (readStatus(ft2232, verbose) != C_STATUS_STATE_IDLE) {
-      throw MyException("Unexpected analyser state in doCapture");
+/**
+ * Read part of a capture again and compare with the full capture (C_WR_READ_OFFSET)
+ *
+ * @tparam Sample       Sample type of analyser
+ *
+ * @param analyser      Interface to analyser
+ * @param capture       Full capture as read by doCapture()
+ * @param window        Offset and count e.g. "1000,200"
+ */
+template<typename Sample>
+static void checkWindow(AnalyserSession &analyser, const std::vector<Sample> &capture, const char *window) {
+   char *end;
+   unsigned long offset = strtoul(window, &end, 0);
+   unsigned long count  = (*end == ',')?strtoul(end+1, nullptr, 0):0;
+   if ((count == 0) || (offset+count > capture.size())) {
+      USBDM::console.writeln("Window is outside capture");
+      return;
    }
+   std::vector<Sample> samples(count);
+   readWindow(analyser, samples.data(), capture.size(), offset, count);
+   bool matches = std::equal(samples.begin(), samples.end(), capture.begin()+offset);
+   USBDM::console.
+      write("Window ").write(offset).write("..").write(offset+count-1).
+      writeln(matches?" matches capture":" differs from capture");
+}
 
-   writeControl(ft2232, setup.getSampleRate()|C_CONTROL_START_ACQ, verbose);
-
-   uint8_t state;
-   do {
-      uint8_t status = readStatus(ft2232, verbose);
-      state = status & C_STATUS_STATE_MASK;
-   } while (state != C_STATUS_STATE_DONE);
-   readCaptureData(ft2232, buffer, setup.getSampleSize());
+/**
+ * Report capture progress (C_RD_SNAPSHOT)
+ *
+ * @param ft2232        Interface to analyser
+ */
+static void reportSnapshot(FT2232 &ft2232) {
+   StatusSnapshot snapshot = readSnapshot(ft2232);
+   USBDM::console.
+      write("Status = ").write(getStatuslNames(snapshot.status)).
+      write(", Step = ").write(snapshot.triggerStep).
+      write(", Matches = ").write(snapshot.matchCount).
+      write(", Capture counter = ").write((unsigned long)snapshot.captureCounter).
+      write(", Pre-trigger = ").write((unsigned long)snapshot.preTriggerFill).
+      write(", Written = ").writeln((unsigned long)snapshot.written);
 }
 
-int main() {
+/**
+ * Command line:
+ *    --list             List attached analysers
+ *    --emulate[=file]   Use emulated analyser (see openAnalyser())
+ *    --hardware=w,s,p,c Size of emulated trigger hardware e.g. --hardware=32,16,4,16 (emulator only)
+ *    --serial=sn        Use analyser with serial number (repeat to capture from several)
+ *    --location=id      Use analyser at USB location (repeat to capture from several)
+ *    --autotune         Find and save the best USB transfer profile for the analyser
+ *    --stats            Print transfer statistics after each capture (build with FT2232_STATISTICS=1)
+ *    --trace            Print trace of analyser commands
+ *    --trigger=expr     Trigger expression e.g. --trigger="D3 rising x 10 then D0..7 == 0x5A" (see TriggerCompiler.h)
+ *    --stream=file      Stream samples to file until Enter is pressed (see StreamCapture.h)
+ *    --rle              Run-length encode captures (see RunLength.h)
+ *    --transition       Capture changes with timestamps only (see RunLength.h)
+ *    --pack=mask        Read back only channels in mask e.g. --pack=0xFF (see PackedSamples.h)
+ *    --window=off,count Read part of each capture again and check it e.g. --window=9990,20
+ *    --snapshot         Print capture progress after each capture (see readSnapshot())
+ *    --timeout=ms       Give up waiting for a capture after ms (default 10000, 0 => wait until Ctrl-C)
+ */
+int main(int argc, char *argv[]) {
 
    constexpr unsigned   PRETRIG_SIZE = 10000;
    constexpr unsigned   CAPTURE_SIZE = 40000;
@@ -431,23 +557,117 @@ int main() {
       write("Expected capture interval = ").
       write((setup.getSampleSize()*getSamplePeriodIn_nanoseconds(sampleRate))/1000).writeln(" us");
 
+   if (hasOption(argc, argv, "--trace")) {
+      traceLog.setEnabled(true);
+      traceLog.startConsumer(stdout);
+   }
+   const char *triggerExpression = getOption(argc, argv, "--trigger=");
+   const char *streamFilename    = getOption(argc, argv, "--stream=");
+   const char *packChannels      = getOption(argc, argv, "--pack=");
+   const char *readbackWindow    = getOption(argc, argv, "--window=");
+   const char *timeoutOption     = getOption(argc, argv, "--timeout=");
+   const unsigned timeout_ms     = (timeoutOption != nullptr)?strtoul(timeoutOption, nullptr, 0):DEFAULT_CAPTURE_TIMEOUT_ms;
    try {
-      FT2232 ft2232;
+      if (hasOption(argc, argv, "--list")) {
+         for (const DeviceInfo &info:FT2232::listDevices()) {
+            printf("Serial = '%s', Location = 0x%X, Description = '%s'\n",
+                  info.serialNumber.c_str(), info.locationId, info.description.c_str());
+         }
+         return 0;
+      }
+      std::vector<DeviceSelector> selectors = getSelectors(argc, argv);
+      if (selectors.size() > 1) {
+         groupCapture(selectors, setup, triggerExpression, timeout_ms);
+         return 0;
+      }
+      FT2232Ptr       ft2232Ptr = openAnalyser(argc, argv);
+      FT2232         &ft2232    = *ft2232Ptr;
+      AnalyserSession analyser(ft2232);
+      WaitMode waitMode = WaitMode::Poll;
       try {
-         uint8_t version = readVersion(ft2232, true);
+         uint8_t version = identifyAnalyser(analyser);
          USBDM::console.write("Version = ").writeln(version);
+         if (version >= NOTIFY_MIN_VERSION) {
+            waitMode = WaitMode::Notify;
+         }
       } catch (MyException &) {
          USBDM::console.writeln("Unable to read version");
       }
+      const AnalyserConfig &config = analyser.getAnalyserConfig();
+      USBDM::console.
+         write("Inputs = ").write(config.sampleWidth).
+         write(", Steps = ").write(config.maxTriggerSteps).
+         write(", Patterns = ").write(config.maxTriggerPatterns).
+         write(", Counter bits = ").writeln(config.matchCounterBits);
+
+      // Tuned after identification so readback uses the analyser's sample size
+      if (hasOption(argc, argv, "--autotune")) {
+         autotune(analyser, true, true);
+      }
 
-      int ch;
-      do {
-         uint16_t buffer[CAPTURE_SIZE];
-         doCapture(ft2232, setup, buffer, true);
+      const bool showStatistics = hasOption(argc, argv, "--stats");
+      const bool runLength      = hasOption(argc, argv, "--rle");
+      const bool transitions    = hasOption(argc, argv, "--transition");
+      const bool showSnapshot   = hasOption(argc, argv, "--snapshot");
 
-         puts("Again?");
-         ch = getchar();
-      } while (ch != 'n');
+      uint8_t mode = runLength?C_MODE_RLE:transitions?C_MODE_TRANSITION:C_MODE_RAW;
+      if (packChannels != nullptr) {
+         writeChannels(analyser, strtoul(packChannels, nullptr, 0));
+         mode |= C_MODE_PACK;
+      }
+      if (mode != C_MODE_RAW) {
+         writeMode(analyser, mode);
+         USBDM::console.write("Mode = ").write(getModeNames(mode)).
+            write(", Readback bits/sample = ").writeln(analyser.getReadbackSampleBits());
+      }
+
+      // Trigger encoding and sample size are selected once for the analyser
+      withTriggerEncoding(config, [&](auto tag) {
+         using Encoding = typename decltype(tag)::Encoding;
+
+         if (streamFilename != nullptr) {
+            streamToFile<typename Encoding::Sample>(analyser, sampleRate, streamFilename);
+            return;
+         }
+         auto analyserSetup = (triggerExpression != nullptr)?
+               compileTrigger<Encoding>(triggerExpression, sampleRate, CAPTURE_SIZE, PRETRIG_SIZE):
+               convertSetup<Encoding>(setup);
+         if (triggerExpression != nullptr) {
+            analyserSetup.printTriggers(USBDM::console);
+         }
+         std::vector<typename Encoding::Sample> buffer(analyserSetup.getSampleSize());
+         int ch;
+         do {
+            // Ctrl-C cancels the capture rather than the program while waiting
+            captureCancelled = false;
+            signal(SIGINT, cancelCapture);
+            const bool complete = doCapture(analyser, analyserSetup, buffer.data(), waitMode, timeout_ms, &captureCancelled);
+            signal(SIGINT, SIG_DFL);
+            if (!complete) {
+               USBDM::console.writeln(captureCancelled?"Capture cancelled":"Capture did not complete");
+            }
+            else if (runLength) {
+               reportRleCapture(buffer, analyserSetup.getPreTrigSize());
+            }
+            else if (transitions) {
+               reportTransitionCapture(buffer, analyserSetup.getPreTrigSize(), sampleRate);
+            }
+            if (complete && (readbackWindow != nullptr)) {
+               checkWindow(analyser, buffer, readbackWindow);
+            }
+            if (showSnapshot) {
+               reportSnapshot(ft2232);
+            }
+            if (showStatistics) {
+               USBDM::console.flushOutput();
+               ft2232.getStatistics().report(stdout);
+               ft2232.getStatistics().reset();
+            }
+
+            puts("Again?");
+            ch = getchar();
+         } while (ch != 'n');
+      });
 
    }
    catch (std::exception &e) {
@@ -15,44 +15,11 @@
 
 namespace Analyser {
 
-const uint16_t TriggerStep::lutEncoding[] = {
-      0b1111111111111111,  // XX
-      0b1010101010101010,  // XH
-      0b0101010101010101,  // XL
-      0b0010001000100010,  // XR
-      0b0100010001000100,  // XF
-      0b0110011001100110,  // XC
-      0b1111000011110000,  // HX
-      0b1010000010100000,  // HH
-      0b0101000001010000,  // HL
-      0b0010000000100000,  // HR
-      0b0100000001000000,  // HF
-      0b0110000001100000,  // HC
-      0b0000111100001111,  // LX
-      0b0000101000001010,  // LH
-      0b0000010100000101,  // LL
-      0b0000001000000010,  // LR
-      0b0000010000000100,  // LF
-      0b0000011000000110,  // LC
-      0b0000000011110000,  // RX
-      0b0000000010100000,  // RH
-      0b0000000001010000,  // RL
-      0b0000000000100000,  // RR
-      0b0000000001000000,  // RF
-      0b0000000001100000,  // RC
-      0b0000111100000000,  // FX
-      0b0000101000000000,  // FH
-      0b0000010100000000,  // FL
-      0b0000001000000000,  // FR
-      0b0000010000000000,  // FF
-      0b0000011000000000,  // FC
-      0b0000111111110000,  // CX
-      0b0000101010100000,  // CH
-      0b0000010101010000,  // CL
-      0b0000001000100000,  // CR
-      0b0000010001000000,  // CF
-      0b0000011001100000,  // CC
-};
+// FPGA variants
+template class TriggerEncoding<16, 16, 2, 16>;   // 16 inputs, 2 patterns/step (this analyser)
+template class TriggerEncoding<16, 16, 4, 16>;   // 16 inputs, 4 patterns/step
+template class TriggerEncoding<32, 16, 2, 16>;   // 32 inputs, 2 patterns/step
+template class TriggerEncoding<32, 16, 4, 16>;   // 32 inputs, 4 patterns/step
 
 /**
  * Print an array of LUTs
@@ -8,76 +8,348 @@
 #ifndef FT2232_H_
 #define FT2232_H_
 
-#include "ftd2xx.h"
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
 
-class FT2232 {
+#include "TransferStatistics.h"
 
-private:
-   FT_HANDLE handle = nullptr;
+class FT2232;
 
-public:
+/// Owning handle for a FT2232 transport
+using FT2232Ptr = std::unique_ptr<FT2232>;
 
 /**
- * Construct FT2232 device
- * This open the device
- *
- * @return Device handle
+ * USB transfer parameters that affect latency and throughput
  */
-FT2232(bool verbose = false);
+struct TransferProfile {
+   unsigned latencyTimer_ms;  //!< FT2232 latency timer - partial packets are sent after this time (1-255 ms)
+   unsigned inTransferSize;   //!< USB IN transfer size in bytes (multiple of 512)
+   unsigned outTransferSize;  //!< USB OUT transfer size in bytes (multiple of 512)
+   unsigned blockSize;        //!< Maximum bytes in a single C_RD_BUFFER or C_LUT_CONFIG command (multiple of 4)
+};
 
 /**
- * Send data to FPGA through FT2232
- *
- * @param ftHandle   Device handle
- * @param data       Data to send
- * @param dataSize   Size of data in bytes
- *
- * @return true  => OK
- * @return false => Failed
+ * Selects which analyser to open
+ * Empty/zero fields match any device
  */
-void transmitData(const uint8_t data[], unsigned dataSize);
+struct DeviceSelector {
+   std::string serialNumber;   //!< Serial number as reported by FT2232::listDevices()
+   unsigned    locationId = 0; //!< USB location (bus and port path) as reported by FT2232::listDevices()
+};
 
 /**
- * Receive data from FPGA through FT2232
- *
- * @param ftHandle   Device handle
- * @param data       Data to send
- * @param dataSize   Size of data in bytes
- *
- * @return true  => OK
- * @return false => Failed
+ * Description of an attached analyser
  */
-void receiveData(uint8_t data[], unsigned dataSize);
+struct DeviceInfo {
+   std::string serialNumber;   //!< Serial number
+   unsigned    locationId;     //!< USB location (bus and port path)
+   std::string description;    //!< Product description
+};
 
-/**
- * Purge receive data buffer
- */
-void purgeRx() {
-   FT_Purge(handle, FT_PURGE_RX);
-}
+/// Profile used until tuned
+static constexpr TransferProfile DEFAULT_TRANSFER_PROFILE = {2, 16384, 4096, 60000};
 
 /**
- * Purge transmit data buffer
+ * Abstract transport used to communicate with the FPGA through a FT2232.
+ *
+ * The public interface is the same for all back-ends.
+ * Each back-end implements the protected _xxx() methods.
  */
-void purgeTx() {
-   FT_Purge(handle, FT_PURGE_TX);
-}
+class FT2232 {
 
-/**
- * Purge receive and transmit data buffer
- */
-void purge() {
-   FT_Purge(handle, FT_PURGE_RX|FT_PURGE_TX);
-}
+protected:
+   /**
+    * Send data to FPGA (back-end specific)
+    *
+    * @param data       Data to send
+    * @param dataSize   Size of data in bytes
+    *
+    * @throw MyException on failure
+    */
+   virtual void _transmitData(const uint8_t data[], unsigned dataSize) = 0;
 
-/**
- * Destruct FT2232 device
- * This closes the device
- *
- * @param ftHandle Device handles
- */
-~FT2232();
+   /**
+    * Receive data from FPGA (back-end specific)
+    * Does not return until all data is received
+    *
+    * @param data       Buffer for data
+    * @param dataSize   Size of data in bytes
+    *
+    * @throw MyException on failure or timeout
+    */
+   virtual void _receiveData(uint8_t data[], unsigned dataSize) = 0;
+
+   /**
+    * Discard buffered data (back-end specific)
+    *
+    * @param rx   Discard data from FPGA not yet received
+    * @param tx   Discard data to FPGA not yet sent
+    */
+   virtual void _purge(bool rx, bool tx) = 0;
+
+   /**
+    * Wait until data from FPGA is available (back-end specific)
+    * This is expected to block on a driver event rather than poll
+    *
+    * @param timeout_ms   Maximum time to wait in ms
+    *
+    * @return true  => Data is available
+    * @return false => Timeout
+    *
+    * @throw MyException on failure
+    */
+   virtual bool _waitForData(unsigned timeout_ms) = 0;
+
+   /**
+    * Apply USB transfer parameters (back-end specific)
+    *
+    * @param profile Parameters to apply (already validated)
+    *
+    * @throw MyException on failure
+    */
+   virtual void _setTransferProfile(const TransferProfile &profile) = 0;
+
+   /**
+    * Get serial number of device (back-end specific)
+    *
+    * @return Serial number
+    */
+   virtual std::string _getSerialNumber() = 0;
+
+   /**
+    * Check if the analyser is emulated in software (back-end specific)
+    *
+    * @return true for FT2232_Emulator
+    */
+   virtual bool _isEmulated() {
+      return false;
+   }
+
+   FT2232() {
+   }
+
+   /// Transfer statistics (back-ends record partial reads and timeouts)
+   TransferStatistics statistics;
+
+private:
+   /// Current transfer parameters
+   TransferProfile transferProfile = DEFAULT_TRANSFER_PROFILE;
+
+public:
+
+   /**
+    * Open the FT2232 device using the default back-end for this platform
+    *  - Windows  D2XX driver
+    *  - Linux    libusb bulk transfers
+    * The transfer profile saved for the device is applied.
+    *
+    * @param verbose Print device information while opening
+    *
+    * @return Device handle
+    *
+    * @throw MyException if the device cannot be opened
+    */
+   static FT2232Ptr open(bool verbose = false) {
+      return open(DeviceSelector(), verbose);
+   }
+
+   /**
+    * Open a particular FT2232 device using the default back-end for this platform
+    * The transfer profile saved for the device is applied.
+    *
+    * @param selector Selects device
+    * @param verbose  Print device information while opening
+    *
+    * @return Device handle
+    *
+    * @throw MyException if the device cannot be opened
+    */
+   static FT2232Ptr open(const DeviceSelector &selector, bool verbose = false);
+
+   /**
+    * Open FT2232 device by serial number
+    *
+    * @param serialNumber  Serial number as reported by listDevices()
+    * @param verbose       Print device information while opening
+    *
+    * @return Device handle
+    *
+    * @throw MyException if the device cannot be opened
+    */
+   static FT2232Ptr openBySerialNumber(const std::string &serialNumber, bool verbose = false) {
+      DeviceSelector selector;
+      selector.serialNumber = serialNumber;
+      return open(selector, verbose);
+   }
+
+   /**
+    * Open FT2232 device by USB location
+    *
+    * @param locationId  Location as reported by listDevices()
+    * @param verbose     Print device information while opening
+    *
+    * @return Device handle
+    *
+    * @throw MyException if the device cannot be opened
+    */
+   static FT2232Ptr openByLocation(unsigned locationId, bool verbose = false) {
+      DeviceSelector selector;
+      selector.locationId = locationId;
+      return open(selector, verbose);
+   }
+
+   /**
+    * List attached analysers
+    *
+    * @return Devices found
+    *
+    * @throw MyException on driver failure
+    */
+   static std::vector<DeviceInfo> listDevices();
+
+   /**
+    * Send data to FPGA through FT2232
+    *
+    * @param data       Data to send
+    * @param dataSize   Size of data in bytes
+    *
+    * @throw MyException on failure
+    */
+   void transmitData(const uint8_t data[], unsigned dataSize) {
+      ActivityTimer timer(statistics, Activity::Transmit, dataSize);
+      _transmitData(data, dataSize);
+   }
+
+   /**
+    * Receive data from FPGA through FT2232
+    *
+    * @param data       Buffer for data
+    * @param dataSize   Size of data in bytes
+    *
+    * @throw MyException on failure
+    */
+   void receiveData(uint8_t data[], unsigned dataSize) {
+      ActivityTimer timer(statistics, Activity::Receive, dataSize);
+      _receiveData(data, dataSize);
+   }
+
+   /**
+    * Wait until data from FPGA is available without consuming it
+    *
+    * @param timeout_ms   Maximum time to wait in ms
+    *
+    * @return true  => Data is available
+    * @return false => Timeout
+    *
+    * @throw MyException on failure
+    */
+   bool waitForData(unsigned timeout_ms) {
+      ActivityTimer timer(statistics, Activity::WaitForData);
+      bool available = _waitForData(timeout_ms);
+      if (!available) {
+         timer.timeout();
+      }
+      return available;
+   }
+
+   /**
+    * Get transfer statistics
+    * These are only collected when built with FT2232_STATISTICS=1
+    *
+    * @return Statistics for this device
+    */
+   TransferStatistics &getStatistics() {
+      return statistics;
+   }
+
+   /**
+    * Set USB transfer parameters
+    * Values are adjusted to the nearest acceptable value
+    *
+    * @param profile Parameters to apply
+    *
+    * @throw MyException on failure
+    */
+   void setTransferProfile(const TransferProfile &profile);
+
+   /**
+    * Get current USB transfer parameters
+    *
+    * @return Parameters
+    */
+   const TransferProfile &getTransferProfile() const {
+      return transferProfile;
+   }
+
+   /**
+    * Get serial number of device
+    * This is used to identify the saved transfer profile
+    *
+    * @return Serial number
+    */
+   std::string getSerialNumber() {
+      return _getSerialNumber();
+   }
+
+   /**
+    * Check if the analyser is emulated in software
+    * Emulator-only configurations (see AnalyserConfig::isEmulatorOnly()) are
+    * not accepted from other devices
+    *
+    * @return true for FT2232_Emulator
+    */
+   bool isEmulated() {
+      return _isEmulated();
+   }
+
+   /**
+    * Apply the transfer profile saved for this device (if any)
+    *
+    * @return true  => Saved profile applied
+    * @return false => No profile saved for this device
+    */
+   bool loadTransferProfile();
+
+   /**
+    * Save the current transfer profile for this device
+    * The profile is applied by open() in future
+    *
+    * @throw MyException if the profile file cannot be written
+    */
+   void saveTransferProfile();
+
+   /**
+    * Purge receive data buffer
+    */
+   void purgeRx() {
+      _purge(true, false);
+   }
+
+   /**
+    * Purge transmit data buffer
+    */
+   void purgeTx() {
+      _purge(false, true);
+   }
+
+   /**
+    * Purge receive and transmit data buffer
+    */
+   void purge() {
+      _purge(true, true);
+   }
+
+   /**
+    * Destruct FT2232 device
+    * This closes the device
+    */
+   virtual ~FT2232() {
+   }
 
+   FT2232(const FT2232 &) = delete;
+   FT2232 &operator=(const FT2232 &) = delete;
 };
 
 #endif /* FT2232_H_ */
@@ -0,0 +1,331 @@
+//============================================================================
+// Name        : FT2232_D2xx.cpp
+// Author      : pgo
+// FT2232 transport using the FTDI D2XX driver (Windows)
+//============================================================================
+#if defined(_WIN32)
+#include <stdio.h>
+#include <stdint.h>
+#include <windows.h>
+#include <assert.h>
+#include <string.h>
+#include <vector>
+#include "ftd2xx.h"
+
+#include "MyException.h"
+#include "FT2232_D2xx.h"
+
+/// Product description of channel A as reported by D2XX
+static constexpr const char *DESCRIPTION = "Fast Logic Analyser A";
+
+/**
+ * List attached analysers
+ *
+ * @return Devices found
+ */
+std::vector<DeviceInfo> FT2232_D2xx::listDevices() {
+   std::vector<DeviceInfo> devices;
+
+   DWORD numDevs;
+   FT_STATUS ftStatus = FT_CreateDeviceInfoList(&numDevs);
+   if (ftStatus != FT_OK) {
+      fprintf(stderr, "FT_CreateDeviceInfoList failed\n");
+      throw MyException("FT_CreateDeviceInfoList failed");
+   }
+   if (numDevs == 0) {
+      return devices;
+   }
+   std::vector<FT_DEVICE_LIST_INFO_NODE> devInfo(numDevs);
+   ftStatus = FT_GetDeviceInfoList(devInfo.data(), &numDevs);
+   if (ftStatus != FT_OK) {
+      fprintf(stderr, "FT_GetDeviceInfoList failed\n");
+      throw MyException("FT_GetDeviceInfoList failed");
+   }
+   for (unsigned index=0; index<numDevs; index++) {
+      if (strcmp(devInfo[index].Description, DESCRIPTION) == 0) {
+         devices.push_back(DeviceInfo{devInfo[index].SerialNumber, (unsigned)devInfo[index].LocId, devInfo[index].Description});
+      }
+   }
+   return devices;
+}
+
+/**
+ * Open FT2232 device
+ *
+ * @param selector Selects device (by serial number, then location, then description)
+ * @param verbose  Print device information while opening
+ */
+FT2232_D2xx::FT2232_D2xx(const DeviceSelector &selector, bool verbose) {
+
+   FT_STATUS ftStatus;
+   long unsigned numDevs;
+   handle = nullptr;
+
+   // Create the device information list
+   ftStatus = FT_CreateDeviceInfoList(&numDevs);
+   if (ftStatus == FT_OK) {
+      if (verbose) {
+         printf("Number of devices found: %ld\n", numDevs);
+      }
+   } else {
+      printf("FT_CreateDeviceInfoList failed\n");
+      throw MyException("FT_CreateDeviceInfoList failed");
+   }
+
+   if (numDevs > 0) {
+      // Allocate storage for list based on numDevs
+      std::vector<FT_DEVICE_LIST_INFO_NODE> devInfo(numDevs);
+      // Get the device information list
+      ftStatus = FT_GetDeviceInfoList(devInfo.data(), &numDevs);
+      if (verbose) {
+         if (ftStatus == FT_OK) {
+            for (unsigned i = 0; i < numDevs; i++) {
+               printf("Dev %d:\n",i);
+               printf(" Flags          = 0x%lx\n",    devInfo[i].Flags);
+               printf(" Type           = 0x%lx\n",    devInfo[i].Type);
+               printf(" ID             = 0x%lx\n",    devInfo[i].ID);
+               printf(" LocId          = 0x%lx\n",    devInfo[i].LocId);
+               printf(" SerialNumber   = '%s'\n",     devInfo[i].SerialNumber);
+               printf(" Description    = '%s'\n",     devInfo[i].Description);
+               printf(" handle       = 0x%p\n",       devInfo[i].ftHandle);
+            }
+         }
+      }
+   }
+
+   if (!selector.serialNumber.empty()) {
+      ftStatus = FT_OpenEx((PVOID)selector.serialNumber.c_str(), FT_OPEN_BY_SERIAL_NUMBER, &handle);
+   }
+   else if (selector.locationId != 0) {
+      ftStatus = FT_OpenEx((PVOID)(uintptr_t)selector.locationId, FT_OPEN_BY_LOCATION, &handle);
+   }
+   else {
+      ftStatus = FT_OpenEx((PVOID)DESCRIPTION, FT_OPEN_BY_DESCRIPTION, &handle);
+   }
+   if (ftStatus == FT_OK) {
+      if (verbose) {
+         printf("FT_OpenEx() OK\n");
+      }
+   } else {
+      printf("FT_OpenEx() failed\n");
+      throw MyException("FT_OpenEx() failed");
+   }
+
+   ftStatus = FT_SetTimeouts(handle, 1000, 1000); // read, write timeouts in ms
+   if (ftStatus != FT_OK) {
+      printf("FT_SetTimeouts() failed\n");
+      throw MyException("FT_SetTimeouts() failed");
+   }
+
+   FT_DEVICE deviceType;
+   DWORD     deviceId;
+   char      serial[16]      = {0};
+   char      description[64] = {0};
+   ftStatus = FT_GetDeviceInfo(handle, &deviceType, &deviceId, serial, description, nullptr);
+   if (ftStatus != FT_OK) {
+      printf("FT_GetDeviceInfo() failed\n");
+      throw MyException("FT_GetDeviceInfo() failed");
+   }
+   serialNumber = serial;
+
+   setTransferProfile(DEFAULT_TRANSFER_PROFILE);
+
+   purge();
+
+   return;
+}
+
+/**
+ * Close FT2232 device
+ *
+ * @param handle Device handles
+ */
+FT2232_D2xx::~FT2232_D2xx() {
+   try {
+      FT_Close(handle);
+   } catch (std::exception &) {
+      // Ignore
+   }
+   if (rxEvent != nullptr) {
+      CloseHandle(rxEvent);
+   }
+}
+
+/**
+ * Apply USB transfer parameters
+ *
+ * @param profile Parameters to apply
+ */
+void FT2232_D2xx::_setTransferProfile(const TransferProfile &profile) {
+   FT_STATUS ftStatus = FT_SetLatencyTimer(handle, (UCHAR)profile.latencyTimer_ms);
+   if (ftStatus != FT_OK) {
+      fprintf(stderr, "\nFT_SetLatencyTimer() failed\n");
+      throw MyException("FT_SetLatencyTimer() failed");
+   }
+   ftStatus = FT_SetUSBParameters(handle, profile.inTransferSize, profile.outTransferSize);
+   if (ftStatus != FT_OK) {
+      fprintf(stderr, "\nFT_SetUSBParameters() failed\n");
+      throw MyException("FT_SetUSBParameters() failed");
+   }
+}
+
+/**
+ * Get serial number of device
+ *
+ * @return Serial number obtained when opened
+ */
+std::string FT2232_D2xx::_getSerialNumber() {
+   return serialNumber;
+}
+
+/**
+ * Send data to FPGA through FT2232
+ *
+ * @param handle   Device handle
+ * @param data       Data to send
+ * @param dataSize   Size of data in bytes
+ *
+ * @return true  => OK
+ * @return false => Failed
+ */
+void FT2232_D2xx::_transmitData(const uint8_t data[], unsigned dataSize) {
+   FT_STATUS ftStatus;
+   //   unsigned long rxQueueBytes, txQueueBytes, status;
+   //   ftStatus = FT_GetStatus(handle,&rxQueueBytes, &txQueueBytes, &status);
+   //   if (ftStatus != FT_OK) {
+   //      printf("FT_GetStatus() failed\n");
+   //      return false;
+   //   }
+   unsigned bytesRemaining    = dataSize;
+   unsigned long bytesWritten = 0;
+   unsigned long offset       = 0;
+//   unsigned col = 0;
+
+   while(bytesRemaining > 0) {
+      ftStatus = FT_Write(handle, (LPVOID)(data+offset), bytesRemaining, &bytesWritten);
+      if (ftStatus == FT_OK) {
+         if (bytesWritten > 0) {
+//            printf(".");
+//            if (col++==60) {
+//               col = 0;
+//               printf("\n");
+//            }
+//            printf("bytesWritten = %ld\n", bytesWritten);
+            offset         += bytesWritten;
+            bytesRemaining -= bytesWritten;
+         }
+         else {
+            statistics.countTimeout(Activity::Transmit);
+            fprintf(stderr, "\nFT_Write() Timeout\n");
+            throw MyException("FT_Write() Timeout");
+         }
+         fflush(stdout);
+         //         printf("FT_Write() OK\n");
+      }
+      else {
+         fprintf(stderr, "\nFT_Write() failed\n");
+         throw MyException("FT_Write() failed");
+      }
+   }
+}
+
+/**
+ * Receive data from FPGA through FT2232
+ *
+ * @param handle   Device handle
+ * @param data       Data to send
+ * @param dataSize   Size of data in bytes
+ *
+ * @return true  => OK
+ * @return false => Failed
+ */
+void FT2232_D2xx::_receiveData(uint8_t data[], unsigned dataSize) {
+   FT_STATUS ftStatus;
+
+   //   unsigned long rxQueueBytes, txQueueBytes, status;
+   //   ftStatus = FT_GetStatus(handle,&rxQueueBytes, &txQueueBytes, &status);
+   //   if (ftStatus != FT_OK) {
+   //      printf("FT_GetStatus() failed\n");
+   //      return false;
+   //   }
+   unsigned bytesRemaining    = dataSize;
+   unsigned long bytesRead = 0;
+   unsigned long offset       = 0;
+//   unsigned col = 0;
+
+   while(bytesRemaining > 0) {
+      ftStatus = FT_Read(handle, (LPVOID)(data+offset), bytesRemaining, &bytesRead);
+      if (ftStatus == FT_OK) {
+         if (bytesRead > 0) {
+            if (bytesRead < bytesRemaining) {
+               statistics.countPartialRead();
+            }
+//            printf(".");
+//            if (col++==60) {
+//               col = 0;
+//               printf("\n");
+//            }
+//            printf("bytesReceived = %ld\n", bytesRead);
+            offset         += bytesRead;
+            bytesRemaining -= bytesRead;
+         }
+         else {
+            statistics.countTimeout(Activity::Receive);
+            fprintf(stderr, "\nFT_Read() Timeout\n");
+            throw MyException("FT_Read() Timeout");
+         }
+         fflush(stdout);
+         //         printf("FT_Write() OK\n");
+      }
+      else {
+         fprintf(stderr, "\nFT_Read() failed\n");
+         throw MyException("FT_Read() failed");
+      }
+   }
+}
+
+/**
+ * Discard buffered data
+ *
+ * @param rx   Discard data from FPGA not yet received
+ * @param tx   Discard data to FPGA not yet sent
+ */
+void FT2232_D2xx::_purge(bool rx, bool tx) {
+   FT_Purge(handle, (rx?FT_PURGE_RX:0)|(tx?FT_PURGE_TX:0));
+}
+
+/**
+ * Wait until data from FPGA is available
+ * Blocks on a driver receive event
+ *
+ * @param timeout_ms   Maximum time to wait in ms
+ *
+ * @return true  => Data is available
+ * @return false => Timeout
+ */
+bool FT2232_D2xx::_waitForData(unsigned timeout_ms) {
+   if (rxEvent == nullptr) {
+      rxEvent = CreateEvent(nullptr, false, false, nullptr);
+      if (rxEvent == nullptr) {
+         throw MyException("CreateEvent() failed");
+      }
+      if (FT_SetEventNotification(handle, FT_EVENT_RXCHAR, rxEvent) != FT_OK) {
+         throw MyException("FT_SetEventNotification() failed");
+      }
+   }
+   DWORD rxBytes = 0;
+   if (FT_GetQueueStatus(handle, &rxBytes) != FT_OK) {
+      fprintf(stderr, "\nFT_GetQueueStatus() failed\n");
+      throw MyException("FT_GetQueueStatus() failed");
+   }
+   if (rxBytes == 0) {
+      WaitForSingleObject(rxEvent, timeout_ms);
+      if (FT_GetQueueStatus(handle, &rxBytes) != FT_OK) {
+         fprintf(stderr, "\nFT_GetQueueStatus() failed\n");
+         throw MyException("FT_GetQueueStatus() failed");
+      }
+   }
+   return rxBytes > 0;
+}
+
+#endif // defined(_WIN32)
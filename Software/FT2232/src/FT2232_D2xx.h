@@ -0,0 +1,63 @@
+/*
+ * FT2232_D2xx.h
+ *
+ *  Created on: 4 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef FT2232_D2XX_H_
+#define FT2232_D2XX_H_
+
+#include <string>
+
+#include "ftd2xx.h"
+#include "FT2232.h"
+
+/**
+ * FT2232 transport using the FTDI D2XX driver
+ */
+class FT2232_D2xx : public FT2232 {
+
+private:
+   FT_HANDLE handle  = nullptr;
+
+   /// Event signalled by driver when data is received (created on first use)
+   HANDLE    rxEvent = nullptr;
+
+   /// Serial number obtained when opened
+   std::string serialNumber;
+
+protected:
+   virtual void _transmitData(const uint8_t data[], unsigned dataSize) override;
+   virtual void _receiveData(uint8_t data[], unsigned dataSize) override;
+   virtual void _purge(bool rx, bool tx) override;
+   virtual bool _waitForData(unsigned timeout_ms) override;
+   virtual void _setTransferProfile(const TransferProfile &profile) override;
+   virtual std::string _getSerialNumber() override;
+
+public:
+
+   /**
+    * Construct FT2232 device
+    * This open the device
+    *
+    * @param selector Selects device
+    * @param verbose  Print device information while opening
+    */
+   FT2232_D2xx(const DeviceSelector &selector = DeviceSelector(), bool verbose = false);
+
+   /**
+    * List attached analysers
+    *
+    * @return Devices found
+    */
+   static std::vector<DeviceInfo> listDevices();
+
+   /**
+    * Destruct FT2232 device
+    * This closes the device
+    */
+   virtual ~FT2232_D2xx();
+};
+
+#endif /* FT2232_D2XX_H_ */
@@ -0,0 +1,696 @@
+//============================================================================
+// Name        : FT2232_Emulator.cpp
+// Author      : pgo
+// Software model of the FPGA analyser behind the FT2232 transport
+//============================================================================
+#include <stdio.h>
+#include <thread>
+#include <algorithm>
+
+#include "console.h"
+#include "MyException.h"
+#include "EncodeLuts.h"
+#include "FT2232_Emulator.h"
+
+using namespace Analyser;
+
+/**
+ * Load raw little-endian samples from file
+ *
+ * @param filename         File to load
+ * @param bytesPerSample   Size of samples in file (2 or 4 bytes)
+ */
+FileSignalSource::FileSignalSource(const char *filename, unsigned bytesPerSample) :
+      bytesPerSample(bytesPerSample) {
+   if ((bytesPerSample != 2) && (bytesPerSample != 4)) {
+      fprintf(stderr, "\nIllegal sample size %u for '%s'\n", bytesPerSample, filename);
+      throw MyException("Illegal sample size %u for '%s'", bytesPerSample, filename);
+   }
+   FILE *fp = fopen(filename, "rb");
+   if (fp == nullptr) {
+      fprintf(stderr, "\nFailed to open '%s'\n", filename);
+      throw MyException("Failed to open '%s'", filename);
+   }
+   uint8_t buff[4];
+   while (fread(buff, bytesPerSample, 1, fp) == 1) {
+      uint32_t sample = 0;
+      for (unsigned index=bytesPerSample; index-->0;) {
+         sample = (sample<<8)|buff[index];
+      }
+      samples.push_back(sample);
+   }
+   fclose(fp);
+   if (samples.empty()) {
+      fprintf(stderr, "\nNo samples in '%s'\n", filename);
+      throw MyException("No samples in '%s'", filename);
+   }
+}
+
+/**
+ * Construct emulated analyser
+ *
+ * @param source     Source of sample data (ownership is taken)
+ * @param linkModel  USB timing model
+ * @param config     Size of trigger hardware
+ */
+FT2232_Emulator::FT2232_Emulator(
+      SignalSource          *source,
+      const LinkModel       &linkModel,
+      const AnalyserConfig  &config) :
+      source(source), linkModel(linkModel), config(config) {
+
+   if (source->getSampleWidth() < config.sampleWidth) {
+      fprintf(stderr, "\n%u-bit signal source can't drive %u-bit hardware\n",
+            source->getSampleWidth(), config.sampleWidth);
+      throw MyException("%u-bit signal source can't drive %u-bit hardware",
+            source->getSampleWidth(), config.sampleWidth);
+   }
+   sampleMask = (config.sampleWidth>=32)?0xFFFFFFFF:((1U<<config.sampleWidth)-1);
+
+   // The input register holds the signal from before the first capture
+   currentSample = source->nextSample()&sampleMask;
+
+   // LUT chain is the size of the LUT image for the hardware
+   unsigned lutChainSize = withTriggerEncoding(config, [](auto tag) {
+      return (unsigned)sizeof(typename decltype(tag)::Encoding::LutImage);
+   });
+   lutChain.assign(lutChainSize, 0);
+   triggerModel = makeTriggerModel(config);
+}
+
+/**
+ * Sample period selected by the control register
+ * (see Prescaler.vhd)
+ *
+ * @return Period in ns
+ */
+unsigned FT2232_Emulator::getSamplePeriodIn_nanoseconds() {
+   static const unsigned divs[]    = {1,2,5,10};
+   static const unsigned decades[] = {1,10,100,1000};
+
+   return 10 *
+         divs[(controlRegister&C_CONTROL_DIV_MASK)>>C_CONTROL_DIV_OFFSET] *
+         decades[(controlRegister&C_CONTROL_DIVx_MASK)>>C_CONTROL_DIVx_OFFSET];
+}
+
+/**
+ * Delay to model USB transfer time
+ *
+ * @param byteCount        Number of bytes in transfer
+ * @param transferSize     Size of individual USB transfers
+ * @param bytesPerSecond   Link bandwidth
+ * @param partialPacket    Transfer ends in a partial packet so waits for latency timer
+ */
+void FT2232_Emulator::linkDelay(unsigned byteCount, unsigned transferSize, unsigned bytesPerSecond, bool partialPacket) {
+   using namespace std::chrono;
+
+   unsigned transfers = std::max(1U, (byteCount+transferSize-1)/transferSize);
+   nanoseconds delay = microseconds(transfers*linkModel.transactionLatency_us);
+   if (bytesPerSecond > 0) {
+      delay += nanoseconds((1000000000ULL*byteCount)/bytesPerSecond);
+   }
+   if (partialPacket) {
+      delay += milliseconds(linkModel.latencyTimer_ms);
+   }
+   if (delay.count() > 0) {
+      std::this_thread::sleep_for(delay);
+   }
+}
+
+/**
+ * Start capture - clears SDRAM pointers (clear_counter)
+ */
+void FT2232_Emulator::startAcquisition() {
+   if (sdram.empty()) {
+      sdram.resize(SDRAM_SIZE);
+   }
+   wrAddress      = 0;
+   rdAddress      = 0;
+   rdBase         = 0;
+   sdramArmed     = false;
+   readByte       = 0;
+   captureCounter = 0;
+   preTriggerFlag = false;
+   triggerFound   = false;
+   samplesTaken   = 0;
+   armed          = false;
+   overrun        = false;
+   rleValid       = false;
+   trValid        = false;
+   trTriggerHeld  = false;
+   trDeltaPending = false;
+   startTime      = Clock::now();
+   tState         = (controlRegister&C_CONTROL_STREAM)?t_streaming:t_preTrig;
+}
+
+/**
+ * Write sample to SDRAM
+ * While armed the read pointer trails the write pointer by the pre-trigger amount
+ * (see SDRAM_Controller.vhd)
+ *
+ * @param sample           Sample value
+ * @param preTriggerSample Sample marks end of pre-trigger
+ * @param triggerSample    Sample marks trigger
+ */
+void FT2232_Emulator::writeSdram(uint32_t sample, bool preTriggerSample, bool triggerSample) {
+   // A transition capture may store the trigger as the first word after the pre-trigger
+   if (triggerSample) {
+      sdramArmed = false;
+   }
+   else if (preTriggerSample) {
+      sdramArmed = true;
+   }
+   sdram[wrAddress] = sample;
+   wrAddress = (wrAddress+1)&ADDRESS_MASK;
+   if (sdramArmed) {
+      rdAddress = (rdAddress+1)&ADDRESS_MASK;
+      rdBase    = (rdBase+1)&ADDRESS_MASK;
+   }
+}
+
+/**
+ * Process one sample in streaming mode
+ * The sample is discarded if the ring buffer is full
+ * (see SDRAM_Controller.vhd)
+ *
+ * @param sample New sample value
+ */
+void FT2232_Emulator::streamSample(uint32_t sample) {
+   if (((wrAddress-rdAddress)&ADDRESS_MASK) >= RING_FULL) {
+      overrun = true;
+   }
+   else {
+      writeSdram(currentSample, false, false);
+   }
+   currentSample = sample&sampleMask;
+}
+
+/**
+ * Write word to SDRAM and count it towards the pre-trigger and capture amounts
+ * (capture_tick)
+ *
+ * @param word         Sample or RLE word
+ * @param triggerWord  Word marks trigger
+ */
+void FT2232_Emulator::storeWord(uint32_t word, bool triggerWord) {
+
+   // write_fifo captures the word and flags
+   writeSdram(word, preTriggerFlag, triggerWord);
+
+   switch(tState) {
+      case t_preTrig:
+         captureCounter = (captureCounter+1)&ADDRESS_MASK;
+         if (captureCounter == preTriggerAmount) {
+            tState         = t_armed;
+            preTriggerFlag = true;
+         }
+         break;
+      case t_armed:
+         preTriggerFlag = false;
+         break;
+      case t_running:
+         if (captureCounter == captureAmount) {
+            tState = t_complete;
+            if (controlRegister&C_CONTROL_NOTIFY) {
+               // Unsolicited completion status
+               toHost.push_back(C_STATUS_NOTIFY|tState|(overrun?C_STATUS_OVERRUN:0));
+            }
+         }
+         captureCounter = (captureCounter+1)&ADDRESS_MASK;
+         break;
+      default:
+         break;
+   }
+}
+
+/**
+ * Run-length encode sample (C_MODE_RLE)
+ * A finished run is stored as value (with trigger flag) followed by repeat count
+ *
+ * @param sample         Sample value
+ * @param triggerSample  Sample is the trigger (starts a new run)
+ */
+void FT2232_Emulator::encodeRle(uint32_t sample, bool triggerSample) {
+   if (rleValid && (sample == rleValue) && (rleCount < C_RLE_MAX_COUNT) && !triggerSample) {
+      rleCount++;
+      return;
+   }
+   if (rleValid) {
+      storeWord(rleValue, rleTrigger);
+      storeWord(rleCount, false);
+   }
+   rleValid   = true;
+   rleValue   = sample;
+   rleCount   = 0;
+   rleTrigger = triggerSample;
+}
+
+/**
+ * Transition encode sample (C_MODE_TRANSITION)
+ * An event is stored as value (with trigger flag) followed by ticks since the previous event
+ *
+ * @param sample         Sample value
+ * @param triggerSample  Sample is the trigger (forces an event)
+ */
+void FT2232_Emulator::encodeTransition(uint32_t sample, bool triggerSample) {
+   // At 10 ns the second word of an event occupies the following clock
+   const bool busy    = trDeltaPending;
+   const bool trigger = triggerSample || trTriggerHeld;
+   trDeltaPending = false;
+
+   if (!busy && (!trValid || (((sample^trValue)&channelRegister) != 0) ||
+                 (trTicks == C_TRANSITION_MAX_DELTA) || trigger)) {
+      storeWord(sample, trigger);
+      storeWord(trValid?trTicks:0, false);
+      trValid        = true;
+      trValue        = sample;
+      trTicks        = 1;
+      trTriggerHeld  = false;
+      trDeltaPending = (getSamplePeriodIn_nanoseconds() == 10);
+   }
+   else {
+      // Trigger is held until an event can be stored
+      trTicks++;
+      trTriggerHeld = trigger;
+   }
+}
+
+/**
+ * Process one sample (doSample) through the capture state machine
+ *
+ * @param sample New sample value
+ */
+void FT2232_Emulator::takeSample(uint32_t sample) {
+
+   if (lutChainChanged) {
+      triggerModel->load(lutChain.data(), lutChain.size());
+      lutChainChanged = false;
+   }
+
+   // armed is registered from the capture state so lags by a clock at the fastest sample rate
+   bool enable = (getSamplePeriodIn_nanoseconds() > 10)?(tState == t_armed):armed;
+   armed       = (tState == t_armed);
+
+   const bool triggerFlag = triggerFound;
+   const bool found       = triggerFlag && (tState == t_armed);
+   triggerFound           = triggerModel->clock(currentSample, enable);
+
+   // RLE needs 2 clocks per run so is not used at the fastest sample rate
+   const uint8_t mode = modeRegister&C_MODE_CAPTURE_MASK;
+   if ((mode == C_MODE_RLE) && (getSamplePeriodIn_nanoseconds() > 10)) {
+      encodeRle(currentSample, found);
+   }
+   else if (mode == C_MODE_TRANSITION) {
+      encodeTransition(currentSample, found);
+   }
+   else {
+      storeWord(currentSample, triggerFlag);
+   }
+   currentSample = sample&sampleMask;
+
+   if (found) {
+      tState = t_running;
+   }
+}
+
+/**
+ * Bring the capture state machine up to the current time
+ */
+void FT2232_Emulator::advance() {
+   if (tState == t_idle) {
+      captureCounter = 0;
+      if (controlRegister&C_CONTROL_START_ACQ) {
+         startAcquisition();
+      }
+   }
+   if ((tState == t_preTrig) || (tState == t_armed) || (tState == t_running)) {
+      uint64_t due = (Clock::now()-startTime)/std::chrono::nanoseconds(getSamplePeriodIn_nanoseconds());
+      while ((samplesTaken < due) && (tState != t_complete)) {
+         takeSample(source->nextSample());
+         samplesTaken++;
+      }
+   }
+   if (tState == t_streaming) {
+      uint64_t due = (Clock::now()-startTime)/std::chrono::nanoseconds(getSamplePeriodIn_nanoseconds());
+      for (; samplesTaken < due; samplesTaken++) {
+         streamSample(source->nextSample());
+      }
+      controlRegister &= ~C_CONTROL_START_ACQ;
+      if (controlRegister&C_CONTROL_CLEAR) {
+         controlRegister &= ~C_CONTROL_CLEAR;
+         tState = t_idle;
+      }
+   }
+   if (tState == t_complete) {
+      controlRegister &= ~C_CONTROL_START_ACQ;
+      if (controlRegister&C_CONTROL_CLEAR) {
+         controlRegister &= ~C_CONTROL_CLEAR;
+         tState = t_idle;
+      }
+   }
+}
+
+/**
+ * Read SDRAM through the read FIFO (low byte first)
+ * With C_MODE_PACK each word sent holds several samples reduced to
+ * the channels in the channel mask (see ReadPacker_proc in LogicAnalyser.vhd)
+ *
+ * @param byteCount Number of bytes to transfer
+ */
+void FT2232_Emulator::readSdram(uint32_t byteCount) {
+   if (sdram.empty()) {
+      sdram.resize(SDRAM_SIZE);
+   }
+   if (tState == t_streaming) {
+      // Samples written while the host was sending the command
+      advance();
+   }
+   const unsigned bytesPerSample = config.getBytesPerSample();
+   const unsigned sampleBits     = (controlRegister&C_CONTROL_STREAM)?8*bytesPerSample:
+         Analyser::getReadbackSampleBits(modeRegister, channelRegister, bytesPerSample);
+   const uint64_t channels       = (1ULL<<sampleBits)-1;
+   while (byteCount-- > 0) {
+      if (readByte == 0) {
+         // Next word for read FIFO
+         readWord = 0;
+         for (unsigned bit=0; bit<8*bytesPerSample; bit+=sampleBits) {
+            readWord  |= (sdram[rdAddress]&channels)<<bit;
+            rdAddress  = (rdAddress+1)&ADDRESS_MASK;
+         }
+      }
+      toHost.push_back((uint8_t)(readWord>>(8*readByte)));
+      if (++readByte == bytesPerSample) {
+         readByte  = 0;
+      }
+   }
+}
+
+/**
+ * Send status snapshot (see status_snapshot in LogicAnalyser.vhd)
+ * The trigger logic is only enabled while armed so is otherwise
+ * at the first step with the match counter cleared.
+ */
+void FT2232_Emulator::sendSnapshot() {
+   const bool     triggering     = (tState == t_armed);
+   const uint16_t matchCounter   = triggering?triggerModel->getMatchCounter():1;
+   uint32_t       preTriggerFill = 0;
+   if (tState == t_preTrig) {
+      preTriggerFill = captureCounter;
+   }
+   else if ((tState == t_armed) || (tState == t_running) || (tState == t_complete)) {
+      preTriggerFill = preTriggerAmount;
+   }
+   auto push24 = [this](uint32_t value) {
+      toHost.push_back((uint8_t)value);
+      toHost.push_back((uint8_t)(value>>8));
+      toHost.push_back((uint8_t)(value>>16));
+   };
+   toHost.push_back(tState|(overrun?C_STATUS_OVERRUN:0));
+   toHost.push_back(triggering?triggerModel->getStep():0);
+   toHost.push_back((uint8_t)matchCounter);
+   toHost.push_back((uint8_t)(matchCounter>>8));
+   push24(captureCounter);
+   push24(preTriggerFill);
+   push24(wrAddress);
+}
+
+/**
+ * Process one byte from host (see ProcIStateMachineComb in LogicAnalyser.vhd)
+ *
+ * @param data Byte from host
+ */
+void FT2232_Emulator::processByte(uint8_t data) {
+
+   switch(iState) {
+      case s_cmd:
+         if (data != C_NOP) {
+            command = data;
+            iState  = s_size;
+         }
+         break;
+
+      case s_size:
+         iState = s_cmd;
+         switch(command) {
+            case C_LUT_CONFIG:
+               dataCount = data;
+               iState    = s_load_luts1;
+               break;
+            case C_LUT_UPDATE:
+               dataCount = data;
+               iState    = s_update_luts1;
+               break;
+            case C_WR_CONTROL:
+               controlRegister = data;
+               advance();
+               break;
+            case C_WR_MODE:
+               modeRegister = data;
+               break;
+            case C_WR_CHANNELS:
+               channelRegister = (channelRegister>>8)|((uint32_t)data<<24);
+               iState          = s_write_channels2;
+               break;
+            case C_WR_PRETRIG:
+               preTriggerAmount = (preTriggerAmount&~0xFF)|data;
+               iState           = s_write_pretrig2;
+               break;
+            case C_WR_CAPTURE:
+               captureAmount = (captureAmount&~0xFF)|data;
+               iState        = s_write_capture2;
+               break;
+            case C_WR_READ_OFFSET:
+               readOffset = (readOffset&~0xFF)|data;
+               iState     = s_write_offset2;
+               break;
+            case C_RD_BUFFER:
+               dataCount = data;
+               iState    = s_read_buffer1;
+               break;
+            case C_RD_STATUS:
+               advance();
+               toHost.push_back(tState|(overrun?C_STATUS_OVERRUN:0));
+               break;
+            case C_RD_FILL:
+               // Samples written to ring buffer
+               advance();
+               toHost.push_back((uint8_t)wrAddress);
+               toHost.push_back((uint8_t)(wrAddress>>8));
+               toHost.push_back((uint8_t)(wrAddress>>16));
+               break;
+            case C_RD_SNAPSHOT:
+               advance();
+               sendSnapshot();
+               break;
+            case C_RD_VERSION:
+               toHost.push_back(VERSION);
+               break;
+            case C_RD_CONFIG:
+               toHost.insert(toHost.end(), C_CONFIG_KEY, C_CONFIG_KEY+sizeof(C_CONFIG_KEY));
+               toHost.push_back(config.sampleWidth);
+               toHost.push_back(config.maxTriggerSteps);
+               toHost.push_back(config.maxTriggerPatterns);
+               toHost.push_back(config.matchCounterBits);
+               break;
+            default:
+               break;
+         }
+         break;
+
+      case s_write_pretrig2:
+         preTriggerAmount = (preTriggerAmount&~0xFF00)|(data<<8);
+         iState           = s_write_pretrig3;
+         break;
+
+      case s_write_pretrig3:
+         preTriggerAmount = (preTriggerAmount&~0xFF0000)|(data<<16);
+         iState           = s_cmd;
+         break;
+
+      case s_write_capture2:
+         captureAmount = (captureAmount&~0xFF00)|(data<<8);
+         iState        = s_write_capture3;
+         break;
+
+      case s_write_capture3:
+         captureAmount = (captureAmount&~0xFF0000)|(data<<16);
+         iState        = s_cmd;
+         break;
+
+      case s_write_offset2:
+         readOffset = (readOffset&~0xFF00)|(data<<8);
+         iState     = s_write_offset3;
+         break;
+
+      case s_write_offset3:
+         readOffset = (readOffset&~0xFF0000)|(data<<16);
+         iState     = s_cmd;
+         if (!(controlRegister&C_CONTROL_STREAM)) {
+            // Seek (discards partly sent word)
+            rdAddress = (rdBase+readOffset)&ADDRESS_MASK;
+            readByte  = 0;
+         }
+         break;
+
+      case s_write_channels2:
+         channelRegister = (channelRegister>>8)|((uint32_t)data<<24);
+         iState          = s_write_channels3;
+         break;
+
+      case s_write_channels3:
+         channelRegister = (channelRegister>>8)|((uint32_t)data<<24);
+         iState          = s_write_channels4;
+         break;
+
+      case s_write_channels4:
+         channelRegister = (channelRegister>>8)|((uint32_t)data<<24);
+         iState          = s_cmd;
+         break;
+
+      case s_load_luts1:
+         dataCount |= data<<8;
+         iState     = s_load_luts2;
+         break;
+
+      case s_load_luts2:
+         // Shift byte into LUT chain
+         lutChain.erase(lutChain.begin());
+         lutChain.push_back(data);
+         lutChainChanged = true;
+         if (dataCount == 1) {
+            iState = s_cmd;
+         }
+         else {
+            dataCount = (dataCount-1)&0xFFFF;
+         }
+         break;
+
+      case s_update_luts1:
+         dataCount |= data<<8;
+         // Recirculate bytes around LUT chain (unchanged)
+         std::rotate(lutChain.begin(), lutChain.begin()+(dataCount%lutChain.size()), lutChain.end());
+         lutChainChanged = true;
+         iState     = s_update_luts2;
+         break;
+
+      case s_update_luts2:
+         dataCount = data;
+         iState    = s_update_luts3;
+         break;
+
+      case s_update_luts3:
+         dataCount |= data<<8;
+         // Bytes to load follow as for C_LUT_CONFIG
+         iState     = (dataCount == 0)?s_cmd:s_load_luts2;
+         break;
+
+      case s_read_buffer1:
+         dataCount |= data<<8;
+         // A count of zero wraps to 65536 bytes
+         readSdram((dataCount == 0)?0x10000:dataCount);
+         iState = s_cmd;
+         break;
+   }
+}
+
+/**
+ * Send data to emulated FPGA
+ *
+ * @param data       Data to send
+ * @param dataSize   Size of data in bytes
+ */
+void FT2232_Emulator::_transmitData(const uint8_t data[], unsigned dataSize) {
+   linkDelay(dataSize, outTransferSize, linkModel.txBytesPerSecond, false);
+   for (unsigned index=0; index<dataSize; index++) {
+      processByte(data[index]);
+   }
+}
+
+/**
+ * Receive data from emulated FPGA
+ *
+ * @param data       Buffer for data
+ * @param dataSize   Size of data in bytes
+ */
+void FT2232_Emulator::_receiveData(uint8_t data[], unsigned dataSize) {
+   advance();
+
+   // The FT2232 only sends a partial packet when its FIFO runs dry, after the latency timer.
+   // Data already queued behind this receive (e.g. pipelined C_RD_BUFFER) fills the packet.
+   const unsigned queued     = toHostSent+toHost.size();
+   const unsigned lastPacket = queued-(queued%PACKET_PAYLOAD);
+   bool partialPacket = (toHost.size() >= dataSize) && (lastPacket < queued) && (toHostSent+dataSize > lastPacket);
+   if (partialPacket) {
+      statistics.countPartialRead();
+   }
+   linkDelay(dataSize, inTransferSize, linkModel.rxBytesPerSecond, partialPacket);
+   advance();
+   if (toHost.size() < dataSize) {
+      statistics.countTimeout(Activity::Receive);
+      fprintf(stderr, "\nFT2232_Emulator::receiveData() Timeout\n");
+      throw MyException("FT2232_Emulator::receiveData() Timeout");
+   }
+   std::copy(toHost.begin(), toHost.begin()+dataSize, data);
+   toHost.erase(toHost.begin(), toHost.begin()+dataSize);
+   toHostSent = toHost.empty()?0:(toHostSent+dataSize)%PACKET_PAYLOAD;
+}
+
+/**
+ * Wait until data from emulated FPGA is available
+ *
+ * @param timeout_ms   Maximum time to wait in ms
+ *
+ * @return true  => Data is available
+ * @return false => Timeout
+ */
+bool FT2232_Emulator::_waitForData(unsigned timeout_ms) {
+   using namespace std::chrono;
+
+   auto deadline = Clock::now()+milliseconds(timeout_ms);
+   for(;;) {
+      advance();
+      if (!toHost.empty()) {
+         return true;
+      }
+      if (Clock::now() >= deadline) {
+         return false;
+      }
+      std::this_thread::sleep_for(milliseconds(1));
+   }
+}
+
+/**
+ * Apply USB transfer parameters to link model
+ * The latency timer only applies if the link model has one.
+ *
+ * @param profile Parameters to apply
+ */
+void FT2232_Emulator::_setTransferProfile(const TransferProfile &profile) {
+   if (linkModel.latencyTimer_ms != 0) {
+      linkModel.latencyTimer_ms = profile.latencyTimer_ms;
+   }
+   inTransferSize  = profile.inTransferSize;
+   outTransferSize = profile.outTransferSize;
+}
+
+/**
+ * Get serial number of device
+ *
+ * @return Fixed serial number for emulator
+ */
+std::string FT2232_Emulator::_getSerialNumber() {
+   return "EMULATOR";
+}
+
+/**
+ * Discard buffered data
+ *
+ * @param rx   Discard data from FPGA not yet received
+ * @param tx   Discard data to FPGA not yet sent (nothing is buffered)
+ */
+void FT2232_Emulator::_purge(bool rx, bool) {
+   if (rx) {
+      toHost.clear();
+      toHostSent = 0;
+   }
+}
@@ -0,0 +1,313 @@
+/*
+ * FT2232_Emulator.h
+ *
+ *  Created on: 4 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef FT2232_EMULATOR_H_
+#define FT2232_EMULATOR_H_
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <memory>
+
+#include "FT2232.h"
+#include "EncodeLuts.h"
+#include "TriggerModel.h"
+
+/**
+ * Source of sample values for the emulated analyser
+ */
+class SignalSource {
+public:
+   virtual ~SignalSource() {
+   }
+
+   /**
+    * Get next sample value
+    *
+    * @return Sample (one bit per channel)
+    */
+   virtual uint32_t nextSample() = 0;
+
+   /**
+    * Get number of channels provided by the source
+    *
+    * @return Width of samples in bits
+    */
+   virtual unsigned getSampleWidth() const {
+      return 32;
+   }
+};
+
+/**
+ * Synthetic signal - a 32-bit binary counter
+ * Channel n toggles every 2^n samples
+ */
+class CounterSignalSource : public SignalSource {
+private:
+   uint32_t value = 0;
+
+public:
+   virtual uint32_t nextSample() override {
+      return value++;
+   }
+};
+
+/**
+ * File backed signal - raw 16-bit or 32-bit little-endian samples.
+ * The file is replayed from the start when exhausted.
+ */
+class FileSignalSource : public SignalSource {
+private:
+   std::vector<uint32_t> samples;
+   size_t                index = 0;
+   unsigned              bytesPerSample;
+
+public:
+   /**
+    * @param filename         File to load
+    * @param bytesPerSample   Size of samples in file (2 or 4 bytes)
+    *
+    * @throw MyException if the file cannot be read or is empty
+    */
+   FileSignalSource(const char *filename, unsigned bytesPerSample = 2);
+
+   virtual uint32_t nextSample() override {
+      uint32_t sample = samples[index++];
+      if (index == samples.size()) {
+         index = 0;
+      }
+      return sample;
+   }
+
+   virtual unsigned getSampleWidth() const override {
+      return 8*bytesPerSample;
+   }
+};
+
+/**
+ * Model of USB link timing used by the emulator
+ */
+struct LinkModel {
+   unsigned transactionLatency_us;  //!< Fixed cost of each USB transfer (USB scheduling)
+   unsigned latencyTimer_ms;        //!< Added to receives ending in a partial packet (FT2232 latency timer)
+   unsigned rxBytesPerSecond;       //!< Bandwidth FPGA->host (0 => unlimited)
+   unsigned txBytesPerSecond;       //!< Bandwidth host->FPGA (0 => unlimited)
+};
+
+/// Typical FT2232H in FIFO mode using the default D2XX latency timer
+static constexpr LinkModel FT2232H_LINK_MODEL = {125, 16, 40000000, 30000000};
+
+/// No delays (functional testing)
+static constexpr LinkModel IDEAL_LINK_MODEL   = {0, 0, 0, 0};
+
+/**
+ * Software model of the FPGA analyser behind the FT2232 transport.
+ *
+ * Decodes the command stream the same way as LogicAnalyser.vhd and runs
+ * the capture state machine against a SignalSource in real time so that
+ * host throughput measured against it is meaningful.
+ *
+ * The trigger logic (TriggerBlock.vhd) is modelled by TriggerModel using
+ * the contents of the LUT chain.
+ *
+ * In streaming mode (C_CONTROL_STREAM) the SDRAM is a ring buffer drained by
+ * C_RD_BUFFER. Samples are discarded and C_STATUS_OVERRUN set when it is full.
+ *
+ * In C_MODE_RLE captured samples are run-length encoded before being written to
+ * the SDRAM. In C_MODE_TRANSITION only changes are written with the time since
+ * the previous change (see RunLength.h).
+ *
+ * With C_MODE_PACK raw samples are read back packed to the channels in the
+ * channel mask (see PackedSamples.h).
+ *
+ * C_WR_READ_OFFSET moves the read pointer to an offset from the start of a
+ * completed capture so it may be read back in any order.
+ *
+ * C_RD_SNAPSHOT returns the capture and trigger progress (see sendSnapshot()).
+ *
+ * The size of the trigger hardware (reported by C_RD_CONFIG) may be any of the
+ * trigger encodings. This sets the length of the LUT chain and the size of samples.
+ * The FPGA SDRAM is C_SDRAM_WIDTH (16) bits wide so the 32-input encodings are
+ * emulator-only (AnalyserConfig::isEmulatorOnly()). They exercise the host's
+ * 32-bit sample paths and have no hardware equivalent.
+ */
+class FT2232_Emulator : public FT2232 {
+
+private:
+   /// Version reported by C_RD_VERSION
+   static constexpr uint8_t  VERSION            = 0b00001011;
+
+   /// SDRAM size in samples (24-bit address)
+   static constexpr uint32_t SDRAM_SIZE         = 1U<<24;
+
+   /// Mask for 24-bit registers and counters
+   static constexpr uint32_t ADDRESS_MASK       = SDRAM_SIZE-1;
+
+   /// Streaming ring buffer is full at this fill level (RING_MARGIN in SDRAM_Controller.vhd)
+   static constexpr uint32_t RING_FULL          = SDRAM_SIZE-16;
+
+   /// USB packet payload size (used for latency timer model)
+   static constexpr unsigned PACKET_PAYLOAD     = 510;
+
+   /// Command interface states (iState)
+   enum InterfaceState {
+      s_cmd,            // Waiting for command value
+      s_size,           // Getting size of read/write
+      s_write_pretrig2, // Writing 24-bit pre-trig value
+      s_write_pretrig3,
+      s_write_capture2, // Writing 24-bit capture value
+      s_write_capture3,
+      s_write_channels2,// Writing 32-bit channel mask
+      s_write_channels3,
+      s_write_channels4,
+      s_write_offset2,  // Writing 24-bit read offset
+      s_write_offset3,
+      s_load_luts1,     // Writing LUT config data
+      s_load_luts2,
+      s_update_luts1,   // Partial LUT update - recirculate count
+      s_update_luts2,   // Partial LUT update - load count
+      s_update_luts3,
+      s_read_buffer1,   // Reading SDRAM
+   };
+
+   /// Capture states (tState)
+   enum TriggerState {
+      t_idle,        // Idle (not capturing)
+      t_preTrig,     // Capturing data to create pre-trig data
+      t_armed,       // Looking for trigger while capturing
+      t_running,     // Capturing after trigger
+      t_complete,    // Buffer filled (not capturing)
+      t_streaming    // Capturing continuously to SDRAM ring buffer
+   };
+
+   using Clock = std::chrono::steady_clock;
+
+   std::unique_ptr<SignalSource> source;
+   LinkModel                     linkModel;
+
+   // Size of trigger hardware
+   Analyser::AnalyserConfig      config;
+   uint32_t                      sampleMask;
+
+   // USB transfer sizes (from transfer profile)
+   unsigned             inTransferSize  = DEFAULT_TRANSFER_PROFILE.inTransferSize;
+   unsigned             outTransferSize = DEFAULT_TRANSFER_PROFILE.outTransferSize;
+
+   // Command interface
+   InterfaceState       iState         = s_cmd;
+   uint8_t              command        = 0;
+   uint32_t             dataCount      = 0;
+
+   // Registers
+   uint8_t              controlRegister   = 0;
+   uint8_t              modeRegister      = 0;
+   uint32_t             channelRegister   = 0xFFFFFFFF;
+   uint32_t             preTriggerAmount  = 0;
+   uint32_t             captureAmount     = 0;
+   uint32_t             readOffset        = 0;
+
+   // Trigger LUT shift chain (most recent byte last)
+   std::vector<uint8_t> lutChain;
+   bool                 lutChainChanged = true;
+
+   // Trigger logic
+   std::unique_ptr<Analyser::TriggerPipeline> triggerModel;
+   bool                 armed          = false;
+
+   // Capture state
+   TriggerState         tState         = t_idle;
+   uint32_t             captureCounter = 0;
+   bool                 preTriggerFlag = false;
+   bool                 triggerFound   = false;
+   uint32_t             currentSample  = 0;
+   Clock::time_point    startTime;
+
+   // Run-length encoder
+   bool                 rleValid       = false;
+   uint32_t             rleValue       = 0;
+   uint32_t             rleCount       = 0;
+   bool                 rleTrigger     = false;
+
+   // Transition encoder
+   bool                 trValid        = false;
+   uint32_t             trValue        = 0;
+   uint32_t             trTicks        = 0;
+   bool                 trTriggerHeld  = false;
+   bool                 trDeltaPending = false;
+   uint64_t             samplesTaken   = 0;
+
+   // SDRAM (one word per sample, wider than the FPGA for emulator-only configurations)
+   std::vector<uint32_t> sdram;
+   uint32_t             wrAddress      = 0;
+   uint32_t             rdAddress      = 0;
+   uint32_t             rdBase         = 0;
+   bool                 sdramArmed     = false;
+   bool                 overrun        = false;
+   unsigned             readByte       = 0;
+   uint64_t             readWord       = 0;
+
+   // Data waiting to be sent to host
+   std::deque<uint8_t>  toHost;
+
+   // Bytes already sent to host since toHost was last empty (position in current USB packet)
+   unsigned             toHostSent     = 0;
+
+   void     sendSnapshot();
+   void     processByte(uint8_t data);
+   void     startAcquisition();
+   void     advance();
+   void     takeSample(uint32_t sample);
+   void     streamSample(uint32_t sample);
+   void     storeWord(uint32_t word, bool triggerWord);
+   void     encodeRle(uint32_t sample, bool triggerSample);
+   void     encodeTransition(uint32_t sample, bool triggerSample);
+   void     writeSdram(uint32_t sample, bool preTriggerSample, bool triggerSample);
+   void     readSdram(uint32_t byteCount);
+   unsigned getSamplePeriodIn_nanoseconds();
+   void     linkDelay(unsigned byteCount, unsigned transferSize, unsigned bytesPerSecond, bool partialPacket);
+
+protected:
+   virtual void _transmitData(const uint8_t data[], unsigned dataSize) override;
+   virtual void _receiveData(uint8_t data[], unsigned dataSize) override;
+   virtual void _purge(bool rx, bool tx) override;
+   virtual bool _waitForData(unsigned timeout_ms) override;
+   virtual void _setTransferProfile(const TransferProfile &profile) override;
+   virtual std::string _getSerialNumber() override;
+   virtual bool _isEmulated() override {
+      return true;
+   }
+
+public:
+   /**
+    * Construct emulated analyser
+    *
+    * @param source     Source of sample data (ownership is taken)
+    * @param linkModel  USB timing model
+    * @param config     Size of trigger hardware
+    *
+    * @throw MyException if config is not one of the FPGA variants
+    */
+   FT2232_Emulator(
+         SignalSource                   *source,
+         const LinkModel                &linkModel = FT2232H_LINK_MODEL,
+         const Analyser::AnalyserConfig &config    = Analyser::DEFAULT_ANALYSER_CONFIG);
+
+   virtual ~FT2232_Emulator() {
+   }
+
+   /**
+    * Get the LUT configuration data last shifted into the trigger logic
+    *
+    * @return LUT chain bytes in the order sent
+    */
+   const std::vector<uint8_t> &getLutChain() const {
+      return lutChain;
+   }
+};
+
+#endif /* FT2232_EMULATOR_H_ */
@@ -0,0 +1,518 @@
+//============================================================================
+// Name        : FT2232_Libusb.cpp
+// Author      : pgo
+// FT2232 transport using libusb bulk transfers (Linux)
+//============================================================================
+#if !defined(_WIN32)
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+#include "MyException.h"
+#include "FT2232_Libusb.h"
+
+// FTDI vendor requests (see libftdi)
+static constexpr uint8_t  FTDI_DEVICE_OUT_REQTYPE        = LIBUSB_REQUEST_TYPE_VENDOR|LIBUSB_RECIPIENT_DEVICE|LIBUSB_ENDPOINT_OUT;
+
+static constexpr uint8_t  SIO_RESET_REQUEST              = 0x00;
+static constexpr uint8_t  SIO_SET_FLOW_CTRL_REQUEST      = 0x02;
+static constexpr uint8_t  SIO_SET_LATENCY_TIMER_REQUEST  = 0x09;
+static constexpr uint8_t  SIO_SET_BITMODE_REQUEST        = 0x0B;
+
+static constexpr uint16_t SIO_RESET_SIO                  = 0;
+static constexpr uint16_t SIO_TCOFLUSH                   = 1;  // Discard data from host not yet sent to FIFO
+static constexpr uint16_t SIO_TCIFLUSH                   = 2;  // Discard data from FIFO not yet sent to host
+
+static constexpr uint16_t SIO_RTS_CTS_HS                 = (0x1<<8);
+
+// Bit-mode reset => Use FIFO mode configured in EEPROM
+static constexpr uint16_t BITMODE_RESET                  = 0x00;
+
+// Product description programmed in EEPROM (D2XX adds " A" for channel A)
+static constexpr const char *DESCRIPTION = "Fast Logic Analyser";
+
+/**
+ * Get USB location of device
+ * This is the bus number followed by the port path, one hex digit each (as D2XX LocId)
+ *
+ * @param device Device
+ *
+ * @return Location ID
+ */
+static unsigned getLocationId(libusb_device *device) {
+   uint8_t ports[7];
+   int numPorts = libusb_get_port_numbers(device, ports, sizeof(ports));
+   unsigned locationId = libusb_get_bus_number(device);
+   for (int index=0; index<numPorts; index++) {
+      locationId = (locationId<<4)|(ports[index]&0xF);
+   }
+   return locationId;
+}
+
+/**
+ * Get description of FT2232H device
+ *
+ * @param device           Device
+ * @param deviceHandle     Open handle for device
+ * @param deviceDescriptor Device descriptor
+ *
+ * @return Device information
+ */
+static DeviceInfo getDeviceInfo(
+      libusb_device                  *device,
+      libusb_device_handle           *deviceHandle,
+      const libusb_device_descriptor &deviceDescriptor) {
+
+   char description[100] = {0};
+   libusb_get_string_descriptor_ascii(
+         deviceHandle, deviceDescriptor.iProduct, (unsigned char *)description, sizeof(description));
+   char serial[100] = {0};
+   libusb_get_string_descriptor_ascii(
+         deviceHandle, deviceDescriptor.iSerialNumber, (unsigned char *)serial, sizeof(serial));
+
+   return DeviceInfo{serial, getLocationId(device), description};
+}
+
+/**
+ * List attached analysers
+ *
+ * @return Devices found
+ */
+std::vector<DeviceInfo> FT2232_Libusb::listDevices() {
+   std::vector<DeviceInfo> devices;
+
+   libusb_context *context;
+   int rc = libusb_init(&context);
+   if (rc != LIBUSB_SUCCESS) {
+      throw MyException("libusb_init() failed, rc = (%d):%s", rc, libusb_error_name(rc));
+   }
+   libusb_device **list;
+   ssize_t numDevs = libusb_get_device_list(context, &list);
+   for (ssize_t index=0; index<numDevs; index++) {
+      libusb_device_descriptor deviceDescriptor;
+      rc = libusb_get_device_descriptor(list[index], &deviceDescriptor);
+      if ((rc != LIBUSB_SUCCESS) ||
+          (deviceDescriptor.idVendor != VENDOR_ID) ||
+          (deviceDescriptor.idProduct != PRODUCT_ID)) {
+         continue;
+      }
+      libusb_device_handle *deviceHandle;
+      if (libusb_open(list[index], &deviceHandle) != LIBUSB_SUCCESS) {
+         continue;
+      }
+      DeviceInfo info = getDeviceInfo(list[index], deviceHandle, deviceDescriptor);
+      libusb_close(deviceHandle);
+      if (info.description.compare(0, strlen(DESCRIPTION), DESCRIPTION) == 0) {
+         devices.push_back(info);
+      }
+   }
+   if (numDevs >= 0) {
+      libusb_free_device_list(list, 1);
+   }
+   libusb_exit(context);
+
+   return devices;
+}
+
+/**
+ * Open FT2232 device
+ *
+ * @param selector Selects device (first matching device is opened)
+ * @param verbose  Print device information while opening
+ */
+FT2232_Libusb::FT2232_Libusb(const DeviceSelector &selector, bool verbose) {
+
+   for (Transfer &transfer:transfers) {
+      transfer.owner    = this;
+      transfer.transfer = nullptr;
+      transfer.busy     = false;
+   }
+
+   int rc = libusb_init(&context);
+   if (rc != LIBUSB_SUCCESS) {
+      throw MyException("libusb_init() failed, rc = (%d):%s", rc, libusb_error_name(rc));
+   }
+
+   try {
+      libusb_device **list;
+      ssize_t numDevs = libusb_get_device_list(context, &list);
+      if (numDevs < 0) {
+         throw MyException("libusb_get_device_list() failed");
+      }
+      if (verbose) {
+         printf("Number of USB devices found: %ld\n", (long)numDevs);
+      }
+      for (ssize_t index=0; (handle == nullptr) && (index<numDevs); index++) {
+         libusb_device_descriptor deviceDescriptor;
+         rc = libusb_get_device_descriptor(list[index], &deviceDescriptor);
+         if ((rc != LIBUSB_SUCCESS) ||
+             (deviceDescriptor.idVendor != VENDOR_ID) ||
+             (deviceDescriptor.idProduct != PRODUCT_ID)) {
+            continue;
+         }
+         libusb_device_handle *deviceHandle;
+         if (libusb_open(list[index], &deviceHandle) != LIBUSB_SUCCESS) {
+            continue;
+         }
+         DeviceInfo info = getDeviceInfo(list[index], deviceHandle, deviceDescriptor);
+         if (verbose) {
+            printf("Dev %ld:\n",                (long)index);
+            printf(" Bus            = %d\n",    libusb_get_bus_number(list[index]));
+            printf(" Address        = %d\n",    libusb_get_device_address(list[index]));
+            printf(" LocId          = 0x%x\n",  info.locationId);
+            printf(" SerialNumber   = '%s'\n",  info.serialNumber.c_str());
+            printf(" Description    = '%s'\n",  info.description.c_str());
+         }
+         if ((info.description.compare(0, strlen(DESCRIPTION), DESCRIPTION) == 0) &&
+             (selector.serialNumber.empty() || (selector.serialNumber == info.serialNumber)) &&
+             ((selector.locationId == 0)    || (selector.locationId == info.locationId))) {
+            handle       = deviceHandle;
+            serialNumber = info.serialNumber;
+         }
+         else {
+            libusb_close(deviceHandle);
+         }
+      }
+      libusb_free_device_list(list, 1);
+
+      if (handle == nullptr) {
+         printf("FT2232_Libusb() failed\n");
+         throw MyException("FT2232H '%s' not found (serial='%s', location=0x%X)",
+               DESCRIPTION, selector.serialNumber.c_str(), selector.locationId);
+      }
+      if (verbose) {
+         printf("FT2232_Libusb() OK\n");
+      }
+
+      // Release ftdi_sio if bound to interface
+      libusb_set_auto_detach_kernel_driver(handle, 1);
+
+      rc = libusb_claim_interface(handle, 0);
+      if (rc != LIBUSB_SUCCESS) {
+         throw MyException("libusb_claim_interface(0) failed, rc = (%d):%s", rc, libusb_error_name(rc));
+      }
+      vendorRequest(SIO_RESET_REQUEST,             SIO_RESET_SIO,                   INTERFACE_A);
+      vendorRequest(SIO_SET_FLOW_CTRL_REQUEST,     0,                               SIO_RTS_CTS_HS|INTERFACE_A);
+      vendorRequest(SIO_SET_BITMODE_REQUEST,       (BITMODE_RESET<<8)|0xFF,         INTERFACE_A);
+
+      for (Transfer &transfer:transfers) {
+         transfer.transfer = libusb_alloc_transfer(0);
+         if (transfer.transfer == nullptr) {
+            throw MyException("libusb_alloc_transfer() failed");
+         }
+      }
+      setTransferProfile(DEFAULT_TRANSFER_PROFILE);
+      purge();
+   } catch (MyException &) {
+      close();
+      throw;
+   }
+}
+
+/**
+ * Close FT2232 device
+ */
+FT2232_Libusb::~FT2232_Libusb() {
+   close();
+}
+
+/**
+ * Release all libusb resources
+ */
+void FT2232_Libusb::close() {
+   if (handle != nullptr) {
+      cancelTransfers();
+   }
+   for (Transfer &transfer:transfers) {
+      if (transfer.transfer != nullptr) {
+         libusb_free_transfer(transfer.transfer);
+         transfer.transfer = nullptr;
+      }
+   }
+   if (handle != nullptr) {
+      libusb_release_interface(handle, 0);
+      libusb_close(handle);
+      handle = nullptr;
+   }
+   if (context != nullptr) {
+      libusb_exit(context);
+      context = nullptr;
+   }
+}
+
+/**
+ * Issue FTDI vendor request
+ *
+ * @param request Request number SIO_XXX_REQUEST
+ * @param value   Request value
+ * @param index   Request index (usually interface)
+ */
+void FT2232_Libusb::vendorRequest(uint8_t request, uint16_t value, uint16_t index) {
+   int rc = libusb_control_transfer(handle, FTDI_DEVICE_OUT_REQTYPE, request, value, index, nullptr, 0, TIMEOUT);
+   if (rc < 0) {
+      throw MyException("libusb_control_transfer(%d) failed, rc = (%d):%s", request, rc, libusb_error_name(rc));
+   }
+}
+
+/**
+ * Wait for libusb events (transfer completion)
+ */
+void FT2232_Libusb::handleEvents() {
+   timeval tv = {0, 100000};
+   libusb_handle_events_timeout_completed(context, &tv, nullptr);
+}
+
+/**
+ * Called by libusb when a IN transfer completes or is cancelled
+ *
+ * @param transfer The completed transfer
+ */
+void LIBUSB_CALL FT2232_Libusb::transferComplete(libusb_transfer *transfer) {
+   Transfer      *t  = static_cast<Transfer *>(transfer->user_data);
+   FT2232_Libusb *me = t->owner;
+
+   t->busy = false;
+   me->inFlight--;
+
+   if ((transfer->status == LIBUSB_TRANSFER_COMPLETED) && (transfer->actual_length < transfer->length)) {
+      me->statistics.countPartialRead();
+   }
+
+   // Each packet starts with modem status bytes which are discarded
+   for (int offset=0; offset<transfer->actual_length; offset+=MAX_PACKET_SIZE) {
+      int packetLength = std::min((int)MAX_PACKET_SIZE, transfer->actual_length-offset);
+      if (packetLength > (int)STATUS_BYTES) {
+         me->acceptData(t->buffer+offset+STATUS_BYTES, packetLength-STATUS_BYTES);
+      }
+   }
+   switch(transfer->status) {
+      case LIBUSB_TRANSFER_COMPLETED:
+      case LIBUSB_TRANSFER_CANCELLED:
+      case LIBUSB_TRANSFER_TIMED_OUT:
+         break;
+      default:
+         me->rxError = transfer->status;
+         break;
+   }
+}
+
+/**
+ * Deliver received data to current receive or to the backlog if not needed
+ * The backlog is always empty while a receive is waiting for data
+ *
+ * @param data    Data received
+ * @param length  Length of data
+ */
+void FT2232_Libusb::acceptData(const uint8_t data[], unsigned length) {
+   unsigned wanted = std::min(length, rxSize-rxOffset);
+   if (wanted > 0) {
+      memcpy(rxData+rxOffset, data, wanted);
+      rxOffset += wanted;
+   }
+   if (wanted < length) {
+      backlog.insert(backlog.end(), data+wanted, data+length);
+   }
+}
+
+/**
+ * Submit IN transfers until NUM_TRANSFERS are in flight
+ * Transfers complete in submission order so are used in rotation
+ */
+void FT2232_Libusb::submitTransfers() {
+   while (inFlight < NUM_TRANSFERS) {
+      Transfer &t = transfers[nextTransfer];
+      if (t.busy) {
+         fprintf(stderr, "\nTransfer still in use\n");
+         throw MyException("Transfer still in use");
+      }
+      libusb_fill_bulk_transfer(t.transfer, handle, EP_IN, t.buffer, inTransferSize, transferComplete, &t, TIMEOUT);
+      int rc = libusb_submit_transfer(t.transfer);
+      if (rc != LIBUSB_SUCCESS) {
+         fprintf(stderr, "\nlibusb_submit_transfer() failed\n");
+         throw MyException("libusb_submit_transfer() failed, rc = (%d):%s", rc, libusb_error_name(rc));
+      }
+      t.busy = true;
+      inFlight++;
+      nextTransfer = (nextTransfer+1)%NUM_TRANSFERS;
+   }
+}
+
+/**
+ * Cancel IN transfers in flight and wait for them to be retired
+ * Any data they hold goes to the backlog
+ */
+void FT2232_Libusb::cancelTransfers() {
+   for (Transfer &transfer:transfers) {
+      if (transfer.busy) {
+         libusb_cancel_transfer(transfer.transfer);
+      }
+   }
+   while (inFlight > 0) {
+      handleEvents();
+   }
+   nextTransfer = 0;
+}
+
+/**
+ * Report failure of an IN transfer since the last check
+ */
+void FT2232_Libusb::checkTransferError() {
+   if (rxError != LIBUSB_TRANSFER_COMPLETED) {
+      int status = rxError;
+      rxError = LIBUSB_TRANSFER_COMPLETED;
+      fprintf(stderr, "\nlibusb IN transfer failed\n");
+      throw MyException("libusb IN transfer failed, status = %d", status);
+   }
+}
+
+/**
+ * Send data to FPGA through FT2232
+ *
+ * @param data       Data to send
+ * @param dataSize   Size of data in bytes
+ */
+void FT2232_Libusb::_transmitData(const uint8_t data[], unsigned dataSize) {
+   unsigned offset = 0;
+
+   while(offset < dataSize) {
+      int bytesWritten = 0;
+      int rc = libusb_bulk_transfer(
+            handle, EP_OUT, const_cast<uint8_t *>(data+offset), std::min(dataSize-offset, outTransferSize), &bytesWritten, TIMEOUT);
+      if ((rc != LIBUSB_SUCCESS) && (rc != LIBUSB_ERROR_TIMEOUT)) {
+         fprintf(stderr, "\nlibusb_bulk_transfer() failed\n");
+         throw MyException("libusb_bulk_transfer() failed, rc = (%d):%s", rc, libusb_error_name(rc));
+      }
+      if (bytesWritten <= 0) {
+         statistics.countTimeout(Activity::Transmit);
+         fprintf(stderr, "\nlibusb_bulk_transfer() Timeout\n");
+         throw MyException("libusb_bulk_transfer() Timeout");
+      }
+      offset += bytesWritten;
+   }
+}
+
+/**
+ * Receive data from FPGA through FT2232
+ *
+ * NUM_TRANSFERS transfers are kept in flight. They are left queued on return
+ * so data following this receive is read ahead into the backlog.
+ *
+ * @param data       Buffer for data
+ * @param dataSize   Size of data in bytes
+ */
+void FT2232_Libusb::_receiveData(uint8_t data[], unsigned dataSize) {
+   using namespace std::chrono;
+
+   checkTransferError();
+
+   rxData   = data;
+   rxSize   = dataSize;
+   rxOffset = 0;
+
+   // Use any data left from earlier transfers
+   unsigned available = std::min((unsigned)(backlog.size()-backlogOffset), dataSize);
+   memcpy(data, backlog.data()+backlogOffset, available);
+   rxOffset       = available;
+   backlogOffset += available;
+   if (backlogOffset == backlog.size()) {
+      backlog.clear();
+      backlogOffset = 0;
+   }
+
+   auto     lastProgress = steady_clock::now();
+   unsigned lastOffset   = rxOffset;
+
+   while ((rxOffset < rxSize) && (rxError == LIBUSB_TRANSFER_COMPLETED)) {
+      submitTransfers();
+      handleEvents();
+      if (rxOffset != lastOffset) {
+         lastOffset   = rxOffset;
+         lastProgress = steady_clock::now();
+      }
+      else if ((steady_clock::now()-lastProgress) > milliseconds(TIMEOUT)) {
+         break;
+      }
+   }
+
+   // Transfers still in flight deliver to the backlog
+   bool complete = (rxOffset == rxSize);
+   rxData   = nullptr;
+   rxSize   = 0;
+   rxOffset = 0;
+
+   checkTransferError();
+   if (!complete) {
+      statistics.countTimeout(Activity::Receive);
+      fprintf(stderr, "\nlibusb IN transfer Timeout\n");
+      throw MyException("libusb IN transfer Timeout");
+   }
+}
+
+/**
+ * Wait until data from FPGA is available
+ * The IN transfers are kept in flight and left queued on return
+ *
+ * @param timeout_ms   Maximum time to wait in ms
+ *
+ * @return true  => Data is available (held in backlog)
+ * @return false => Timeout
+ */
+bool FT2232_Libusb::_waitForData(unsigned timeout_ms) {
+   using namespace std::chrono;
+
+   checkTransferError();
+
+   auto startTime = steady_clock::now();
+   while ((backlog.size() == backlogOffset) && (rxError == LIBUSB_TRANSFER_COMPLETED)) {
+      if ((steady_clock::now()-startTime) > milliseconds(timeout_ms)) {
+         break;
+      }
+      submitTransfers();
+      handleEvents();
+   }
+   checkTransferError();
+   return backlog.size() > backlogOffset;
+}
+
+/**
+ * Apply USB transfer parameters
+ *
+ * @param profile Parameters to apply
+ */
+void FT2232_Libusb::_setTransferProfile(const TransferProfile &profile) {
+   vendorRequest(SIO_SET_LATENCY_TIMER_REQUEST, profile.latencyTimer_ms, INTERFACE_A);
+   inTransferSize  = std::min(profile.inTransferSize, MAX_TRANSFER_SIZE);
+   outTransferSize = profile.outTransferSize;
+}
+
+/**
+ * Get serial number of device
+ *
+ * @return Serial number from device descriptor
+ */
+std::string FT2232_Libusb::_getSerialNumber() {
+   return serialNumber;
+}
+
+/**
+ * Discard buffered data
+ *
+ * @param rx   Discard data from FPGA not yet received
+ * @param tx   Discard data to FPGA not yet sent
+ */
+void FT2232_Libusb::_purge(bool rx, bool tx) {
+   if (rx) {
+      // Read-ahead data is stale
+      cancelTransfers();
+      vendorRequest(SIO_RESET_REQUEST, SIO_TCIFLUSH, INTERFACE_A);
+      backlog.clear();
+      backlogOffset = 0;
+      rxError       = LIBUSB_TRANSFER_COMPLETED;
+   }
+   if (tx) {
+      vendorRequest(SIO_RESET_REQUEST, SIO_TCOFLUSH, INTERFACE_A);
+   }
+}
+
+#endif // !defined(_WIN32)
@@ -0,0 +1,141 @@
+/*
+ * FT2232_Libusb.h
+ *
+ *  Created on: 4 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef FT2232_LIBUSB_H_
+#define FT2232_LIBUSB_H_
+
+#include <vector>
+#include <string>
+#include <libusb.h>
+
+#include "FT2232.h"
+
+/**
+ * FT2232 transport using libusb bulk transfers directly (Linux)
+ *
+ * Reads keep several asynchronous transfers (URBs) in flight so the
+ * FIFO is drained continuously rather than one request at a time.
+ * The transfers stay queued between receives (read-ahead). Data arriving
+ * when no receive is waiting for it is held in the backlog.
+ * Transfers are only cancelled by purge() and when closing.
+ */
+class FT2232_Libusb : public FT2232 {
+
+private:
+   /// FTDI vendor ID
+   static constexpr uint16_t VENDOR_ID          = 0x0403;
+
+   /// FT2232H product ID
+   static constexpr uint16_t PRODUCT_ID         = 0x6010;
+
+   /// Interface A bulk endpoints
+   static constexpr uint8_t  EP_IN              = 0x81;
+   static constexpr uint8_t  EP_OUT             = 0x02;
+
+   /// Interface A index used in vendor requests
+   static constexpr uint16_t INTERFACE_A        = 1;
+
+   /// High-speed bulk packet size
+   static constexpr unsigned MAX_PACKET_SIZE    = 512;
+
+   /// Modem status bytes at the start of each IN packet
+   static constexpr unsigned STATUS_BYTES       = 2;
+
+   /// Number of IN transfers kept in flight
+   static constexpr unsigned NUM_TRANSFERS      = 8;
+
+   /// Maximum size of each IN transfer (multiple of MAX_PACKET_SIZE)
+   static constexpr unsigned MAX_TRANSFER_SIZE  = 128*MAX_PACKET_SIZE;
+
+   /// Read and write timeouts in ms
+   static constexpr unsigned TIMEOUT            = 1000;
+
+   /**
+    * Asynchronous IN transfer and its buffer
+    */
+   struct Transfer {
+      FT2232_Libusb  *owner;
+      libusb_transfer *transfer;
+      bool            busy;
+      uint8_t         buffer[MAX_TRANSFER_SIZE];
+   };
+
+   libusb_context       *context = nullptr;
+   libusb_device_handle *handle  = nullptr;
+
+   Transfer transfers[NUM_TRANSFERS];
+
+   /// Size of IN and OUT transfers (from transfer profile)
+   unsigned inTransferSize  = DEFAULT_TRANSFER_PROFILE.inTransferSize;
+   unsigned outTransferSize = DEFAULT_TRANSFER_PROFILE.outTransferSize;
+
+   /// Serial number from device descriptor
+   std::string serialNumber;
+
+   /// Next transfer to submit (transfers are used in rotation)
+   unsigned nextTransfer = 0;
+
+   /// Number of transfers currently submitted
+   unsigned inFlight     = 0;
+
+   /// Data received beyond what was requested by the last receive
+   std::vector<uint8_t> backlog;
+   unsigned             backlogOffset = 0;
+
+   /// Destination of the current receive
+   uint8_t  *rxData      = nullptr;
+   unsigned  rxSize      = 0;
+   unsigned  rxOffset    = 0;
+
+   /// Status of last failed transfer (reported by the next receive)
+   int       rxError     = LIBUSB_TRANSFER_COMPLETED;
+
+   static void LIBUSB_CALL transferComplete(libusb_transfer *transfer);
+
+   void vendorRequest(uint8_t request, uint16_t value, uint16_t index);
+   void submitTransfers();
+   void cancelTransfers();
+   void checkTransferError();
+   void acceptData(const uint8_t data[], unsigned length);
+   void handleEvents();
+   void close();
+
+protected:
+   virtual void _transmitData(const uint8_t data[], unsigned dataSize) override;
+   virtual void _receiveData(uint8_t data[], unsigned dataSize) override;
+   virtual void _purge(bool rx, bool tx) override;
+   virtual bool _waitForData(unsigned timeout_ms) override;
+   virtual void _setTransferProfile(const TransferProfile &profile) override;
+   virtual std::string _getSerialNumber() override;
+
+public:
+
+   /**
+    * Construct FT2232 device
+    * This opens the first FT2232H with a matching product description,
+    * serial number and location
+    *
+    * @param selector Selects device
+    * @param verbose  Print device information while opening
+    */
+   FT2232_Libusb(const DeviceSelector &selector = DeviceSelector(), bool verbose = false);
+
+   /**
+    * List attached analysers
+    *
+    * @return Devices found
+    */
+   static std::vector<DeviceInfo> listDevices();
+
+   /**
+    * Destruct FT2232 device
+    * This closes the device
+    */
+   virtual ~FT2232_Libusb();
+};
+
+#endif /* FT2232_LIBUSB_H_ */
@@ -10,8 +10,51 @@
 
 #include <stdint.h>
 #include <assert.h>
+#include <array>
 
 class Lfsr16 {
+
+private:
+   /**
+    * 16x16 matrix over GF(2) describing a linear change of LFSR state.
+    * Column i is the result for the state with only bit i set.
+    */
+   struct Matrix {
+      uint16_t columns[16];
+
+      /**
+       * Apply matrix to LFSR state
+       *
+       * @param state State to transform
+       *
+       * @return Transformed state
+       */
+      constexpr uint16_t apply(uint16_t state) const {
+         uint16_t result = 0;
+         for (unsigned bit=0; bit<16; bit++) {
+            if (state & (1U<<bit)) {
+               result ^= columns[bit];
+            }
+         }
+         return result;
+      }
+   };
+
+   /**
+    * Matrices advancing the LFSR by 2^n steps i.e. jumpTable[n] = M^(2^n)
+    */
+   struct JumpTable {
+      Matrix powers[16];
+   };
+
+   /**
+    * Create table of matrices for jump-ahead by squaring the single step matrix
+    */
+   static constexpr JumpTable makeJumpTable();
+
+   /// Matrices advancing the LFSR by 2^n steps
+   static const JumpTable jumpTable;
+
 public:
    /**
     * Calculate next value in LFSR sequence
@@ -20,7 +63,7 @@ public:
     *
     * See https://en.wikipedia.org/wiki/Linear-feedback_shift_register
     */
-   static uint16_t calcNextValue(uint16_t start_state) {
+   static constexpr uint16_t calcNextValue(uint16_t start_state) {
 
       assert(start_state != 0);
 
@@ -45,7 +88,7 @@ public:
     *
     * @return period.
     */
-   static unsigned findPeriod(void) {
+   static constexpr unsigned findPeriod(void) {
 
        uint16_t start_state = 0x0001;
 
@@ -60,6 +103,17 @@ public:
        return period;
    }
 
+   /**
+    * Advance LFSR by a number of steps.
+    * This takes O(log(steps)) rather than O(steps).
+    *
+    * @param state   Starting state [1..65535]
+    * @param steps   Number of steps to advance
+    *
+    * @return State after steps
+    */
+   static constexpr uint16_t jump(uint16_t state, unsigned steps);
+
    /**
     * Find LFSR state corresponding to the given value
     * Note: 0 is considered invalid.
@@ -68,14 +122,61 @@ public:
     *
     * @return encoded value [1..65535]
     */
-   static uint16_t encode(uint16_t value) {
-      uint16_t lfsr = 1;
-      while (value-->1) {
-         lfsr = calcNextValue(lfsr);
-      }
-      return lfsr;
+   static constexpr uint16_t encode(uint16_t value) {
+      return (value>1)?jump(1, value-1U):1;
    }
 
+   /**
+    * Find value corresponding to the given LFSR state.
+    * This is the inverse of encode().
+    * Uses a table built on first use.
+    *
+    * @param state LFSR state [1..65535] e.g. matchCounter value from the analyser
+    *
+    * @return value [1..65535] or 0 if state is invalid (0)
+    */
+   static uint16_t decode(uint16_t state) {
+      static const std::array<uint16_t, 65536> decodeTable = [] {
+         std::array<uint16_t, 65536> table{};
+         uint16_t lfsr = 1;
+         for (unsigned value=1; value<=0xFFFF; value++) {
+            table[lfsr] = value;
+            lfsr = calcNextValue(lfsr);
+         }
+         return table;
+      }();
+      return decodeTable[state];
+   }
 };
 
+constexpr Lfsr16::JumpTable Lfsr16::makeJumpTable() {
+   JumpTable table{};
+
+   // Single step
+   for (unsigned bit=0; bit<16; bit++) {
+      table.powers[0].columns[bit] = calcNextValue(1U<<bit);
+   }
+   // M^(2^n) = M^(2^(n-1)) * M^(2^(n-1))
+   for (unsigned power=1; power<16; power++) {
+      for (unsigned bit=0; bit<16; bit++) {
+         const Matrix &previous = table.powers[power-1];
+         table.powers[power].columns[bit] = previous.apply(previous.columns[bit]);
+      }
+   }
+   return table;
+}
+
+inline constexpr Lfsr16::JumpTable Lfsr16::jumpTable = Lfsr16::makeJumpTable();
+
+constexpr uint16_t Lfsr16::jump(uint16_t state, unsigned steps) {
+   // Sequence repeats every 65535 steps
+   steps %= 0xFFFFU;
+   for (unsigned power=0; steps != 0; power++, steps >>= 1) {
+      if (steps & 1) {
+         state = jumpTable.powers[power].apply(state);
+      }
+   }
+   return state;
+}
+
 #endif /* SOURCES_LFSR16_H_ */
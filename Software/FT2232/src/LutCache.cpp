@@ -0,0 +1,99 @@
+//============================================================================
+// Name        : LutCache.cpp
+// Author      : pgo
+// Avoids re-sending unchanged trigger LUTs to the analyser
+//============================================================================
+#include <stdio.h>
+#include <algorithm>
+#include "console.h"
+#include "EncodeLuts.h"
+#include "CommandBuilder.h"
+#include "LutCache.h"
+
+using namespace Analyser;
+
+/**
+ * Range of LUT image bytes that differ from the analyser
+ */
+struct DirtyRange {
+   unsigned start;   //!< Offset of first changed byte
+   unsigned end;     //!< Offset following last changed byte
+};
+
+template<typename Setup>
+unsigned LutCache::writeLuts(CommandBuilder &builder, const Setup &setup, unsigned maxBlockSize) {
+
+   const uint64_t newHash = setup.getLutHash();
+   if (valid && (newHash == lutHash)) {
+      return 0;
+   }
+   const auto     newImage  = setup.getLutImage();
+   const unsigned imageSize = newImage.size();
+
+   if (!valid || !differential || (image.size() != imageSize)) {
+      builder.writeLutImage(newImage.data(), imageSize, maxBlockSize);
+      image.assign(newImage.begin(), newImage.end());
+      lutHash = newHash;
+      valid   = true;
+      return imageSize;
+   }
+
+   // Find changed LUTs.
+   // Unchanged gaps too short to be worth a separate C_LUT_UPDATE are re-sent.
+   std::vector<DirtyRange> ranges;
+   for (unsigned offset=0; offset<imageSize; offset+=4) {
+      if (std::equal(newImage.begin()+offset, newImage.begin()+offset+4, image.begin()+offset)) {
+         continue;
+      }
+      if (!ranges.empty() && ((offset-ranges.back().end) < LUT_UPDATE_OVERHEAD)) {
+         ranges.back().end = offset+4;
+      }
+      else {
+         ranges.push_back(DirtyRange{offset, offset+4});
+      }
+   }
+   // Cost of update - each range and trailing recirculation is a separate command
+   unsigned updateCost = 0;
+   for (const DirtyRange &range:ranges) {
+      updateCost += LUT_UPDATE_OVERHEAD+(range.end-range.start);
+   }
+   if (!ranges.empty() && (ranges.back().end < imageSize)) {
+      updateCost += LUT_UPDATE_OVERHEAD;
+   }
+   if (updateCost >= imageSize) {
+      builder.writeLutImage(newImage.data(), imageSize, maxBlockSize);
+      image.assign(newImage.begin(), newImage.end());
+      lutHash = newHash;
+      return imageSize;
+   }
+
+   // Complete rotation of LUT chain - each LUT is either recirculated or replaced
+   maxBlockSize = std::max(4U, std::min(maxBlockSize, 0xFFFFU)&~3U);
+
+   unsigned position  = 0;
+   unsigned bytesSent = 0;
+   for (const DirtyRange &range:ranges) {
+      unsigned recirculate = range.start-position;
+      unsigned start       = range.start;
+      while (start < range.end) {
+         unsigned blockSize = std::min(range.end-start, maxBlockSize);
+         builder.updateLuts(recirculate, newImage.data()+start, blockSize);
+         recirculate  = 0;
+         start       += blockSize;
+      }
+      bytesSent += range.end-range.start;
+      position   = range.end;
+   }
+   if (!ranges.empty() && (position < imageSize)) {
+      builder.updateLuts(imageSize-position, nullptr, 0);
+   }
+   image.assign(newImage.begin(), newImage.end());
+   lutHash = newHash;
+   return bytesSent;
+}
+
+// FPGA variants (see EncodeLuts.cpp)
+template unsigned LutCache::writeLuts(CommandBuilder &, const TriggerEncoding<16, 16, 2, 16>::TriggerSetup &, unsigned);
+template unsigned LutCache::writeLuts(CommandBuilder &, const TriggerEncoding<16, 16, 4, 16>::TriggerSetup &, unsigned);
+template unsigned LutCache::writeLuts(CommandBuilder &, const TriggerEncoding<32, 16, 2, 16>::TriggerSetup &, unsigned);
+template unsigned LutCache::writeLuts(CommandBuilder &, const TriggerEncoding<32, 16, 4, 16>::TriggerSetup &, unsigned);
@@ -0,0 +1,96 @@
+/*
+ * LutCache.h
+ *
+ *  Created on: 12 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_LUTCACHE_H_
+#define SOURCES_LUTCACHE_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "EncodeLuts.h"
+
+class CommandBuilder;
+
+
+/**
+ * Copy of the trigger LUT configuration last sent to an analyser.
+ *
+ * This is used to avoid re-sending LUTs that have not changed:
+ *  - If the trigger setup is unchanged (same hash) nothing is sent.
+ *  - If the analyser supports C_LUT_UPDATE only the changed LUTs are sent.
+ *    The analyser recirculates the unchanged LUTs around the LUT shift chain.
+ *  - Otherwise the complete image is sent with C_LUT_CONFIG.
+ *
+ * The cache assumes the commands it adds are executed.
+ * It must be invalidated if they fail or the LUTs are loaded by other means.
+ */
+class LutCache {
+
+private:
+   /// Cached image is the LUT configuration of the analyser
+   bool                 valid        = false;
+
+   /// Analyser supports C_LUT_UPDATE
+   bool                 differential = false;
+
+   /// Hash of setup used to create image
+   uint64_t             lutHash      = 0;
+
+   /// LUT image as sent to analyser
+   std::vector<uint8_t> image;
+
+public:
+   /// Command bytes needed for each C_LUT_UPDATE in addition to LUT data
+   static constexpr unsigned LUT_UPDATE_OVERHEAD = 5;
+
+   /**
+    * Forget the cached image so the next writeLuts() sends the complete image
+    */
+   void invalidate() {
+      valid = false;
+   }
+
+   /**
+    * Indicates if the cached image matches the analyser
+    */
+   bool isValid() const {
+      return valid;
+   }
+
+   /**
+    * Enable sending only changed LUTs with C_LUT_UPDATE
+    *
+    * @param enable True if the analyser supports C_LUT_UPDATE
+    */
+   void setDifferential(bool enable) {
+      differential = enable;
+   }
+
+   /**
+    * Indicates if only changed LUTs are sent
+    */
+   bool isDifferential() const {
+      return differential;
+   }
+
+   /**
+    * Add commands to bring the analyser LUTs to the configuration for the trigger setup.
+    * The cache is updated on the assumption the commands will be executed.
+    *
+    * @tparam Setup        TriggerSetup of one of the FPGA variants
+    *
+    * @param builder       Commands are added to this
+    * @param setup         Trigger setup
+    * @param maxBlockSize  Maximum LUT bytes in each command
+    *
+    * @return Number of LUT bytes added (0 if unchanged)
+    */
+   template<typename Setup>
+   unsigned writeLuts(CommandBuilder &builder, const Setup &setup, unsigned maxBlockSize);
+};
+
+#endif /* SOURCES_LUTCACHE_H_ */
@@ -0,0 +1,114 @@
+//============================================================================
+// Name        : PackedSamples.cpp
+// Author      : pgo
+// Unpacking of samples read back with C_MODE_PACK
+//============================================================================
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "PackedSamples.h"
+
+#if defined(__SSE2__)
+static inline __m128i load16(const uint8_t *address) {
+   return _mm_loadu_si128(reinterpret_cast<const __m128i *>(address));
+}
+
+/**
+ * Widen 16 byte values to 16 samples
+ *
+ * @param samples Where to store samples
+ * @param bytes   Values to widen
+ */
+static inline void storeWidened(uint16_t samples[], __m128i bytes) {
+#if defined(__AVX2__)
+   _mm256_storeu_si256(reinterpret_cast<__m256i *>(samples), _mm256_cvtepu8_epi16(bytes));
+#else
+   const __m128i zero = _mm_setzero_si128();
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(samples),   _mm_unpacklo_epi8(bytes, zero));
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(samples+8), _mm_unpackhi_epi8(bytes, zero));
+#endif
+}
+
+/**
+ * Widen 16 byte values to 16 samples
+ *
+ * @param samples Where to store samples
+ * @param bytes   Values to widen
+ */
+static inline void storeWidened(uint32_t samples[], __m128i bytes) {
+#if defined(__AVX2__)
+   _mm256_storeu_si256(reinterpret_cast<__m256i *>(samples),   _mm256_cvtepu8_epi32(bytes));
+   _mm256_storeu_si256(reinterpret_cast<__m256i *>(samples+8), _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+#else
+   const __m128i zero  = _mm_setzero_si128();
+   const __m128i low   = _mm_unpacklo_epi8(bytes, zero);
+   const __m128i high  = _mm_unpackhi_epi8(bytes, zero);
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(samples),    _mm_unpacklo_epi16(low,  zero));
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(samples+4),  _mm_unpackhi_epi16(low,  zero));
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(samples+8),  _mm_unpacklo_epi16(high, zero));
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(samples+12), _mm_unpackhi_epi16(high, zero));
+#endif
+}
+
+/**
+ * Unpack whole blocks of samples
+ *
+ * @param packed          Packed data
+ * @param samples         Buffer for samples
+ * @param count           Number of samples
+ * @param bitsPerSample   Bits for each sample
+ *
+ * @return Number of samples unpacked (remainder is left for scalar code)
+ */
+template<typename Sample>
+static size_t unpackBlocks(const uint8_t packed[], Sample samples[], size_t count, unsigned bitsPerSample) {
+   size_t index = 0;
+   switch(bitsPerSample) {
+      case 4: {
+         // Each byte holds 2 samples (first in low nibble)
+         const __m128i nibble = _mm_set1_epi8(0x0F);
+         for (; index+32<=count; index+=32) {
+            const __m128i bytes = load16(packed+index/2);
+            const __m128i low   = _mm_and_si128(bytes, nibble);
+            const __m128i high  = _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble);
+            storeWidened(samples+index,    _mm_unpacklo_epi8(low, high));
+            storeWidened(samples+index+16, _mm_unpackhi_epi8(low, high));
+         }
+         break;
+      }
+      case 8:
+         for (; index+16<=count; index+=16) {
+            storeWidened(samples+index, load16(packed+index));
+         }
+         break;
+   }
+   return index;
+}
+#endif
+
+template<typename Sample>
+void unpackSamples(const uint8_t packed[], Sample samples[], size_t count, unsigned bitsPerSample) {
+   size_t index = 0;
+#if defined(__SSE2__)
+   index = unpackBlocks(packed, samples, count, bitsPerSample);
+#endif
+   for (; index<count; index++) {
+      const size_t bit = index*bitsPerSample;
+      if (bitsPerSample < 8) {
+         samples[index] = (packed[bit/8]>>(bit%8))&((1U<<bitsPerSample)-1);
+      }
+      else {
+         Sample value = 0;
+         for (unsigned byte=0; byte<bitsPerSample/8; byte++) {
+            value |= (Sample)packed[bit/8+byte]<<(8*byte);
+         }
+         samples[index] = value;
+      }
+   }
+}
+
+template void unpackSamples(const uint8_t packed[], uint16_t samples[], size_t count, unsigned bitsPerSample);
+template void unpackSamples(const uint8_t packed[], uint32_t samples[], size_t count, unsigned bitsPerSample);
@@ -0,0 +1,52 @@
+/*
+ * PackedSamples.h
+ *
+ *  Created on: 1 Sep 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_PACKEDSAMPLES_H_
+#define SOURCES_PACKEDSAMPLES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Packed readback (C_MODE_PACK)
+ *
+ * Only the low 4 or 8 channels of each sample are sent by the analyser.
+ * They are packed as a little-endian bit stream so the first sample is in the
+ * least significant bits of the first byte (see getReadbackSampleBits()).
+ *
+ * The unpacking uses AVX2 or SSE2 where available.
+ */
+
+/**
+ * Get number of bytes sent by the analyser for packed samples
+ * This is rounded up to whole analyser words
+ *
+ * @param count            Number of samples
+ * @param bitsPerSample    Bits sent for each sample (4, 8 or full sample size)
+ * @param bytesPerSample   Size of analyser samples in bytes
+ *
+ * @return Size in bytes
+ */
+constexpr size_t getPackedSize(size_t count, unsigned bitsPerSample, unsigned bytesPerSample) {
+   return (((count*bitsPerSample)+(8*bytesPerSample-1))/(8*bytesPerSample))*bytesPerSample;
+}
+
+/**
+ * Unpack samples read back with C_MODE_PACK
+ * Channels that were not sent are zero
+ *
+ * @tparam Sample         uint16_t or uint32_t
+ *
+ * @param packed          Packed data as received from analyser
+ * @param samples         Buffer for samples (host order)
+ * @param count           Number of samples
+ * @param bitsPerSample   Bits sent for each sample (4, 8 or full sample size)
+ */
+template<typename Sample>
+void unpackSamples(const uint8_t packed[], Sample samples[], size_t count, unsigned bitsPerSample);
+
+#endif /* SOURCES_PACKEDSAMPLES_H_ */
@@ -0,0 +1,264 @@
+//============================================================================
+// Name        : RunLength.cpp
+// Author      : pgo
+// Decoding of run-length encoded (C_MODE_RLE) and transitional (C_MODE_TRANSITION) capture data
+//============================================================================
+#include <stdint.h>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "RunLength.h"
+
+#if defined(__AVX2__)
+using Vector = __m256i;
+
+static inline Vector broadcast(uint16_t value) {
+   return _mm256_set1_epi16((short)value);
+}
+
+static inline Vector broadcast(uint32_t value) {
+   return _mm256_set1_epi32((int)value);
+}
+
+static inline void storeVector(void *address, Vector value) {
+   _mm256_storeu_si256(reinterpret_cast<__m256i *>(address), value);
+}
+#elif defined(__SSE2__)
+using Vector = __m128i;
+
+static inline Vector broadcast(uint16_t value) {
+   return _mm_set1_epi16((short)value);
+}
+
+static inline Vector broadcast(uint32_t value) {
+   return _mm_set1_epi32((int)value);
+}
+
+static inline void storeVector(void *address, Vector value) {
+   _mm_storeu_si128(reinterpret_cast<__m128i *>(address), value);
+}
+#endif
+
+/**
+ * Sum the second word of each pair (RLE repeat counts or transition ticks)
+ *
+ * @param words   RLE or transition words
+ * @param runs    Number of runs (word pairs)
+ *
+ * @return Sum of repeat counts
+ */
+static uint64_t sumRepeatCounts(const uint16_t words[], size_t runs) {
+   uint64_t total = 0;
+   size_t   run   = 0;
+
+#if defined(__AVX2__)
+   // Each 32-bit lane holds a run (count in high half)
+   // Lane sums are flushed before they can overflow
+   constexpr size_t MAX_BATCH = 8*0x10000;
+   while (run+8 <= runs) {
+      const size_t batchEnd = std::min(run+MAX_BATCH, runs&~(size_t)7);
+      __m256i sum = _mm256_setzero_si256();
+      for (; run<batchEnd; run+=8) {
+         __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words+2*run));
+         sum = _mm256_add_epi32(sum, _mm256_srli_epi32(v, 16));
+      }
+      alignas(32) uint32_t lanes[8];
+      _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sum);
+      for (uint32_t lane:lanes) {
+         total += lane;
+      }
+   }
+#endif
+   for (; run<runs; run++) {
+      total += words[2*run+1];
+   }
+   return total;
+}
+
+/**
+ * Sum the second word of each pair (RLE repeat counts or transition ticks)
+ *
+ * @param words   RLE or transition words
+ * @param runs    Number of runs (word pairs)
+ *
+ * @return Sum of repeat counts
+ */
+static uint64_t sumRepeatCounts(const uint32_t words[], size_t runs) {
+   uint64_t total = 0;
+   size_t   run   = 0;
+
+#if defined(__AVX2__)
+   // Each 64-bit lane holds a run (count in high half)
+   __m256i sum = _mm256_setzero_si256();
+   for (; run+4<=runs; run+=4) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words+2*run));
+      sum = _mm256_add_epi64(sum, _mm256_srli_epi64(v, 32));
+   }
+   alignas(32) uint64_t lanes[4];
+   _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sum);
+   for (uint64_t lane:lanes) {
+      total += lane;
+   }
+#endif
+   for (; run<runs; run++) {
+      total += words[2*run+1];
+   }
+   return total;
+}
+
+#if defined(__AVX2__)
+/// Number of runs checked at once by isUnchangedBlock()
+template<typename Sample>
+static constexpr size_t RUNS_PER_BLOCK = sizeof(__m256i)/(2*sizeof(Sample));
+
+/**
+ * Check a block of runs for changes in the selected channels
+ *
+ * @param words         Start of block (RUNS_PER_BLOCK runs)
+ * @param previous      Value of run before block
+ * @param channelMask   Channels of interest
+ *
+ * @return true if no run in the block differs from the one before
+ */
+static inline bool isUnchangedBlock(const uint16_t words[], uint16_t previous, uint16_t channelMask) {
+   __m256i values = _mm256_and_si256(
+         _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words)), _mm256_set1_epi32(channelMask));
+   __m256i before = _mm256_permutevar8x32_epi32(values, _mm256_setr_epi32(0,0,1,2,3,4,5,6));
+   before = _mm256_blend_epi32(before, _mm256_set1_epi32(previous&channelMask), 0x01);
+   return _mm256_movemask_epi8(_mm256_cmpeq_epi32(values, before)) == -1;
+}
+
+/**
+ * Check a block of runs for changes in the selected channels
+ *
+ * @param words         Start of block (RUNS_PER_BLOCK runs)
+ * @param previous      Value of run before block
+ * @param channelMask   Channels of interest
+ *
+ * @return true if no run in the block differs from the one before
+ */
+static inline bool isUnchangedBlock(const uint32_t words[], uint32_t previous, uint32_t channelMask) {
+   __m256i values = _mm256_and_si256(
+         _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words)), _mm256_set1_epi64x(channelMask));
+   __m256i before = _mm256_permute4x64_epi64(values, _MM_SHUFFLE(2,1,0,0));
+   before = _mm256_blend_epi32(before, _mm256_set1_epi64x(previous&channelMask), 0x03);
+   return _mm256_movemask_epi8(_mm256_cmpeq_epi64(values, before)) == -1;
+}
+#endif
+
+template<typename Sample>
+uint64_t getRleSampleCount(const Sample words[], size_t wordCount) {
+   const size_t runs = wordCount/2;
+   return runs+sumRepeatCounts(words, runs);
+}
+
+template<typename Sample>
+size_t expandRle(const Sample words[], size_t wordCount, Sample samples[], size_t maxSamples) {
+   Sample       *out = samples;
+   Sample *const end = samples+maxSamples;
+
+   for (size_t index=0; (index+1<wordCount) && (out<end); index+=2) {
+      const Sample  value  = words[index];
+      Sample *const runEnd = out+std::min<size_t>((size_t)words[index+1]+1, end-out);
+      Sample       *p      = out;
+#if defined(__AVX2__) || defined(__SSE2__)
+      // Whole vectors are written while they fit in the buffer.
+      // These may extend past the run - the excess is overwritten by the following runs
+      // so most runs take a single store.
+      constexpr size_t LANES = sizeof(Vector)/sizeof(Sample);
+      if ((size_t)(end-p) >= LANES) {
+         const Vector v = broadcast(value);
+         do {
+            storeVector(p, v);
+            p += LANES;
+         } while ((p < runEnd) && ((size_t)(end-p) >= LANES));
+      }
+#endif
+      for (; p<runEnd; p++) {
+         *p = value;
+      }
+      out = runEnd;
+   }
+   return out-samples;
+}
+
+template<typename Sample>
+void rleToEdges(const Sample words[], size_t wordCount, std::vector<SampleEdge<Sample>> &edges, Sample channelMask) {
+   const size_t runs = wordCount/2;
+   if (runs == 0) {
+      return;
+   }
+   Sample   previous = words[0];
+   uint64_t position = (uint64_t)words[1]+1;
+   edges.push_back({0, previous, channelMask});
+
+   size_t run = 1;
+   while (run < runs) {
+#if defined(__AVX2__)
+      constexpr size_t RUNS = RUNS_PER_BLOCK<Sample>;
+      if ((run+RUNS <= runs) && isUnchangedBlock(words+2*run, previous, channelMask)) {
+         // Skip block without edges
+         position += RUNS+sumRepeatCounts(words+2*run, RUNS);
+         run      += RUNS;
+         continue;
+      }
+#endif
+      const Sample value   = words[2*run];
+      const Sample changed = (value^previous)&channelMask;
+      if (changed != 0) {
+         edges.push_back({position, value, changed});
+         previous = value;
+      }
+      position += (uint64_t)words[2*run+1]+1;
+      run++;
+   }
+}
+
+template<typename Sample>
+uint64_t getTransitionTicks(const Sample words[], size_t wordCount) {
+   if (wordCount < 4) {
+      return 0;
+   }
+   return sumRepeatCounts(words+2, wordCount/2-1);
+}
+
+template<typename Sample>
+void decodeTransitions(
+      const Sample                        words[],
+      size_t                              wordCount,
+      Analyser::SampleRate                sampleRate,
+      std::vector<TimedSample<Sample>>   &events,
+      Sample                              channelMask) {
+
+   const size_t   numEvents = wordCount/2;
+   const uint64_t period    = Analyser::getSamplePeriodIn_nanoseconds(sampleRate);
+   if (numEvents == 0) {
+      return;
+   }
+   Sample   previous = words[0];
+   uint64_t ticks    = 0;
+   events.push_back({0, previous});
+
+   for (size_t event=1; event<numEvents; event++) {
+      const Sample value = words[2*event];
+      ticks += words[2*event+1];
+      if (((value^previous)&channelMask) != 0) {
+         events.push_back({ticks*period, value});
+         previous = value;
+      }
+   }
+}
+
+template uint64_t getRleSampleCount(const uint16_t words[], size_t wordCount);
+template uint64_t getRleSampleCount(const uint32_t words[], size_t wordCount);
+template size_t expandRle(const uint16_t words[], size_t wordCount, uint16_t samples[], size_t maxSamples);
+template size_t expandRle(const uint32_t words[], size_t wordCount, uint32_t samples[], size_t maxSamples);
+template void rleToEdges(const uint16_t words[], size_t wordCount, std::vector<SampleEdge<uint16_t>> &edges, uint16_t channelMask);
+template void rleToEdges(const uint32_t words[], size_t wordCount, std::vector<SampleEdge<uint32_t>> &edges, uint32_t channelMask);
+template uint64_t getTransitionTicks(const uint16_t words[], size_t wordCount);
+template uint64_t getTransitionTicks(const uint32_t words[], size_t wordCount);
+template void decodeTransitions(const uint16_t words[], size_t wordCount, Analyser::SampleRate sampleRate, std::vector<TimedSample<uint16_t>> &events, uint16_t channelMask);
+template void decodeTransitions(const uint32_t words[], size_t wordCount, Analyser::SampleRate sampleRate, std::vector<TimedSample<uint32_t>> &events, uint32_t channelMask);
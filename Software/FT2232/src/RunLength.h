@@ -0,0 +1,147 @@
+/*
+ * RunLength.h
+ *
+ *  Created on: 30 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_RUNLENGTH_H_
+#define SOURCES_RUNLENGTH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "TriggerEncoding.h"
+
+/**
+ * Run-length encoded capture data (C_MODE_RLE)
+ *
+ * The capture is a sequence of runs, each stored as two words:
+ *    words[2n]   Sample value
+ *    words[2n+1] Repeat count (run length-1, at most C_RLE_MAX_COUNT)
+ *
+ * Adjacent runs may have the same value (long runs are split and the
+ * trigger sample always starts a new run).
+ *
+ * The pre-trigger length is a number of words so the trigger is the first
+ * sample of run preTrigSize/2. Its position in the expanded samples is
+ * getRleSampleCount(words, preTrigSize).
+ *
+ * The expansion to samples uses AVX2 or SSE2 where available.
+ *
+ * Transitional capture data (C_MODE_TRANSITION) has the same layout with
+ * the repeat count replaced by the number of sample ticks since the previous
+ * event:
+ *    words[2n]   Sample value
+ *    words[2n+1] Ticks since event n-1
+ *
+ * The first event has no previous event in the capture (it may have been
+ * overwritten while filling the pre-trigger) so its tick count is ignored.
+ *
+ * The trigger is event preTrigSize/2. Its time from the first event is
+ * getTransitionTicks(words, preTrigSize+2) ticks.
+ */
+
+/**
+ * Change of value in an edge list
+ *
+ * @tparam Sample  uint16_t or uint32_t
+ */
+template<typename Sample>
+struct SampleEdge {
+   uint64_t position;   //!< Index of first sample with new value
+   Sample   value;      //!< New value
+   Sample   changed;    //!< Channels that changed (within channel mask)
+};
+
+/**
+ * Event from transitional capture
+ *
+ * @tparam Sample  uint16_t or uint32_t
+ */
+template<typename Sample>
+struct TimedSample {
+   uint64_t time_ns;    //!< Time from first event
+   Sample   value;      //!< Sample value from this time
+};
+
+/**
+ * Get the number of samples represented by run-length encoded words
+ *
+ * @tparam Sample     uint16_t or uint32_t
+ *
+ * @param words       RLE words (in host order)
+ * @param wordCount   Number of words (a trailing odd word is ignored)
+ *
+ * @return Number of samples
+ */
+template<typename Sample>
+uint64_t getRleSampleCount(const Sample words[], size_t wordCount);
+
+/**
+ * Expand run-length encoded words to samples
+ *
+ * @tparam Sample     uint16_t or uint32_t
+ *
+ * @param words       RLE words (in host order)
+ * @param wordCount   Number of words (a trailing odd word is ignored)
+ * @param samples     Buffer for samples
+ * @param maxSamples  Size of sample buffer (expansion stops when full)
+ *
+ * @return Number of samples written
+ */
+template<typename Sample>
+size_t expandRle(const Sample words[], size_t wordCount, Sample samples[], size_t maxSamples);
+
+/**
+ * Convert run-length encoded words directly to an edge list
+ * The first run always produces an edge at position 0 (changed = channelMask).
+ * Blocks of runs without a change in the selected channels are skipped using AVX2 where available.
+ *
+ * @tparam Sample       uint16_t or uint32_t
+ *
+ * @param words         RLE words (in host order)
+ * @param wordCount     Number of words (a trailing odd word is ignored)
+ * @param edges         Edges are appended to this
+ * @param channelMask   Channels of interest (changes in other channels are ignored)
+ */
+template<typename Sample>
+void rleToEdges(const Sample words[], size_t wordCount, std::vector<SampleEdge<Sample>> &edges, Sample channelMask = (Sample)~0);
+
+/**
+ * Get the number of sample ticks from the first to the last event of transitional capture words
+ * The tick count of the first event is not included
+ *
+ * @tparam Sample     uint16_t or uint32_t
+ *
+ * @param words       Transition words (in host order)
+ * @param wordCount   Number of words (a trailing odd word is ignored)
+ *
+ * @return Number of ticks
+ */
+template<typename Sample>
+uint64_t getTransitionTicks(const Sample words[], size_t wordCount);
+
+/**
+ * Decode transitional capture words to values with absolute timestamps
+ * Events without a change in the selected channels (stored only because the tick
+ * count saturated or for the trigger) are dropped, apart from the first.
+ *
+ * @tparam Sample       uint16_t or uint32_t
+ *
+ * @param words         Transition words (in host order)
+ * @param wordCount     Number of words (a trailing odd word is ignored)
+ * @param sampleRate    Sample rate of capture (length of a tick)
+ * @param events        Events are appended to this
+ * @param channelMask   Channels of interest
+ */
+template<typename Sample>
+void decodeTransitions(
+      const Sample                        words[],
+      size_t                              wordCount,
+      Analyser::SampleRate                sampleRate,
+      std::vector<TimedSample<Sample>>   &events,
+      Sample                              channelMask = (Sample)~0);
+
+#endif /* SOURCES_RUNLENGTH_H_ */
@@ -0,0 +1,336 @@
+//============================================================================
+// Name        : StreamCapture.cpp
+// Author      : pgo
+// Continuous capture through the analyser SDRAM ring buffer
+//============================================================================
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+
+#include "MyException.h"
+#include "EncodeLuts.h"
+#include "ByteSwap.h"
+#include "CommandBuilder.h"
+#include "AnalyserCommands.h"
+#include "Trace.h"
+#include "StreamCapture.h"
+
+using namespace Analyser;
+
+/// Shortest and longest wait before polling an empty analyser ring buffer (us)
+static constexpr unsigned MIN_FILL_POLL_us = 100;
+static constexpr unsigned MAX_FILL_POLL_us = 10000;
+
+/// Wait when the host ring is full or empty (us)
+static constexpr unsigned RING_WAIT_us = 200;
+
+template<typename Sample>
+RawFileSink<Sample>::RawFileSink(const char *filename) {
+   fp = fopen(filename, "wb");
+   if (fp == nullptr) {
+      fprintf(stderr, "RawFileSink() - failed to create '%s'\n", filename);
+      throw MyException("RawFileSink() - failed to create '%s'", filename);
+   }
+}
+
+template<typename Sample>
+RawFileSink<Sample>::~RawFileSink() {
+   if (fp != nullptr) {
+      fclose(fp);
+   }
+}
+
+template<typename Sample>
+void RawFileSink<Sample>::write(const Sample samples[], size_t count) {
+   if (!HOST_IS_LITTLE_ENDIAN) {
+      // Ring is shared with other sinks so swap a copy
+      swapBuffer.assign(samples, samples+count);
+      samplesToHostOrder(swapBuffer.data(), count);
+      samples = swapBuffer.data();
+   }
+   if (fwrite(samples, sizeof(Sample), count, fp) != count) {
+      fprintf(stderr, "RawFileSink::write() - write failed\n");
+      throw MyException("RawFileSink::write() - write failed");
+   }
+}
+
+template<typename Sample>
+void RawFileSink<Sample>::close() {
+   if (fp == nullptr) {
+      return;
+   }
+   int rc = fclose(fp);
+   fp = nullptr;
+   if (rc != 0) {
+      fprintf(stderr, "RawFileSink::close() - close failed\n");
+      throw MyException("RawFileSink::close() - close failed");
+   }
+}
+
+template<typename Sample>
+StreamCapture<Sample>::StreamCapture(AnalyserSession &analyser, size_t ringSize) : ft2232(analyser.getTransport()), ring(ringSize) {
+   if (sizeof(Sample) != analyser.getAnalyserConfig().getBytesPerSample()) {
+      fprintf(stderr, "StreamCapture() - %u-byte samples do not match analyser (%u inputs)\n",
+            (unsigned)sizeof(Sample), analyser.getAnalyserConfig().sampleWidth);
+      throw MyException("StreamCapture() - %u-byte samples do not match analyser (%u inputs)",
+            (unsigned)sizeof(Sample), analyser.getAnalyserConfig().sampleWidth);
+   }
+}
+
+template<typename Sample>
+StreamCapture<Sample>::~StreamCapture() {
+   if (running) {
+      try {
+         stop();
+      } catch (...) {
+      }
+   }
+}
+
+template<typename Sample>
+void StreamCapture<Sample>::addSink(StreamSink<Sample> *sink) {
+   std::unique_ptr<StreamSink<Sample>> owned(sink);
+   if (running) {
+      fprintf(stderr, "StreamCapture::addSink() - capture is running\n");
+      throw MyException("StreamCapture::addSink() - capture is running");
+   }
+   ring.addConsumer();
+   sinks.push_back(std::move(owned));
+}
+
+template<typename Sample>
+void StreamCapture<Sample>::setError(std::exception_ptr exception) {
+   std::lock_guard<std::mutex> lock(errorMutex);
+   if (error == nullptr) {
+      error = exception;
+   }
+   failed.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * Read samples from analyser ring buffer with pipelined C_RD_BUFFER commands
+ * The samples must be available (see C_RD_FILL)
+ *
+ * @param data    Where to place samples
+ * @param count   Number of samples
+ */
+template<typename Sample>
+void StreamCapture<Sample>::readSamples(Sample *data, size_t count) {
+   const unsigned maxBlockSize = ft2232.getTransferProfile().blockSize&~(sizeof(Sample)-1);
+   const unsigned sizeInBytes  = count*sizeof(Sample);
+
+   ActivityTimer timer(ft2232.getStatistics(), Activity::StreamCapture, sizeInBytes);
+
+   std::vector<uint8_t> commands;
+   for (unsigned offset=0; offset<sizeInBytes; offset+=maxBlockSize) {
+      unsigned blockSize = std::min(maxBlockSize, sizeInBytes-offset);
+      commands.push_back(C_RD_BUFFER);
+      commands.push_back((uint8_t)(blockSize));
+      commands.push_back((uint8_t)((blockSize)>>8));
+   }
+   ft2232.transmitData(commands.data(), commands.size());
+   ft2232.receiveData(reinterpret_cast<uint8_t *>(data), sizeInBytes);
+
+   // Samples are sent low byte first
+   samplesToHostOrder(data, count);
+}
+
+/**
+ * Drain the analyser ring buffer into the host ring until stopped
+ */
+template<typename Sample>
+void StreamCapture<Sample>::readerThread() {
+   using namespace std::chrono;
+
+   const unsigned maxBlockSize = ft2232.getTransferProfile().blockSize&~(sizeof(Sample)-1);
+   const size_t   maxRead      = MAX_BLOCKS_PER_READ*(maxBlockSize/sizeof(Sample));
+
+   // Wait about the time needed to fill a block
+   const unsigned pollInterval = std::min<uint64_t>(MAX_FILL_POLL_us, std::max<uint64_t>(MIN_FILL_POLL_us,
+         ((uint64_t)(maxBlockSize/sizeof(Sample))*getSamplePeriodIn_nanoseconds(sampleRate))/1000));
+
+   uint64_t read     = 0;
+   bool     stopping = false;
+   try {
+      for(;;) {
+         if (failed.load(std::memory_order_relaxed)) {
+            // Sink failed - stop sampling and abandon remaining samples
+            if (!stopping) {
+               writeControl(ft2232, sampleRate|C_CONTROL_STREAM|C_CONTROL_CLEAR);
+            }
+            break;
+         }
+         if (!stopping && stopRequested.load(std::memory_order_acquire)) {
+            // Stop sampling - remaining samples are still read
+            writeControl(ft2232, sampleRate|C_CONTROL_STREAM|C_CONTROL_CLEAR);
+            stopping = true;
+         }
+         uint8_t  status;
+         uint32_t written = readFill(ft2232, status);
+         uint32_t fill    = (written-(uint32_t)read)&C_FILL_MASK;
+
+         if ((status&C_STATUS_OVERRUN) && !overrun.load(std::memory_order_relaxed)) {
+            traceLog.record(TraceEvent::StreamOverrun, &ft2232, (uint32_t)read);
+            overrunAt.store(read, std::memory_order_relaxed);
+            overrun.store(true, std::memory_order_relaxed);
+         }
+         if (fill > maxFill.load(std::memory_order_relaxed)) {
+            maxFill.store(fill, std::memory_order_relaxed);
+         }
+         if (fill == 0) {
+            if (stopping && ((status&C_STATUS_STATE_MASK) == C_STATUS_STATE_IDLE)) {
+               // Sampling has stopped and all samples read
+               break;
+            }
+            std::this_thread::sleep_for(microseconds(pollInterval));
+            continue;
+         }
+         // Wait for space in host ring (throttled by slowest sink)
+         Sample *region;
+         size_t  space;
+         while (((space = ring.getWritable(region)) == 0) && !failed.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(microseconds(RING_WAIT_us));
+         }
+         if (space == 0) {
+            continue;
+         }
+         size_t count = std::min({(size_t)fill, space, maxRead});
+         readSamples(region, count);
+         traceLog.record(TraceEvent::StreamBlock, &ft2232, (uint32_t)count, fill);
+         ring.commit(count);
+         read += count;
+         samplesRead.store(read, std::memory_order_relaxed);
+      }
+   } catch (...) {
+      setError(std::current_exception());
+      try {
+         // Try to leave analyser idle
+         writeControl(ft2232, sampleRate|C_CONTROL_STREAM|C_CONTROL_CLEAR);
+      } catch (...) {
+      }
+   }
+   traceLog.record(TraceEvent::StreamStop, &ft2232, (uint32_t)read, overrun.load(std::memory_order_relaxed));
+   ring.close();
+}
+
+/**
+ * Pass samples from the host ring to a sink until the reader finishes
+ *
+ * @param consumer Index of sink (and ring consumer)
+ */
+template<typename Sample>
+void StreamCapture<Sample>::writerThread(unsigned consumer) {
+   StreamSink<Sample> &sink = *sinks[consumer];
+   try {
+      for(;;) {
+         // Check before reading so the final samples are not missed
+         bool          finished = ring.isClosed();
+         const Sample *region;
+         size_t        count = ring.getReadable(consumer, region);
+         if (count == 0) {
+            if (finished) {
+               break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(RING_WAIT_us));
+            continue;
+         }
+         sink.write(region, count);
+         ring.release(consumer, count);
+      }
+      sink.close();
+   } catch (...) {
+      setError(std::current_exception());
+
+      // Keep releasing samples so the reader is not blocked
+      for(;;) {
+         bool          finished = ring.isClosed();
+         const Sample *region;
+         size_t        count = ring.getReadable(consumer, region);
+         if (count == 0) {
+            if (finished) {
+               break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(RING_WAIT_us));
+            continue;
+         }
+         ring.release(consumer, count);
+      }
+   }
+}
+
+template<typename Sample>
+void StreamCapture<Sample>::start(SampleRate sampleRate) {
+   if (running) {
+      fprintf(stderr, "StreamCapture::start() - already running\n");
+      throw MyException("StreamCapture::start() - already running");
+   }
+   this->sampleRate = sampleRate;
+
+   ring.reset();
+   stopRequested.store(false);
+   failed.store(false);
+   samplesRead.store(0);
+   maxFill.store(0);
+   overrun.store(false);
+   overrunAt.store(0);
+   error = nullptr;
+
+   // Return to idle then start streaming in a single transfer
+   const uint8_t control = sampleRate|C_CONTROL_STREAM;
+   uint8_t status[2];
+   {
+      ActivityTimer timer(ft2232.getStatistics(), Activity::StartCapture);
+      CommandBuilder().
+            writeControl(control|C_CONTROL_CLEAR).
+            readStatus().
+            writeControl(control|C_CONTROL_START_ACQ).
+            readStatus().
+            execute(ft2232, status, sizeof(status));
+   }
+   traceLog.record(TraceEvent::StartCapture, &ft2232, control|C_CONTROL_START_ACQ, 0, 0);
+   if (((status[0]&C_STATUS_STATE_MASK) != C_STATUS_STATE_IDLE) ||
+       ((status[1]&C_STATUS_STATE_MASK) != C_STATUS_STATE_STREAM)) {
+      fprintf(stderr, "StreamCapture::start() - analyser did not start streaming (status 0x%02X, 0x%02X)\n", status[0], status[1]);
+      throw MyException("StreamCapture::start() - analyser did not start streaming (status 0x%02X, 0x%02X)", status[0], status[1]);
+   }
+   running = true;
+   reader  = std::thread(&StreamCapture::readerThread, this);
+   for (unsigned consumer=0; consumer<sinks.size(); consumer++) {
+      writers.emplace_back(&StreamCapture::writerThread, this, consumer);
+   }
+}
+
+template<typename Sample>
+void StreamCapture<Sample>::stop() {
+   if (!running) {
+      return;
+   }
+   stopRequested.store(true, std::memory_order_release);
+   reader.join();
+   for (std::thread &writer:writers) {
+      writer.join();
+   }
+   writers.clear();
+   running = false;
+
+   std::lock_guard<std::mutex> lock(errorMutex);
+   if (error != nullptr) {
+      std::rethrow_exception(error);
+   }
+}
+
+template<typename Sample>
+StreamStatus StreamCapture<Sample>::getStatus() const {
+   StreamStatus status;
+   status.samplesRead   = samplesRead.load(std::memory_order_relaxed);
+   status.samplesStored = ring.getReleased();
+   status.maxFill       = maxFill.load(std::memory_order_relaxed);
+   status.overrun       = overrun.load(std::memory_order_relaxed);
+   status.overrunAt     = overrunAt.load(std::memory_order_relaxed);
+   return status;
+}
+
+template class RawFileSink<uint16_t>;
+template class RawFileSink<uint32_t>;
+template class StreamCapture<uint16_t>;
+template class StreamCapture<uint32_t>;
@@ -0,0 +1,391 @@
+/*
+ * StreamCapture.h
+ *
+ *  Created on: 28 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_STREAMCAPTURE_H_
+#define SOURCES_STREAMCAPTURE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MyException.h"
+#include "EncodeLuts.h"
+#include "FT2232.h"
+#include "AnalyserSession.h"
+
+/**
+ * Lock-free ring of samples with a single producer and several consumers.
+ *
+ * Every consumer sees every sample. The producer may only overwrite samples
+ * released by all consumers so it runs at most the size of the ring ahead of
+ * the slowest consumer.
+ *
+ * Space and data are exposed as contiguous regions so the producer can receive
+ * directly into the ring and consumers can write directly from it.
+ *
+ * @tparam Sample  uint16_t or uint32_t
+ */
+template<typename Sample>
+class SampleRing {
+public:
+   /// Maximum number of consumers
+   static constexpr unsigned MAX_CONSUMERS = 8;
+
+private:
+   /// Position of a consumer (on its own cache line)
+   struct alignas(64) Tail {
+      std::atomic<uint64_t> position{0};
+   };
+
+   std::vector<Sample>               buffer;
+   const uint64_t                    mask;
+   unsigned                          numConsumers = 0;
+
+   alignas(64) std::atomic<uint64_t> head{0};
+   alignas(64) std::atomic<bool>     closed{false};
+   Tail                              tails[MAX_CONSUMERS];
+
+public:
+   /**
+    * @param size Number of samples in ring (power of 2)
+    *
+    * @throw MyException if size is not a power of 2
+    */
+   SampleRing(size_t size) : buffer(size), mask(size-1) {
+      if ((size == 0) || ((size&mask) != 0)) {
+         fprintf(stderr, "SampleRing() - size %zu is not a power of 2\n", size);
+         throw MyException("SampleRing() - size %zu is not a power of 2", size);
+      }
+   }
+
+   /**
+    * Add a consumer.
+    * Must be done before the ring is used.
+    *
+    * @return Consumer index
+    *
+    * @throw MyException if too many consumers
+    */
+   unsigned addConsumer() {
+      if (numConsumers >= MAX_CONSUMERS) {
+         fprintf(stderr, "SampleRing::addConsumer() - too many consumers\n");
+         throw MyException("SampleRing::addConsumer() - too many consumers");
+      }
+      return numConsumers++;
+   }
+
+   /**
+    * Empty the ring.
+    * Must not be used while the producer or consumers are running.
+    */
+   void reset() {
+      head.store(0, std::memory_order_relaxed);
+      closed.store(false, std::memory_order_relaxed);
+      for (Tail &tail:tails) {
+         tail.position.store(0, std::memory_order_relaxed);
+      }
+   }
+
+   /// @return Number of samples in ring
+   size_t getSize() const {
+      return buffer.size();
+   }
+
+   /**
+    * Producer - Get free space
+    *
+    * @param region  Set to start of free space
+    *
+    * @return Number of samples available at region (contiguous)
+    */
+   size_t getWritable(Sample *&region) {
+      const uint64_t position = head.load(std::memory_order_relaxed);
+      uint64_t       slowest  = position;
+      for (unsigned consumer=0; consumer<numConsumers; consumer++) {
+         slowest = std::min(slowest, tails[consumer].position.load(std::memory_order_acquire));
+      }
+      const size_t offset = position&mask;
+      region = buffer.data()+offset;
+      return std::min<size_t>(buffer.size()-(position-slowest), buffer.size()-offset);
+   }
+
+   /**
+    * Producer - Make samples written to the free space available to consumers
+    *
+    * @param count Number of samples
+    */
+   void commit(size_t count) {
+      head.store(head.load(std::memory_order_relaxed)+count, std::memory_order_release);
+   }
+
+   /**
+    * Producer - No more samples will be committed
+    */
+   void close() {
+      closed.store(true, std::memory_order_release);
+   }
+
+   /**
+    * Consumer - Get available samples
+    *
+    * @param consumer  Consumer index
+    * @param region    Set to start of samples
+    *
+    * @return Number of samples available at region (contiguous)
+    */
+   size_t getReadable(unsigned consumer, const Sample *&region) const {
+      const uint64_t position = tails[consumer].position.load(std::memory_order_relaxed);
+      const size_t   offset   = position&mask;
+      region = buffer.data()+offset;
+      return std::min<size_t>(head.load(std::memory_order_acquire)-position, buffer.size()-offset);
+   }
+
+   /**
+    * Consumer - Release samples so they may be overwritten
+    *
+    * @param consumer  Consumer index
+    * @param count     Number of samples
+    */
+   void release(unsigned consumer, size_t count) {
+      std::atomic<uint64_t> &position = tails[consumer].position;
+      position.store(position.load(std::memory_order_relaxed)+count, std::memory_order_release);
+   }
+
+   /**
+    * Consumer - Check if the producer has finished.
+    * Check this before getReadable() so that no samples are missed.
+    *
+    * @return true if no more samples will be committed
+    */
+   bool isClosed() const {
+      return closed.load(std::memory_order_acquire);
+   }
+
+   /**
+    * Get number of samples released by the slowest consumer
+    *
+    * @return Count
+    */
+   uint64_t getReleased() const {
+      uint64_t slowest = head.load(std::memory_order_acquire);
+      for (unsigned consumer=0; consumer<numConsumers; consumer++) {
+         slowest = std::min(slowest, tails[consumer].position.load(std::memory_order_acquire));
+      }
+      return slowest;
+   }
+
+   SampleRing(const SampleRing &) = delete;
+   SampleRing &operator=(const SampleRing &) = delete;
+};
+
+/**
+ * Destination for streamed samples.
+ * Each sink is written from its own thread.
+ *
+ * @tparam Sample  uint16_t or uint32_t
+ */
+template<typename Sample>
+class StreamSink {
+public:
+   virtual ~StreamSink() {
+   }
+
+   /**
+    * Write samples
+    *
+    * @param samples  Samples in host order
+    * @param count    Number of samples
+    *
+    * @throw MyException on failure
+    */
+   virtual void write(const Sample samples[], size_t count) = 0;
+
+   /**
+    * Called after the last samples have been written
+    *
+    * @throw MyException on failure
+    */
+   virtual void close() {
+   }
+};
+
+/**
+ * File of raw little-endian samples
+ * (can be replayed by FileSignalSource)
+ *
+ * @tparam Sample  uint16_t or uint32_t
+ */
+template<typename Sample>
+class RawFileSink : public StreamSink<Sample> {
+private:
+   FILE                *fp = nullptr;
+   std::vector<Sample>  swapBuffer;
+
+public:
+   /**
+    * @param filename File to create
+    *
+    * @throw MyException if the file cannot be created
+    */
+   RawFileSink(const char *filename);
+
+   virtual ~RawFileSink();
+
+   virtual void write(const Sample samples[], size_t count) override;
+   virtual void close() override;
+};
+
+/**
+ * Progress of a streaming capture
+ */
+struct StreamStatus {
+   uint64_t samplesRead;     //!< Samples read from analyser
+   uint64_t samplesStored;   //!< Samples written by all sinks
+   uint32_t maxFill;         //!< Largest analyser ring buffer fill level seen (samples)
+   bool     overrun;         //!< Analyser discarded samples as its ring buffer was full
+   uint64_t overrunAt;       //!< Samples read when overrun was first seen
+};
+
+/**
+ * Continuous capture using the analyser SDRAM as a ring buffer (C_CONTROL_STREAM)
+ *
+ * A reader thread polls the analyser fill level (C_RD_FILL) and drains it with
+ * C_RD_BUFFER directly into a lock-free SampleRing. Each StreamSink has a writer
+ * thread consuming from the ring. The length of capture is unbounded provided
+ * the USB link and sinks keep up with the sample rate.
+ *
+ * If they do not, the analyser discards samples when its ring buffer is full
+ * and reports C_STATUS_OVERRUN. This is recorded in the StreamStatus and the
+ * capture continues (the samples after the overrun are not contiguous with
+ * those before).
+ *
+ * Requires an analyser of at least STREAM_MIN_VERSION.
+ *
+ * Example:
+ * @code
+ *    StreamCapture<uint16_t> stream(analyser);
+ *    stream.addSink(new RawFileSink<uint16_t>("capture.bin"));
+ *    stream.start(SampleRate_100ns);
+ *    ...
+ *    stream.stop();
+ * @endcode
+ *
+ * @tparam Sample  uint16_t or uint32_t (matching the analyser sample width)
+ */
+template<typename Sample>
+class StreamCapture {
+public:
+   /// Default size of host ring in samples
+   static constexpr size_t DEFAULT_RING_SIZE = 1U<<24;
+
+   /// Maximum samples read between fill level polls (in transfer blocks)
+   static constexpr unsigned MAX_BLOCKS_PER_READ = 16;
+
+private:
+   FT2232                                          &ft2232;
+   SampleRing<Sample>                               ring;
+   std::vector<std::unique_ptr<StreamSink<Sample>>> sinks;
+
+   std::thread                                      reader;
+   std::vector<std::thread>                         writers;
+   Analyser::SampleRate                             sampleRate = Analyser::SampleRate_100ns;
+   bool                                             running    = false;
+
+   std::atomic<bool>                                stopRequested{false};
+   std::atomic<bool>                                failed{false};
+
+   // Progress
+   std::atomic<uint64_t>                            samplesRead{0};
+   std::atomic<uint32_t>                            maxFill{0};
+   std::atomic<bool>                                overrun{false};
+   std::atomic<uint64_t>                            overrunAt{0};
+
+   // First error from a thread
+   std::mutex                                       errorMutex;
+   std::exception_ptr                               error = nullptr;
+
+   void readerThread();
+   void writerThread(unsigned consumer);
+   void readSamples(Sample *data, size_t count);
+   void setError(std::exception_ptr exception);
+
+public:
+   /**
+    * @param analyser  Interface to analyser
+    * @param ringSize  Size of host ring in samples (power of 2)
+    *
+    * @throw MyException if the sample type does not match the analyser
+    */
+   StreamCapture(AnalyserSession &analyser, size_t ringSize = DEFAULT_RING_SIZE);
+
+   /**
+    * Stops capture if running (errors are discarded)
+    */
+   ~StreamCapture();
+
+   /**
+    * Add destination for samples.
+    * Must be done before start().
+    *
+    * @param sink  Sink (ownership is taken)
+    *
+    * @throw MyException if running or too many sinks
+    */
+   void addSink(StreamSink<Sample> *sink);
+
+   /**
+    * Start streaming
+    *
+    * @param sampleRate Sample rate
+    *
+    * @throw MyException if already running or the analyser does not start streaming
+    */
+   void start(Analyser::SampleRate sampleRate);
+
+   /**
+    * Stop streaming.
+    * The samples remaining in the analyser are read and all sinks are closed.
+    *
+    * @throw MyException (or other exception) from the reader or a sink
+    */
+   void stop();
+
+   /**
+    * @return true if started and not stopped
+    */
+   bool isRunning() const {
+      return running;
+   }
+
+   /**
+    * Check if a thread has failed.
+    * The capture should be stopped to get the error.
+    *
+    * @return true if failed
+    */
+   bool hasFailed() const {
+      return failed.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * Get progress
+    *
+    * @return Status
+    */
+   StreamStatus getStatus() const;
+
+   StreamCapture(const StreamCapture &) = delete;
+   StreamCapture &operator=(const StreamCapture &) = delete;
+};
+
+#endif /* SOURCES_STREAMCAPTURE_H_ */
@@ -0,0 +1,234 @@
+//============================================================================
+// Name        : Trace.cpp
+// Author      : pgo
+// Binary trace ring buffer with deferred formatting
+//============================================================================
+#include <stdio.h>
+#include <algorithm>
+
+#include "console.h"
+#include "EncodeLuts.h"
+#include "AnalyserCommands.h"
+#include "Trace.h"
+
+TraceLog traceLog;
+
+TraceLog::~TraceLog() {
+   stopConsumer();
+}
+
+void TraceLog::write(TraceEvent event, const void *source, uint32_t arg0, uint32_t arg1, uint32_t arg2) {
+   uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+   Slot    &slot  = slots[index&MASK];
+
+   // Mark slot as being written so a concurrent reader discards it
+   slot.sequence.store(0, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_release);
+
+   slot.timestamp_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now()-epoch).count(), std::memory_order_relaxed);
+   slot.source.store(reinterpret_cast<uintptr_t>(source), std::memory_order_relaxed);
+   slot.event.store(static_cast<uint32_t>(event), std::memory_order_relaxed);
+   slot.args[0].store(arg0, std::memory_order_relaxed);
+   slot.args[1].store(arg1, std::memory_order_relaxed);
+   slot.args[2].store(arg2, std::memory_order_relaxed);
+
+   slot.sequence.store(index+1, std::memory_order_release);
+}
+
+unsigned TraceLog::read(std::vector<TraceRecord> &records) {
+   std::lock_guard<std::mutex> lock(consumerMutex);
+
+   const uint64_t available = head.load(std::memory_order_acquire);
+   if ((available-tail) > SIZE) {
+      // Overwritten before being read
+      lost += available-SIZE-tail;
+      tail  = available-SIZE;
+   }
+   unsigned count = 0;
+   while (tail < available) {
+      Slot &slot = slots[tail&MASK];
+
+      uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence > tail+1) {
+         // Overwritten by later record
+         lost++;
+         tail++;
+         continue;
+      }
+      if (sequence != tail+1) {
+         // Still being written
+         break;
+      }
+      TraceRecord record;
+      record.sequence     = tail;
+      record.timestamp_ns = slot.timestamp_ns.load(std::memory_order_relaxed);
+      record.source       = slot.source.load(std::memory_order_relaxed);
+      record.event        = static_cast<TraceEvent>(slot.event.load(std::memory_order_relaxed));
+      record.args[0]      = slot.args[0].load(std::memory_order_relaxed);
+      record.args[1]      = slot.args[1].load(std::memory_order_relaxed);
+      record.args[2]      = slot.args[2].load(std::memory_order_relaxed);
+
+      // Discard if overwritten while copying
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != sequence) {
+         lost++;
+         tail++;
+         continue;
+      }
+      records.push_back(record);
+      tail++;
+      count++;
+   }
+   return count;
+}
+
+const char *TraceLog::getName(TraceEvent event) {
+   static const char *const names[] = {
+         "WritePreTrigger",
+         "WriteCaptureLength",
+         "WriteControl",
+         "ReadStatus",
+         "ReadVersion",
+         "ReadConfig",
+         "StartCapture",
+         "ArmCapture",
+         "Notify",
+         "CaptureComplete",
+         "ReadCaptureData",
+         "RequestBlocks",
+         "ReceiveBlock",
+         "ReadFill",
+         "StreamBlock",
+         "StreamOverrun",
+         "StreamStop",
+         "WriteMode",
+         "WriteChannels",
+         "WriteReadOffset",
+         "ReadSnapshot",
+   };
+   unsigned index = static_cast<unsigned>(event);
+   if (index >= sizeof(names)/sizeof(names[0])) {
+      return "Unknown";
+   }
+   return names[index];
+}
+
+/**
+ * Print a record
+ * Sources are numbered in order of first appearance
+ *
+ * @param fp      Where to print
+ * @param record  Record to print
+ */
+void TraceLog::format(FILE *fp, const TraceRecord &record) {
+   unsigned sourceIndex = std::find(sources.begin(), sources.end(), record.source)-sources.begin();
+   if (sourceIndex == sources.size()) {
+      sources.push_back(record.source);
+   }
+   fprintf(fp, "%12.3f us [%u] %-18s ", record.timestamp_ns/1000.0, sourceIndex, getName(record.event));
+
+   const uint32_t *args = record.args;
+   switch(record.event) {
+      case TraceEvent::WritePreTrigger:
+      case TraceEvent::WriteCaptureLength:
+      case TraceEvent::WriteReadOffset:
+         fprintf(fp, "%u\n", args[0]);
+         break;
+      case TraceEvent::WriteControl:
+      case TraceEvent::ArmCapture:
+         fprintf(fp, "0x%02X (%s)\n", args[0], getControlNames(args[0]));
+         break;
+      case TraceEvent::ReadStatus:
+      case TraceEvent::Notify:
+         fprintf(fp, "0x%02X (%s)\n", args[0], getStatuslNames(args[0]));
+         break;
+      case TraceEvent::ReadVersion:
+         fprintf(fp, "0x%02X\n", args[0]);
+         break;
+      case TraceEvent::ReadConfig:
+         fprintf(fp, "inputs=%u, steps=%u, patterns=%u, counter bits=%u\n",
+               args[0]&0xFF, (args[0]>>8)&0xFF, (args[0]>>16)&0xFF, args[0]>>24);
+         break;
+      case TraceEvent::StartCapture:
+         fprintf(fp, "control=0x%02X (%s), capture=%u, pretrig=%u\n", args[0], getControlNames(args[0]), args[1], args[2]);
+         break;
+      case TraceEvent::CaptureComplete:
+         fprintf(fp, "%s\n", args[0]?"complete":"timeout/cancelled");
+         break;
+      case TraceEvent::ReadCaptureData:
+         fprintf(fp, "samples=%u, blocks=%u, queue=%u\n", args[0], args[1], args[2]);
+         break;
+      case TraceEvent::RequestBlocks:
+         fprintf(fp, "C_RD_BUFFER blocks %u-%u, size=%u\n", args[0], args[0]+args[1]-1, args[2]);
+         break;
+      case TraceEvent::ReceiveBlock:
+         fprintf(fp, "block %u, %u bytes\n", args[0], args[1]);
+         break;
+      case TraceEvent::ReadFill:
+         fprintf(fp, "written=%u, status=0x%02X (%s)\n", args[0], args[1], getStatuslNames(args[1]));
+         break;
+      case TraceEvent::StreamBlock:
+         fprintf(fp, "%u samples, fill=%u\n", args[0], args[1]);
+         break;
+      case TraceEvent::StreamOverrun:
+         fprintf(fp, "after %u samples\n", args[0]);
+         break;
+      case TraceEvent::StreamStop:
+         fprintf(fp, "%u samples%s\n", args[0], args[1]?", overrun":"");
+         break;
+      case TraceEvent::WriteMode:
+         fprintf(fp, "0x%02X (%s)\n", args[0], getModeNames(args[0]));
+         break;
+      case TraceEvent::WriteChannels:
+         fprintf(fp, "0x%08X\n", args[0]);
+         break;
+      case TraceEvent::ReadSnapshot:
+         fprintf(fp, "status=0x%02X (%s), step=%u, match=0x%04X, capture=%u, written=%u\n",
+               args[0]&0xFF, getStatuslNames(args[0]&0xFF), (args[0]>>8)&0xFF, args[0]>>16, args[1], args[2]);
+         break;
+      default:
+         fprintf(fp, "%u, %u, %u\n", args[0], args[1], args[2]);
+         break;
+   }
+}
+
+unsigned TraceLog::drain(FILE *fp) {
+   std::vector<TraceRecord> records;
+   uint64_t lostBefore = getLost();
+   read(records);
+
+   std::lock_guard<std::mutex> lock(consumerMutex);
+   if (lost != lostBefore) {
+      fprintf(fp, "*** %llu trace records lost\n", (unsigned long long)(lost-lostBefore));
+   }
+   for (const TraceRecord &record:records) {
+      format(fp, record);
+   }
+   fflush(fp);
+   return records.size();
+}
+
+void TraceLog::startConsumer(FILE *fp, unsigned interval_ms) {
+   stopConsumer();
+   stop           = false;
+   consumerOutput = fp;
+   consumer = std::thread([this, interval_ms]() {
+      std::unique_lock<std::mutex> lock(threadMutex);
+      while (!stop) {
+         stopRequested.wait_for(lock, std::chrono::milliseconds(interval_ms));
+         drain(consumerOutput);
+      }
+   });
+}
+
+void TraceLog::stopConsumer() {
+   if (!consumer.joinable()) {
+      return;
+   }
+   {
+      std::lock_guard<std::mutex> lock(threadMutex);
+      stop = true;
+   }
+   stopRequested.notify_one();
+   consumer.join();
+}
@@ -0,0 +1,210 @@
+/*
+ * Trace.h
+ *
+ *  Created on: 11 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_TRACE_H_
+#define SOURCES_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <vector>
+
+/**
+ * Events recorded in trace
+ */
+enum class TraceEvent : uint32_t {
+   WritePreTrigger,     //!< arg0 = pre-trigger samples
+   WriteCaptureLength,  //!< arg0 = capture samples
+   WriteControl,        //!< arg0 = control value
+   ReadStatus,          //!< arg0 = status
+   ReadVersion,         //!< arg0 = version
+   ReadConfig,          //!< arg0 = sample width, steps, patterns, counter bits (byte 0-3)
+   StartCapture,        //!< arg0 = control value, arg1 = capture samples, arg2 = pre-trigger samples
+   ArmCapture,          //!< arg0 = control value
+   Notify,              //!< arg0 = status sent by analyser
+   CaptureComplete,     //!< arg0 = 1 complete, 0 timeout/cancelled
+   ReadCaptureData,     //!< arg0 = samples, arg1 = blocks, arg2 = queue depth
+   RequestBlocks,       //!< arg0 = first block, arg1 = number of blocks, arg2 = block size
+   ReceiveBlock,        //!< arg0 = block, arg1 = bytes
+   ReadFill,            //!< arg0 = samples written (24-bit), arg1 = status
+   StreamBlock,         //!< arg0 = samples, arg1 = fill level before read
+   StreamOverrun,       //!< arg0 = samples read before overrun detected
+   StreamStop,          //!< arg0 = samples read (low 32 bits), arg1 = 1 if overrun
+   WriteMode,           //!< arg0 = mode value
+   WriteChannels,       //!< arg0 = channel mask
+   WriteReadOffset,     //!< arg0 = offset in words
+   ReadSnapshot,        //!< arg0 = status, step, match counter (byte 0, 1, 2-3), arg1 = capture counter, arg2 = written
+};
+
+/**
+ * Trace record as returned to consumer
+ */
+struct TraceRecord {
+   uint64_t    sequence;      //!< Position in trace
+   uint64_t    timestamp_ns;  //!< Time since trace created
+   uintptr_t   source;        //!< Object generating event (e.g. FT2232 interface)
+   TraceEvent  event;         //!< Event
+   uint32_t    args[3];       //!< Event arguments
+};
+
+/**
+ * Binary trace ring buffer.
+ *
+ * Fixed-size records are written without locking by any number of threads and
+ * formatted later by a single consumer. When the ring is full the oldest
+ * records are overwritten and counted as lost.
+ *
+ * Recording is switched at run-time. When off the cost is a single relaxed load.
+ */
+class TraceLog {
+public:
+   /// Number of records in ring (power of 2)
+   static constexpr unsigned SIZE = 4096;
+
+private:
+   static constexpr uint64_t MASK = SIZE-1;
+
+   static_assert((SIZE&MASK) == 0, "SIZE must be a power of 2");
+
+   using Clock = std::chrono::steady_clock;
+
+   /**
+    * Ring entry
+    * sequence is zero while being written and index+1 once complete
+    */
+   struct Slot {
+      std::atomic<uint64_t>   sequence{0};
+      std::atomic<uint64_t>   timestamp_ns{0};
+      std::atomic<uintptr_t>  source{0};
+      std::atomic<uint32_t>   event{0};
+      std::atomic<uint32_t>   args[3] = {};
+   };
+
+   std::atomic<bool>       enabled{false};
+   std::atomic<uint64_t>   head{0};
+   const Clock::time_point epoch;
+   Slot                    slots[SIZE];
+
+   // Consumer state
+   std::mutex              consumerMutex;
+   uint64_t                tail = 0;
+   uint64_t                lost = 0;
+   std::vector<uintptr_t>  sources;
+
+   // Consumer thread
+   std::mutex              threadMutex;
+   std::condition_variable stopRequested;
+   std::thread             consumer;
+   FILE                   *consumerOutput = nullptr;
+   bool                    stop = false;
+
+   void write(TraceEvent event, const void *source, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+   void format(FILE *fp, const TraceRecord &record);
+
+public:
+   TraceLog() : epoch(Clock::now()) {
+   }
+
+   /**
+    * Stops consumer thread (remaining records are printed)
+    */
+   ~TraceLog();
+
+   /**
+    * Switch recording on or off
+    *
+    * @param enable true to record
+    */
+   void setEnabled(bool enable) {
+      enabled.store(enable, std::memory_order_relaxed);
+   }
+
+   /**
+    * @return true if recording
+    */
+   bool isEnabled() const {
+      return enabled.load(std::memory_order_relaxed);
+   }
+
+   /**
+    * Record event (if enabled)
+    *
+    * @param event   Event
+    * @param source  Object generating event
+    * @param arg0    Event argument
+    * @param arg1    Event argument
+    * @param arg2    Event argument
+    */
+   void record(TraceEvent event, const void *source, uint32_t arg0 = 0, uint32_t arg1 = 0, uint32_t arg2 = 0) {
+      if (enabled.load(std::memory_order_relaxed)) {
+         write(event, source, arg0, arg1, arg2);
+      }
+   }
+
+   /**
+    * Remove available records from ring
+    *
+    * @param records Records removed (appended)
+    *
+    * @return Number of records removed
+    */
+   unsigned read(std::vector<TraceRecord> &records);
+
+   /**
+    * Format and print available records
+    *
+    * @param fp Where to print
+    *
+    * @return Number of records printed
+    */
+   unsigned drain(FILE *fp = stdout);
+
+   /**
+    * Get number of records overwritten before being read
+    *
+    * @return Count
+    */
+   uint64_t getLost() {
+      std::lock_guard<std::mutex> lock(consumerMutex);
+      return lost;
+   }
+
+   /**
+    * Start thread that prints records as they become available
+    *
+    * @param fp           Where to print
+    * @param interval_ms  How often to print
+    */
+   void startConsumer(FILE *fp = stdout, unsigned interval_ms = 50);
+
+   /**
+    * Stop consumer thread
+    * Remaining records are printed
+    */
+   void stopConsumer();
+
+   /**
+    * Get name of event
+    *
+    * @param event Event
+    *
+    * @return Name
+    */
+   static const char *getName(TraceEvent event);
+
+   TraceLog(const TraceLog &) = delete;
+   TraceLog &operator=(const TraceLog &) = delete;
+};
+
+/// Trace shared by all analysers
+extern TraceLog traceLog;
+
+#endif /* SOURCES_TRACE_H_ */
@@ -0,0 +1,130 @@
+//============================================================================
+// Name        : TransferProfile.cpp
+// Author      : pgo
+// USB transfer parameters of the FT2232 transport and the saved per-device profiles
+//============================================================================
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "MyException.h"
+#include "FT2232.h"
+
+/**
+ * Set USB transfer parameters
+ * Values are adjusted to the nearest acceptable value
+ *
+ * @param profile Parameters to apply
+ */
+void FT2232::setTransferProfile(const TransferProfile &profile) {
+   TransferProfile p = profile;
+
+   p.latencyTimer_ms = std::max(1U,   std::min(255U,   p.latencyTimer_ms));
+   p.inTransferSize  = std::max(512U, std::min(65536U, p.inTransferSize))  & ~511U;
+   p.outTransferSize = std::max(512U, std::min(65536U, p.outTransferSize)) & ~511U;
+   p.blockSize       = std::max(4U,   std::min(65532U, p.blockSize))       & ~3U;
+
+   _setTransferProfile(p);
+   transferProfile = p;
+}
+
+/**
+ * Get name of file used to save transfer profiles
+ *
+ * @return Path to file
+ */
+static std::string getProfileFilename() {
+#if defined(_WIN32)
+   const char *dir = getenv("APPDATA");
+   const char *name = "\\LogicAnalyser_profiles.cfg";
+#else
+   const char *dir = getenv("HOME");
+   const char *name = "/.LogicAnalyser_profiles";
+#endif
+   return std::string((dir != nullptr)?dir:".")+name;
+}
+
+/**
+ * Saved profile entry
+ */
+struct ProfileEntry {
+   char            serial[64];
+   TransferProfile profile;
+};
+
+/**
+ * Read all saved profiles
+ *
+ * @return Profiles (empty if none saved)
+ */
+static std::vector<ProfileEntry> readProfiles() {
+   std::vector<ProfileEntry> entries;
+
+   FILE *fp = fopen(getProfileFilename().c_str(), "r");
+   if (fp == nullptr) {
+      return entries;
+   }
+   char line[200];
+   while (fgets(line, sizeof(line), fp) != nullptr) {
+      ProfileEntry entry;
+      if ((line[0] != '#') && (sscanf(line, "%63s %u %u %u %u",
+            entry.serial,
+            &entry.profile.latencyTimer_ms,
+            &entry.profile.inTransferSize,
+            &entry.profile.outTransferSize,
+            &entry.profile.blockSize) == 5)) {
+         entries.push_back(entry);
+      }
+   }
+   fclose(fp);
+   return entries;
+}
+
+/**
+ * Apply the transfer profile saved for this device (if any)
+ *
+ * @return true  => Saved profile applied
+ * @return false => No profile saved for this device
+ */
+bool FT2232::loadTransferProfile() {
+   std::string serial = getSerialNumber();
+
+   for (const ProfileEntry &entry:readProfiles()) {
+      if (serial == entry.serial) {
+         setTransferProfile(entry.profile);
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * Save the current transfer profile for this device
+ */
+void FT2232::saveTransferProfile() {
+   std::string serial = getSerialNumber();
+
+   std::vector<ProfileEntry> entries = readProfiles();
+   entries.erase(
+         std::remove_if(entries.begin(), entries.end(), [&](const ProfileEntry &e){ return serial == e.serial; }),
+         entries.end());
+
+   ProfileEntry entry;
+   snprintf(entry.serial, sizeof(entry.serial), "%s", serial.c_str());
+   entry.profile = transferProfile;
+   entries.push_back(entry);
+
+   std::string filename = getProfileFilename();
+   FILE *fp = fopen(filename.c_str(), "w");
+   if (fp == nullptr) {
+      throw MyException("Failed to write '%s'", filename.c_str());
+   }
+   fprintf(fp, "# serial latency_ms in_size out_size block_size\n");
+   for (const ProfileEntry &e:entries) {
+      fprintf(fp, "%s %u %u %u %u\n", e.serial,
+            e.profile.latencyTimer_ms, e.profile.inTransferSize, e.profile.outTransferSize, e.profile.blockSize);
+   }
+   fclose(fp);
+}
@@ -0,0 +1,110 @@
+//============================================================================
+// Name        : TransferStatistics.cpp
+// Author      : pgo
+// Latency and throughput statistics for the FT2232 transport
+//============================================================================
+#include <stdio.h>
+
+#include "TransferStatistics.h"
+
+const char *TransferStatistics::getName(Activity activity) {
+   static const char *const names[NUM_ACTIVITIES] = {
+         "Transmit",
+         "Receive",
+         "WaitForData",
+         "WriteLuts",
+         "WriteControl",
+         "WritePreTrigger",
+         "WriteCaptureLength",
+         "ReadStatus",
+         "ReadVersion",
+         "ReadConfig",
+         "StartCapture",
+         "WaitForCapture",
+         "ReadCaptureData",
+         "ReadFill",
+         "StreamCapture",
+         "WriteMode",
+         "WriteChannels",
+         "WriteReadOffset",
+         "ReadSnapshot",
+   };
+   unsigned index = static_cast<unsigned>(activity);
+   if (index >= NUM_ACTIVITIES) {
+      return "Unknown";
+   }
+   return names[index];
+}
+
+#if FT2232_STATISTICS
+
+uint64_t LatencyHistogram::getPercentile_us(double fraction) const {
+   uint64_t total = 0;
+   for (unsigned bucket=0; bucket<NUM_BUCKETS; bucket++) {
+      total += getCount(bucket);
+   }
+   if (total == 0) {
+      return 0;
+   }
+   uint64_t target = (uint64_t)(fraction*total);
+   uint64_t sum    = 0;
+   for (unsigned bucket=0; bucket<NUM_BUCKETS; bucket++) {
+      sum += getCount(bucket);
+      if (sum > target) {
+         return getLimit_us(bucket);
+      }
+   }
+   return getLimit_us(NUM_BUCKETS-1);
+}
+
+void TransferStatistics::reset() {
+   for (ActivityCounters &c:counters) {
+      c.calls.store(0, std::memory_order_relaxed);
+      c.bytes.store(0, std::memory_order_relaxed);
+      c.partialReads.store(0, std::memory_order_relaxed);
+      c.timeouts.store(0, std::memory_order_relaxed);
+      c.totalTime_ns.store(0, std::memory_order_relaxed);
+      c.maxTime_ns.store(0, std::memory_order_relaxed);
+      c.histogram.reset();
+   }
+}
+
+void TransferStatistics::report(FILE *fp, bool showHistograms) const {
+   fprintf(fp, "%-20s %8s %12s %10s %10s %10s %8s %8s %8s\n",
+         "Activity", "Calls", "Bytes", "Avg(us)", "Max(us)", "p99(<us)", "MB/s", "Partial", "Timeout");
+   for (unsigned index=0; index<NUM_ACTIVITIES; index++) {
+      const Activity          activity = static_cast<Activity>(index);
+      const ActivityCounters &c        = get(activity);
+
+      uint64_t calls = c.calls.load(std::memory_order_relaxed);
+      if (calls == 0) {
+         continue;
+      }
+      uint64_t bytes        = c.bytes.load(std::memory_order_relaxed);
+      uint64_t totalTime_ns = c.totalTime_ns.load(std::memory_order_relaxed);
+      double   throughput   = (totalTime_ns == 0)?0:(1000.0*bytes)/totalTime_ns;
+
+      fprintf(fp, "%-20s %8llu %12llu %10.1f %10.1f %10llu %8.2f %8llu %8llu\n",
+            getName(activity),
+            (unsigned long long)calls,
+            (unsigned long long)bytes,
+            totalTime_ns/(1000.0*calls),
+            c.maxTime_ns.load(std::memory_order_relaxed)/1000.0,
+            (unsigned long long)c.histogram.getPercentile_us(0.99),
+            throughput,
+            (unsigned long long)c.partialReads.load(std::memory_order_relaxed),
+            (unsigned long long)c.timeouts.load(std::memory_order_relaxed));
+
+      if (showHistograms) {
+         for (unsigned bucket=0; bucket<LatencyHistogram::NUM_BUCKETS; bucket++) {
+            uint64_t count = c.histogram.getCount(bucket);
+            if (count != 0) {
+               fprintf(fp, "   < %8llu us : %llu\n",
+                     (unsigned long long)LatencyHistogram::getLimit_us(bucket), (unsigned long long)count);
+            }
+         }
+      }
+   }
+}
+
+#endif
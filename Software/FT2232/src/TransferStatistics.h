@@ -0,0 +1,318 @@
+/*
+ * TransferStatistics.h
+ *
+ *  Created on: 9 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_TRANSFERSTATISTICS_H_
+#define SOURCES_TRANSFERSTATISTICS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Set to 1 to collect transfer statistics.
+ * When 0 the instrumentation compiles to nothing.
+ */
+#ifndef FT2232_STATISTICS
+#define FT2232_STATISTICS 0
+#endif
+
+#if FT2232_STATISTICS
+#include <atomic>
+#include <chrono>
+#endif
+
+/**
+ * Activities for which statistics are collected
+ */
+enum class Activity {
+   Transmit,            //!< FT2232::transmitData()
+   Receive,             //!< FT2232::receiveData()
+   WaitForData,         //!< FT2232::waitForData()
+   WriteLuts,           //!< Load trigger LUTs
+   WriteControl,        //!< C_WR_CONTROL
+   WritePreTrigger,     //!< C_WR_PRETRIG
+   WriteCaptureLength,  //!< C_WR_CAPTURE
+   ReadStatus,          //!< C_RD_STATUS
+   ReadVersion,         //!< C_RD_VERSION
+   ReadConfig,          //!< C_RD_CONFIG
+   StartCapture,        //!< Configure and start capture
+   WaitForCapture,      //!< Wait for capture completion
+   ReadCaptureData,     //!< Readback of capture (C_RD_BUFFER)
+   ReadFill,            //!< C_RD_FILL
+   StreamCapture,       //!< Streaming readback (C_RD_BUFFER)
+   WriteMode,           //!< C_WR_MODE
+   WriteChannels,       //!< C_WR_CHANNELS
+   WriteReadOffset,     //!< C_WR_READ_OFFSET
+   ReadSnapshot,        //!< C_RD_SNAPSHOT
+};
+
+/// Number of Activity values
+static constexpr unsigned NUM_ACTIVITIES = static_cast<unsigned>(Activity::ReadSnapshot)+1;
+
+#if FT2232_STATISTICS
+
+/**
+ * Histogram of durations with power-of-2 microsecond buckets
+ *
+ * Bucket 0 holds durations < 1 us.
+ * Bucket n holds durations in [2^(n-1), 2^n) us.
+ * The last bucket also holds all longer durations.
+ */
+class LatencyHistogram {
+public:
+   static constexpr unsigned NUM_BUCKETS = 24;
+
+private:
+   std::atomic<uint64_t> buckets[NUM_BUCKETS] = {};
+
+public:
+   /**
+    * Add a duration
+    *
+    * @param duration_ns Duration in ns
+    */
+   void record(uint64_t duration_ns) {
+      uint64_t duration_us = duration_ns/1000;
+      unsigned bucket = 0;
+      while ((duration_us != 0) && (bucket < NUM_BUCKETS-1)) {
+         duration_us >>= 1;
+         bucket++;
+      }
+      buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+   }
+
+   /**
+    * Get number of durations in bucket
+    *
+    * @param bucket Bucket index
+    *
+    * @return Count
+    */
+   uint64_t getCount(unsigned bucket) const {
+      return buckets[bucket].load(std::memory_order_relaxed);
+   }
+
+   /**
+    * Get upper limit of bucket
+    *
+    * @param bucket Bucket index
+    *
+    * @return Limit in us (exclusive)
+    */
+   static uint64_t getLimit_us(unsigned bucket) {
+      return 1ULL<<bucket;
+   }
+
+   /**
+    * Estimate a percentile from the histogram
+    *
+    * @param fraction Fraction of durations (e.g. 0.99)
+    *
+    * @return Upper limit of bucket containing the percentile in us (0 if empty)
+    */
+   uint64_t getPercentile_us(double fraction) const;
+
+   void reset() {
+      for (auto &bucket:buckets) {
+         bucket.store(0, std::memory_order_relaxed);
+      }
+   }
+};
+
+/**
+ * Counters for one activity
+ */
+struct ActivityCounters {
+   std::atomic<uint64_t> calls{0};         //!< Number of calls
+   std::atomic<uint64_t> bytes{0};         //!< Bytes transferred
+   std::atomic<uint64_t> partialReads{0};  //!< Driver reads returning less than requested
+   std::atomic<uint64_t> timeouts{0};      //!< Calls that timed out
+   std::atomic<uint64_t> totalTime_ns{0};  //!< Total duration of calls
+   std::atomic<uint64_t> maxTime_ns{0};    //!< Longest call
+   LatencyHistogram      histogram;        //!< Distribution of call durations
+};
+
+/**
+ * Transfer statistics for a FT2232 transport
+ *
+ * Counters are updated with relaxed atomics so may be recorded from
+ * several threads (e.g. readback thread) and read while running.
+ */
+class TransferStatistics {
+public:
+   /// Statistics are being collected
+   static constexpr bool enabled = true;
+
+private:
+   ActivityCounters counters[NUM_ACTIVITIES];
+
+   ActivityCounters &operator[](Activity activity) {
+      return counters[static_cast<unsigned>(activity)];
+   }
+
+public:
+   /**
+    * Record a completed call
+    *
+    * @param activity     Activity
+    * @param bytes        Bytes transferred
+    * @param duration_ns  Duration of call in ns
+    */
+   void record(Activity activity, uint64_t bytes, uint64_t duration_ns) {
+      ActivityCounters &c = (*this)[activity];
+      c.calls.fetch_add(1, std::memory_order_relaxed);
+      c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+      c.totalTime_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+      uint64_t max = c.maxTime_ns.load(std::memory_order_relaxed);
+      while ((duration_ns > max) &&
+             !c.maxTime_ns.compare_exchange_weak(max, duration_ns, std::memory_order_relaxed)) {
+      }
+      c.histogram.record(duration_ns);
+   }
+
+   /**
+    * Record a driver read that returned less data than requested
+    *
+    * @param activity Activity
+    */
+   void countPartialRead(Activity activity = Activity::Receive) {
+      (*this)[activity].partialReads.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   /**
+    * Record a timeout
+    *
+    * @param activity Activity
+    */
+   void countTimeout(Activity activity) {
+      (*this)[activity].timeouts.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   /**
+    * Get counters for an activity
+    *
+    * @param activity Activity
+    *
+    * @return Counters
+    */
+   const ActivityCounters &get(Activity activity) const {
+      return counters[static_cast<unsigned>(activity)];
+   }
+
+   /**
+    * Clear all counters
+    */
+   void reset();
+
+   /**
+    * Print summary of statistics
+    *
+    * @param fp               Where to print
+    * @param showHistograms   Include latency histograms
+    */
+   void report(FILE *fp = stdout, bool showHistograms = false) const;
+
+   /**
+    * Get name of activity
+    *
+    * @param activity Activity
+    *
+    * @return Name
+    */
+   static const char *getName(Activity activity);
+};
+
+/**
+ * Times an activity from construction to destruction
+ */
+class ActivityTimer {
+private:
+   using Clock = std::chrono::steady_clock;
+
+   TransferStatistics &statistics;
+   const Activity      activity;
+   uint64_t            bytes;
+   const Clock::time_point start;
+
+public:
+   /**
+    * Start timing
+    *
+    * @param statistics  Where to record
+    * @param activity    Activity being timed
+    * @param bytes       Bytes transferred (may be added later)
+    */
+   ActivityTimer(TransferStatistics &statistics, Activity activity, uint64_t bytes = 0) :
+      statistics(statistics), activity(activity), bytes(bytes), start(Clock::now()) {
+   }
+
+   /**
+    * Record duration
+    */
+   ~ActivityTimer() {
+      statistics.record(activity, bytes, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now()-start).count());
+   }
+
+   /**
+    * Add to bytes transferred
+    *
+    * @param count Number of bytes
+    */
+   void addBytes(uint64_t count) {
+      bytes += count;
+   }
+
+   /**
+    * Record a timeout
+    */
+   void timeout() {
+      statistics.countTimeout(activity);
+   }
+
+   ActivityTimer(const ActivityTimer &) = delete;
+   ActivityTimer &operator=(const ActivityTimer &) = delete;
+};
+
+#else
+
+/**
+ * Transfer statistics (disabled - build with FT2232_STATISTICS=1)
+ */
+class TransferStatistics {
+public:
+   /// Statistics are being collected
+   static constexpr bool enabled = false;
+
+   void record(Activity, uint64_t, uint64_t) {
+   }
+   void countPartialRead(Activity = Activity::Receive) {
+   }
+   void countTimeout(Activity) {
+   }
+   void reset() {
+   }
+   void report(FILE *fp = stdout, bool = false) const {
+      fprintf(fp, "Transfer statistics not available (build with FT2232_STATISTICS=1)\n");
+   }
+   static const char *getName(Activity activity);
+};
+
+/**
+ * Times an activity (disabled)
+ */
+class ActivityTimer {
+public:
+   ActivityTimer(TransferStatistics &, Activity, uint64_t = 0) {
+   }
+   void addBytes(uint64_t) {
+   }
+   void timeout() {
+   }
+};
+
+#endif
+
+#endif /* SOURCES_TRANSFERSTATISTICS_H_ */
@@ -0,0 +1,344 @@
+/*
+ * TriggerBatch.h
+ *
+ *  Created on: 27 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_TRIGGERBATCH_H_
+#define SOURCES_TRIGGERBATCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "MyException.h"
+#include "TriggerEncoding.h"
+
+namespace Analyser {
+
+/**
+ * Outcome of one candidate in a TriggerBatch
+ */
+struct TriggerBatchResult {
+   bool     found;   //!< Trigger sequence completed
+   long     index;   //!< Index of the sample completing the sequence or -1 if not found
+   unsigned step;    //!< Step reached (the last step if found)
+};
+
+/**
+ * Evaluates up to 64 trigger setups over the same samples in one pass.
+ *
+ * The candidates are bitsliced i.e. each 64-bit word holds one bit for every candidate.
+ * For each sample:
+ *  - The index of each pin pair into TriggerStep::lutEncoding[] is formed once.
+ *    For each step in use, each pattern is the AND of a word per pair selected by that index.
+ *  - The combiner LUT is applied as an OR of minterms of the patterns.
+ *  - Match counters are 16 bit-planes incremented and compared with ripple logic.
+ * Step changes are rare so the per-step masks are only rebuilt when a candidate advances.
+ *
+ * The result for each candidate is the same as findTrigger(setup, ...) in TriggerCompiler.h
+ * and TriggerModel::findTrigger() i.e. the first sample is treated as its own previous value.
+ *
+ * @tparam Encoding TriggerEncoding of the hardware
+ */
+template<typename Encoding>
+class TriggerBatch {
+
+public:
+   using Sample       = typename Encoding::Sample;
+   using TriggerSetup = typename Encoding::TriggerSetup;
+
+   /// Maximum number of candidates evaluated together
+   static constexpr unsigned MAX_CANDIDATES = 64;
+
+private:
+   using TriggerStep = typename Encoding::TriggerStep;
+
+   static constexpr unsigned STEPS      = Encoding::MAX_TRIGGER_STEPS;
+   static constexpr unsigned PATTERNS   = Encoding::MAX_TRIGGER_PATTERNS;
+   static constexpr unsigned PIN_PAIRS  = Encoding::SAMPLE_WIDTH/2;
+   static constexpr unsigned COMBINERS  = 1U<<PATTERNS;
+   static constexpr unsigned COUNT_BITS = 16;
+
+   static_assert((Encoding::SAMPLE_WIDTH%2) == 0, "Pattern LUTs use pairs of pins");
+   static_assert(Encoding::SAMPLE_WIDTH <= 32,    "Pin pair indices are formed from 32-bit samples (spreadBits())");
+
+   /// Pair LUT words for a pattern of a step where some candidate does not accept every value
+   struct PairTerm {
+      unsigned pair;
+      uint64_t lanes[16];  //!< Candidates accepting each lutEncoding[] index
+   };
+
+   /// Bitsliced configuration of a step
+   struct StepLanes {
+      std::vector<PairTerm> terms[PATTERNS];
+      uint64_t combiner[COMBINERS];   //!< Candidates accepting each combination of patterns
+      uint64_t target[COUNT_BITS];    //!< Matches before the count matches (count-1)
+      uint64_t contiguous;
+      uint64_t last;
+   };
+
+   std::vector<TriggerSetup> candidates;
+   StepLanes                 steps[STEPS];
+
+   /**
+    * Build bitsliced configuration of the candidates
+    */
+   void buildLanes() {
+      for (unsigned stepNum=0; stepNum<STEPS; stepNum++) {
+         StepLanes &lanes = steps[stepNum];
+         lanes = StepLanes{};
+         for (unsigned patternNum=0; patternNum<PATTERNS; patternNum++) {
+            for (unsigned pair=0; pair<PIN_PAIRS; pair++) {
+               PairTerm term{pair, {}};
+               bool     used = false;
+               for (unsigned lane=0; lane<candidates.size(); lane++) {
+                  const auto     pattern = candidates[lane].getTrigger(stepNum).getPattern(patternNum);
+                  const uint16_t table   = TriggerStep::getPatternMatchHalfLutValues(pattern[2*pair+1], pattern[2*pair]);
+                  for (unsigned index=0; index<16; index++) {
+                     term.lanes[index] |= (uint64_t)((table>>index)&1)<<lane;
+                  }
+                  used = used || (table != 0xFFFF);
+               }
+               if (used) {
+                  lanes.terms[patternNum].push_back(term);
+               }
+            }
+         }
+         for (unsigned lane=0; lane<candidates.size(); lane++) {
+            const TriggerSetup &setup = candidates[lane];
+            const TriggerStep   step  = setup.getTrigger(stepNum);
+
+            uint32_t combiner[Encoding::LUTS_PER_TRIGGER_STEP_FOR_COMBINERS];
+            step.getTriggerStepCombinerLutValues(combiner);
+            for (unsigned index=0; index<COMBINERS; index++) {
+               lanes.combiner[index] |= (uint64_t)((combiner[0]>>index)&1)<<lane;
+            }
+            // A count of 0 is encoded the same as 1
+            unsigned target = std::max(1U, step.getCount())-1;
+            for (unsigned bit=0; bit<COUNT_BITS; bit++) {
+               lanes.target[bit] |= (uint64_t)((target>>bit)&1)<<lane;
+            }
+            lanes.contiguous |= (uint64_t)step.isContiguous()<<lane;
+            lanes.last       |= (uint64_t)(stepNum == setup.getLastActiveTriggerCount())<<lane;
+         }
+      }
+   }
+
+   /**
+    * Spread bits to even bit positions
+    *
+    * @param value Value to spread
+    *
+    * @return Bit n of value is in bit 2n
+    */
+   static uint64_t spreadBits(uint32_t value) {
+      uint64_t bits = value;
+      bits = (bits|(bits<<16)) & 0x0000FFFF0000FFFFULL;
+      bits = (bits|(bits<<8))  & 0x00FF00FF00FF00FFULL;
+      bits = (bits|(bits<<4))  & 0x0F0F0F0F0F0F0F0FULL;
+      bits = (bits|(bits<<2))  & 0x3333333333333333ULL;
+      bits = (bits|(bits<<1))  & 0x5555555555555555ULL;
+      return bits;
+   }
+
+   /**
+    * Apply the combiner LUT of each candidate as a tree of multiplexers
+    *
+    * @param table    Candidates accepting each combination of patterns
+    * @param patterns Pattern matches of each candidate
+    *
+    * @return Step match of each candidate
+    */
+   static uint64_t combine(const uint64_t table[COMBINERS], const uint64_t patterns[PATTERNS]) {
+      uint64_t level[COMBINERS];
+      for (unsigned index=0; index<COMBINERS; index++) {
+         level[index] = table[index];
+      }
+      for (unsigned patternNum=0; patternNum<PATTERNS; patternNum++) {
+         for (unsigned index=0; index<(COMBINERS>>(patternNum+1)); index++) {
+            level[index] = level[2*index] ^ (patterns[patternNum] & (level[2*index]^level[2*index+1]));
+         }
+      }
+      return level[0];
+   }
+
+public:
+   TriggerBatch() {
+   }
+
+   /**
+    * Add a candidate
+    *
+    * @param setup Trigger setup
+    *
+    * @return Index of candidate in results
+    *
+    * @throw MyException if there are already MAX_CANDIDATES
+    */
+   unsigned add(const TriggerSetup &setup) {
+      if (candidates.size() >= MAX_CANDIDATES) {
+         fprintf(stderr, "TriggerBatch::add() - more than %u candidates\n", MAX_CANDIDATES);
+         throw MyException("TriggerBatch::add() - more than %u candidates", MAX_CANDIDATES);
+      }
+      candidates.push_back(setup);
+      return (unsigned)candidates.size()-1;
+   }
+
+   /**
+    * Get number of candidates
+    */
+   unsigned size() const {
+      return (unsigned)candidates.size();
+   }
+
+   /**
+    * Remove all candidates
+    */
+   void clear() {
+      candidates.clear();
+   }
+
+   /**
+    * Evaluate all candidates over the samples
+    *
+    * @param samples  Samples to search
+    * @param count    Number of samples
+    *
+    * @return Result for each candidate (in the order added)
+    */
+   std::vector<TriggerBatchResult> evaluate(const Sample samples[], size_t count) {
+      buildLanes();
+
+      std::vector<TriggerBatchResult> results(candidates.size(), TriggerBatchResult{false, -1, 0});
+
+      const uint64_t all = (candidates.size() == 64)?~0ULL:((1ULL<<candidates.size())-1);
+
+      // Candidates in each step, one-hot across steps
+      uint64_t inStep[STEPS] = {all};
+      uint64_t running       = all;
+
+      // Per candidate values for the current step of each candidate
+      uint64_t target[COUNT_BITS];
+      uint64_t contiguous = 0;
+      uint64_t last       = 0;
+      uint64_t counter[COUNT_BITS] = {};
+
+      // Steps with running candidates
+      unsigned activeSteps[STEPS];
+      unsigned activeCount = 0;
+
+      auto selectSteps = [&]() {
+         activeCount = 0;
+         contiguous  = 0;
+         last        = 0;
+         for (unsigned bit=0; bit<COUNT_BITS; bit++) {
+            target[bit] = 0;
+         }
+         for (unsigned stepNum=0; stepNum<STEPS; stepNum++) {
+            const uint64_t lanes = inStep[stepNum]&running;
+            if (lanes == 0) {
+               continue;
+            }
+            activeSteps[activeCount++] = stepNum;
+            contiguous |= lanes & steps[stepNum].contiguous;
+            last       |= lanes & steps[stepNum].last;
+            for (unsigned bit=0; bit<COUNT_BITS; bit++) {
+               target[bit] |= lanes & steps[stepNum].target[bit];
+            }
+         }
+      };
+      selectSteps();
+
+      Sample previous = (count>0)?samples[0]:0;
+      for (size_t sampleNum=0; (sampleNum<count) && (running != 0); sampleNum++) {
+         const Sample current = samples[sampleNum];
+
+         // lutEncoding[] index of pin pair n is in bits [4n+3:4n]
+         const uint64_t pairIndex = spreadBits(current)|(spreadBits(previous)<<1);
+         previous = current;
+
+         // Pattern match and combiner for the current step of each candidate
+         uint64_t match = 0;
+         for (unsigned active=0; active<activeCount; active++) {
+            const StepLanes &lanes = steps[activeSteps[active]];
+            uint64_t patterns[PATTERNS];
+            for (unsigned patternNum=0; patternNum<PATTERNS; patternNum++) {
+               uint64_t value = ~0ULL;
+               for (const PairTerm &term:lanes.terms[patternNum]) {
+                  value &= term.lanes[(pairIndex>>(4*term.pair))&0xF];
+               }
+               patterns[patternNum] = value;
+            }
+            match |= combine(lanes.combiner, patterns) & inStep[activeSteps[active]];
+         }
+         match &= running;
+
+         if (match == 0) {
+            // Break in contiguous count
+            if (contiguous != 0) {
+               for (unsigned bit=0; bit<COUNT_BITS; bit++) {
+                  counter[bit] &= ~contiguous;
+               }
+            }
+            continue;
+         }
+
+         // Count compare is made before the counter advances
+         uint64_t countMatch = ~0ULL;
+         for (unsigned bit=0; bit<COUNT_BITS; bit++) {
+            countMatch &= ~(counter[bit]^target[bit]);
+         }
+         const uint64_t complete = match & countMatch;
+
+         // Advance counters of other matches
+         uint64_t carry = match & ~complete;
+         for (unsigned bit=0; (bit<COUNT_BITS) && (carry != 0); bit++) {
+            uint64_t next = counter[bit] & carry;
+            counter[bit] ^= carry;
+            carry = next;
+         }
+         // Reset counters on a break in a contiguous count or a completed step
+         const uint64_t reset = (~match & contiguous) | complete;
+         if (reset != 0) {
+            for (unsigned bit=0; bit<COUNT_BITS; bit++) {
+               counter[bit] &= ~reset;
+            }
+         }
+         if (complete == 0) {
+            continue;
+         }
+         const uint64_t found = complete & last;
+         for (uint64_t lanes=found; lanes!=0; lanes&=lanes-1) {
+            unsigned lane = __builtin_ctzll(lanes);
+            results[lane].found = true;
+            results[lane].index = (long)sampleNum;
+         }
+         running &= ~found;
+
+         // Move candidates to the next step (step counter is 4 bits)
+         const uint64_t advance = complete & ~last;
+         if (advance != 0) {
+            const uint64_t wrapped = inStep[STEPS-1] & advance;
+            for (unsigned stepNum=STEPS-1; stepNum>0; stepNum--) {
+               inStep[stepNum] = (inStep[stepNum] & ~advance) | (inStep[stepNum-1] & advance);
+            }
+            inStep[0] = (inStep[0] & ~advance) | wrapped;
+         }
+         selectSteps();
+      }
+      for (unsigned stepNum=0; stepNum<STEPS; stepNum++) {
+         for (uint64_t lanes=inStep[stepNum]; lanes!=0; lanes&=lanes-1) {
+            results[__builtin_ctzll(lanes)].step = stepNum;
+         }
+      }
+      return results;
+   }
+};
+
+}  // end namespace Analyser
+
+#endif /* SOURCES_TRIGGERBATCH_H_ */
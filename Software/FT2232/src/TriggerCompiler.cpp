@@ -0,0 +1,987 @@
+//============================================================================
+// Name        : TriggerCompiler.cpp
+// Author      : pgo
+// Trigger expression parser, reference evaluator and compiler
+//============================================================================
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+#include <optional>
+
+#include "MyException.h"
+#include "TriggerCompiler.h"
+
+using namespace Analyser;
+
+/// Largest count for a single trigger step (period of the Lfsr16 match counters)
+static constexpr unsigned MAX_STEP_COUNT = 65535;
+
+/// Largest count accepted in an expression
+static constexpr unsigned long MAX_STAGE_COUNT = 0xFFFFFF;
+
+/// Limit on the terms created when distributing && over || (or the reverse)
+static constexpr unsigned MAX_DISTRIBUTED_TERMS = 256;
+
+/**
+ * Get truth table for a pin encoding.
+ * Bit (2*previous+current) is set when the pin values match (as the pattern matcher LUTs).
+ *
+ * @param encoding One of "XHLRFC01"
+ *
+ * @return 4-bit table
+ */
+static uint8_t pinTable(char encoding) {
+   switch(encoding) {
+      case 'H' :
+      case '1' : return 0b1010;
+      case 'L' :
+      case '0' : return 0b0101;
+      case 'R' : return 0b0010;
+      case 'F' : return 0b0100;
+      case 'C' : return 0b0110;
+      default  : return 0b1111;
+   }
+}
+
+/**
+ * Get pin encoding for a truth table
+ *
+ * @param table 4-bit table
+ *
+ * @return One of "XHLRFC" or '\0' if the table has no encoding
+ */
+static char pinEncoding(uint8_t table) {
+   switch(table) {
+      case 0b1111 : return 'X';
+      case 0b1010 : return 'H';
+      case 0b0101 : return 'L';
+      case 0b0010 : return 'R';
+      case 0b0100 : return 'F';
+      case 0b0110 : return 'C';
+   }
+   return '\0';
+}
+
+/**
+ * Check if a pattern matches a sample
+ *
+ * @param pattern   Pin encodings (MSB first)
+ * @param current   Current sample
+ * @param previous  Previous sample
+ */
+static bool patternMatches(const std::string &pattern, uint32_t current, uint32_t previous) {
+   const unsigned width = pattern.size();
+   for (unsigned bitNum=0; bitNum<width; bitNum++) {
+      unsigned pins = 2*((previous>>bitNum)&1)+((current>>bitNum)&1);
+      if (((pinTable(pattern[(width-1)-bitNum])>>pins)&1) == 0) {
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+ * Evaluate a condition on a sample
+ *
+ * @param node      Condition
+ * @param current   Current sample
+ * @param previous  Previous sample
+ */
+static bool evaluate(const TriggerExpression::Node &node, uint32_t current, uint32_t previous) {
+   using Node = TriggerExpression::Node;
+
+   switch(node.type) {
+      case Node::Pattern :
+         return patternMatches(node.pattern, current, previous);
+      case Node::Not :
+         return !evaluate(node.children[0], current, previous);
+      case Node::And :
+         for (const Node &child:node.children) {
+            if (!evaluate(child, current, previous)) {
+               return false;
+            }
+         }
+         return true;
+      case Node::Or :
+         for (const Node &child:node.children) {
+            if (evaluate(child, current, previous)) {
+               return true;
+            }
+         }
+         return false;
+   }
+   return false;
+}
+
+//=======================================================================
+// Parser
+//
+namespace {
+
+class Parser {
+
+   using Node  = TriggerExpression::Node;
+   using Stage = TriggerExpression::Stage;
+
+   const char *const text;
+   const char       *pos;
+   const unsigned    sampleWidth;
+
+   std::vector<std::string> &hints;
+
+   [[noreturn]] void error(const char *message) {
+      unsigned column = (pos-text)+1;
+      fprintf(stderr, "Trigger: %s at column %u\n   %s\n   %*s^\n", message, column, text, column-1, "");
+      throw MyException("Trigger: %s at column %u", message, column);
+   }
+
+   void skipSpace() {
+      while (isspace(*pos)) {
+         pos++;
+      }
+   }
+
+   /**
+    * Accept punctuation
+    */
+   bool accept(const char *symbol) {
+      skipSpace();
+      size_t length = strlen(symbol);
+      if (strncmp(pos, symbol, length) == 0) {
+         pos += length;
+         return true;
+      }
+      return false;
+   }
+
+   /**
+    * Accept keyword (not case sensitive)
+    */
+   bool acceptKeyword(const char *keyword) {
+      skipSpace();
+      size_t length = strlen(keyword);
+      if ((strncasecmp(pos, keyword, length) == 0) && !isalnum(pos[length]) && (pos[length] != '_')) {
+         pos += length;
+         return true;
+      }
+      return false;
+   }
+
+   /**
+    * Parse number (decimal, 0x.. or 0b..)
+    */
+   unsigned long parseNumber() {
+      skipSpace();
+      if (!isdigit(*pos)) {
+         error("Expected number");
+      }
+      char *end;
+      unsigned long value;
+      if ((pos[0] == '0') && (tolower(pos[1]) == 'b')) {
+         value = strtoul(pos+2, &end, 2);
+      }
+      else {
+         value = strtoul(pos, &end, 0);
+      }
+      if (isalnum(*end)) {
+         error("Illegal number");
+      }
+      pos = end;
+      return value;
+   }
+
+   /**
+    * Parse pin number after 'D'
+    */
+   unsigned parsePin() {
+      const char *start = pos;
+      if (!isdigit(*pos)) {
+         error("Expected pin number");
+      }
+      unsigned long pin = strtoul(pos, const_cast<char **>(&pos), 10);
+      if (pin >= sampleWidth) {
+         pos = start;
+         error("Pin number too large");
+      }
+      return pin;
+   }
+
+   Node makePattern(std::string &&pattern) {
+      hints.push_back(pattern);
+      return Node{Node::Pattern, std::move(pattern), {}};
+   }
+
+   /**
+    * pins [ state | '==' value | '!=' value ]
+    */
+   Node parsePins() {
+      skipSpace();
+      if (toupper(*pos) != 'D') {
+         error("Expected pin (D0..D31), '(', '!' or 'any'");
+      }
+      pos++;
+      unsigned low  = parsePin();
+      unsigned high = low;
+      if (accept("..")) {
+         skipSpace();
+         if (toupper(*pos) == 'D') {
+            pos++;
+         }
+         high = parsePin();
+      }
+      if (low > high) {
+         std::swap(low, high);
+      }
+      std::string pattern(sampleWidth, 'X');
+      auto setPin = [&](unsigned pin, char encoding) {
+         pattern[(sampleWidth-1)-pin] = encoding;
+      };
+
+      static const struct {
+         const char *name;
+         char        encoding;
+      } states[] = {
+            {"high", 'H'}, {"low", 'L'}, {"rising", 'R'}, {"falling", 'F'}, {"change", 'C'},
+            {"H",    'H'}, {"L",   'L'}, {"R",      'R'}, {"F",       'F'}, {"C",      'C'},
+      };
+      for (const auto &state:states) {
+         if (acceptKeyword(state.name)) {
+            for (unsigned pin=low; pin<=high; pin++) {
+               setPin(pin, state.encoding);
+            }
+            return makePattern(std::move(pattern));
+         }
+      }
+      bool notEqual = accept("!=");
+      if (!notEqual && !accept("==")) {
+         // Pin on its own
+         for (unsigned pin=low; pin<=high; pin++) {
+            setPin(pin, 'H');
+         }
+         return makePattern(std::move(pattern));
+      }
+      const unsigned width = high-low+1;
+      skipSpace();
+      if (*pos == '"') {
+         // Pattern string, MSB first
+         const char *start = ++pos;
+         while ((*pos != '"') && (*pos != '\0')) {
+            if (strchr("XHLRFC01", toupper(*pos)) == nullptr) {
+               error("Expected one of XHLRFC01 in pattern");
+            }
+            pos++;
+         }
+         if (*pos != '"') {
+            error("Expected '\"'");
+         }
+         if ((unsigned)(pos-start) != width) {
+            error("Pattern length does not match pins");
+         }
+         for (unsigned index=0; index<width; index++) {
+            setPin(high-index, pinEncoding(pinTable(toupper(start[index]))));
+         }
+         pos++;
+      }
+      else {
+         const char *start = pos;
+         unsigned long value = parseNumber();
+         if ((width < 8*sizeof(value)) && ((value>>width) != 0)) {
+            pos = start;
+            error("Value too large for pins");
+         }
+         for (unsigned pin=low; pin<=high; pin++) {
+            setPin(pin, ((value>>(pin-low))&1)?'H':'L');
+         }
+      }
+      Node node = makePattern(std::move(pattern));
+      if (notEqual) {
+         return Node{Node::Not, "", {std::move(node)}};
+      }
+      return node;
+   }
+
+   /**
+    * '!' unary | '(' condition ')' | 'any' | pins
+    */
+   Node parseUnary() {
+      if (accept("!")) {
+         return Node{Node::Not, "", {parseUnary()}};
+      }
+      if (accept("(")) {
+         Node node = parseCondition();
+         if (!accept(")")) {
+            error("Expected ')'");
+         }
+         return node;
+      }
+      if (acceptKeyword("any")) {
+         return makePattern(std::string(sampleWidth, 'X'));
+      }
+      return parsePins();
+   }
+
+   /**
+    * unary { '&&' unary }
+    */
+   Node parseAnd() {
+      Node node = parseUnary();
+      if (!accept("&&")) {
+         return node;
+      }
+      Node result{Node::And, "", {std::move(node)}};
+      do {
+         result.children.push_back(parseUnary());
+      } while (accept("&&"));
+      return result;
+   }
+
+   /**
+    * and { '||' and }
+    */
+   Node parseCondition() {
+      Node node = parseAnd();
+      if (!accept("||")) {
+         return node;
+      }
+      Node result{Node::Or, "", {std::move(node)}};
+      do {
+         result.children.push_back(parseAnd());
+      } while (accept("||"));
+      return result;
+   }
+
+   /**
+    * Accept repeat e.g. 'x 100' or 'x100'
+    */
+   bool acceptRepeat() {
+      skipSpace();
+      if ((tolower(pos[0]) == 'x') && (isspace(pos[1]) || isdigit(pos[1]))) {
+         pos++;
+         return true;
+      }
+      return false;
+   }
+
+   /**
+    * condition { 'x' count | 'contiguous' }
+    */
+   Stage parseStage() {
+      Stage stage{parseCondition(), 1, false};
+      for(;;) {
+         if (acceptRepeat()) {
+            const char *start = pos;
+            unsigned long count = parseNumber();
+            if ((count == 0) || (count > MAX_STAGE_COUNT)) {
+               pos = start;
+               error("Count out of range");
+            }
+            stage.count = count;
+         }
+         else if (acceptKeyword("contiguous")) {
+            stage.contiguous = true;
+         }
+         else {
+            return stage;
+         }
+      }
+   }
+
+public:
+   Parser(const char *text, unsigned sampleWidth, std::vector<std::string> &hints) :
+      text(text), pos(text), sampleWidth(sampleWidth), hints(hints) {
+   }
+
+   /**
+    * stage { 'then' stage }
+    */
+   std::vector<Stage> parse() {
+      std::vector<Stage> stages;
+      do {
+         stages.push_back(parseStage());
+      } while (acceptKeyword("then"));
+      skipSpace();
+      if (*pos != '\0') {
+         error("Unexpected text");
+      }
+      return stages;
+   }
+};
+
+}  // end anonymous namespace
+
+TriggerExpression::TriggerExpression(const char *text, unsigned sampleWidth) : sampleWidth(sampleWidth) {
+   assert(sampleWidth <= 32);
+   stages = Parser(text, sampleWidth, hints).parse();
+}
+
+long TriggerExpression::findTrigger(const uint32_t samples[], unsigned count) const {
+   unsigned stageNum = 0;
+   unsigned matches  = 0;
+   uint32_t previous = (count>0)?samples[0]:0;
+   for (unsigned index=0; index<count; index++) {
+      const Stage &stage = stages[stageNum];
+      bool match = evaluate(stage.condition, samples[index], previous);
+      previous = samples[index];
+      if (match) {
+         if (++matches >= stage.count) {
+            if (stageNum == stages.size()-1) {
+               return index;
+            }
+            stageNum++;
+            matches = 0;
+         }
+      }
+      else if (stage.contiguous) {
+         matches = 0;
+      }
+   }
+   return -1;
+}
+
+void TriggerExpression::makeTestSamples(std::vector<uint32_t> &samples, unsigned length, std::mt19937 &random) const {
+   unsigned maxRun = 1;
+   for (const Stage &stage:stages) {
+      if (stage.contiguous) {
+         maxRun = std::max(maxRun, stage.count);
+      }
+   }
+   maxRun = std::min(2*maxRun, 4096U);
+
+   const uint32_t mask = (sampleWidth<32)?((1U<<sampleWidth)-1):~0U;
+   samples.clear();
+   while (samples.size() < length) {
+      uint32_t sample = random()&mask;
+      if (!hints.empty() && ((random()%4) != 0)) {
+         // Set the current value of pins given by a pattern in the expression
+         const std::string &hint = hints[random()%hints.size()];
+         for (unsigned bitNum=0; bitNum<sampleWidth; bitNum++) {
+            uint8_t table = pinTable(hint[(sampleWidth-1)-bitNum]);
+            if ((table&0b1010) == 0) {
+               sample &= ~(1U<<bitNum);
+            }
+            else if ((table&0b0101) == 0) {
+               sample |= (1U<<bitNum);
+            }
+         }
+      }
+      unsigned run = ((random()%4) == 0)?1+(random()%maxRun):1+(random()%3);
+      samples.insert(samples.end(), std::min<unsigned>(run, length-samples.size()), sample);
+   }
+}
+
+//=======================================================================
+// Compiler
+//
+namespace {
+
+/**
+ * Folds conditions into the patterns of a single trigger step.
+ *
+ * A list of patterns is treated either as a conjunction (Operation::And)
+ * or a disjunction (Operation::Or) of its patterns.
+ * An always true pattern is all 'X' and an always false pattern is an inverted all 'X'.
+ */
+class Folder {
+
+   using Node     = TriggerExpression::Node;
+   using Patterns = std::vector<CompiledPattern>;
+   using Result   = std::optional<Patterns>;
+
+   const std::string dontCare;
+
+   CompiledPattern alwaysTrue() const {
+      return {dontCare, false};
+   }
+
+   CompiledPattern alwaysFalse() const {
+      return {dontCare, true};
+   }
+
+   /**
+    * Intersection of patterns
+    *
+    * @return false if the patterns can't both match
+    */
+   bool intersect(const std::string &a, const std::string &b, std::string &result) const {
+      result.resize(a.size());
+      for (unsigned index=0; index<a.size(); index++) {
+         uint8_t table = pinTable(a[index])&pinTable(b[index]);
+         if (table == 0) {
+            return false;
+         }
+         result[index] = pinEncoding(table);
+         assert(result[index] != '\0');
+      }
+      return true;
+   }
+
+   /**
+    * Check if pattern a matches whenever pattern b matches
+    */
+   bool contains(const std::string &a, const std::string &b) const {
+      for (unsigned index=0; index<a.size(); index++) {
+         if ((pinTable(b[index])&~pinTable(a[index])) != 0) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+   /**
+    * Check if patterns can't both match
+    */
+   bool disjoint(const std::string &a, const std::string &b) const {
+      std::string dummy;
+      return !intersect(a, b, dummy);
+   }
+
+   /**
+    * Union of patterns that differ in a single pin e.g. D0 rising || D0 falling => D0 change
+    *
+    * @return false if the union has no encoding
+    */
+   bool unite(const std::string &a, const std::string &b, std::string &result) const {
+      unsigned differences = 0;
+      result = a;
+      for (unsigned index=0; index<a.size(); index++) {
+         if (a[index] != b[index]) {
+            result[index] = pinEncoding(pinTable(a[index])|pinTable(b[index]));
+            if ((++differences > 1) || (result[index] == '\0')) {
+               return false;
+            }
+         }
+      }
+      return true;
+   }
+
+   /**
+    * Negate a pattern.
+    * An inverted single pin level becomes the opposite level e.g. !(D3 high) => D3 low
+    */
+   CompiledPattern negate(CompiledPattern item) const {
+      item.inverted = !item.inverted;
+      if (item.inverted) {
+         unsigned pins  = 0;
+         unsigned index = 0;
+         for (unsigned pinIndex=0; pinIndex<item.pattern.size(); pinIndex++) {
+            if (item.pattern[pinIndex] != 'X') {
+               pins++;
+               index = pinIndex;
+            }
+         }
+         if ((pins == 1) && ((item.pattern[index] == 'H') || (item.pattern[index] == 'L'))) {
+            item.pattern[index] = (item.pattern[index] == 'H')?'L':'H';
+            item.inverted       = false;
+         }
+      }
+      return item;
+   }
+
+   /**
+    * Negate each pattern in a list
+    */
+   Patterns negate(const Patterns &items) const {
+      Patterns result;
+      for (const CompiledPattern &item:items) {
+         result.push_back(negate(item));
+      }
+      return result;
+   }
+
+   /**
+    * Simplify conjunction of patterns.
+    * All normal patterns are merged into one.
+    * Inverted patterns implied by another pattern are removed.
+    */
+   Patterns simplifyAnd(const Patterns &items) const {
+      std::string positive = dontCare;
+      Patterns    inverted;
+      for (const CompiledPattern &item:items) {
+         if (!item.inverted) {
+            if (!intersect(positive, item.pattern, positive)) {
+               return {alwaysFalse()};
+            }
+         }
+         else if (item.pattern == dontCare) {
+            return {alwaysFalse()};
+         }
+         else {
+            inverted.push_back(item);
+         }
+      }
+      Patterns result;
+      if (positive != dontCare) {
+         result.push_back({positive, false});
+      }
+      for (unsigned index=0; index<inverted.size(); index++) {
+         const std::string &pattern = inverted[index].pattern;
+         if (disjoint(pattern, positive)) {
+            // Always true when positive matches
+            continue;
+         }
+         if (contains(pattern, positive)) {
+            // Never true when positive matches
+            return {alwaysFalse()};
+         }
+         bool redundant = false;
+         for (unsigned other=0; other<inverted.size(); other++) {
+            // !(wider pattern) implies !pattern
+            if ((other != index) && contains(inverted[other].pattern, pattern) &&
+                ((inverted[other].pattern != pattern) || (other < index))) {
+               redundant = true;
+               break;
+            }
+         }
+         if (!redundant) {
+            result.push_back(inverted[index]);
+         }
+      }
+      if (result.empty()) {
+         return {alwaysTrue()};
+      }
+      std::sort(result.begin(), result.end());
+      return result;
+   }
+
+   /**
+    * Simplify disjunction of patterns.
+    * All inverted patterns are merged into one.
+    * Normal patterns implied by another pattern are removed and
+    * patterns differing in one pin are merged where possible.
+    */
+   Patterns simplifyOr(const Patterns &items) const {
+      std::string negative = dontCare;
+      bool        anyNegative = false;
+      Patterns    positives;
+      for (const CompiledPattern &item:items) {
+         if (item.inverted) {
+            if (item.pattern == dontCare) {
+               // Always false
+               continue;
+            }
+            // !a || !b = !(a && b)
+            if (!intersect(negative, item.pattern, negative)) {
+               return {alwaysTrue()};
+            }
+            anyNegative = true;
+         }
+         else if (item.pattern == dontCare) {
+            return {alwaysTrue()};
+         }
+         else {
+            positives.push_back(item);
+         }
+      }
+      if (anyNegative) {
+         CompiledPattern item = negate(CompiledPattern{negative, false});
+         if (!item.inverted) {
+            positives.push_back(item);
+            anyNegative = false;
+         }
+      }
+      // Remove patterns implied by others and merge neighbours
+      bool changed;
+      do {
+         changed = false;
+         for (unsigned a=0; (a<positives.size()) && !changed; a++) {
+            for (unsigned b=0; (b<positives.size()) && !changed; b++) {
+               if (a == b) {
+                  continue;
+               }
+               std::string merged;
+               if (contains(positives[a].pattern, positives[b].pattern)) {
+                  positives.erase(positives.begin()+b);
+                  changed = true;
+               }
+               else if (unite(positives[a].pattern, positives[b].pattern, merged)) {
+                  positives[a].pattern = merged;
+                  positives.erase(positives.begin()+b);
+                  changed = true;
+               }
+            }
+         }
+      } while (changed);
+
+      Patterns result;
+      for (const CompiledPattern &item:positives) {
+         if (item.pattern == dontCare) {
+            return {alwaysTrue()};
+         }
+         if (anyNegative) {
+            if (contains(item.pattern, negative)) {
+               // !negative || item is always true
+               return {alwaysTrue()};
+            }
+            if (disjoint(item.pattern, negative)) {
+               // Implied by !negative
+               continue;
+            }
+         }
+         result.push_back(item);
+      }
+      if (anyNegative) {
+         result.push_back({negative, true});
+      }
+      if (result.empty()) {
+         return {alwaysFalse()};
+      }
+      if (result.size() > 1) {
+         // Single pin levels may be combined with an inverted pattern e.g. D0 || D1 => !(D0 low && D1 low)
+         std::string combined = dontCare;
+         bool        possible = true;
+         for (const CompiledPattern &item:result) {
+            CompiledPattern inverse = negate(item);
+            if (inverse.inverted) {
+               possible = false;
+               break;
+            }
+            if (!intersect(combined, inverse.pattern, combined)) {
+               return {alwaysTrue()};
+            }
+         }
+         if (possible) {
+            return {{combined, true}};
+         }
+      }
+      std::sort(result.begin(), result.end());
+      return result;
+   }
+
+   /**
+    * Distribute an operation over the children of a node
+    * e.g. (a || b) && c => (a && c) || (b && c)
+    *
+    * @param children  Operands, each as patterns combined by the other operation
+    * @param combine   Simplifies each combination (simplifyAnd or simplifyOr)
+    *
+    * @return Combinations, each reduced to a single pattern, or nothing if not possible
+    */
+   template<typename Combine>
+   Result distribute(const std::vector<Patterns> &children, Combine combine) const {
+      std::vector<Patterns> terms{{}};
+      for (const Patterns &child:children) {
+         std::vector<Patterns> next;
+         for (const Patterns &term:terms) {
+            for (const CompiledPattern &item:child) {
+               next.push_back(term);
+               next.back().push_back(item);
+            }
+         }
+         if (next.size() > MAX_DISTRIBUTED_TERMS) {
+            return {};
+         }
+         terms = std::move(next);
+      }
+      Patterns result;
+      for (const Patterns &term:terms) {
+         Patterns combined = combine(term);
+         if (combined.size() != 1) {
+            return {};
+         }
+         result.push_back(combined[0]);
+      }
+      return result;
+   }
+
+public:
+   Folder(unsigned sampleWidth) : dontCare(sampleWidth, 'X') {
+   }
+
+   /**
+    * Express condition as a conjunction of patterns
+    *
+    * @return Patterns or nothing if not possible
+    */
+   Result fitAnd(const Node &node) const {
+      switch(node.type) {
+         case Node::Pattern :
+            return simplifyAnd({{node.pattern, false}});
+         case Node::Not : {
+            Result result = fitOr(node.children[0]);
+            if (!result) {
+               return {};
+            }
+            return simplifyAnd(negate(*result));
+         }
+         case Node::And : {
+            Patterns items;
+            for (const Node &child:node.children) {
+               Result result = fitAnd(child);
+               if (!result) {
+                  return {};
+               }
+               items.insert(items.end(), result->begin(), result->end());
+            }
+            return simplifyAnd(items);
+         }
+         case Node::Or : {
+            Result result = fitOr(node);
+            if (result && (result->size() == 1)) {
+               return result;
+            }
+            // (a && b) || c => (a || c) && (b || c)
+            std::vector<Patterns> children;
+            for (const Node &child:node.children) {
+               Result result = fitAnd(child);
+               if (!result) {
+                  return {};
+               }
+               children.push_back(*result);
+            }
+            result = distribute(children, [this](const Patterns &items){ return simplifyOr(items); });
+            if (!result) {
+               return {};
+            }
+            return simplifyAnd(*result);
+         }
+      }
+      return {};
+   }
+
+   /**
+    * Express condition as a disjunction of patterns
+    *
+    * @return Patterns or nothing if not possible
+    */
+   Result fitOr(const Node &node) const {
+      switch(node.type) {
+         case Node::Pattern :
+            return simplifyOr({{node.pattern, false}});
+         case Node::Not : {
+            Result result = fitAnd(node.children[0]);
+            if (!result) {
+               return {};
+            }
+            return simplifyOr(negate(*result));
+         }
+         case Node::Or : {
+            Patterns items;
+            for (const Node &child:node.children) {
+               Result result = fitOr(child);
+               if (!result) {
+                  return {};
+               }
+               items.insert(items.end(), result->begin(), result->end());
+            }
+            return simplifyOr(items);
+         }
+         case Node::And : {
+            Result result = fitAnd(node);
+            if (result && (result->size() == 1)) {
+               return result;
+            }
+            // (a || b) && c => (a && c) || (b && c)
+            std::vector<Patterns> children;
+            for (const Node &child:node.children) {
+               Result result = fitOr(child);
+               if (!result) {
+                  return {};
+               }
+               children.push_back(*result);
+            }
+            result = distribute(children, [this](const Patterns &items){ return simplifyAnd(items); });
+            if (!result) {
+               return {};
+            }
+            return simplifyOr(*result);
+         }
+      }
+      return {};
+   }
+
+   /**
+    * Fold condition into a single trigger step using the fewest patterns
+    *
+    * @param condition    Condition to fold
+    * @param maxPatterns  Number of patterns in each trigger step
+    * @param step         Step to set patterns and operation
+    *
+    * @return false if the condition needs more patterns
+    */
+   bool fold(const Node &condition, unsigned maxPatterns, CompiledStep &step) const {
+      Result andPatterns = fitAnd(condition);
+      Result orPatterns  = fitOr(condition);
+      if (andPatterns && (andPatterns->size() <= maxPatterns) &&
+            (!orPatterns || (andPatterns->size() <= orPatterns->size()))) {
+         step.patterns  = *andPatterns;
+         step.operation = Operation::And;
+         return true;
+      }
+      if (orPatterns && (orPatterns->size() <= maxPatterns)) {
+         step.patterns  = *orPatterns;
+         step.operation = Operation::Or;
+         return true;
+      }
+      return false;
+   }
+
+   /**
+    * Check if patterns can never match
+    */
+   bool isAlwaysFalse(const CompiledStep &step) const {
+      return (step.patterns.size() == 1) && (step.patterns[0] == alwaysFalse());
+   }
+};
+
+}  // end anonymous namespace
+
+std::vector<CompiledStep> TriggerExpression::compile(unsigned maxSteps, unsigned maxPatterns) const {
+   Folder folder(sampleWidth);
+
+   // Fold each stage into a step, merging equivalent neighbours
+   std::vector<CompiledStep> merged;
+   for (unsigned stageNum=0; stageNum<stages.size(); stageNum++) {
+      const Stage &stage = stages[stageNum];
+
+      CompiledStep step;
+      if (!folder.fold(stage.condition, maxPatterns, step)) {
+         fprintf(stderr, "Trigger: stage %u needs more than %u patterns\n", stageNum+1, maxPatterns);
+         throw MyException("Trigger: stage %u needs more than %u patterns", stageNum+1, maxPatterns);
+      }
+      if (folder.isAlwaysFalse(step)) {
+         fprintf(stderr, "Trigger: stage %u can never match\n", stageNum+1);
+         throw MyException("Trigger: stage %u can never match", stageNum+1);
+      }
+      // A single match is always contiguous
+      step.contiguous = stage.contiguous && (stage.count > 1);
+      step.count      = stage.count;
+
+      // Consecutive counts of the same condition add unless contiguous
+      if (!merged.empty() && !step.contiguous && !merged.back().contiguous &&
+            (merged.back().operation == step.operation) && (merged.back().patterns == step.patterns) &&
+            (merged.back().count <= maxSteps*MAX_STEP_COUNT)) {
+         merged.back().count += step.count;
+         continue;
+      }
+      merged.push_back(step);
+   }
+
+   // Split counts too large for the match counters
+   std::vector<CompiledStep> steps;
+   for (CompiledStep &step:merged) {
+      if (step.count > MAX_STEP_COUNT) {
+         if (step.contiguous) {
+            fprintf(stderr, "Trigger: contiguous count %u exceeds %u\n", step.count, MAX_STEP_COUNT);
+            throw MyException("Trigger: contiguous count %u exceeds %u", step.count, MAX_STEP_COUNT);
+         }
+         CompiledStep part = step;
+         part.count = MAX_STEP_COUNT;
+         while (step.count > MAX_STEP_COUNT) {
+            if (steps.size() >= maxSteps) {
+               break;
+            }
+            steps.push_back(part);
+            step.count -= MAX_STEP_COUNT;
+         }
+      }
+      steps.push_back(step);
+   }
+   if (steps.size() > maxSteps) {
+      fprintf(stderr, "Trigger: needs more than %u steps\n", maxSteps);
+      throw MyException("Trigger: needs more than %u steps", maxSteps);
+   }
+   return steps;
+}
@@ -0,0 +1,341 @@
+/*
+ * TriggerCompiler.h
+ *
+ *  Created on: 24 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_TRIGGERCOMPILER_H_
+#define SOURCES_TRIGGERCOMPILER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "MyException.h"
+#include "TriggerEncoding.h"
+
+namespace Analyser {
+
+/**
+ * Pattern matcher used by a compiled trigger step
+ */
+struct CompiledPattern {
+   std::string pattern;    //!< Pin encodings "XHLRFC", MSB first (as TriggerPattern)
+   bool        inverted;   //!< Pattern is used with Polarity::Inverted
+
+   bool operator==(const CompiledPattern &other) const {
+      return (inverted == other.inverted) && (pattern == other.pattern);
+   }
+   bool operator<(const CompiledPattern &other) const {
+      return (inverted != other.inverted)?!inverted:(pattern < other.pattern);
+   }
+};
+
+/**
+ * Trigger step produced by the trigger compiler
+ */
+struct CompiledStep {
+   std::vector<CompiledPattern> patterns;     //!< Patterns used (remaining patterns are disabled)
+   unsigned                     operation;    //!< Operation::And or Operation::Or
+   bool                         contiguous;   //!< Count requires contiguous matches
+   unsigned                     count;        //!< Number of matches [1..65535]
+};
+
+/**
+ * Trigger described in a small expression language e.g.
+ * @code
+ *    (D3 rising && D0..7 == 0x5A) x 100 then D4 low contiguous x 8
+ * @endcode
+ *
+ * Grammar (keywords are not case sensitive):
+ * @code
+ *    sequence  := stage { 'then' stage }
+ *    stage     := condition { 'x' count | 'contiguous' }
+ *    condition := and { '||' and }
+ *    and       := unary { '&&' unary }
+ *    unary     := '!' unary | '(' condition ')' | 'any' | pins [ state | '==' value | '!=' value ]
+ *    pins      := 'D'n | 'D'n'..'m
+ *    state     := 'high' | 'low' | 'rising' | 'falling' | 'change' | 'H' | 'L' | 'R' | 'F' | 'C'
+ *    value     := number (decimal, 0x.. or 0b..) | "pattern" ("XHLRFC" string, MSB first)
+ * @endcode
+ * A stage is satisfied after its condition has matched count times (default 1),
+ * on consecutive samples if contiguous.
+ * The next stage starts with the following sample.
+ * A pin range gives the LSB first i.e. D0..7 == 0x5A sets D1, D3, D4 and D6.
+ * A pin on its own is the same as 'high'.
+ */
+class TriggerExpression {
+
+public:
+   /// Node of a parsed condition
+   struct Node {
+      enum Type {Pattern, Not, And, Or};
+
+      Type              type;
+      std::string       pattern;    //!< Pin encodings for Pattern nodes (MSB first)
+      std::vector<Node> children;   //!< Operands of Not, And and Or nodes
+   };
+
+   /// Condition with a repeat count
+   struct Stage {
+      Node     condition;
+      unsigned count;
+      bool     contiguous;
+   };
+
+private:
+   /// Number of sample inputs
+   unsigned sampleWidth;
+
+   /// Stages of trigger sequence
+   std::vector<Stage> stages;
+
+   /// Patterns appearing in the expression (used to make test samples)
+   std::vector<std::string> hints;
+
+public:
+   /**
+    * Parse a trigger expression
+    *
+    * @param text         Expression
+    * @param sampleWidth  Number of sample inputs (<=32)
+    *
+    * @throw MyException on syntax error
+    */
+   TriggerExpression(const char *text, unsigned sampleWidth);
+
+   unsigned getSampleWidth() const {
+      return sampleWidth;
+   }
+
+   const std::vector<Stage> &getStages() const {
+      return stages;
+   }
+
+   /**
+    * Reference evaluator.
+    * Evaluates the expression directly on a sequence of samples.
+    * The first sample has no edges (it is treated as its own previous value).
+    *
+    * @param samples  Samples to search
+    * @param count    Number of samples
+    *
+    * @return Index of the sample completing the last stage or -1 if not found
+    */
+   long findTrigger(const uint32_t samples[], unsigned count) const;
+
+   /**
+    * Compile expression to trigger steps.
+    *
+    * Conditions are folded into the patterns of a single step
+    * using Polarity::Inverted/Disabled and Operation::And/Or.
+    * Adjacent equivalent steps are merged and counts above 65535
+    * are split across steps.
+    *
+    * @param maxSteps     Number of trigger steps available
+    * @param maxPatterns  Number of patterns in each trigger step
+    *
+    * @return Trigger steps
+    *
+    * @throw MyException if the trigger does not fit the hardware
+    */
+   std::vector<CompiledStep> compile(unsigned maxSteps, unsigned maxPatterns) const;
+
+   /**
+    * Make random samples likely to exercise the expression.
+    * Samples are built from the patterns in the expression and repeated in runs.
+    *
+    * @param samples  Filled with samples
+    * @param length   Number of samples
+    * @param random   Random number generator
+    */
+   void makeTestSamples(std::vector<uint32_t> &samples, unsigned length, std::mt19937 &random) const;
+};
+
+/**
+ * Create a trigger setup from compiled trigger steps
+ *
+ * @tparam Encoding        Trigger encoding of analyser
+ *
+ * @param steps            Compiled steps
+ * @param sampleRate       Sample rate
+ * @param sampleSize       Number of samples to capture
+ * @param preTriggerSize   Number of samples before trigger
+ *
+ * @return Trigger setup
+ */
+template<typename Encoding>
+typename Encoding::TriggerSetup makeTriggerSetup(
+      const std::vector<CompiledStep> &steps,
+      SampleRate                       sampleRate,
+      unsigned                         sampleSize,
+      unsigned                         preTriggerSize) {
+
+   using Step = typename Encoding::TriggerStep;
+
+   static const std::string dontCare(Encoding::SAMPLE_WIDTH, 'X');
+
+   assert((steps.size() >= 1) && (steps.size() <= Encoding::MAX_TRIGGER_STEPS));
+
+   Step triggers[Encoding::MAX_TRIGGER_STEPS];
+   for (unsigned stepNum=0; stepNum<steps.size(); stepNum++) {
+      const CompiledStep &step = steps[stepNum];
+      assert(step.patterns.size() <= Encoding::MAX_TRIGGER_PATTERNS);
+
+      const char *patterns[Encoding::MAX_TRIGGER_PATTERNS];
+      Polarity    polarities[Encoding::MAX_TRIGGER_PATTERNS];
+      for (unsigned patternNum=0; patternNum<Encoding::MAX_TRIGGER_PATTERNS; patternNum++) {
+         if (patternNum < step.patterns.size()) {
+            assert(step.patterns[patternNum].pattern.size() == Encoding::SAMPLE_WIDTH);
+            patterns[patternNum]   = step.patterns[patternNum].pattern.c_str();
+            polarities[patternNum] = step.patterns[patternNum].inverted?Polarity::Inverted:Polarity::Normal;
+         }
+         else {
+            patterns[patternNum]   = dontCare.c_str();
+            polarities[patternNum] = Polarity::Disabled;
+         }
+      }
+      triggers[stepNum] = Step{patterns, polarities, step.operation, step.contiguous, step.count};
+   }
+   return typename Encoding::TriggerSetup{triggers, (unsigned)steps.size()-1, sampleRate, sampleSize, preTriggerSize};
+}
+
+/**
+ * Evaluate a trigger setup on a sequence of samples.
+ * This models TriggerStateMachine.vhd using the pin encodings of the LUTs.
+ * The first sample has no edges (it is treated as its own previous value).
+ *
+ * @tparam Setup    TriggerSetup of one of the FPGA variants
+ *
+ * @param setup     Trigger setup
+ * @param samples   Samples to search
+ * @param count     Number of samples
+ *
+ * @return Index of the sample completing the last step or -1 if not found
+ */
+template<typename Setup>
+long findTrigger(const Setup &setup, const uint32_t samples[], unsigned count) {
+
+   using Encoding = typename Setup::Encoding;
+   using Step     = typename Encoding::TriggerStep;
+
+   unsigned stepNum  = 0;
+   unsigned matches  = 0;
+   Step     step     = setup.getTrigger(stepNum);
+   uint32_t previous = (count>0)?samples[0]:0;
+   for (unsigned index=0; index<count; index++) {
+      const uint32_t current = samples[index];
+
+      bool match = (step.getOperation() == Operation::And);
+      for (unsigned patternNum=0; patternNum<Encoding::MAX_TRIGGER_PATTERNS; patternNum++) {
+         const auto pattern = step.getPattern(patternNum);
+         bool patternMatch = true;
+         for (unsigned bitNum=0; bitNum<Encoding::SAMPLE_WIDTH; bitNum++) {
+            unsigned pins = 2*((previous>>bitNum)&1)+((current>>bitNum)&1);
+            patternMatch = patternMatch && ((Step::getPatternMatchPinLutValue(pattern[bitNum])>>pins)&1);
+         }
+         bool term = step.getPolarities(patternNum)(patternMatch, step.getOperation());
+         if (step.getOperation() == Operation::And) {
+            match = match && term;
+         }
+         else {
+            match = match || term;
+         }
+      }
+      previous = current;
+
+      if (match) {
+         // A count of 0 is encoded the same as 1
+         if (++matches >= std::max(1U, step.getCount())) {
+            if (stepNum == setup.getLastActiveTriggerCount()) {
+               return index;
+            }
+            step    = setup.getTrigger(++stepNum);
+            matches = 0;
+         }
+      }
+      else if (step.isContiguous()) {
+         matches = 0;
+      }
+   }
+   return -1;
+}
+
+/**
+ * Check a trigger setup against the reference evaluator of an expression
+ * using random samples.
+ *
+ * @tparam Setup        TriggerSetup of one of the FPGA variants
+ *
+ * @param expression    Trigger expression
+ * @param setup         Trigger setup to check
+ * @param trials        Number of random sample sequences to try
+ *
+ * @throw MyException if the setup and expression disagree
+ */
+template<typename Setup>
+void verifyTriggerSetup(const TriggerExpression &expression, const Setup &setup, unsigned trials = 200) {
+
+   // Long enough to complete every stage a few times
+   unsigned length = 256;
+   for (const TriggerExpression::Stage &stage:expression.getStages()) {
+      length += 4*stage.count;
+   }
+   length = std::min(length, 1U<<20);
+
+   // Limit the total work for large counts
+   trials = std::max(4U, std::min(trials, (1U<<22)/length));
+
+   std::mt19937          random(length);
+   std::vector<uint32_t> samples;
+   for (unsigned trial=0; trial<trials; trial++) {
+      expression.makeTestSamples(samples, length, random);
+      long expected = expression.findTrigger(samples.data(), samples.size());
+      long actual   = findTrigger(setup, samples.data(), samples.size());
+      if (actual != expected) {
+         fprintf(stderr, "verifyTriggerSetup() - trial %u triggers at %ld, expected %ld\n", trial, actual, expected);
+         throw MyException("verifyTriggerSetup() - trial %u triggers at %ld, expected %ld", trial, actual, expected);
+      }
+   }
+}
+
+/**
+ * Compile a trigger expression to a trigger setup for an analyser
+ *
+ * @tparam Encoding        Trigger encoding of analyser
+ *
+ * @param text             Trigger expression (see TriggerExpression)
+ * @param sampleRate       Sample rate
+ * @param sampleSize       Number of samples to capture
+ * @param preTriggerSize   Number of samples before trigger
+ * @param verify           Check the setup against the reference evaluator
+ *
+ * @return Trigger setup
+ *
+ * @throw MyException on syntax error, if the trigger does not fit or fails verification
+ */
+template<typename Encoding>
+typename Encoding::TriggerSetup compileTrigger(
+      const char *text,
+      SampleRate  sampleRate,
+      unsigned    sampleSize,
+      unsigned    preTriggerSize,
+      bool        verify = true) {
+
+   TriggerExpression expression(text, Encoding::SAMPLE_WIDTH);
+   auto setup = makeTriggerSetup<Encoding>(
+         expression.compile(Encoding::MAX_TRIGGER_STEPS, Encoding::MAX_TRIGGER_PATTERNS),
+         sampleRate, sampleSize, preTriggerSize);
+   if (verify) {
+      verifyTriggerSetup(expression, setup);
+   }
+   return setup;
+}
+
+}  // end namespace Analyser
+
+#endif /* SOURCES_TRIGGERCOMPILER_H_ */
@@ -0,0 +1,938 @@
+/*
+ * TriggerEncoding.h
+ *
+ *  Created on: 15 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_TRIGGERENCODING_H_
+#define SOURCES_TRIGGERENCODING_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <array>
+
+#include "Lfsr16.h"
+#include "BitTranspose.h"
+
+namespace Analyser {
+
+///=========================================================================
+/// Uses to represent a trigger bit encoding e.g. 'X','H','L','R','F','C'
+typedef char PinTriggerEncoding;
+
+//==============================================================
+// Sample rate selection (analyser control register)
+//
+constexpr uint8_t C_CONTROL_DIV_MASK      = 0b00001100;
+constexpr uint8_t C_CONTROL_DIV_OFFSET    = 2;
+constexpr uint8_t C_CONTROL_DIV1          = 0b00000000;
+constexpr uint8_t C_CONTROL_DIV2          = 0b00000100;
+constexpr uint8_t C_CONTROL_DIV5          = 0b00001000;
+constexpr uint8_t C_CONTROL_DIV10         = 0b00001100;
+
+constexpr uint8_t C_CONTROL_DIVx_MASK     = 0b00110000;
+constexpr uint8_t C_CONTROL_DIVx_OFFSET   = 4;
+constexpr uint8_t C_CONTROL_DIVx1         = 0b00000000;
+constexpr uint8_t C_CONTROL_DIVx10        = 0b00010000;
+constexpr uint8_t C_CONTROL_DIVx100       = 0b00100000;
+constexpr uint8_t C_CONTROL_DIVx1000      = 0b00110000;
+
+enum SampleRate {
+   SampleRate_10ns  = C_CONTROL_DIVx1    | C_CONTROL_DIV1,
+   SampleRate_20ns  = C_CONTROL_DIVx1    | C_CONTROL_DIV2,
+   SampleRate_50ns  = C_CONTROL_DIVx1    | C_CONTROL_DIV5,
+   SampleRate_100ns = C_CONTROL_DIVx10   | C_CONTROL_DIV1,
+   SampleRate_200ns = C_CONTROL_DIVx10   | C_CONTROL_DIV2,
+   SampleRate_500ns = C_CONTROL_DIVx10   | C_CONTROL_DIV5,
+   SampleRate_1us   = C_CONTROL_DIVx100  | C_CONTROL_DIV1,
+   SampleRate_2us   = C_CONTROL_DIVx100  | C_CONTROL_DIV2,
+   SampleRate_5us   = C_CONTROL_DIVx100  | C_CONTROL_DIV5,
+   SampleRate_10us  = C_CONTROL_DIVx1000 | C_CONTROL_DIV1,
+   SampleRate_20us  = C_CONTROL_DIVx1000 | C_CONTROL_DIV2,
+   SampleRate_50us  = C_CONTROL_DIVx1000 | C_CONTROL_DIV5,
+   SampleRate_100us = C_CONTROL_DIVx1000 | C_CONTROL_DIV10,
+};
+
+static constexpr unsigned getSamplePeriodIn_nanoseconds(SampleRate sampleRate) {
+   switch (sampleRate) {
+      case SampleRate_10ns  : return 10;
+      case SampleRate_20ns  : return 20;
+      case SampleRate_50ns  : return 50;
+      case SampleRate_100ns : return 100;
+      case SampleRate_200ns : return 200;
+      case SampleRate_500ns : return 500;
+      case SampleRate_1us   : return 1000;
+      case SampleRate_2us   : return 2000;
+      case SampleRate_5us   : return 5000;
+      case SampleRate_10us  : return 10000;
+      case SampleRate_20us  : return 20000;
+      case SampleRate_50us  : return 50000;
+      case SampleRate_100us : return 100000;
+   }
+   return 1;
+}
+
+/// Initial value for hashLutValue()
+static constexpr uint64_t LUT_HASH_SEED = 0xCBF29CE484222325ULL;
+
+/**
+ * Add a value to a hash of trigger configuration (FNV-1a)
+ *
+ * @param hash   Hash so far
+ * @param value  Value to add
+ *
+ * @return Updated hash
+ */
+static constexpr uint64_t hashLutValue(uint64_t hash, uint32_t value) {
+   for (unsigned byteNum=0; byteNum<4; byteNum++) {
+      hash ^= (uint8_t)(value>>(8*byteNum));
+      hash *= 0x100000001B3ULL;
+   }
+   return hash;
+}
+
+/**
+ * Used to encode the operation to combine trigger patterns
+ */
+class Operation {
+
+private:
+   unsigned operation;
+
+public:
+   static constexpr unsigned And = 0;   //!< True when all patterns match
+   static constexpr unsigned Or  = 1;   //!< True when any patterns match
+
+   constexpr Operation() : operation(And) {
+   }
+
+   constexpr Operation(unsigned value) : operation(value) {
+   }
+
+   constexpr Operation(const Operation &other) : operation(other.operation) {
+   }
+
+   constexpr Operation &operator=(const Operation &other) {
+      operation = other.operation;
+      return *this;
+   }
+
+   constexpr const char *toString() const {
+      switch(operation) {
+         case And : return "And";
+         case Or  : return "Or ";
+      }
+      return "Illegal";
+   }
+
+   constexpr bool operator==(const unsigned value) const {
+      return operation == value;
+   }
+
+   constexpr operator unsigned() const {
+      return operation;
+   }
+};
+
+/**
+ * Used to indicate or control the polarity of a trigger pattern
+ */
+class Polarity {
+
+private:
+   unsigned polarity;
+
+public:
+   static constexpr unsigned Normal   = 0;   //!< Pattern is true when matched
+   static constexpr unsigned Inverted = 1;   //!< Pattern is true when not matched
+   static constexpr unsigned Disabled = 2;   //!< Pattern is disabled
+
+   constexpr Polarity() : polarity(Normal) {
+   }
+
+   constexpr Polarity(unsigned value) : polarity(value) {
+   }
+
+   constexpr Polarity(const Polarity &other) : polarity(other.polarity) {
+   }
+
+   constexpr Polarity &operator=(const Polarity &other) {
+      polarity = other.polarity;
+      return *this;
+   }
+
+   constexpr const char *toString() const {
+      switch(polarity) {
+         case Normal:   return "Normal  ";
+         case Inverted: return "Inverted";
+         case Disabled: return "Disabled";
+      }
+      return "Illegal";
+   }
+
+   /**
+    *
+    * @param value
+    * @param op
+    *
+    * @return
+    */
+   constexpr bool operator() (bool value, Operation op) const {
+      switch(polarity) {
+         case Normal:   return value;
+         case Inverted: return !value;
+         case Disabled: return ((unsigned)op == Operation::And);
+      }
+      return false;
+   }
+
+   constexpr bool operator==(const unsigned value) const {
+      return polarity == value;
+   }
+
+   constexpr operator unsigned() const {
+      return polarity;
+   }
+};
+
+/**
+ * Trigger LUT encoding for a particular FPGA build.
+ *
+ * The classes for the trigger description (TriggerPattern, TriggerStep, TriggerSetup)
+ * and the LUT layout constants depend on the size of the trigger hardware.
+ * Each FPGA variant uses its own instantiation e.g.
+ * @code
+ *    using Encoding     = TriggerEncoding<16, 16, 2, 16>;
+ *    using TriggerSetup = Encoding::TriggerSetup;
+ * @endcode
+ *
+ * @tparam SampleWidth   Number of sample inputs (16 or 32)
+ * @tparam Steps         Number of steps in complex trigger sequence (<=16)
+ * @tparam Patterns      Number of patterns for each trigger step (2 or 4)
+ * @tparam CounterBits   Number of bits for counter for each trigger step (16)
+ */
+template<unsigned SampleWidth, unsigned Steps, unsigned Patterns, unsigned CounterBits>
+class TriggerEncoding {
+
+public:
+   /// Number of sample inputs
+   static constexpr int SAMPLE_WIDTH = SampleWidth;
+
+   /// Type holding one captured sample (one bit per input) as read from the analyser
+   using Sample = BitMatrixRow<SampleWidth>;
+
+   //====================================================================
+   // Trigger Steps
+
+   /// Maximum number of patterns for each trigger step (either 2 or 4)
+   static constexpr int MAX_TRIGGER_PATTERNS = Patterns;
+
+   /// Maximum number of steps in complex trigger sequence
+   static constexpr int MAX_TRIGGER_STEPS = Steps;
+
+   /// Number of bits for counter for each trigger step
+   static constexpr int NUM_MATCH_COUNTER_BITS = CounterBits;
+
+   /// Number of trigger flags (shared across all steps)
+   static constexpr int NUM_TRIGGER_FLAGS = 2;
+
+   //================================================================
+   // PatternMatchers match an input sample against a pattern
+   // Each trigger step contains multiple PatternMatchers
+   // PatternMatchers are complicated because each LUT implements
+   // 2 bits of 2 separate PatternMatchers with shared inputs
+
+   /// Number of partial PatternMatchers implemented in a PatternMatcher LUT
+   static constexpr int PARTIAL_PATTERN_MATCHERS_PER_LUT = 2;
+
+   /// Number of bits implemented in a PatternMatcher LUT
+   static constexpr int PATTERN_MATCHER_BITS_PER_LUT     = 2;
+
+   //================================================================
+   // Trigger combiners
+   // Combine the outputs of PatternMatchers
+   // Each combiner LUT can handle 4 pattern matchers
+   static constexpr int COMBINERS_PER_LUT = 4;
+
+   //================================================================
+   // CountMatchers match a count in a trigger step
+   // Each LUT (shift-register) implements one bit from each of the count comparisons
+
+   //================================================================
+   // Sizes handled by the LUT encoders
+   static_assert((SAMPLE_WIDTH%PATTERN_MATCHER_BITS_PER_LUT) == 0,     "SampleWidth must be even");
+   static_assert(SAMPLE_WIDTH <= 64,                                   "SampleWidth must be <= 64");
+   static_assert((MAX_TRIGGER_PATTERNS == 2) || (MAX_TRIGGER_PATTERNS == COMBINERS_PER_LUT), "Patterns must be 2 or 4");
+   static_assert((MAX_TRIGGER_STEPS >= 1) && (MAX_TRIGGER_STEPS <= 16), "Flag LUTs handle up to 16 Steps");
+   static_assert(NUM_MATCH_COUNTER_BITS == 16,                         "Match counters are 16-bit LFSRs (Lfsr16)");
+
+   //====================================================================
+
+   /// Number of LUTS for configuration information
+   static constexpr int NUM_CONFIG_WORDS = 4;
+
+   ///============================================================================================
+   /// Number of LUTS per trigger step used for pattern matchers
+   static constexpr int LUTS_PER_TRIGGER_STEP_FOR_PATTERNS = (MAX_TRIGGER_PATTERNS*SAMPLE_WIDTH)/(PATTERN_MATCHER_BITS_PER_LUT*PARTIAL_PATTERN_MATCHERS_PER_LUT);
+
+   /// Number of LUTS per trigger step used for trigger pattern combiners
+   static constexpr int LUTS_PER_TRIGGER_STEP_FOR_COMBINERS = 1;
+
+   /// Each configuration word occupies a LUT
+   static constexpr int LUTS_FOR_CONFIG = 0;//NUM_CONFIG_WORDS/1;
+
+   /// Number of LUTS for triggers used for pattern matchers
+   static constexpr int LUTS_FOR_TRIGGER_PATTERNS = MAX_TRIGGER_STEPS*LUTS_PER_TRIGGER_STEP_FOR_PATTERNS;
+
+   /// Number of LUTS for triggers used for counter matchers ( 1 per counter bit)
+   static constexpr int LUTS_FOR_TRIGGER_COUNTS = NUM_MATCH_COUNTER_BITS;
+
+   /// Number of LUTS for trigger combiners for each trigger step
+   static constexpr int LUTS_FOR_TRIGGER_COMBINERS = MAX_TRIGGER_STEPS;
+
+   /// Number of LUTS trigger flags (A flag can handle up to 32 steps)
+   static constexpr int LUTS_FOR_TRIGGERS_FLAGS = NUM_TRIGGER_FLAGS*((MAX_TRIGGER_STEPS+15)/16);
+
+   static constexpr int TOTAL_TRIGGER_LUTS =
+         LUTS_FOR_TRIGGER_PATTERNS+
+         LUTS_FOR_TRIGGER_COMBINERS+
+         LUTS_FOR_TRIGGER_COUNTS+
+         LUTS_FOR_TRIGGERS_FLAGS;
+
+   //===============================================
+   // Offsets to LUT sections
+
+   // Start of Trigger LUTs
+   static constexpr int START_CONFIG_LUTS             = 0;
+
+   // Start of Trigger LUTs
+   static constexpr int START_TRIGGER_PATTERN_LUTS    = START_CONFIG_LUTS+LUTS_FOR_CONFIG;
+
+   // Start of Trigger Combiner LUTs
+   static constexpr int START_TRIGGER_COMBINER_LUTS   = START_TRIGGER_PATTERN_LUTS+LUTS_FOR_TRIGGER_PATTERNS;
+
+   // Start of Trigger Flag LUTs
+   static constexpr int START_TRIGGER_COUNT_LUTS      = START_TRIGGER_COMBINER_LUTS+LUTS_FOR_TRIGGER_COMBINERS;
+
+   // Start of Trigger Count Matcher LUTs
+   static constexpr int START_TRIGGER_FLAG_LUTS       = START_TRIGGER_COUNT_LUTS+LUTS_FOR_TRIGGER_COUNTS;
+
+   /**
+    * Compares the sample data to a particular trigger pattern.
+    * The pattern is encoded as a string of "XHLRFC" values
+    */
+   class TriggerPattern {
+   private:
+      PinTriggerEncoding triggerValue[SAMPLE_WIDTH+1] = {};
+
+   public:
+      constexpr TriggerPattern() {
+      }
+
+      /**
+       * Construct a pattern from a string
+       * If the pattern is shorter than SAMPLE_WIDTH then it
+       * is padded with 'X' on the left
+       *
+       * @param triggerString
+       */
+      constexpr TriggerPattern(const char *triggerString) {
+         unsigned width = 0;
+         while ((width<SAMPLE_WIDTH) && (triggerString[width] != '\0')) {
+            width++;
+         }
+         unsigned offset = SAMPLE_WIDTH-width;
+         for (unsigned index=0; index<offset; index++) {
+            triggerValue[index] = 'X';
+         }
+         for (unsigned index=0; index<width; index++) {
+            triggerValue[offset+index] = triggerString[index];
+         }
+         triggerValue[SAMPLE_WIDTH] = '\0';
+      }
+
+      // Explicit copy - GCC rejects implicit copies of the default elements
+      // of a constexpr TriggerStep[] in constant expressions
+      constexpr TriggerPattern(const TriggerPattern &other) {
+         for (unsigned index=0; index<=SAMPLE_WIDTH; index++) {
+            triggerValue[index] = other.triggerValue[index];
+         }
+      }
+
+      constexpr TriggerPattern &operator=(const TriggerPattern &other) {
+         for (unsigned index=0; index<=SAMPLE_WIDTH; index++) {
+            triggerValue[index] = other.triggerValue[index];
+         }
+         return *this;
+      }
+
+      TriggerPattern &operator=(const char *&triggerString) {
+         memcpy(triggerValue, triggerString, SAMPLE_WIDTH+1);
+         return *this;
+      }
+      constexpr PinTriggerEncoding operator[](unsigned index) const {
+         return triggerValue[(SAMPLE_WIDTH-1)-index];
+      }
+
+      constexpr PinTriggerEncoding getBitEncoding(unsigned bitNum) const {
+         assert(bitNum < SAMPLE_WIDTH);
+         return triggerValue[bitNum];
+      }
+      constexpr const char *toString() const {
+         return triggerValue;
+      }
+   };
+
+   /**
+    * Represents a Step in the trigger sequence
+    *
+    * This will contain:
+    * - Trigger pattern x MAX_TRIGGER_PATTERNS
+    * - Polarities for above
+    * - Operation (AND/OR) used to combine pattern matches
+    * - Whether pattern counting requires contiguous detection
+    * - Trigger count required for final match
+    */
+   class TriggerStep {
+
+   private:
+      TriggerPattern    patterns[MAX_TRIGGER_PATTERNS];
+      Polarity          polarities[MAX_TRIGGER_PATTERNS];
+      Operation         operation;
+      bool              contiguous;
+      unsigned          triggerCount;
+
+   public:
+      constexpr TriggerStep() : operation(Operation::And), contiguous(false), triggerCount(0) {
+      }
+
+      /**
+       * Construct a step using the first two patterns.
+       * Any remaining patterns are disabled.
+       */
+      constexpr TriggerStep(
+            const TriggerPattern &trigger0,
+            const TriggerPattern &trigger1,
+            const Polarity        polarity0,
+            const Polarity        polarity1,
+            const Operation       op,
+            const bool            contiguous,
+            const unsigned        count) :
+               patterns{trigger0, trigger1}, polarities{polarity0, polarity1}, operation(op), contiguous(contiguous), triggerCount(count) {
+         for (unsigned patternNum=2; patternNum<MAX_TRIGGER_PATTERNS; patternNum++) {
+            polarities[patternNum] = Polarity::Disabled;
+         }
+      }
+
+      /**
+       * Construct a step using the first two patterns.
+       * Any remaining patterns are disabled.
+       */
+      constexpr TriggerStep(
+            const char        *trigger0,
+            const char        *trigger1,
+            const Polarity     polarity0,
+            const Polarity     polarity1,
+            const Operation    op,
+            const bool         contiguous,
+            const unsigned     count) :
+               patterns{trigger0, trigger1}, polarities{polarity0, polarity1}, operation(op), contiguous(contiguous), triggerCount(count) {
+         for (unsigned patternNum=2; patternNum<MAX_TRIGGER_PATTERNS; patternNum++) {
+            polarities[patternNum] = Polarity::Disabled;
+         }
+      }
+
+      /**
+       * Construct a step using all patterns e.g.
+       * @code
+       *    { {"XXXX1XXXXXXXXXXX", "XXXXXXXXXXX0XXXX", "R", "F"},
+       *      {Polarity::Normal, Polarity::Normal, Polarity::Inverted, Polarity::Disabled},
+       *      Operation::And, false, 10 }
+       * @endcode
+       */
+      constexpr TriggerStep(
+            const char *const  (&triggers)[MAX_TRIGGER_PATTERNS],
+            const Polarity     (&polarities)[MAX_TRIGGER_PATTERNS],
+            const Operation    op,
+            const bool         contiguous,
+            const unsigned     count) :
+               operation(op), contiguous(contiguous), triggerCount(count) {
+         for (unsigned patternNum=0; patternNum<MAX_TRIGGER_PATTERNS; patternNum++) {
+            this->patterns[patternNum]   = triggers[patternNum];
+            this->polarities[patternNum] = polarities[patternNum];
+         }
+      }
+
+      static constexpr unsigned triggerValueIndex(PinTriggerEncoding value) {
+         switch (value) {
+            default:
+            case 'X' :
+               return 0;
+            case '1' :
+            case 'H' :
+               return 1;
+            case '0' :
+            case 'L' :
+               return 2;
+            case 'R' :
+               return 3;
+            case 'F' :
+               return 4;
+            case 'C' :
+               return 5;
+         }
+      }
+
+      const char *toString() const {
+         static char buff[20+MAX_TRIGGER_PATTERNS*(SAMPLE_WIDTH+20)+30];
+         unsigned length = snprintf(buff, sizeof(buff), "%s(", operation.toString());
+         for (unsigned triggerNum=0; triggerNum<MAX_TRIGGER_PATTERNS; triggerNum++) {
+            length += snprintf(buff+length, sizeof(buff)-length, "T%u[%s, %s] ",
+                  triggerNum, patterns[triggerNum].toString(), polarities[triggerNum].toString());
+         }
+         snprintf(buff+length, sizeof(buff)-length, "), Count = %u", triggerCount);
+         return buff;
+      }
+
+      constexpr auto getCount() const {
+         return triggerCount;
+      }
+
+      constexpr auto getPattern(unsigned patternNum) const {
+         assert(patternNum<MAX_TRIGGER_PATTERNS);
+         return patterns[patternNum];
+      }
+
+      constexpr auto getPolarities(unsigned patternNum) const {
+         assert(patternNum<MAX_TRIGGER_PATTERNS);
+         return polarities[patternNum];
+      }
+
+      constexpr auto getOperation() const {
+         return operation;
+      }
+
+      constexpr auto isContiguous() const {
+         return contiguous;
+      }
+
+      /**
+       * Add this step to a hash of the trigger configuration
+       *
+       * @param hash Hash so far
+       *
+       * @return Updated hash
+       */
+      constexpr uint64_t hash(uint64_t hash) const {
+         for (unsigned patternNum=0; patternNum<MAX_TRIGGER_PATTERNS; patternNum++) {
+            for (unsigned bitNum=0; bitNum<SAMPLE_WIDTH; bitNum++) {
+               hash = hashLutValue(hash, patterns[patternNum].getBitEncoding(bitNum));
+            }
+            hash = hashLutValue(hash, polarities[patternNum]);
+         }
+         hash = hashLutValue(hash, operation);
+         hash = hashLutValue(hash, contiguous);
+         return hashLutValue(hash, triggerCount);
+      }
+
+      /**
+       * Get the LUT values for the combiner in a trigger step
+       *
+       * @param trigger
+       * @param lutValues
+       */
+      constexpr void getTriggerStepCombinerLutValues(uint32_t lutValues[LUTS_PER_TRIGGER_STEP_FOR_COMBINERS]) const {
+         uint16_t result = 0;
+
+         for (unsigned value=0; value<(1<<MAX_TRIGGER_PATTERNS); value++) {
+            bool bitValue = false;
+            switch(getOperation()) {
+               case Operation::And: bitValue = 1; break;
+               case Operation::Or:  bitValue = 0; break;
+            }
+            for (unsigned patternNum=0; patternNum<MAX_TRIGGER_PATTERNS; patternNum++) {
+               bool term = (value&(1<<patternNum));
+               term = getPolarities(patternNum)(term, getOperation());
+               switch(getOperation()) {
+                  case Operation::And: bitValue = bitValue && term; break;
+                  case Operation::Or:  bitValue = bitValue || term; break;
+               }
+            }
+            result |= bitValue<<value;
+         }
+         lutValues[0] = result;
+      }
+
+      /// LUT encodings for a pair of pin trigger encodings (index = 6*triggerValue1+triggerValue0)
+      static constexpr uint16_t lutEncoding[] = {
+         0b1111111111111111,  // XX
+         0b1010101010101010,  // XH
+         0b0101010101010101,  // XL
+         0b0010001000100010,  // XR
+         0b0100010001000100,  // XF
+         0b0110011001100110,  // XC
+         0b1111000011110000,  // HX
+         0b1010000010100000,  // HH
+         0b0101000001010000,  // HL
+         0b0010000000100000,  // HR
+         0b0100000001000000,  // HF
+         0b0110000001100000,  // HC
+         0b0000111100001111,  // LX
+         0b0000101000001010,  // LH
+         0b0000010100000101,  // LL
+         0b0000001000000010,  // LR
+         0b0000010000000100,  // LF
+         0b0000011000000110,  // LC
+         0b0000000011110000,  // RX
+         0b0000000010100000,  // RH
+         0b0000000001010000,  // RL
+         0b0000000000100000,  // RR
+         0b0000000001000000,  // RF
+         0b0000000001100000,  // RC
+         0b0000111100000000,  // FX
+         0b0000101000000000,  // FH
+         0b0000010100000000,  // FL
+         0b0000001000000000,  // FR
+         0b0000010000000000,  // FF
+         0b0000011000000000,  // FC
+         0b0000111111110000,  // CX
+         0b0000101010100000,  // CH
+         0b0000010101010000,  // CL
+         0b0000001000100000,  // CR
+         0b0000010001000000,  // CF
+         0b0000011001100000,  // CC
+      };
+
+      /**
+       * Get the LUT value for half a LUT pattern matcher
+       * This encodes one bit of two pattern matchers
+       *
+       * @param triggerValue1
+       * @param triggerValue0
+       * @return
+       */
+      static constexpr uint16_t getPatternMatchHalfLutValues(PinTriggerEncoding triggerValue1, PinTriggerEncoding triggerValue0) {
+         unsigned index = 6*triggerValueIndex(triggerValue1)+triggerValueIndex(triggerValue0);
+         return lutEncoding[index];
+      }
+
+      /**
+       * Get the LUT value for a single pin of a pattern matcher.
+       * This is the 4-bit truth table over the current and previous value of the pin.
+       * Each lutEncoding[] value is the product of the tables for its two pins i.e.
+       * bit (4*j1+j0) = pinLut(triggerValue1)[j1] & pinLut(triggerValue0)[j0]
+       *
+       * @param triggerValue
+       * @return
+       */
+      static constexpr uint8_t getPatternMatchPinLutValue(PinTriggerEncoding triggerValue) {
+         // 'X' for the other pin leaves a copy of the table in each nibble
+         return lutEncoding[triggerValueIndex(triggerValue)]&0xF;
+      }
+
+      /**
+       * Get the LUT values for the pattern matchers in a trigger step
+       *
+       * @param trigger
+       * @param lutValues
+       */
+      constexpr void getTriggerStepPatternMatcherLutValues(uint32_t lutValues[LUTS_PER_TRIGGER_STEP_FOR_PATTERNS]) const {
+
+         static_assert(PATTERN_MATCHER_BITS_PER_LUT == 2, "Pattern LUT construction assumes 2 pins per half LUT");
+
+         using Row = BitMatrixRow<SAMPLE_WIDTH>;
+         constexpr unsigned size = 8*sizeof(Row);
+
+         // halfLuts[condition][bitNum] = half LUT value for pins bitNum and bitNum-1 of pattern
+         Row halfLuts[MAX_TRIGGER_PATTERNS][size] = {};
+
+         for (unsigned condition=0; condition<MAX_TRIGGER_PATTERNS; condition++) {
+            // Row per pin holding the pin truth table, transposed to a row per table bit
+            Row planes[size] = {};
+            for (unsigned bitNum=0; bitNum<SAMPLE_WIDTH; bitNum++) {
+               planes[bitNum] = getPatternMatchPinLutValue(getPattern(condition)[bitNum]);
+            }
+            transposeBits(planes);
+
+            // Row per half LUT bit, bitNum holds the product for pins bitNum and bitNum-1,
+            // transposed to a row per pin pair
+            Row *halfLut = halfLuts[condition];
+            for (unsigned j1=0; j1<4; j1++) {
+               for (unsigned j0=0; j0<4; j0++) {
+                  halfLut[4*j1+j0] = planes[j1] & (Row)(planes[j0]<<1);
+               }
+            }
+            transposeBits(halfLut);
+         }
+
+         int lutIndex = 0;
+
+         // LUT chain order is as PatternMatchers.vhd i.e. a PatternMatcher for each pair of conditions
+         // (highest first) and within that a LUT for each pair of pins (highest first)
+         for(int condition=MAX_TRIGGER_PATTERNS-1; condition>=PARTIAL_PATTERN_MATCHERS_PER_LUT-1; condition-=PARTIAL_PATTERN_MATCHERS_PER_LUT) {
+            for(int bitNum=SAMPLE_WIDTH-1; bitNum>=PATTERN_MATCHER_BITS_PER_LUT-1; bitNum-=PATTERN_MATCHER_BITS_PER_LUT) {
+               uint32_t value = 0;
+               value  = (uint16_t)halfLuts[condition][bitNum];
+               value <<= 16;
+               value |= (uint16_t)halfLuts[condition-1][bitNum];
+               lutValues[lutIndex++] = value;
+            }
+         }
+      }
+
+   };
+
+   /// LUT configuration image as sent by C_LUT_CONFIG (each LUT MSB first)
+   using LutImage = std::array<uint8_t, 4*TOTAL_TRIGGER_LUTS>;
+
+   /**
+    * Represents the entire trigger setup
+    */
+   class TriggerSetup {
+   public:
+      /// Trigger encoding this setup belongs to
+      using Encoding = TriggerEncoding;
+
+   private:
+      // Configuration for each trigger
+      TriggerStep triggers[MAX_TRIGGER_STEPS];
+
+      // Number of last active trigger
+      unsigned lastActiveTriggerCount;
+
+      SampleRate sampleRate;
+
+      unsigned   sampleSize;
+      unsigned   preTriggerSize;
+
+   public:
+      constexpr TriggerSetup() : lastActiveTriggerCount(0), sampleRate(SampleRate_100ns), sampleSize(100), preTriggerSize(50) {
+      }
+
+      constexpr TriggerSetup(
+            const TriggerStep triggers[MAX_TRIGGER_STEPS],
+            unsigned          lastActiveTriggerCount,
+            SampleRate        sampleRate     = SampleRate_100ns,
+            unsigned          sampleSize     = 100,
+            unsigned          preTriggerSize = 50)
+
+         : lastActiveTriggerCount(lastActiveTriggerCount), sampleRate(sampleRate), sampleSize(sampleSize), preTriggerSize(preTriggerSize) {
+         assert(lastActiveTriggerCount < MAX_TRIGGER_STEPS);
+         for (unsigned step=0; step<MAX_TRIGGER_STEPS; step++) {
+            this->triggers[step] = triggers[step];
+         }
+      }
+
+      constexpr void setSampleRate(SampleRate sampleRate) {
+         this->sampleRate = sampleRate;
+      }
+
+      constexpr SampleRate getSampleRate() const {
+         return sampleRate;
+      }
+
+      constexpr void setSampleSize(unsigned sampleSize) {
+         this->sampleSize = sampleSize;
+      }
+
+      constexpr unsigned getSampleSize() const {
+         return sampleSize;
+      }
+
+      constexpr void setPreTrigSize(unsigned preTriggerSize) {
+         this->preTriggerSize = preTriggerSize;
+      }
+
+      constexpr unsigned getPreTrigSize() const {
+         return preTriggerSize;
+      }
+
+      constexpr auto getTrigger(unsigned triggerNum) const {
+         return triggers[triggerNum];
+      }
+
+      constexpr auto getLastActiveTriggerCount() const {
+         return lastActiveTriggerCount;
+      }
+
+      /**
+       * Get hash of the parts of the setup that determine the LUT values.
+       * The sample rate and sizes are not included.
+       *
+       * @return Hash
+       */
+      constexpr uint64_t getLutHash() const {
+         uint64_t hash = hashLutValue(LUT_HASH_SEED, lastActiveTriggerCount);
+         for (unsigned step=0; step<MAX_TRIGGER_STEPS; step++) {
+            hash = triggers[step].hash(hash);
+         }
+         return hash;
+      }
+
+      /**
+       * Print the active trigger steps
+       *
+       * @param console Where to write e.g. USBDM::console
+       */
+      template<typename Console>
+      void printTriggers(Console &console) const {
+         for (unsigned step=0; step<=lastActiveTriggerCount; step++) {
+            console.write("-- ").writeln(triggers[step].toString());
+         }
+      }
+
+      /**
+       * Converts data from little-endian to big-endian in-situ
+       *
+       * @param size Number of LUTs to convert
+       * @param data Array of LUTs
+       *
+       * @return Converted array treated as uint8_t
+       */
+      uint8_t *formatData(unsigned size, uint32_t *data) {
+         for(unsigned index=0; index<size; index++) {
+            data[index] = __builtin_bswap32(data[index]);
+         }
+         return reinterpret_cast<uint8_t *>(data);
+      }
+
+      /**
+       * Get the LUT values for the pattern matchers for all trigger steps
+       *
+       * @param trigger
+       * @param lutValues
+       */
+      constexpr void getTriggerPatternMatcherLutValues(uint32_t *&lutValues) const {
+         unsigned lutIndex = 0;
+         for(int step=MAX_TRIGGER_STEPS-1; step >=0; step-- ) {
+            if (step>(int)this->lastActiveTriggerCount) {
+               for (unsigned offset=0; offset<LUTS_PER_TRIGGER_STEP_FOR_PATTERNS; offset++) {
+                  lutValues[lutIndex+offset] = 0x0;
+               }
+            }
+            else {
+               triggers[step].getTriggerStepPatternMatcherLutValues(lutValues+lutIndex);
+            }
+            lutIndex += LUTS_PER_TRIGGER_STEP_FOR_PATTERNS;
+         }
+         lutValues += LUTS_FOR_TRIGGER_PATTERNS;
+      }
+
+      /**
+       * Get the LUT values for the combiner for all trigger steps
+       *
+       * @param trigger
+       * @param lutValues
+       */
+      constexpr void getTriggerCombinerLutValues(uint32_t *&lutValues) const {
+         unsigned lutIndex = 0;
+         for(int step=MAX_TRIGGER_STEPS-1; step >=0; step-- ) {
+            if (step>(int)this->lastActiveTriggerCount) {
+               for (unsigned offset=0; offset<LUTS_PER_TRIGGER_STEP_FOR_COMBINERS; offset++) {
+                  lutValues[lutIndex+offset] = 0x0;
+               }
+            }
+            else {
+               triggers[step].getTriggerStepCombinerLutValues(lutValues+lutIndex);
+            }
+            lutIndex += LUTS_PER_TRIGGER_STEP_FOR_COMBINERS;
+         }
+         lutValues += LUTS_FOR_TRIGGER_COMBINERS;
+      }
+
+      /**
+       * Get the LUT values for the trigger contiguous value
+       *
+       * @param trigger
+       * @param lutValues
+       */
+      constexpr void getTriggerFlagLutValues(uint32_t *&lutValues) const {
+
+         using Row = BitMatrixRow<MAX_TRIGGER_STEPS>;
+
+         // Row per step holding the flags for the step, transposed to a row per flag
+         Row flags[8*sizeof(Row)] = {};
+         for(unsigned step=0; step < MAX_TRIGGER_STEPS; step++ ) {
+            flags[step] = ((step == lastActiveTriggerCount)?0b01:0) | (triggers[step].isContiguous()?0b10:0);
+         }
+         transposeBits(flags);
+
+         *lutValues++ = flags[0];
+         *lutValues++ = flags[1];
+      }
+
+      /**
+       * Get the LUT values for the trigger count comparators for all trigger steps
+       *
+       * @param trigger
+       * @param lutValues
+       */
+      constexpr void getTriggerCountLutValues(uint32_t *&lutValues) const {
+
+         using Row = BitMatrixRow<(MAX_TRIGGER_STEPS>NUM_MATCH_COUNTER_BITS)?MAX_TRIGGER_STEPS:NUM_MATCH_COUNTER_BITS>;
+
+         // Row per step holding the encoded count, transposed to a row per count bit
+         // The bits for each step appear at this location in the SR
+         Row counts[8*sizeof(Row)] = {};
+         for(unsigned step=0; step <= lastActiveTriggerCount; step++ ) {
+            counts[step] = Lfsr16::encode(getTrigger(step).getCount());
+         }
+         transposeBits(counts);
+
+         for(int bit=0; bit<NUM_MATCH_COUNTER_BITS; bit++ ) {
+            lutValues[(NUM_MATCH_COUNTER_BITS-1)-bit] = (uint32_t)counts[bit];
+         }
+         lutValues += LUTS_FOR_TRIGGER_COUNTS;
+      }
+
+      /**
+       * Get the LUT values for the entire trigger setup in the order loaded by C_LUT_CONFIG
+       * (pattern matchers, combiners, counts, flags)
+       *
+       * @param lutValues Array for LUT values
+       */
+      constexpr void getLutValues(uint32_t lutValues[TOTAL_TRIGGER_LUTS]) const {
+         uint32_t *lutValuePtr = lutValues;
+
+         getTriggerPatternMatcherLutValues(lutValuePtr);
+         getTriggerCombinerLutValues(lutValuePtr);
+         getTriggerCountLutValues(lutValuePtr);
+         getTriggerFlagLutValues(lutValuePtr);
+      }
+
+      /**
+       * Get the LUT configuration image for the trigger setup.
+       * The byte order is the same as formatData() i.e. each LUT MSB first.
+       *
+       * This may be evaluated at compile time so that a fixed trigger
+       * is built directly into the upload data e.g.
+       * @code
+       *    constexpr TriggerSetup setup{triggers, 0, SampleRate_100ns, 1000, 100};
+       *    constexpr LutImage     lutImage = setup.getLutImage();
+       * @endcode
+       *
+       * @return LUT image
+       */
+      constexpr LutImage getLutImage() const {
+         uint32_t lutValues[TOTAL_TRIGGER_LUTS] = {};
+         getLutValues(lutValues);
+
+         LutImage image = {};
+         for(unsigned index=0; index<TOTAL_TRIGGER_LUTS; index++) {
+            image[4*index+0] = (uint8_t)(lutValues[index]>>24);
+            image[4*index+1] = (uint8_t)(lutValues[index]>>16);
+            image[4*index+2] = (uint8_t)(lutValues[index]>>8);
+            image[4*index+3] = (uint8_t)(lutValues[index]);
+         }
+         return image;
+      }
+
+   };
+};
+
+}  // end namespace Analyser
+
+#endif /* SOURCES_TRIGGERENCODING_H_ */
@@ -0,0 +1,756 @@
+/*
+ * TriggerModel.h
+ *
+ *  Created on: 26 Aug 2019
+ *      Author: podonoghue
+ */
+
+#ifndef SOURCES_TRIGGERMODEL_H_
+#define SOURCES_TRIGGERMODEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <memory>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "BitTranspose.h"
+#include "Lfsr16.h"
+#include "EncodeLuts.h"
+
+namespace Analyser {
+
+/**
+ * Trigger pipeline of the analyser independent of the hardware size
+ * (see TriggerModel)
+ */
+class TriggerPipeline {
+public:
+   virtual ~TriggerPipeline() = default;
+
+   /**
+    * Load LUT configuration
+    *
+    * @param lutImage LUT image in the order loaded by C_LUT_CONFIG (each LUT MSB first)
+    * @param size     Size of image in bytes
+    *
+    * @throw MyException if the image is the wrong size for the hardware
+    */
+   virtual void load(const uint8_t lutImage[], size_t size) = 0;
+
+   /**
+    * Clear the pipeline as if sample had been applied for several samples
+    * with the trigger disabled
+    *
+    * @param sample Sample value
+    */
+   virtual void reset(uint32_t sample = 0) = 0;
+
+   /**
+    * Advance the pipeline by one sample (doSample)
+    *
+    * @param sample  Sample in currentSample i.e. the sample written to SDRAM by this doSample
+    * @param enable  Trigger enabled (armed)
+    *
+    * @return triggerFound after this sample i.e. the next sample written is the trigger sample
+    */
+   virtual bool clock(uint32_t sample, bool enable) = 0;
+
+   /// Current trigger step (triggerStep)
+   virtual unsigned getStep() const = 0;
+
+   /// Current match counter (LFSR state)
+   virtual uint16_t getMatchCounter() const = 0;
+};
+
+/**
+ * Software model of the trigger hardware.
+ *
+ * This evaluates a LUT image the same way as TriggerBlock.vhd i.e.
+ *  - PatternMatchers.vhd  LUT per pin pair per two patterns over currentSample/lastSample
+ *  - PatternCombiner.vhd  LUT per step combining the patterns
+ *  - CountMatchers_sr.vhd LUT per counter bit giving the count to compare for the step
+ *  - StepFlags.vhd        LUT per flag (last step, contiguous)
+ *  - TriggerStateMachine.vhd including the LFSR match counter and contiguous reset
+ *
+ * As it works from the LUT image it may be used to check the image produced by
+ * TriggerSetup::getLutImage(), to re-trigger stored captures and to model the analyser.
+ *
+ * clock() steps the registers of the hardware one sample at a time.
+ * findTrigger() searches a buffer of samples 256 at a time. The samples are transposed to
+ * a bit-plane per pin so the LUTs of the current step are evaluated for all 256 samples
+ * with a few logic operations (AVX2 when available). The state machine then skips between
+ * matches using bit counts rather than visiting each sample.
+ *
+ * @tparam Encoding TriggerEncoding of the hardware
+ */
+template<typename Encoding>
+class TriggerModel : public TriggerPipeline {
+
+public:
+   using Sample   = typename Encoding::Sample;
+   using LutImage = typename Encoding::LutImage;
+
+   /**
+    * Number of doSample between a sample being in currentSample and its pattern match
+    * being used by the state machine (conditionFFs, triggerFFs)
+    */
+   static constexpr unsigned PIPELINE_DELAY = 2;
+
+private:
+   static constexpr unsigned STEPS         = Encoding::MAX_TRIGGER_STEPS;
+   static constexpr unsigned PATTERNS      = Encoding::MAX_TRIGGER_PATTERNS;
+   static constexpr unsigned PIN_PAIRS     = Encoding::SAMPLE_WIDTH/2;
+   static constexpr unsigned BLOCKS        = PATTERNS/2;
+   static constexpr unsigned BLOCK_SAMPLES = 256;
+   static constexpr unsigned BLOCK_WORDS   = BLOCK_SAMPLES/64;
+   static constexpr unsigned ROW_BITS      = 8*sizeof(Sample);
+   static constexpr unsigned LFSR_PERIOD   = 65535;
+
+   static_assert((Encoding::SAMPLE_WIDTH%2) == 0, "Pattern LUTs use pairs of pins");
+   static_assert((PATTERNS == 2) || (PATTERNS == 4), "Combiner is a LUT4");
+   static_assert(STEPS == 16, "Step counter is 4 bits (TriggerRangeType)");
+
+   /// Pattern matcher LUT half that is not always true (all true LUTs are dropped)
+   struct PatternTerm {
+      uint8_t  condition;  //!< Pattern number
+      uint8_t  pair;       //!< Pins 2*pair+1 and 2*pair
+      uint16_t table;      //!< Index is 8*last(2*pair+1) + 4*current(2*pair+1) + 2*last(2*pair) + current(2*pair)
+   };
+
+   /// Decoded LUTs for each step
+   struct StepLuts {
+      std::vector<PatternTerm> terms;
+      uint16_t combiner;      //!< Index is 8*c3 + 4*c2 + 2*c1 + c0
+      uint16_t countCompare;  //!< LFSR state compared with match counter
+      bool     last;          //!< TRIGGER_SEQUENCE_COMPLETE flag
+      bool     contiguous;    //!< CONTIGUOUS flag
+      unsigned resetNeeded;   //!< Matches needed from a reset match counter (0 => never)
+   };
+
+   StepLuts steps[STEPS];
+
+   enum State {s_idle, s_running, s_complete};
+
+   // TriggerStateMachine.vhd
+   State    state        = s_idle;
+   unsigned stepCounter  = 0;
+   uint16_t matchCounter = 1;
+   bool     triggerFound = false;
+
+   /// Samples in order currentSample, lastSample and the two previous (in conditionFFs/triggerFFs)
+   Sample   history[4]   = {};
+
+   /**
+    * 256 samples of one signal, bit n of word[n/64] is sample n
+    */
+   struct Plane {
+#if defined(__AVX2__)
+      __m256i v;
+
+      static Plane load(const uint64_t words[BLOCK_WORDS]) {
+         return Plane{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(words))};
+      }
+      void store(uint64_t words[BLOCK_WORDS]) const {
+         _mm256_storeu_si256(reinterpret_cast<__m256i *>(words), v);
+      }
+      static Plane zeros() {
+         return Plane{_mm256_setzero_si256()};
+      }
+      static Plane ones() {
+         return Plane{_mm256_set1_epi64x(-1)};
+      }
+      Plane operator&(Plane other) const { return Plane{_mm256_and_si256(v, other.v)}; }
+      Plane operator^(Plane other) const { return Plane{_mm256_xor_si256(v, other.v)}; }
+      Plane operator~() const            { return Plane{_mm256_xor_si256(v, _mm256_set1_epi64x(-1))}; }
+#else
+      uint64_t word[BLOCK_WORDS];
+
+      static Plane load(const uint64_t words[BLOCK_WORDS]) {
+         Plane plane;
+         memcpy(plane.word, words, sizeof(plane.word));
+         return plane;
+      }
+      void store(uint64_t words[BLOCK_WORDS]) const {
+         memcpy(words, word, sizeof(word));
+      }
+      static Plane zeros() {
+         return Plane{};
+      }
+      static Plane ones() {
+         return ~Plane{};
+      }
+      Plane operator&(Plane other) const {
+         Plane result;
+         for (unsigned index=0; index<BLOCK_WORDS; index++) {
+            result.word[index] = word[index] & other.word[index];
+         }
+         return result;
+      }
+      Plane operator^(Plane other) const {
+         Plane result;
+         for (unsigned index=0; index<BLOCK_WORDS; index++) {
+            result.word[index] = word[index] ^ other.word[index];
+         }
+         return result;
+      }
+      Plane operator~() const {
+         Plane result;
+         for (unsigned index=0; index<BLOCK_WORDS; index++) {
+            result.word[index] = ~word[index];
+         }
+         return result;
+      }
+#endif
+   };
+
+   /**
+    * Select between planes
+    *
+    * @return select?one:zero for each sample
+    */
+   static Plane mux(Plane select, Plane one, Plane zero) {
+      return zero ^ (select & (zero ^ one));
+   }
+
+   /**
+    * Evaluate a LUT4 for each sample as a tree of multiplexers
+    *
+    * @param table Truth table, index is 8*i3 + 4*i2 + 2*i1 + i0
+    *
+    * @return Output for each sample
+    */
+   static Plane lut4(uint16_t table, Plane i0, Plane i1, Plane i2, Plane i3) {
+      Plane level[8];
+      for (unsigned index=0; index<8; index++) {
+         switch((table>>(2*index))&0b11) {
+            case 0b00: level[index] = Plane::zeros(); break;
+            case 0b01: level[index] = ~i0;            break;
+            case 0b10: level[index] = i0;             break;
+            case 0b11: level[index] = Plane::ones();  break;
+         }
+      }
+      for (unsigned index=0; index<4; index++) {
+         level[index] = mux(i1, level[2*index+1], level[2*index]);
+      }
+      for (unsigned index=0; index<2; index++) {
+         level[index] = mux(i2, level[2*index+1], level[2*index]);
+      }
+      return mux(i3, level[1], level[0]);
+   }
+
+#if defined(__AVX2__)
+   /**
+    * Transpose 32 samples to planes using AVX2.
+    * The samples are rearranged so each vector holds the same byte of 32 samples
+    * and each plane is collected by _mm256_movemask_epi8() from the top bit of each byte.
+    *
+    * @param samples  32 samples
+    * @param planes   Plane per pin
+    * @param offset   Position of samples in planes (multiple of 32)
+    */
+   static void toPlanes32(const Sample samples[32], uint64_t planes[Encoding::SAMPLE_WIDTH][BLOCK_WORDS], unsigned offset) {
+      constexpr unsigned BYTES = sizeof(Sample);
+
+      // bytes[n] holds byte n of each sample
+      __m256i bytes[BYTES];
+      if constexpr (BYTES == 2) {
+         // Low bytes then high bytes of each 8 samples
+         const __m256i shuffle = _mm256_setr_epi8(
+               0,2,4,6,8,10,12,14,1,3,5,7,9,11,13,15,
+               0,2,4,6,8,10,12,14,1,3,5,7,9,11,13,15);
+         __m256i a = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples)),    shuffle);
+         __m256i b = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples+16)), shuffle);
+         bytes[0] = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0b11011000);
+         bytes[1] = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0b11011000);
+      }
+      else {
+         // Byte n of each 8 samples in 64-bit element n
+         const __m256i shuffle = _mm256_setr_epi8(
+               0,4,8,12,1,5,9,13,2,6,10,14,3,7,11,15,
+               0,4,8,12,1,5,9,13,2,6,10,14,3,7,11,15);
+         const __m256i order = _mm256_setr_epi32(0,4,1,5,2,6,3,7);
+         __m256i v[4];
+         for (unsigned index=0; index<4; index++) {
+            v[index] = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(
+                  _mm256_loadu_si256(reinterpret_cast<const __m256i *>(samples+8*index)), shuffle), order);
+         }
+         __m256i lo01 = _mm256_unpacklo_epi64(v[0], v[1]);
+         __m256i lo23 = _mm256_unpacklo_epi64(v[2], v[3]);
+         __m256i hi01 = _mm256_unpackhi_epi64(v[0], v[1]);
+         __m256i hi23 = _mm256_unpackhi_epi64(v[2], v[3]);
+         bytes[0] = _mm256_permute2x128_si256(lo01, lo23, 0x20);
+         bytes[1] = _mm256_permute2x128_si256(hi01, hi23, 0x20);
+         bytes[2] = _mm256_permute2x128_si256(lo01, lo23, 0x31);
+         bytes[3] = _mm256_permute2x128_si256(hi01, hi23, 0x31);
+      }
+      for (unsigned byte=0; byte<BYTES; byte++) {
+         __m256i value = bytes[byte];
+         for (int bit=7; bit>=0; bit--) {
+            unsigned pin = 8*byte+bit;
+            if (pin < (unsigned)Encoding::SAMPLE_WIDTH) {
+               planes[pin][offset/64] |= (uint64_t)(uint32_t)_mm256_movemask_epi8(value)<<(offset%64);
+            }
+            value = _mm256_slli_epi16(value, 1);
+         }
+      }
+   }
+#endif
+
+   /**
+    * Transpose a block of samples to a plane per pin
+    *
+    * @param samples  Samples
+    * @param count    Number of samples (<=BLOCK_SAMPLES)
+    * @param previous Sample before samples[0]
+    * @param current  Plane per pin of samples
+    * @param last     Plane per pin of samples delayed by one
+    */
+   static void toPlanes(
+         const Sample samples[],
+         unsigned     count,
+         Sample       previous,
+         uint64_t     current[Encoding::SAMPLE_WIDTH][BLOCK_WORDS],
+         uint64_t     last[Encoding::SAMPLE_WIDTH][BLOCK_WORDS]) {
+
+      memset(current, 0, sizeof(uint64_t)*Encoding::SAMPLE_WIDTH*BLOCK_WORDS);
+      unsigned offset = 0;
+#if defined(__AVX2__)
+      for (; offset+32<=count; offset+=32) {
+         toPlanes32(samples+offset, current, offset);
+      }
+#endif
+      for (; offset<count; offset+=ROW_BITS) {
+         Sample rows[ROW_BITS] = {};
+         memcpy(rows, samples+offset, sizeof(Sample)*std::min(ROW_BITS, count-offset));
+         transposeBits(rows);
+         for (unsigned pin=0; pin<Encoding::SAMPLE_WIDTH; pin++) {
+            current[pin][offset/64] |= (uint64_t)rows[pin]<<(offset%64);
+         }
+      }
+      for (unsigned pin=0; pin<Encoding::SAMPLE_WIDTH; pin++) {
+         uint64_t carry = (previous>>pin)&1;
+         for (unsigned index=0; index<BLOCK_WORDS; index++) {
+            last[pin][index] = (current[pin][index]<<1)|carry;
+            carry = current[pin][index]>>63;
+         }
+      }
+   }
+
+   /**
+    * Evaluate the pattern matchers and combiner of a step for a block of samples
+    *
+    * @param step     Step to evaluate
+    * @param current  Plane per pin of samples
+    * @param last     Plane per pin of samples delayed by one
+    * @param matches  Bit n set if sample n matches
+    */
+   void matchBlock(
+         unsigned       step,
+         const uint64_t current[Encoding::SAMPLE_WIDTH][BLOCK_WORDS],
+         const uint64_t last[Encoding::SAMPLE_WIDTH][BLOCK_WORDS],
+         uint64_t       matches[BLOCK_WORDS]) const {
+
+      Plane conditions[4] = {Plane::ones(), Plane::ones(), Plane::zeros(), Plane::zeros()};
+      for (unsigned condition=2; condition<PATTERNS; condition++) {
+         conditions[condition] = Plane::ones();
+      }
+      for (const PatternTerm &term:steps[step].terms) {
+         conditions[term.condition] = conditions[term.condition] & lut4(term.table,
+               Plane::load(current[2*term.pair]),   Plane::load(last[2*term.pair]),
+               Plane::load(current[2*term.pair+1]), Plane::load(last[2*term.pair+1]));
+      }
+      lut4(steps[step].combiner, conditions[0], conditions[1], conditions[2], conditions[3]).store(matches);
+   }
+
+   /**
+    * Evaluate the pattern matchers and combiner of a step for one sample
+    *
+    * @param step     Step to evaluate
+    * @param current  Sample
+    * @param last     Previous sample
+    *
+    * @return Trigger for step (triggers(step))
+    */
+   bool matchSample(unsigned step, Sample current, Sample last) const {
+      unsigned conditions = (1U<<PATTERNS)-1;
+      for (const PatternTerm &term:steps[step].terms) {
+         unsigned index =
+               8*((last>>(2*term.pair+1))&1)    + 4*((current>>(2*term.pair+1))&1) +
+               2*((last>>(2*term.pair))&1)      + ((current>>(2*term.pair))&1);
+         if (((term.table>>index)&1) == 0) {
+            conditions &= ~(1U<<term.condition);
+         }
+      }
+      return (steps[step].combiner>>conditions)&1;
+   }
+
+   /**
+    * Get number of matches needed before the count matches i.e. including the match
+    * where the match counter equals the compare value
+    *
+    * @return Number of matches [1..65535] or 0 if the count never matches
+    */
+   unsigned matchesNeeded() const {
+      uint16_t compare = steps[stepCounter].countCompare;
+      if (compare == 0) {
+         // LFSR never reaches 0
+         return 0;
+      }
+      return 1+((LFSR_PERIOD+Lfsr16::decode(compare)-Lfsr16::decode(matchCounter))%LFSR_PERIOD);
+   }
+
+   /**
+    * Length of the run of equal bits starting at a position
+    *
+    * @param words   Bits to search
+    * @param start   Start position
+    * @param end     End position
+    *
+    * @return Length of run (stops at end)
+    */
+   static unsigned runLength(const uint64_t words[BLOCK_WORDS], unsigned start, unsigned end) {
+      const uint64_t invert = ((words[start/64]>>(start%64))&1)?~0ULL:0;
+      unsigned position = start;
+      while (position < end) {
+         uint64_t bits = (words[position/64]^invert)>>(position%64);
+         if (bits != 0) {
+            position += __builtin_ctzll(bits);
+            break;
+         }
+         position = (position|63)+1;
+      }
+      return std::min(position, end)-start;
+   }
+
+   /**
+    * Get word of bits restricted to a range of positions
+    *
+    * @param words   Bits
+    * @param index   Word index
+    * @param start   Start position
+    * @param end     End position
+    *
+    * @return Bits of words[index] within [start, end)
+    */
+   static uint64_t maskedWord(const uint64_t words[BLOCK_WORDS], unsigned index, unsigned start, unsigned end) {
+      uint64_t bits = words[index];
+      if (index == start/64) {
+         bits &= ~0ULL<<(start%64);
+      }
+      if ((index == (end-1)/64) && ((end%64) != 0)) {
+         bits &= ~(~0ULL<<(end%64));
+      }
+      return bits;
+   }
+
+   /**
+    * Position of the n-th set bit at or after a position
+    *
+    * @param words   Bits to search
+    * @param start   Start position
+    * @param end     End position
+    * @param n       Bit to find [1..]
+    *
+    * @return Position or end if there are fewer than n bits set
+    */
+   static unsigned findSetBit(const uint64_t words[BLOCK_WORDS], unsigned start, unsigned end, unsigned n) {
+      for (unsigned index=start/64; index<=(end-1)/64; index++) {
+         uint64_t bits  = maskedWord(words, index, start, end);
+         unsigned count = __builtin_popcountll(bits);
+         if (count >= n) {
+            while (--n > 0) {
+               bits &= bits-1;
+            }
+            return 64*index+__builtin_ctzll(bits);
+         }
+         n -= count;
+      }
+      return end;
+   }
+
+   /**
+    * Count set bits in a range of positions
+    *
+    * @param words   Bits to count
+    * @param start   Start position
+    * @param end     End position
+    *
+    * @return Number of bits set
+    */
+   static unsigned countSetBits(const uint64_t words[BLOCK_WORDS], unsigned start, unsigned end) {
+      unsigned count = 0;
+      for (unsigned index=start/64; index<=(end-1)/64; index++) {
+         count += __builtin_popcountll(maskedWord(words, index, start, end));
+      }
+      return count;
+   }
+
+   /**
+    * Run the state machine over a block of pattern matches for the current step
+    *
+    * @param matches  Bit n set if sample n matches
+    * @param start    Position to start
+    * @param end      Position to stop
+    *
+    * @return Position of the match that satisfies the step or end if none
+    */
+   unsigned runStep(const uint64_t matches[BLOCK_WORDS], unsigned start, unsigned end) {
+      unsigned needed = matchesNeeded();
+      if (!steps[stepCounter].contiguous) {
+         if (needed != 0) {
+            unsigned position = findSetBit(matches, start, end, needed);
+            if (position < end) {
+               // Match counter has reached the compare value
+               matchCounter = steps[stepCounter].countCompare;
+               return position;
+            }
+         }
+         matchCounter = Lfsr16::jump(matchCounter, countSetBits(matches, start, end));
+         return end;
+      }
+      // Match counter is advanced from base by count
+      uint16_t base     = matchCounter;
+      unsigned count    = 0;
+      unsigned position = start;
+      while (position < end) {
+         unsigned length = runLength(matches, position, end);
+         if ((matches[position/64]>>(position%64))&1) {
+            if ((needed != 0) && (length >= needed)) {
+               matchCounter = steps[stepCounter].countCompare;
+               return position+needed-1;
+            }
+            count += length;
+            if (needed != 0) {
+               needed -= length;
+            }
+         }
+         else {
+            base   = 1;
+            count  = 0;
+            needed = steps[stepCounter].resetNeeded;
+         }
+         position += length;
+      }
+      matchCounter = Lfsr16::jump(base, count);
+      return end;
+   }
+
+   /**
+    * State machine action for a match that also matches the count
+    */
+   void completeStep() {
+      matchCounter = Lfsr16::calcNextValue(matchCounter);
+      if (steps[stepCounter].last) {
+         triggerFound = true;
+         state        = s_complete;
+      }
+      else {
+         stepCounter  = (stepCounter+1)%STEPS;
+         matchCounter = 1;
+      }
+   }
+
+   /**
+    * State machine with enable = '0'
+    */
+   void disable() {
+      state        = s_idle;
+      stepCounter  = 0;
+      matchCounter = 1;
+      triggerFound = false;
+   }
+
+public:
+   TriggerModel() {
+      load(LutImage{});
+   }
+
+   /**
+    * Construct model with LUT configuration
+    *
+    * @param lutImage LUT image e.g. from TriggerSetup::getLutImage()
+    */
+   TriggerModel(const LutImage &lutImage) {
+      load(lutImage);
+   }
+
+   /**
+    * Load LUT configuration
+    *
+    * @param lutImage LUT image e.g. from TriggerSetup::getLutImage()
+    */
+   void load(const LutImage &lutImage) {
+      auto lut = [&](unsigned index) {
+         return
+               (uint32_t)lutImage[4*index+0]<<24 | (uint32_t)lutImage[4*index+1]<<16 |
+               (uint32_t)lutImage[4*index+2]<<8  | (uint32_t)lutImage[4*index+3];
+      };
+      // The first LUT in the image is the furthest along the LUT chain i.e. the highest step
+      for (unsigned step=0; step<STEPS; step++) {
+         StepLuts &luts = steps[step];
+
+         luts.terms.clear();
+         unsigned lutIndex = Encoding::START_TRIGGER_PATTERN_LUTS+(STEPS-1-step)*Encoding::LUTS_PER_TRIGGER_STEP_FOR_PATTERNS;
+         for (int block=BLOCKS-1; block>=0; block--) {
+            for (int pair=PIN_PAIRS-1; pair>=0; pair--) {
+               uint32_t value = lut(lutIndex++);
+               for (unsigned half=0; half<2; half++) {
+                  uint16_t table = (uint16_t)(value>>(16*half));
+                  if (table != 0xFFFF) {
+                     luts.terms.push_back(PatternTerm{(uint8_t)(2*block+half), (uint8_t)pair, table});
+                  }
+               }
+            }
+         }
+         luts.combiner = (uint16_t)lut(Encoding::START_TRIGGER_COMBINER_LUTS+(STEPS-1-step));
+         if (PATTERNS == 2) {
+            // i3, i2 are tied low
+            luts.combiner &= 0xF;
+         }
+         luts.countCompare = 0;
+         for (unsigned bit=0; bit<Encoding::NUM_MATCH_COUNTER_BITS; bit++) {
+            uint32_t value = lut(Encoding::START_TRIGGER_COUNT_LUTS+(Encoding::NUM_MATCH_COUNTER_BITS-1-bit));
+            luts.countCompare |= ((value>>step)&1)<<bit;
+         }
+         // LFSR never reaches 0
+         luts.resetNeeded = (luts.countCompare == 0)?0:Lfsr16::decode(luts.countCompare);
+         luts.last        = (lut(Encoding::START_TRIGGER_FLAG_LUTS+0)>>step)&1;
+         luts.contiguous  = (lut(Encoding::START_TRIGGER_FLAG_LUTS+1)>>step)&1;
+      }
+   }
+
+   virtual void load(const uint8_t lutImage[], size_t size) override {
+      if (size != sizeof(LutImage)) {
+         fprintf(stderr, "TriggerModel::load() - LUT image is %u bytes, expected %u\n", (unsigned)size, (unsigned)sizeof(LutImage));
+         throw MyException("TriggerModel::load() - LUT image is %u bytes, expected %u", (unsigned)size, (unsigned)sizeof(LutImage));
+      }
+      LutImage image;
+      memcpy(image.data(), lutImage, size);
+      load(image);
+   }
+
+   virtual void reset(uint32_t sample = 0) override {
+      disable();
+      for (Sample &value:history) {
+         value = (Sample)sample;
+      }
+   }
+
+   virtual bool clock(uint32_t sample, bool enable) override {
+      // Sampling_proc, conditionFFs and triggerFFs
+      history[3] = history[2];
+      history[2] = history[1];
+      history[1] = history[0];
+      history[0] = (Sample)sample;
+
+      if (!enable) {
+         disable();
+         return triggerFound;
+      }
+      switch(state) {
+         case s_idle:
+            stepCounter  = 0;
+            matchCounter = 1;
+            triggerFound = false;
+            state        = s_running;
+            break;
+         case s_running:
+            if (matchSample(stepCounter, history[PIPELINE_DELAY], history[PIPELINE_DELAY+1])) {
+               if (steps[stepCounter].countCompare == matchCounter) {
+                  completeStep();
+               }
+               else {
+                  matchCounter = Lfsr16::calcNextValue(matchCounter);
+               }
+            }
+            else if (steps[stepCounter].contiguous) {
+               matchCounter = 1;
+            }
+            break;
+         case s_complete:
+            triggerFound = false;
+            break;
+      }
+      return triggerFound;
+   }
+
+   virtual unsigned getStep() const override {
+      return stepCounter;
+   }
+
+   virtual uint16_t getMatchCounter() const override {
+      return matchCounter;
+   }
+
+   /**
+    * Search stored samples for the trigger.
+    * Each sample is evaluated with the one before as lastSample (as the hardware) but without the
+    * pipeline delay. The first sample is treated as its own previous value.
+    *
+    * @param samples  Samples to search
+    * @param count    Number of samples
+    *
+    * @return Index of the sample that completes the trigger sequence or -1 if not found.
+    *         The hardware marks the sample PIPELINE_DELAY+1 later as the trigger sample.
+    */
+   long findTrigger(const Sample samples[], size_t count) {
+      reset((count>0)?samples[0]:0);
+      state = s_running;
+
+      uint64_t current[Encoding::SAMPLE_WIDTH][BLOCK_WORDS];
+      uint64_t last[Encoding::SAMPLE_WIDTH][BLOCK_WORDS];
+      uint64_t matches[BLOCK_WORDS];
+
+      size_t   blockStart  = 0;
+      unsigned blockStep   = STEPS;
+      unsigned blockLength = 0;
+      size_t   index       = 0;
+      while (index < count) {
+         if (index >= blockStart+blockLength) {
+            // Next block of samples
+            blockStart  = index;
+            blockLength = (unsigned)std::min((size_t)BLOCK_SAMPLES, count-index);
+            toPlanes(samples+blockStart, blockLength, samples[(blockStart>0)?blockStart-1:0], current, last);
+            blockStep   = STEPS;
+         }
+         if (blockStep != stepCounter) {
+            blockStep = stepCounter;
+            matchBlock(blockStep, current, last, matches);
+         }
+         unsigned position = runStep(matches, (unsigned)(index-blockStart), blockLength);
+         index = blockStart+position;
+         if (position < blockLength) {
+            completeStep();
+            if (state == s_complete) {
+               return (long)index;
+            }
+            index++;
+         }
+      }
+      return -1;
+   }
+};
+
+/**
+ * Create a trigger model for analyser hardware
+ *
+ * @param config Hardware configuration (from readConfig())
+ *
+ * @return Model
+ *
+ * @throw MyException if there is no trigger encoding for the hardware
+ */
+inline std::unique_ptr<TriggerPipeline> makeTriggerModel(const AnalyserConfig &config) {
+   return withTriggerEncoding(config, [](auto tag) -> std::unique_ptr<TriggerPipeline> {
+      return std::make_unique<TriggerModel<typename decltype(tag)::Encoding>>();
+   });
+}
+
+}  // end namespace Analyser
+
+#endif /* SOURCES_TRIGGERMODEL_H_ */
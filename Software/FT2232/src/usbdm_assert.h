@@ -24,7 +24,7 @@ inline void log_error(const char *msg) {
 
 inline void _usbdm_assert(const char *msg) {
    log_error(msg);
-   ::_exit(-1);
+   ::_Exit(-1);
 }
 
 } // End namespace USBDM
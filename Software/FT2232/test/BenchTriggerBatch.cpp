@@ -0,0 +1,89 @@
+//============================================================================
+// Name        : BenchTriggerBatch.cpp
+// Author      : pgo
+// Times TriggerBatch against running TriggerModel and findTrigger() per setup
+//============================================================================
+//
+// 64 variants of a two-step trigger are evaluated over 4M random samples:
+//  - In one pass with TriggerBatch
+//  - With TriggerModel::findTrigger() (vectorised) once for each variant
+//  - With findTrigger() (scalar reference in TriggerCompiler.h) once for each variant
+// The results of the three must agree.
+//
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "EncodeLuts.h"
+#include "TriggerModel.h"
+#include "TriggerCompiler.h"
+#include "TriggerBatch.h"
+#include "Check.h"
+
+using namespace Analyser;
+
+using Encoding = AnalyserTriggerEncoding;
+using Clock    = std::chrono::steady_clock;
+
+/**
+ * Get time since start in ms
+ */
+static double elapsed_ms(Clock::time_point start) {
+   return std::chrono::duration<double, std::milli>(Clock::now()-start).count();
+}
+
+int main() {
+   constexpr unsigned LENGTH = 1U<<22;
+
+   std::mt19937          random(3);
+   std::vector<uint16_t> samples(LENGTH);
+   for (uint16_t &sample:samples) {
+      sample = (uint16_t)random();
+   }
+   const std::vector<uint32_t> wideSamples(samples.begin(), samples.end());
+
+   TriggerBatch<Encoding>             batch;
+   std::vector<Encoding::TriggerSetup> setups;
+   for (unsigned variant=0; variant<TriggerBatch<Encoding>::MAX_CANDIDATES; variant++) {
+      char text[100];
+      snprintf(text, sizeof(text), "D0..5 == %u x %u then D8 rising && D9 low x %u", variant, 20000+100*variant, 1000+997*variant);
+      setups.push_back(compileTrigger<Encoding>(text, SampleRate_100ns, 100, 10, false));
+      batch.add(setups.back());
+   }
+
+   Clock::time_point start = Clock::now();
+   const std::vector<TriggerBatchResult> results = batch.evaluate(samples.data(), samples.size());
+   const double batch_ms = elapsed_ms(start);
+
+   std::vector<long> modelResults;
+   start = Clock::now();
+   for (const Encoding::TriggerSetup &setup:setups) {
+      TriggerModel<Encoding> model(setup.getLutImage());
+      modelResults.push_back(model.findTrigger(samples.data(), samples.size()));
+   }
+   const double model_ms = elapsed_ms(start);
+
+   std::vector<long> referenceResults;
+   start = Clock::now();
+   for (const Encoding::TriggerSetup &setup:setups) {
+      referenceResults.push_back(findTrigger(setup, wideSamples.data(), wideSamples.size()));
+   }
+   const double reference_ms = elapsed_ms(start);
+
+   unsigned found = 0;
+   for (unsigned index=0; index<setups.size(); index++) {
+      CHECK((results[index].index == modelResults[index]) && (modelResults[index] == referenceResults[index]),
+            "Variant %u: batch %ld, model %ld, reference %ld", index, results[index].index, modelResults[index], referenceResults[index]);
+      if (results[index].found) {
+         found++;
+      }
+   }
+   printf("%u variants over %u samples (%u triggered)\n", (unsigned)setups.size(), LENGTH, found);
+   printf("TriggerBatch (one pass)  = %8.1f ms\n", batch_ms);
+   printf("TriggerModel x %u        = %8.1f ms\n", (unsigned)setups.size(), model_ms);
+   printf("findTrigger() x %u       = %8.1f ms\n", (unsigned)setups.size(), reference_ms);
+
+   return checkResult("BenchTriggerBatch");
+}
@@ -0,0 +1,78 @@
+/*
+ * Check.h
+ *
+ *  Created on: 3 Sep 2019
+ *      Author: podonoghue
+ */
+
+#ifndef TEST_CHECK_H_
+#define TEST_CHECK_H_
+
+#include <stdio.h>
+
+/// Number of failed checks in this test program
+static unsigned checkFailures = 0;
+
+/**
+ * Report a failed check and continue
+ * main() returns checkResult() so any failure makes the test fail
+ *
+ * @param condition  Condition that should be true
+ * @param ...        printf() style description of the failure
+ */
+#define CHECK(condition, ...)                                        \
+   do {                                                              \
+      if (!(condition)) {                                            \
+         fprintf(stderr, "%s:%d: ", __FILE__, __LINE__);             \
+         fprintf(stderr, __VA_ARGS__);                               \
+         fprintf(stderr, "\n");                                      \
+         checkFailures++;                                            \
+      }                                                              \
+   } while (false)
+
+/**
+ * Print summary of checks
+ *
+ * @param name Name of test program
+ *
+ * @return Exit code for main() (0 => all checks passed)
+ */
+static inline int checkResult(const char *name) {
+   if (checkFailures > 0) {
+      printf("%s: %u check(s) FAILED\n", name, checkFailures);
+      return 1;
+   }
+   printf("%s: passed\n", name);
+   return 0;
+}
+
+/// SIMD code path this test program was built for (appended to test names)
+#if defined(__AVX2__)
+#define SIMD_VARIANT " (AVX2)"
+#elif defined(__SSE2__)
+#define SIMD_VARIANT " (SSE2)"
+#else
+#define SIMD_VARIANT ""
+#endif
+
+/**
+ * Check the CPU can run this test program
+ * Builds with -mavx2 are skipped on CPUs without AVX2
+ *
+ * @param name Name of test program
+ *
+ * @return true if the test should be run
+ */
+static inline bool checkCpuSupport(const char *name) {
+#if defined(__AVX2__) && (defined(__GNUC__) || defined(__clang__))
+   if (!__builtin_cpu_supports("avx2")) {
+      printf("%s: skipped (CPU does not support AVX2)\n", name);
+      return false;
+   }
+#else
+   (void)name;
+#endif
+   return true;
+}
+
+#endif /* TEST_CHECK_H_ */
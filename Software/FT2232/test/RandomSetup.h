@@ -0,0 +1,56 @@
+/*
+ * RandomSetup.h
+ *
+ *  Created on: 3 Sep 2019
+ *      Author: podonoghue
+ */
+
+#ifndef TEST_RANDOMSETUP_H_
+#define TEST_RANDOMSETUP_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <random>
+
+#include "EncodeLuts.h"
+
+/**
+ * Create a random trigger setup of 1 to 4 steps
+ * Patterns are mostly 'X' so that the triggers complete on random samples.
+ *
+ * @tparam Encoding  Trigger encoding of FPGA variant
+ *
+ * @param random     Random number generator
+ * @param maxCount   Largest step count
+ *
+ * @return Setup
+ */
+template<typename Encoding>
+static typename Encoding::TriggerSetup randomSetup(std::mt19937 &random, unsigned maxCount = 4) {
+   using namespace Analyser;
+   using Step = typename Encoding::TriggerStep;
+
+   static const char pinValues[] = "01HLRFC";
+
+   Step     steps[Encoding::MAX_TRIGGER_STEPS];
+   unsigned lastStep = random()%4;
+   for (unsigned stepNum=0; stepNum<=lastStep; stepNum++) {
+      char        patterns[Encoding::MAX_TRIGGER_PATTERNS][Encoding::SAMPLE_WIDTH+1];
+      const char *patternPtrs[Encoding::MAX_TRIGGER_PATTERNS];
+      Polarity    polarities[Encoding::MAX_TRIGGER_PATTERNS];
+      for (unsigned patternNum=0; patternNum<Encoding::MAX_TRIGGER_PATTERNS; patternNum++) {
+         memset(patterns[patternNum], 'X', Encoding::SAMPLE_WIDTH);
+         patterns[patternNum][Encoding::SAMPLE_WIDTH] = '\0';
+         for (unsigned pins=random()%4; pins>0; pins--) {
+            patterns[patternNum][random()%Encoding::SAMPLE_WIDTH] = pinValues[random()%(sizeof(pinValues)-1)];
+         }
+         patternPtrs[patternNum] = patterns[patternNum];
+         polarities[patternNum]  = random()%3;
+      }
+      Operation operation = (random()%2)?Operation::And:Operation::Or;
+      steps[stepNum] = Step{patternPtrs, polarities, operation, (random()%4) == 0, (unsigned)(random()%(maxCount+1))};
+   }
+   return typename Encoding::TriggerSetup{steps, lastStep};
+}
+
+#endif /* TEST_RANDOMSETUP_H_ */
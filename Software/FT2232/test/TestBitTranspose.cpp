@@ -0,0 +1,126 @@
+//============================================================================
+// Name        : TestBitTranspose.cpp
+// Author      : pgo
+// Checks the bit-matrix transpose kernels against a bit-by-bit reference
+//============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <random>
+
+#include "BitTranspose.h"
+#include "Check.h"
+
+/**
+ * Transpose 16x16 matrix with only row 0 set (all ones)
+ * Every row of the result is 1
+ *
+ * @param row  Row of result to return
+ *
+ * @return Row of transposed matrix
+ */
+static constexpr uint16_t constantTranspose(unsigned row) {
+   uint16_t rows[16] = {0xFFFF};
+   transposeBits(rows);
+   return rows[row];
+}
+
+// The portable transpose is selected during constant evaluation
+static_assert(constantTranspose(0)  == 1, "transposeBits() at compile time");
+static_assert(constantTranspose(15) == 1, "transposeBits() at compile time");
+
+/**
+ * Reference transpose, one bit at a time
+ *
+ * @param rows Matrix to transpose in place
+ */
+template<typename T>
+static void referenceTranspose(T rows[]) {
+   constexpr unsigned size = 8*sizeof(T);
+
+   T result[size] = {};
+   for (unsigned row=0; row<size; row++) {
+      for (unsigned col=0; col<size; col++) {
+         if ((rows[row]>>col)&1) {
+            result[col] |= (T)((T)1<<row);
+         }
+      }
+   }
+   memcpy(rows, result, sizeof(result));
+}
+
+/**
+ * Check a transpose function against the reference on one matrix
+ *
+ * @param name       Name of function
+ * @param transpose  Function to check
+ * @param matrix     Matrix to transpose
+ */
+template<typename T>
+static void checkMatrix(const char *name, void (*transpose)(T rows[]), const T matrix[]) {
+   constexpr unsigned size = 8*sizeof(T);
+
+   T expected[size];
+   T result[size];
+   memcpy(expected, matrix, sizeof(expected));
+   memcpy(result,   matrix, sizeof(result));
+   referenceTranspose(expected);
+   transpose(result);
+   for (unsigned row=0; row<size; row++) {
+      if (result[row] != expected[row]) {
+         CHECK(false, "%s: row %u = 0x%llX, expected 0x%llX",
+               name, row, (unsigned long long)result[row], (unsigned long long)expected[row]);
+         return;
+      }
+   }
+}
+
+/**
+ * Check a transpose function on single bits at every position, all ones and random matrices
+ *
+ * @param name       Name of function
+ * @param transpose  Function to check
+ */
+template<typename T>
+static void checkTranspose(const char *name, void (*transpose)(T rows[])) {
+   constexpr unsigned size = 8*sizeof(T);
+
+   T matrix[size];
+   for (unsigned row=0; row<size; row++) {
+      for (unsigned col=0; col<size; col++) {
+         memset(matrix, 0, sizeof(matrix));
+         matrix[row] = (T)((T)1<<col);
+         checkMatrix(name, transpose, matrix);
+      }
+   }
+   memset(matrix, 0xFF, sizeof(matrix));
+   checkMatrix(name, transpose, matrix);
+
+   std::mt19937_64 random(size);
+   for (unsigned trial=0; trial<1000; trial++) {
+      for (T &row:matrix) {
+         row = (T)random();
+      }
+      checkMatrix(name, transpose, matrix);
+   }
+}
+
+int main() {
+   const char *name = "TestBitTranspose" SIMD_VARIANT;
+   if (!checkCpuSupport(name)) {
+      return 0;
+   }
+   checkTranspose<uint16_t>("transposeBitsPortable<uint16_t>", transposeBitsPortable<uint16_t>);
+   checkTranspose<uint32_t>("transposeBitsPortable<uint32_t>", transposeBitsPortable<uint32_t>);
+   checkTranspose<uint64_t>("transposeBitsPortable<uint64_t>", transposeBitsPortable<uint64_t>);
+#if defined(__SSE2__)
+   checkTranspose<uint16_t>("transposeBits16_sse2()", transposeBits16_sse2);
+   checkTranspose<uint32_t>("transposeBits32_simd()", transposeBits32_simd);
+   checkTranspose<uint64_t>("transposeBits64_simd()", transposeBits64_simd);
+#endif
+   checkTranspose<uint16_t>("transposeBits(uint16_t[])", transposeBits);
+   checkTranspose<uint32_t>("transposeBits(uint32_t[])", transposeBits);
+   checkTranspose<uint64_t>("transposeBits(uint64_t[])", transposeBits);
+
+   return checkResult(name);
+}
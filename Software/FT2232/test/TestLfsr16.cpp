@@ -0,0 +1,64 @@
+//============================================================================
+// Name        : TestLfsr16.cpp
+// Author      : pgo
+// Checks the LFSR used for the trigger match counters
+//============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <random>
+
+#include "Lfsr16.h"
+#include "Check.h"
+
+// Encoder may be used in constant expressions (compile-time LUT images)
+static_assert(Lfsr16::encode(1) == 1,                                                  "encode(1)");
+static_assert(Lfsr16::encode(2) == Lfsr16::calcNextValue(1),                           "encode(2)");
+static_assert(Lfsr16::jump(0xACE1, 2) == Lfsr16::calcNextValue(Lfsr16::calcNextValue(0xACE1)), "jump(2)");
+static_assert(Lfsr16::jump(0xACE1, 0xFFFF) == 0xACE1,                                  "Period is 65535");
+
+/**
+ * Check encode() and decode() against stepping through the sequence
+ */
+static void checkEncodeDecode() {
+   CHECK(Lfsr16::findPeriod() == 0xFFFF, "Period = %u", Lfsr16::findPeriod());
+
+   // Value 0 is not a valid count or state
+   CHECK(Lfsr16::decode(0) == 0, "decode(0) = %u", Lfsr16::decode(0));
+
+   uint16_t lfsr = 1;
+   for (uint32_t value=1; value<=0xFFFF; value++) {
+      CHECK(Lfsr16::encode(value) == lfsr,  "encode(%u) = 0x%04X, expected 0x%04X", value, Lfsr16::encode(value), lfsr);
+      CHECK(Lfsr16::decode(lfsr)  == value, "decode(0x%04X) = %u, expected %u", lfsr, Lfsr16::decode(lfsr), value);
+      lfsr = Lfsr16::calcNextValue(lfsr);
+   }
+   // Every non-zero state is reached i.e. decode() is the inverse of encode()
+   for (uint32_t state=1; state<=0xFFFF; state++) {
+      const uint16_t value = Lfsr16::decode(state);
+      CHECK((value != 0) && (Lfsr16::encode(value) == state), "encode(decode(0x%04X)) = 0x%04X", state, Lfsr16::encode(value));
+   }
+}
+
+/**
+ * Check jump() against stepping from random states
+ */
+static void checkJump() {
+   std::mt19937 random(16);
+   for (unsigned trial=0; trial<1000; trial++) {
+      const uint16_t start = 1+random()%0xFFFF;
+      const unsigned steps = random()%(3*0xFFFF);
+
+      // Sequence repeats every 65535 steps
+      uint16_t lfsr = start;
+      for (unsigned step=0; step<(steps%0xFFFF); step++) {
+         lfsr = Lfsr16::calcNextValue(lfsr);
+      }
+      CHECK(Lfsr16::jump(start, steps) == lfsr, "jump(0x%04X, %u) = 0x%04X, expected 0x%04X", start, steps, Lfsr16::jump(start, steps), lfsr);
+   }
+}
+
+int main() {
+   checkEncodeDecode();
+   checkJump();
+
+   return checkResult("TestLfsr16");
+}
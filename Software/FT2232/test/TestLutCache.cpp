@@ -0,0 +1,355 @@
+//============================================================================
+// Name        : TestLutCache.cpp
+// Author      : pgo
+// Checks LutCache uploads of trigger setups through the emulator
+//============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "EncodeLuts.h"
+#include "FT2232_Emulator.h"
+#include "AnalyserCommands.h"
+#include "CommandBuilder.h"
+#include "LutCache.h"
+#include "RandomSetup.h"
+#include "Check.h"
+
+using namespace Analyser;
+
+/// LUT bytes in each command (large enough that no image is split)
+static constexpr unsigned BLOCK_SIZE = CommandBuilder::MAX_LUT_BLOCK_SIZE;
+
+/**
+ * Expected result of an upload
+ */
+struct Upload {
+   bool     fullWrite;     //!< Complete image sent with C_LUT_CONFIG
+   unsigned lutBytes;      //!< LUT bytes sent (value returned by LutCache::writeLuts())
+   unsigned commandBytes;  //!< Size of the commands
+   unsigned ranges;        //!< Number of C_LUT_UPDATE ranges
+   bool     gapResent;     //!< An unchanged LUT between two changed LUTs is re-sent
+};
+
+/// Occurrences of each case so the test can check they were all exercised
+struct Coverage {
+   unsigned unchanged      = 0;   //!< Same hash, nothing sent
+   unsigned sameImage      = 0;   //!< Different hash but same image, nothing sent
+   unsigned fullWrites     = 0;   //!< C_LUT_CONFIG
+   unsigned costlyUpdates  = 0;   //!< C_LUT_CONFIG as C_LUT_UPDATE would be no smaller
+   unsigned singleRanges   = 0;   //!< C_LUT_UPDATE of one range
+   unsigned multipleRanges = 0;   //!< C_LUT_UPDATE of several ranges
+   unsigned gapsResent     = 0;   //!< C_LUT_UPDATE re-sending an unchanged LUT
+};
+
+/**
+ * Reference for the commands LutCache should use to change the LUTs from one image to another
+ *
+ * A C_LUT_UPDATE command costs LUT_UPDATE_OVERHEAD bytes which is more than a LUT.
+ * A single unchanged LUT between changed LUTs is therefore re-sent rather than
+ * starting another command. Longer gaps are recirculated by the next command.
+ * A command also recirculates any LUTs after the last change.
+ * The complete image is sent if this is no smaller.
+ *
+ * @param previous      Image in analyser (nullptr if unknown)
+ * @param next          Image required
+ * @param imageSize     Size of images in bytes
+ *
+ * @return Expected upload (ranges is that of the rejected update for a full write)
+ */
+static Upload referenceUpload(const uint8_t *previous, const uint8_t *next, unsigned imageSize) {
+   const unsigned fullCommandBytes = imageSize+3*((imageSize+BLOCK_SIZE-1)/BLOCK_SIZE);
+   if (previous == nullptr) {
+      return Upload{true, imageSize, fullCommandBytes, 0, false};
+   }
+   Upload   update      = {false, 0, 0, 0, false};
+   unsigned lastChanged = 0;
+   for (unsigned lut=0; lut<imageSize/4; lut++) {
+      if (memcmp(previous+4*lut, next+4*lut, 4) == 0) {
+         continue;
+      }
+      if ((update.ranges > 0) && (lut <= lastChanged+2)) {
+         // Continue range, re-sending any unchanged LUT in between
+         update.gapResent |= (lut == lastChanged+2);
+         update.lutBytes  += 4*(lut-lastChanged);
+      }
+      else {
+         update.ranges++;
+         update.lutBytes     += 4;
+         update.commandBytes += LutCache::LUT_UPDATE_OVERHEAD;
+      }
+      lastChanged = lut;
+   }
+   if ((update.ranges > 0) && (lastChanged < (imageSize/4-1))) {
+      update.commandBytes += LutCache::LUT_UPDATE_OVERHEAD;
+   }
+   update.commandBytes += update.lutBytes;
+   if (update.commandBytes >= imageSize) {
+      return Upload{true, imageSize, fullCommandBytes, update.ranges, false};
+   }
+   return update;
+}
+
+/**
+ * Copy a step changing either its count or one pin of one pattern
+ *
+ * @param random  Random number generator
+ * @param step    Step to copy
+ *
+ * @return Changed step
+ */
+template<typename Encoding>
+static typename Encoding::TriggerStep editStep(std::mt19937 &random, const typename Encoding::TriggerStep &step) {
+   static const char pinValues[] = "X01HLRFC";
+
+   char        patterns[Encoding::MAX_TRIGGER_PATTERNS][Encoding::SAMPLE_WIDTH+1];
+   const char *patternPtrs[Encoding::MAX_TRIGGER_PATTERNS];
+   Polarity    polarities[Encoding::MAX_TRIGGER_PATTERNS];
+   for (unsigned patternNum=0; patternNum<Encoding::MAX_TRIGGER_PATTERNS; patternNum++) {
+      strcpy(patterns[patternNum], step.getPattern(patternNum).toString());
+      patternPtrs[patternNum] = patterns[patternNum];
+      polarities[patternNum]  = step.getPolarities(patternNum);
+   }
+   unsigned count = step.getCount();
+   if (random()%2) {
+      count = random()%1000;
+   }
+   else {
+      patterns[random()%Encoding::MAX_TRIGGER_PATTERNS][random()%Encoding::SAMPLE_WIDTH] =
+            pinValues[random()%(sizeof(pinValues)-1)];
+   }
+   return typename Encoding::TriggerStep{patternPtrs, polarities, step.getOperation(), step.isContiguous(), count};
+}
+
+/**
+ * Create a setup that differs from another by a random amount
+ *
+ * @param random  Random number generator
+ * @param setup   Setup to change
+ *
+ * @return New setup
+ */
+template<typename Encoding>
+static typename Encoding::TriggerSetup changeSetup(std::mt19937 &random, const typename Encoding::TriggerSetup &setup) {
+   using Setup = typename Encoding::TriggerSetup;
+   using Step  = typename Encoding::TriggerStep;
+
+   Step steps[Encoding::MAX_TRIGGER_STEPS];
+   for (unsigned stepNum=0; stepNum<Encoding::MAX_TRIGGER_STEPS; stepNum++) {
+      steps[stepNum] = setup.getTrigger(stepNum);
+   }
+   unsigned   lastStep   = setup.getLastActiveTriggerCount();
+   SampleRate sampleRate = setup.getSampleRate();
+   unsigned   sampleSize = setup.getSampleSize();
+
+   const Setup other = randomSetup<Encoding>(random, 1000);
+   switch(random()%8) {
+      case 0:
+         // Same triggers, different capture
+         sampleRate = (sampleRate == SampleRate_100ns)?SampleRate_1us:SampleRate_100ns;
+         sampleSize = 100+random()%1000;
+         break;
+      case 1:
+         // Different setup
+         return other;
+      case 2:
+         // Different number of steps
+         lastStep = random()%4;
+         break;
+      case 3:
+         // Step replaced
+         steps[random()%4] = other.getTrigger(0);
+         break;
+      default:
+         // Small changes to one or more steps
+         for (unsigned edits=1+random()%3; edits>0; edits--) {
+            const unsigned stepNum = random()%4;
+            steps[stepNum] = editStep<Encoding>(random, steps[stepNum]);
+         }
+         break;
+   }
+   return Setup{steps, lastStep, sampleRate, sampleSize, sampleSize/2};
+}
+
+/**
+ * Create a setup with every step the same
+ *
+ * @param pinValue    Value of every pin of every pattern
+ * @param polarity    Polarity of every pattern
+ * @param operation   Operation of every step
+ * @param contiguous  Contiguous matching of every step
+ * @param count       Count of every step
+ *
+ * @return Setup using all steps
+ */
+template<typename Encoding>
+static typename Encoding::TriggerSetup uniformSetup(
+      char pinValue, Polarity polarity, Operation operation, bool contiguous, unsigned count) {
+   using Step = typename Encoding::TriggerStep;
+
+   char        pattern[Encoding::SAMPLE_WIDTH+1];
+   const char *patternPtrs[Encoding::MAX_TRIGGER_PATTERNS];
+   Polarity    polarities[Encoding::MAX_TRIGGER_PATTERNS];
+   memset(pattern, pinValue, Encoding::SAMPLE_WIDTH);
+   pattern[Encoding::SAMPLE_WIDTH] = '\0';
+   for (unsigned patternNum=0; patternNum<Encoding::MAX_TRIGGER_PATTERNS; patternNum++) {
+      patternPtrs[patternNum] = pattern;
+      polarities[patternNum]  = polarity;
+   }
+   Step steps[Encoding::MAX_TRIGGER_STEPS];
+   for (unsigned stepNum=0; stepNum<Encoding::MAX_TRIGGER_STEPS; stepNum++) {
+      steps[stepNum] = Step{patternPtrs, polarities, operation, contiguous, count};
+   }
+   return typename Encoding::TriggerSetup{steps, Encoding::MAX_TRIGGER_STEPS-1};
+}
+
+/**
+ * Upload a setup through the cache and check
+ *  - The commands (C_LUT_CONFIG or C_LUT_UPDATE), their size and the LUT bytes reported are as expected
+ *  - A setup with the same LUT hash as the previous setup sends nothing
+ *  - The LUTs of the emulator match those loaded by a full CommandBuilder::writeLuts()
+ *
+ * @param name       Name of encoding
+ * @param analyser   Session using the cache
+ * @param emulator   Emulator of session
+ * @param reference  Emulator used to load the setup with a full write
+ * @param setup      Setup to upload
+ * @param previous   Setup last uploaded (nullptr if the cache is not valid)
+ * @param coverage   Updated with the cases seen
+ */
+template<typename Setup>
+static void checkUpload(
+      const char *name, AnalyserSession &analyser, FT2232_Emulator &emulator, FT2232_Emulator &reference,
+      const Setup &setup, const Setup *previous, Coverage &coverage) {
+
+   LutCache      &cache     = analyser.getLutCache();
+   const auto     image     = setup.getLutImage();
+   const unsigned imageSize = image.size();
+
+   Upload expected = {false, 0, 0, 0, false};
+   if ((previous == nullptr) || (previous->getLutHash() != setup.getLutHash())) {
+      const auto previousImage = (previous != nullptr)?previous->getLutImage():image;
+      expected = referenceUpload(((previous != nullptr) && cache.isDifferential())?previousImage.data():nullptr,
+                                 image.data(), imageSize);
+   }
+   CommandBuilder commands;
+   const unsigned lutBytes = cache.writeLuts(commands, setup, BLOCK_SIZE);
+
+   CHECK(lutBytes == expected.lutBytes, "%s: writeLuts() sent %u LUT bytes, expected %u",
+         name, lutBytes, expected.lutBytes);
+   CHECK(commands.size() == expected.commandBytes, "%s: writeLuts() added %u command bytes, expected %u",
+         name, commands.size(), expected.commandBytes);
+   if (commands.size() > 0) {
+      const uint8_t command = expected.fullWrite?C_LUT_CONFIG:C_LUT_UPDATE;
+      CHECK(commands.data()[0] == command, "%s: writeLuts() used command 0x%02X, expected 0x%02X",
+            name, commands.data()[0], command);
+      commands.execute(emulator);
+   }
+   CHECK(cache.isValid(), "%s: cache not valid after writeLuts()", name);
+
+   if (expected.fullWrite) {
+      unsigned &count = (expected.ranges > 0)?coverage.costlyUpdates:coverage.fullWrites;
+      count++;
+   }
+   else if (expected.ranges > 0) {
+      unsigned &count = (expected.ranges > 1)?coverage.multipleRanges:coverage.singleRanges;
+      count++;
+      coverage.gapsResent += expected.gapResent;
+   }
+   else {
+      unsigned &count = (previous->getLutHash() == setup.getLutHash())?coverage.unchanged:coverage.sameImage;
+      count++;
+   }
+
+   // Same LUTs as a complete write of the setup
+   Setup          copy = setup;
+   CommandBuilder fullWrite;
+   fullWrite.writeLuts(copy).execute(reference);
+
+   const std::vector<uint8_t> &chain = emulator.getLutChain();
+   if ((chain != reference.getLutChain()) ||
+       (chain.size() != imageSize) || !std::equal(image.begin(), image.end(), chain.begin())) {
+      CHECK(false, "%s: emulator LUTs (%zu bytes) differ from complete write (%zu bytes)",
+            name, chain.size(), reference.getLutChain().size());
+   }
+}
+
+/**
+ * Upload a sequence of setups for an FPGA variant through the cache of an emulated analyser
+ * Each setup differs from the previous one by a random amount.
+ *
+ * @param name  Name of encoding
+ */
+template<typename Encoding>
+static void checkEncoding(const char *name) {
+   using Setup = typename Encoding::TriggerSetup;
+
+   FT2232_Emulator emulator(new CounterSignalSource(), IDEAL_LINK_MODEL, getEncodingConfig<Encoding>());
+   FT2232_Emulator reference(new CounterSignalSource(), IDEAL_LINK_MODEL, getEncodingConfig<Encoding>());
+   AnalyserSession analyser(emulator);
+   identifyAnalyser(analyser);
+
+   LutCache &cache = analyser.getLutCache();
+   CHECK(!cache.isValid(),      "%s: cache valid before first upload", name);
+   CHECK(cache.isDifferential(), "%s: emulator does not use C_LUT_UPDATE", name);
+
+   std::mt19937 random(Encoding::SAMPLE_WIDTH+Encoding::MAX_TRIGGER_PATTERNS);
+   Coverage     coverage;
+
+   Setup setup = randomSetup<Encoding>(random, 1000);
+   checkUpload(name, analyser, emulator, reference, setup, (const Setup *)nullptr, coverage);
+   CHECK(coverage.fullWrites == 1, "%s: first upload was not a complete write", name);
+
+   for (unsigned trial=0; trial<1000; trial++) {
+      const Setup next = changeSetup<Encoding>(random, setup);
+      checkUpload(name, analyser, emulator, reference, next, &setup, coverage);
+      setup = next;
+   }
+
+   // Changing almost every LUT costs more as C_LUT_UPDATE than a complete write
+   // The counts are chosen so that every bit of the encoded count changes
+   const Setup zeros = uniformSetup<Encoding>('0', Polarity::Normal, Operation::And, false, Lfsr16::decode(0x00FF));
+   const Setup ones  = uniformSetup<Encoding>('1', Polarity::Normal, Operation::Or,  true,  Lfsr16::decode(0xFF00));
+   checkUpload(name, analyser, emulator, reference, zeros, &setup, coverage);
+   const unsigned costlyUpdates = coverage.costlyUpdates;
+   checkUpload(name, analyser, emulator, reference, ones, &zeros, coverage);
+   CHECK(coverage.costlyUpdates == costlyUpdates+1, "%s: change of every step did not send complete image", name);
+   setup = ones;
+
+   // Same setup again
+   const unsigned unchanged = coverage.unchanged;
+   checkUpload(name, analyser, emulator, reference, setup, &setup, coverage);
+   CHECK(coverage.unchanged == unchanged+1, "%s: same setup was sent again", name);
+
+   // An invalidated cache sends the complete image even if unchanged
+   const unsigned fullWrites = coverage.fullWrites;
+   cache.invalidate();
+   checkUpload(name, analyser, emulator, reference, setup, (const Setup *)nullptr, coverage);
+   CHECK(coverage.fullWrites == fullWrites+1, "%s: invalidated cache did not send complete image", name);
+
+   // Without C_LUT_UPDATE every change sends the complete image
+   cache.setDifferential(false);
+   for (unsigned trial=0; trial<20; trial++) {
+      const Setup next = changeSetup<Encoding>(random, setup);
+      checkUpload(name, analyser, emulator, reference, next, &setup, coverage);
+      setup = next;
+   }
+
+   CHECK(coverage.unchanged      > 0, "%s: no unchanged setups",                        name);
+   CHECK(coverage.sameImage      > 0, "%s: no changed setups with the same LUTs",       name);
+   CHECK(coverage.singleRanges   > 0, "%s: no updates of a single range",               name);
+   CHECK(coverage.multipleRanges > 0, "%s: no updates of several ranges",               name);
+   CHECK(coverage.gapsResent     > 0, "%s: no updates re-sending an unchanged LUT",     name);
+}
+
+int main() {
+   checkEncoding<TriggerEncoding<16, 16, 2, 16>>("TriggerEncoding<16, 16, 2, 16>");
+   checkEncoding<TriggerEncoding<16, 16, 4, 16>>("TriggerEncoding<16, 16, 4, 16>");
+   checkEncoding<TriggerEncoding<32, 16, 2, 16>>("TriggerEncoding<32, 16, 2, 16>");
+   checkEncoding<TriggerEncoding<32, 16, 4, 16>>("TriggerEncoding<32, 16, 4, 16>");
+
+   return checkResult("TestLutCache");
+}
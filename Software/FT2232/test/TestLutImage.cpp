@@ -0,0 +1,218 @@
+//============================================================================
+// Name        : TestLutImage.cpp
+// Author      : pgo
+// Checks the trigger LUT images produced by TriggerEncoding
+//============================================================================
+//
+// - The images for AnalyserTriggerEncoding (16 inputs, 2 patterns) are compared
+//   with golden images produced by the original (pre-template) encoder.
+// - The compile-time image (getLutImage() in a constant expression) is compared
+//   with the run-time image.
+// - There is no earlier encoder for the other FPGA variants. For each of them random
+//   setups are encoded and the image is evaluated by TriggerModel (the LUT level model
+//   of TriggerBlock.vhd) and compared with findTrigger() which evaluates the setup directly.
+//
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <vector>
+
+#include "EncodeLuts.h"
+#include "TriggerModel.h"
+#include "TriggerCompiler.h"
+#include "RandomSetup.h"
+#include "Check.h"
+
+using namespace Analyser;
+
+constexpr TriggerStep trigger0x7FFFor0x7FFE[MAX_TRIGGER_STEPS] = {
+      //   Pattern 0              Pattern 1            Polarity 0          Polarity 1           Operation        Contiguous  Count
+      {   "0111111111111111",    "0111111111111110",   Polarity::Normal,   Polarity::Normal,    Operation::Or,   false,        1},
+};
+
+constexpr TriggerStep triggersEdges[MAX_TRIGGER_STEPS] = {
+      //   Pattern 0              Pattern 1            Polarity 0          Polarity 1           Operation        Contiguous  Count
+      {   "XXXXXXXXXXXXXXXR",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Disabled,  Operation::And,  false,        1},
+      {   "XXXXXXXXXXXXXXFX",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Disabled,  Operation::And,  false,        2},
+      {   "XXXXXXXXCXXXXXXX",    "HXXXXXXXXXXXXXXL",   Polarity::Normal,   Polarity::Normal,    Operation::And,  true,         3},
+      {   "RFCXHL01XXXXXXXX",    "XXXXXXXX10LHXCFR",   Polarity::Inverted, Polarity::Normal,    Operation::Or,   false,      100},
+};
+
+constexpr TriggerStep triggersCounts[MAX_TRIGGER_STEPS] = {
+      //   Pattern 0              Pattern 1            Polarity 0          Polarity 1           Operation        Contiguous  Count
+      {   "XXXXXXXXXXXXXXX1",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Inverted,  Operation::And,  false,        1},
+      {   "XXXXXXXXXXXXXX1X",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Inverted,  Operation::And,  true,         2},
+      {   "XXXXXXXXXXXXX1XX",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Inverted,  Operation::Or,   false,        7},
+      {   "XXXXXXXXXXXX1XXX",    "XXXXXXXXXXXXXXXX",   Polarity::Inverted, Polarity::Inverted,  Operation::And,  true,        10},
+      {   "XXXXXXXXXXX1XXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Normal,    Operation::Or,   false,       99},
+      {   "XXXXXXXXXX1XXXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Disabled,  Operation::And,  true,       255},
+      {   "XXXXXXXXX1XXXXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Disabled, Polarity::Normal,    Operation::And,  false,      256},
+      {   "XXXXXXXX1XXXXXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Normal,    Operation::And,  true,      1000},
+      {   "XXXXXXX1XXXXXXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Normal,    Operation::Or,   false,     4095},
+      {   "XXXXXX1XXXXXXXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Inverted, Polarity::Normal,    Operation::And,  true,      4096},
+      {   "XXXXX1XXXXXXXXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Inverted,  Operation::Or,   false,    12345},
+      {   "XXXX1XXXXXXXXXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Normal,    Operation::And,  true,     32767},
+      {   "XXX1XXXXXXXXXXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Normal,    Operation::Or,   false,    32768},
+      {   "XX1XXXXXXXXXXXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Disabled, Polarity::Disabled,  Operation::Or,   true,     50000},
+      {   "X1XXXXXXXXXXXXXX",    "XXXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Normal,    Operation::And,  false,    65534},
+      {   "1XXXXXXXXXXXXXXX",    "0XXXXXXXXXXXXXXX",   Polarity::Normal,   Polarity::Normal,    Operation::Or,   true,     65535},
+};
+
+/// Image built into the program
+constexpr LutImage trigger0x7FFFor0x7FFEImage = TriggerSetup{trigger0x7FFFor0x7FFE, 0}.getLutImage();
+
+/// trigger0x7FFFor0x7FFE (baseline encoder)
+static const uint32_t trigger0x7FFFor0x7FFELuts[TOTAL_TRIGGER_LUTS] = {
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x0A0A0A0A, 0xA0A0A0A0, 0xA0A0A0A0, 0xA0A0A0A0, 0xA0A0A0A0, 0xA0A0A0A0, 0xA0A0A0A0, 0x5050A0A0,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x0000000E,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000001,
+      0x00000001, 0x00000000,
+};
+
+/// triggersEdges (baseline encoder)
+static const uint32_t triggersEdgesLuts[TOTAL_TRIGGER_LUTS] = {
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0xFFFF0040, 0xFFFF0FF0, 0xFFFF5050, 0xFFFF0A0A, 0x5050FFFF, 0x0A0AFFFF, 0x6666FFFF, 0x0200FFFF,
+      0xF0F0FFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFF0FF0, 0xFFFFFFFF, 0xFFFFFFFF, 0x5555FFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFF0F00,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFF2222,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000,
+      0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x0000000D, 0x00000008, 0x0000000A, 0x0000000A,
+      0x0000000A, 0x0000000C, 0x00000002, 0x0000000E, 0x0000000C, 0x0000000A, 0x0000000C, 0x00000008,
+      0x00000000, 0x00000008, 0x00000000, 0x00000000, 0x00000008, 0x00000008, 0x00000008, 0x00000009,
+      0x00000008, 0x00000004,
+};
+
+/// triggersCounts (baseline encoder)
+static const uint32_t triggersCountsLuts[TOTAL_TRIGGER_LUTS] = {
+      0x0F0FF0F0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFAAAA, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFF0F0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFAAAA, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFF0F0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFAAAA, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFF0F0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFAAAA, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFF0F0, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFAAAA, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFF0F0, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFAAAA, 0xFFFFFFFF, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFF0F0, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFAAAA, 0xFFFFFFFF,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFF0F0,
+      0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFAAAA,
+      0x0000000E, 0x00000008, 0x00000000, 0x0000000E, 0x00000008, 0x0000000B, 0x00000004, 0x0000000E,
+      0x00000008, 0x0000000C, 0x0000000A, 0x0000000E, 0x00000001, 0x0000000B, 0x00000002, 0x00000002,
+      0x00002332, 0x000026D0, 0x00002622, 0x000007F2, 0x00002A60, 0x00003BD6, 0x000017B0, 0x00000EC4,
+      0x00003CBC, 0x000035E0, 0x000026EC, 0x000000D8, 0x00002D90, 0x00007798, 0x000086B0, 0x000025D1,
+      0x00008000, 0x0000AAAA,
+};
+
+/**
+ * Compare the image of a setup with a golden image
+ *
+ * @param name       Name of setup
+ * @param steps      Trigger steps
+ * @param lastStep   Last active step
+ * @param golden     Expected LUT values
+ */
+static void checkGoldenImage(const char *name, const TriggerStep steps[], unsigned lastStep, const uint32_t golden[]) {
+   const TriggerSetup setup{steps, lastStep};
+
+   uint32_t lutValues[TOTAL_TRIGGER_LUTS] = {0};
+   setup.getLutValues(lutValues);
+   for (unsigned index=0; index<TOTAL_TRIGGER_LUTS; index++) {
+      CHECK(lutValues[index] == golden[index], "%s: LUT[%u] = 0x%08X, expected 0x%08X", name, index, lutValues[index], golden[index]);
+   }
+   // Image is each LUT MSB first
+   const LutImage image = setup.getLutImage();
+   for (unsigned index=0; index<TOTAL_TRIGGER_LUTS; index++) {
+      const uint32_t value =
+            (uint32_t)image[4*index+0]<<24 | (uint32_t)image[4*index+1]<<16 |
+            (uint32_t)image[4*index+2]<<8  | (uint32_t)image[4*index+3];
+      CHECK(value == golden[index], "%s: image LUT[%u] = 0x%08X, expected 0x%08X", name, index, value, golden[index]);
+   }
+}
+
+/**
+ * Check the LUT images of random setups for an FPGA variant using TriggerModel
+ *
+ * @tparam Encoding  Trigger encoding of FPGA variant
+ *
+ * @param name       Name of variant
+ * @param trials     Number of setups to try
+ */
+template<typename Encoding>
+static void checkModelledImages(const char *name, unsigned trials) {
+   using Sample = typename Encoding::Sample;
+
+   constexpr unsigned LENGTH = 1000;
+
+   const uint32_t sampleMask = (Encoding::SAMPLE_WIDTH>=32)?0xFFFFFFFF:((1U<<Encoding::SAMPLE_WIDTH)-1);
+
+   std::mt19937          random(Encoding::SAMPLE_WIDTH*Encoding::MAX_TRIGGER_PATTERNS);
+   std::vector<uint32_t> samples(LENGTH);
+   std::vector<Sample>   hardwareSamples(LENGTH);
+   unsigned              found = 0;
+   for (unsigned trial=0; trial<trials; trial++) {
+      const auto setup = randomSetup<Encoding>(random);
+      for (unsigned index=0; index<LENGTH; index++) {
+         samples[index]         = random()&sampleMask;
+         hardwareSamples[index] = (Sample)samples[index];
+      }
+      TriggerModel<Encoding> model(setup.getLutImage());
+      const long expected = findTrigger(setup, samples.data(), LENGTH);
+      const long actual   = model.findTrigger(hardwareSamples.data(), LENGTH);
+      CHECK(actual == expected, "%s: trial %u triggers at %ld, expected %ld", name, trial, actual, expected);
+      if (expected >= 0) {
+         found++;
+      }
+   }
+   // Make sure the trials are not trivial
+   CHECK((found > trials/4) && (found < trials), "%s: %u of %u setups triggered", name, found, trials);
+}
+
+int main() {
+   checkGoldenImage("trigger0x7FFFor0x7FFE", trigger0x7FFFor0x7FFE, 0,  trigger0x7FFFor0x7FFELuts);
+   checkGoldenImage("triggersEdges",         triggersEdges,         3,  triggersEdgesLuts);
+   checkGoldenImage("triggersCounts",        triggersCounts,        15, triggersCountsLuts);
+
+   const LutImage image = TriggerSetup{trigger0x7FFFor0x7FFE, 0}.getLutImage();
+   CHECK(memcmp(image.data(), trigger0x7FFFor0x7FFEImage.data(), image.size()) == 0, "Compile-time LUT image differs");
+
+   checkModelledImages<TriggerEncoding<16, 16, 2, 16>>("16,16,2,16", 2000);
+   checkModelledImages<TriggerEncoding<16, 16, 4, 16>>("16,16,4,16", 2000);
+   checkModelledImages<TriggerEncoding<32, 16, 2, 16>>("32,16,2,16", 2000);
+   checkModelledImages<TriggerEncoding<32, 16, 4, 16>>("32,16,4,16", 2000);
+
+   return checkResult("TestLutImage");
+}
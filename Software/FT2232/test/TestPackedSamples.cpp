@@ -0,0 +1,118 @@
+//============================================================================
+// Name        : TestPackedSamples.cpp
+// Author      : pgo
+// Checks the SIMD unpacking of packed readback against a scalar reference
+//============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+#include "PackedSamples.h"
+#include "Check.h"
+
+/// Sample value used to detect writes past the end of a buffer
+static constexpr uint16_t GUARD_VALUE = 0xDEAD;
+
+/**
+ * Reference unpacking of a little-endian bit stream
+ *
+ * @param packed         Packed data
+ * @param count          Number of samples
+ * @param bitsPerSample  Bits for each sample
+ *
+ * @return Samples
+ */
+template<typename Sample>
+static std::vector<Sample> referenceUnpack(const std::vector<uint8_t> &packed, size_t count, unsigned bitsPerSample) {
+   std::vector<Sample> samples(count, 0);
+   for (size_t index=0; index<count; index++) {
+      for (unsigned bit=0; bit<bitsPerSample; bit++) {
+         const size_t position = index*bitsPerSample+bit;
+         if ((packed[position/8]>>(position%8))&1) {
+            samples[index] |= (Sample)1<<bit;
+         }
+      }
+   }
+   return samples;
+}
+
+/**
+ * Check unpackSamples() against the reference for one length
+ *
+ * @param random         Random number generator
+ * @param count          Number of samples
+ * @param bitsPerSample  Bits for each sample
+ */
+template<typename Sample>
+static void checkUnpack(std::mt19937 &random, size_t count, unsigned bitsPerSample) {
+   constexpr size_t GUARD = 64;
+
+   // Exactly the size sent by the analyser so reads past the end are not hidden by padding
+   std::vector<uint8_t> packed(getPackedSize(count, bitsPerSample, sizeof(Sample)));
+   for (uint8_t &byte:packed) {
+      byte = (uint8_t)random();
+   }
+   const std::vector<Sample> expected = referenceUnpack<Sample>(packed, count, bitsPerSample);
+
+   std::vector<Sample> samples(count+GUARD, (Sample)GUARD_VALUE);
+   unpackSamples(packed.data(), samples.data(), count, bitsPerSample);
+
+   for (size_t index=0; index<count; index++) {
+      if (samples[index] != expected[index]) {
+         CHECK(false, "%zu-bit samples, %u bits, count %zu: sample[%zu] = 0x%X, expected 0x%X",
+               8*sizeof(Sample), bitsPerSample, count, index, (unsigned)samples[index], (unsigned)expected[index]);
+         break;
+      }
+   }
+   for (size_t index=count; index<count+GUARD; index++) {
+      if (samples[index] != (Sample)GUARD_VALUE) {
+         CHECK(false, "%zu-bit samples, %u bits, count %zu: wrote past end of buffer at %zu",
+               8*sizeof(Sample), bitsPerSample, count, index);
+         break;
+      }
+   }
+}
+
+/**
+ * Check each packed width for all lengths up to several vectors and some longer lengths
+ * Most lengths are not a multiple of the vector width so leave a tail for the scalar code
+ */
+template<typename Sample>
+static void checkWidths() {
+   std::mt19937 random(8*sizeof(Sample));
+   for (unsigned bitsPerSample:{4U, 8U, (unsigned)(8*sizeof(Sample))}) {
+      for (size_t count=0; count<=200; count++) {
+         checkUnpack<Sample>(random, count, bitsPerSample);
+      }
+      for (size_t count:{1023, 1024, 1025, 4093, 65536+31}) {
+         checkUnpack<Sample>(random, count, bitsPerSample);
+      }
+   }
+}
+
+/**
+ * Check getPackedSize() rounds up to whole analyser words
+ */
+static void checkPackedSize() {
+   CHECK(getPackedSize(0, 4, 2)  == 0,  "getPackedSize(0, 4, 2) = %zu",  getPackedSize(0, 4, 2));
+   CHECK(getPackedSize(1, 4, 2)  == 2,  "getPackedSize(1, 4, 2) = %zu",  getPackedSize(1, 4, 2));
+   CHECK(getPackedSize(4, 4, 2)  == 2,  "getPackedSize(4, 4, 2) = %zu",  getPackedSize(4, 4, 2));
+   CHECK(getPackedSize(5, 4, 2)  == 4,  "getPackedSize(5, 4, 2) = %zu",  getPackedSize(5, 4, 2));
+   CHECK(getPackedSize(3, 8, 2)  == 4,  "getPackedSize(3, 8, 2) = %zu",  getPackedSize(3, 8, 2));
+   CHECK(getPackedSize(9, 4, 4)  == 8,  "getPackedSize(9, 4, 4) = %zu",  getPackedSize(9, 4, 4));
+   CHECK(getPackedSize(3, 16, 2) == 6,  "getPackedSize(3, 16, 2) = %zu", getPackedSize(3, 16, 2));
+   CHECK(getPackedSize(3, 32, 4) == 12, "getPackedSize(3, 32, 4) = %zu", getPackedSize(3, 32, 4));
+}
+
+int main() {
+   const char *name = "TestPackedSamples" SIMD_VARIANT;
+   if (!checkCpuSupport(name)) {
+      return 0;
+   }
+   checkPackedSize();
+   checkWidths<uint16_t>();
+   checkWidths<uint32_t>();
+
+   return checkResult(name);
+}
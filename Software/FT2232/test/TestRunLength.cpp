@@ -0,0 +1,263 @@
+//============================================================================
+// Name        : TestRunLength.cpp
+// Author      : pgo
+// Checks the SIMD run-length decoders against scalar reference decoders
+//============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+#include "EncodeLuts.h"
+#include "RunLength.h"
+#include "Check.h"
+
+using namespace Analyser;
+
+/// Sample value used to detect writes past the end of a buffer
+static constexpr uint16_t GUARD_VALUE = 0xDEAD;
+
+/// Repeat counts around the vector and block sizes (SSE2 = 8 or 4 lanes, AVX2 = 16 or 8 lanes)
+static const uint32_t BOUNDARY_COUNTS[] = {0, 1, 2, 3, 4, 6, 7, 8, 9, 14, 15, 16, 17, 30, 31, 32, 33, 63, 64, 65};
+
+/**
+ * Generate random run-length encoded words
+ * Values are drawn from a few levels so that runs often repeat the previous
+ * value. This gives blocks of runs without changes, and changes at every
+ * position within a block.
+ *
+ * @tparam Sample   uint16_t or uint32_t
+ *
+ * @param random    Random number generator
+ * @param runs      Number of runs
+ * @param maxCount  Largest repeat count
+ *
+ * @return RLE words
+ */
+template<typename Sample>
+static std::vector<Sample> makeWords(std::mt19937 &random, size_t runs, uint32_t maxCount) {
+   const Sample levels[] = {0, 1, (Sample)0x8000, (Sample)~0, (Sample)random(), (Sample)random()};
+
+   std::vector<Sample> words;
+   Sample value = levels[0];
+   for (size_t run=0; run<runs; run++) {
+      switch(random()%4) {
+         case 0:  value = levels[random()%(sizeof(levels)/sizeof(levels[0]))]; break;
+         case 1:  value ^= (Sample)(1U<<(random()%(8*sizeof(Sample))));      break;
+         default: break;
+      }
+      uint32_t count;
+      switch(random()%3) {
+         case 0:  count = BOUNDARY_COUNTS[random()%(sizeof(BOUNDARY_COUNTS)/sizeof(BOUNDARY_COUNTS[0]))]; break;
+         case 1:  count = random()%(maxCount+1); break;
+         default: count = random()%4;            break;
+      }
+      words.push_back(value);
+      words.push_back((Sample)count);
+   }
+   return words;
+}
+
+/**
+ * Reference expansion of RLE words
+ */
+template<typename Sample>
+static std::vector<Sample> referenceExpand(const std::vector<Sample> &words) {
+   std::vector<Sample> samples;
+   for (size_t index=0; index+1<words.size(); index+=2) {
+      samples.insert(samples.end(), (size_t)words[index+1]+1, words[index]);
+   }
+   return samples;
+}
+
+/**
+ * Reference sum of repeat counts (or ticks)
+ */
+template<typename Sample>
+static uint64_t referenceSum(const std::vector<Sample> &words) {
+   uint64_t total = 0;
+   for (size_t index=1; index<words.size(); index+=2) {
+      total += words[index];
+   }
+   return total;
+}
+
+/**
+ * Reference conversion of RLE words to an edge list
+ */
+template<typename Sample>
+static std::vector<SampleEdge<Sample>> referenceEdges(const std::vector<Sample> &words, Sample channelMask) {
+   std::vector<SampleEdge<Sample>> edges;
+   Sample   previous = 0;
+   uint64_t position = 0;
+   for (size_t index=0; index+1<words.size(); index+=2) {
+      const Sample value = words[index];
+      if (index == 0) {
+         edges.push_back({0, value, channelMask});
+         previous = value;
+      }
+      else if (((value^previous)&channelMask) != 0) {
+         edges.push_back({position, value, (Sample)((value^previous)&channelMask)});
+         previous = value;
+      }
+      position += (uint64_t)words[index+1]+1;
+   }
+   return edges;
+}
+
+/**
+ * Check expandRle() against the reference including truncation at every buffer size near the end
+ *
+ * @param name    Description of words
+ * @param words   RLE words
+ */
+template<typename Sample>
+static void checkExpand(const char *name, const std::vector<Sample> &words) {
+   const std::vector<Sample> expected = referenceExpand(words);
+
+   CHECK(getRleSampleCount(words.data(), words.size()) == expected.size(),
+         "%s: getRleSampleCount() = %llu, expected %zu",
+         name, (unsigned long long)getRleSampleCount(words.data(), words.size()), expected.size());
+
+   // Whole buffer, buffers cut inside the vectors of the last runs and a buffer cut part way
+   // Long captures are only cut at a few sizes
+   const size_t        cutStep = (expected.size() > 10000)?8:1;
+   std::vector<size_t> sizes   = {expected.size(), expected.size()+5, expected.size()/3};
+   for (size_t cut=1; (cut<=40) && (cut<=expected.size()); cut+=cutStep) {
+      sizes.push_back(expected.size()-cut);
+   }
+
+   constexpr size_t GUARD = 64;
+   for (size_t maxSamples:sizes) {
+      std::vector<Sample> samples(maxSamples+GUARD, (Sample)GUARD_VALUE);
+      const size_t written = expandRle(words.data(), words.size(), samples.data(), maxSamples);
+      const size_t size    = std::min(maxSamples, expected.size());
+      CHECK(written == size, "%s: expandRle(%zu) wrote %zu samples, expected %zu", name, maxSamples, written, size);
+      for (size_t index=0; index<size; index++) {
+         if (samples[index] != expected[index]) {
+            CHECK(false, "%s: expandRle(%zu) sample[%zu] = 0x%X, expected 0x%X",
+                  name, maxSamples, index, (unsigned)samples[index], (unsigned)expected[index]);
+            break;
+         }
+      }
+      for (size_t index=maxSamples; index<maxSamples+GUARD; index++) {
+         if (samples[index] != (Sample)GUARD_VALUE) {
+            CHECK(false, "%s: expandRle(%zu) wrote past end of buffer at %zu", name, maxSamples, index);
+            break;
+         }
+      }
+   }
+}
+
+/**
+ * Check getTransitionTicks() (sum of second words after the first event) against the reference
+ *
+ * @param name    Description of words
+ * @param words   RLE or transition words
+ */
+template<typename Sample>
+static void checkSum(const char *name, const std::vector<Sample> &words) {
+   // Odd lengths check the trailing word is ignored
+   for (size_t wordCount:{words.size(), words.size()-1}) {
+      const std::vector<Sample> events(words.begin()+std::min<size_t>(2, wordCount), words.begin()+wordCount);
+      const uint64_t            ticks = getTransitionTicks(words.data(), wordCount);
+      CHECK(ticks == referenceSum(events), "%s: getTransitionTicks(%zu words) = %llu, expected %llu",
+            name, wordCount, (unsigned long long)ticks, (unsigned long long)referenceSum(events));
+   }
+}
+
+/**
+ * Check rleToEdges() against the reference for several channel masks
+ *
+ * @param name    Description of words
+ * @param words   RLE words
+ */
+template<typename Sample>
+static void checkEdges(const char *name, const std::vector<Sample> &words) {
+   for (Sample channelMask:{(Sample)~0, (Sample)0, (Sample)0x00FF, (Sample)0x8001}) {
+      const std::vector<SampleEdge<Sample>> expected = referenceEdges(words, channelMask);
+      std::vector<SampleEdge<Sample>>       edges;
+      rleToEdges(words.data(), words.size(), edges, channelMask);
+
+      CHECK(edges.size() == expected.size(), "%s: rleToEdges(mask=0x%X) found %zu edges, expected %zu",
+            name, (unsigned)channelMask, edges.size(), expected.size());
+      for (size_t index=0; index<std::min(edges.size(), expected.size()); index++) {
+         const SampleEdge<Sample> &edge = edges[index];
+         const SampleEdge<Sample> &ref  = expected[index];
+         if ((edge.position != ref.position) || (edge.value != ref.value) || (edge.changed != ref.changed)) {
+            CHECK(false, "%s: rleToEdges(mask=0x%X) edge[%zu] = {%llu, 0x%X, 0x%X}, expected {%llu, 0x%X, 0x%X}",
+                  name, (unsigned)channelMask, index,
+                  (unsigned long long)edge.position, (unsigned)edge.value, (unsigned)edge.changed,
+                  (unsigned long long)ref.position,  (unsigned)ref.value,  (unsigned)ref.changed);
+            break;
+         }
+      }
+   }
+}
+
+/**
+ * Check the decoders on random words of every length up to a few blocks
+ * and on longer captures
+ *
+ * @param name  Sample type
+ */
+template<typename Sample>
+static void checkRandom(const char *name) {
+   std::mt19937 random(8*sizeof(Sample));
+   char         description[80];
+
+   // Each run count gives a different tail after the last whole block
+   for (size_t runs=1; runs<=40; runs++) {
+      for (unsigned trial=0; trial<20; trial++) {
+         const std::vector<Sample> words = makeWords<Sample>(random, runs, 100);
+         snprintf(description, sizeof(description), "%s, %zu runs, trial %u", name, runs, trial);
+         checkExpand(description, words);
+         checkSum(description, words);
+         checkEdges(description, words);
+      }
+   }
+   for (unsigned trial=0; trial<4; trial++) {
+      const std::vector<Sample> words = makeWords<Sample>(random, 1000+random()%100, C_RLE_MAX_COUNT);
+      snprintf(description, sizeof(description), "%s, long capture %u", name, trial);
+      checkExpand(description, words);
+      checkSum(description, words);
+      checkEdges(description, words);
+   }
+}
+
+/**
+ * Check sums of the largest repeat counts
+ * The 16-bit sum uses 32-bit lanes that must be flushed before they overflow
+ *
+ * @param name  Sample type
+ */
+template<typename Sample>
+static void checkLargeSum(const char *name) {
+   const size_t runs = 3*8*0x10000+13;
+
+   std::vector<Sample> words;
+   for (size_t run=0; run<runs; run++) {
+      words.push_back((Sample)run);
+      words.push_back((Sample)C_RLE_MAX_COUNT);
+   }
+   const uint64_t expected = (uint64_t)runs*C_RLE_MAX_COUNT;
+   const uint64_t ticks    = getTransitionTicks(words.data(), words.size());
+   const uint64_t count    = getRleSampleCount(words.data(), words.size());
+   CHECK(ticks == expected-C_RLE_MAX_COUNT, "%s: getTransitionTicks() = %llu, expected %llu",
+         name, (unsigned long long)ticks, (unsigned long long)(expected-C_RLE_MAX_COUNT));
+   CHECK(count == expected+runs, "%s: getRleSampleCount() = %llu, expected %llu",
+         name, (unsigned long long)count, (unsigned long long)(expected+runs));
+}
+
+int main() {
+   const char *name = "TestRunLength" SIMD_VARIANT;
+   if (!checkCpuSupport(name)) {
+      return 0;
+   }
+   checkRandom<uint16_t>("16-bit");
+   checkRandom<uint32_t>("32-bit");
+   checkLargeSum<uint16_t>("16-bit");
+   checkLargeSum<uint32_t>("32-bit");
+
+   return checkResult(name);
+}
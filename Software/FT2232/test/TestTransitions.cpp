@@ -0,0 +1,189 @@
+//============================================================================
+// Name        : TestTransitions.cpp
+// Author      : pgo
+// Checks transitional capture (C_MODE_TRANSITION) and decodeTransitions()
+//============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "EncodeLuts.h"
+#include "FT2232_Emulator.h"
+#include "AnalyserCommands.h"
+#include "TriggerCompiler.h"
+#include "RunLength.h"
+#include "Check.h"
+
+using namespace Analyser;
+
+/**
+ * Reference decoder
+ * The first event has no previous value so is always reported at time 0.
+ *
+ * @param words         Transition words
+ * @param period        Length of a tick in ns
+ * @param channelMask   Channels of interest
+ *
+ * @return Events
+ */
+static std::vector<TimedSample<uint16_t>> referenceDecode(const std::vector<uint16_t> &words, uint64_t period, uint16_t channelMask) {
+   std::vector<TimedSample<uint16_t>> events;
+   uint64_t ticks = 0;
+   for (size_t index=0; index+1<words.size(); index+=2) {
+      if (index == 0) {
+         events.push_back({0, words[0]});
+         continue;
+      }
+      ticks += words[index+1];
+      if (((words[index]^events.back().value)&channelMask) != 0) {
+         events.push_back({ticks*period, words[index]});
+      }
+   }
+   return events;
+}
+
+/**
+ * Compare decodeTransitions() with the reference decoder
+ *
+ * @param name          Description of words
+ * @param words         Transition words
+ * @param sampleRate    Sample rate of capture
+ * @param channelMask   Channels of interest
+ */
+static void checkDecode(const char *name, const std::vector<uint16_t> &words, SampleRate sampleRate, uint16_t channelMask) {
+   const std::vector<TimedSample<uint16_t>> expected =
+         referenceDecode(words, getSamplePeriodIn_nanoseconds(sampleRate), channelMask);
+
+   std::vector<TimedSample<uint16_t>> events;
+   decodeTransitions<uint16_t>(words.data(), words.size(), sampleRate, events, channelMask);
+
+   CHECK(events.size() == expected.size(), "%s, mask=0x%04X: %zu events, expected %zu",
+         name, channelMask, events.size(), expected.size());
+   for (size_t index=0; index<std::min(events.size(), expected.size()); index++) {
+      if ((events[index].time_ns != expected[index].time_ns) || (events[index].value != expected[index].value)) {
+         CHECK(false, "%s, mask=0x%04X: event[%zu] = {%llu ns, 0x%04X}, expected {%llu ns, 0x%04X}",
+               name, channelMask, index,
+               (unsigned long long)events[index].time_ns,   events[index].value,
+               (unsigned long long)expected[index].time_ns, expected[index].value);
+         break;
+      }
+   }
+}
+
+/**
+ * Check decodeTransitions() on hand-written words
+ */
+static void checkWords() {
+   // No events
+   std::vector<TimedSample<uint16_t>> events;
+   decodeTransitions<uint16_t>(nullptr, 0, SampleRate_100ns, events);
+   CHECK(events.empty(), "No words gave %zu events", events.size());
+
+   // A first sample of 0 has no previous value so is still an event
+   // Its tick count refers to an event before the capture so is ignored
+   const std::vector<uint16_t> first = {0x0000, 1234, 0x0001, 10};
+   for (uint16_t channelMask:{0x0000, 0xFFFF}) {
+      events.clear();
+      decodeTransitions<uint16_t>(first.data(), 2, SampleRate_100ns, events, channelMask);
+      CHECK((events.size() == 1) && (events[0].time_ns == 0) && (events[0].value == 0),
+            "First sample, mask=0x%04X: %zu events", channelMask, events.size());
+      checkDecode("First sample", first, SampleRate_100ns, channelMask);
+   }
+   CHECK(getTransitionTicks(first.data(), 2) == 0,
+         "getTransitionTicks(first sample) = %llu", (unsigned long long)getTransitionTicks(first.data(), 2));
+   CHECK(getTransitionTicks(first.data(), first.size()) == 10,
+         "getTransitionTicks() = %llu, expected 10", (unsigned long long)getTransitionTicks(first.data(), first.size()));
+
+   // Events stored for a saturated tick count or the trigger are dropped but their ticks are kept
+   const std::vector<uint16_t> words = {
+         0x0001, 0,
+         0x0001, (uint16_t)C_TRANSITION_MAX_DELTA,
+         0x0003, 10,
+         0x0103, 5,
+         0x0103, 1,
+         0x0000, 7,
+         0x0001,              // Trailing odd word is ignored
+   };
+   for (uint16_t channelMask:{0x0000, 0x0001, 0x0002, 0x0100, 0xFFFF}) {
+      checkDecode("Hand-written words", words, SampleRate_100ns, channelMask);
+      checkDecode("Hand-written words", words, SampleRate_10us,  channelMask);
+   }
+}
+
+/**
+ * Capture from the emulator with a channel mask set through C_WR_CHANNELS and check
+ *  - Events are only stored for a change in the enabled channels, a saturated tick count or the trigger
+ *  - No change in the enabled channels is missed
+ *  - Events after the trigger are read back (the trigger may be the first word after the pre-trigger)
+ *  - decodeTransitions() and getTransitionTicks() agree with the reference decoder
+ *
+ * The signal is a counter so the value of each event is its sample number.
+ *
+ * @param channelMask  Channels enabled
+ */
+static void checkCapture(uint32_t channelMask) {
+   constexpr unsigned   CAPTURE_WORDS = 200;
+   constexpr unsigned   PRETRIG_WORDS = 50;
+   constexpr SampleRate SAMPLE_RATE   = SampleRate_100ns;
+
+   char name[40];
+   snprintf(name, sizeof(name), "Capture, mask=0x%08X", channelMask);
+
+   FT2232_Emulator emulator(new CounterSignalSource(), IDEAL_LINK_MODEL);
+   AnalyserSession analyser(emulator);
+   identifyAnalyser(analyser);
+   writeMode(analyser, C_MODE_TRANSITION);
+   writeChannels(analyser, channelMask);
+
+   auto setup = compileTrigger<AnalyserTriggerEncoding>("any", SAMPLE_RATE, CAPTURE_WORDS, PRETRIG_WORDS);
+   std::vector<uint16_t> words(setup.getSampleSize());
+   if (!doCapture(analyser, setup, words.data(), WaitMode::Poll, 10000)) {
+      CHECK(false, "%s: capture did not complete", name);
+      return;
+   }
+   const uint16_t mask    = (uint16_t)channelMask;
+   uint16_t       current = words[0];
+   for (size_t event=1; event<words.size()/2; event++) {
+      const uint16_t value = words[2*event];
+      const uint16_t ticks = words[2*event+1];
+      CHECK((uint16_t)(value-current) == ticks, "%s: event %zu value 0x%04X is %u ticks after 0x%04X",
+            name, event, value, ticks, current);
+
+      const bool changed   = ((value^current)&mask) != 0;
+      const bool saturated = (ticks == C_TRANSITION_MAX_DELTA);
+      const bool trigger   = (2*event == setup.getPreTrigSize());
+      CHECK(changed || saturated || trigger, "%s: event %zu (0x%04X) has no reason to be stored", name, event, value);
+
+      for (uint16_t tick=1; tick<ticks; tick++) {
+         if ((((uint16_t)(current+tick)^current)&mask) != 0) {
+            CHECK(false, "%s: change to 0x%04X before event %zu was not stored", name, (uint16_t)(current+tick), event);
+            break;
+         }
+      }
+      current = value;
+   }
+   checkDecode(name, words, SAMPLE_RATE, mask);
+
+   const unsigned lastEvent = words.size()-2;
+   CHECK((uint16_t)getTransitionTicks(words.data(), words.size()) == (uint16_t)(words[lastEvent]-words[0]),
+         "%s: getTransitionTicks() = %llu, expected %u", name,
+         (unsigned long long)getTransitionTicks(words.data(), words.size()), (uint16_t)(words[lastEvent]-words[0]));
+
+   // With no channels enabled only the first event remains, with every channel each event is a change
+   std::vector<TimedSample<uint16_t>> events;
+   decodeTransitions<uint16_t>(words.data(), words.size(), SAMPLE_RATE, events, mask);
+   if (mask == 0) {
+      CHECK(events.size() == 1, "%s: %zu events, expected 1", name, events.size());
+   }
+   if ((mask&1) != 0) {
+      CHECK(events.size() == words.size()/2, "%s: %zu events, expected %zu", name, events.size(), words.size()/2);
+   }
+}
+
+int main() {
+   checkWords();
+   for (uint32_t channelMask:{0x00000000U, 0x00000100U, 0x00008001U, 0x0000FFFFU, 0xFFFFFFFFU}) {
+      checkCapture(channelMask);
+   }
+   return checkResult("TestTransitions");
+}
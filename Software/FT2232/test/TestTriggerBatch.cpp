@@ -0,0 +1,77 @@
+//============================================================================
+// Name        : TestTriggerBatch.cpp
+// Author      : pgo
+// Checks TriggerBatch against TriggerModel on random trigger setups
+//============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+#include "EncodeLuts.h"
+#include "TriggerModel.h"
+#include "TriggerBatch.h"
+#include "RandomSetup.h"
+#include "Check.h"
+
+using namespace Analyser;
+
+/**
+ * Evaluate batches of random setups and compare each candidate with TriggerModel
+ *
+ * @tparam Encoding  Trigger encoding of FPGA variant
+ *
+ * @param name       Name of variant
+ * @param batches    Number of batches of TriggerBatch::MAX_CANDIDATES setups
+ */
+template<typename Encoding>
+static void checkBatches(const char *name, unsigned batches) {
+   using Sample = typename Encoding::Sample;
+   using Batch  = TriggerBatch<Encoding>;
+
+   constexpr unsigned LENGTH = 20000;
+
+   const uint32_t sampleMask = (Encoding::SAMPLE_WIDTH>=32)?0xFFFFFFFF:((1U<<Encoding::SAMPLE_WIDTH)-1);
+
+   std::mt19937 random(Encoding::SAMPLE_WIDTH*Encoding::MAX_TRIGGER_PATTERNS);
+   unsigned     found = 0;
+   unsigned     total = 0;
+   for (unsigned batchNum=0; batchNum<batches; batchNum++) {
+      Batch                                         batch;
+      std::vector<typename Encoding::TriggerSetup>  setups;
+      while (batch.size() < Batch::MAX_CANDIDATES) {
+         setups.push_back(randomSetup<Encoding>(random, 300));
+         batch.add(setups.back());
+      }
+      std::vector<Sample> hardwareSamples(LENGTH);
+      for (Sample &sample:hardwareSamples) {
+         sample = (Sample)(random()&sampleMask);
+      }
+      const std::vector<TriggerBatchResult> results = batch.evaluate(hardwareSamples.data(), hardwareSamples.size());
+      for (unsigned index=0; index<setups.size(); index++) {
+         TriggerModel<Encoding> model(setups[index].getLutImage());
+
+         const long     expected     = model.findTrigger(hardwareSamples.data(), hardwareSamples.size());
+         const unsigned expectedStep = (expected >= 0)?setups[index].getLastActiveTriggerCount():model.getStep();
+         const TriggerBatchResult &result = results[index];
+         CHECK((result.found == (expected >= 0)) && (result.index == expected) && (result.step == expectedStep),
+               "%s: batch %u candidate %u found at %ld step %u, expected %ld step %u",
+               name, batchNum, index, result.index, result.step, expected, expectedStep);
+         if (expected >= 0) {
+            found++;
+         }
+         total++;
+      }
+   }
+   // Make sure the trials are not trivial
+   CHECK((found > total/10) && (found < total), "%s: %u of %u candidates triggered", name, found, total);
+}
+
+int main() {
+   checkBatches<TriggerEncoding<16, 16, 2, 16>>("16,16,2,16", 8);
+   checkBatches<TriggerEncoding<16, 16, 4, 16>>("16,16,4,16", 8);
+   checkBatches<TriggerEncoding<32, 16, 2, 16>>("32,16,2,16", 8);
+   checkBatches<TriggerEncoding<32, 16, 4, 16>>("32,16,4,16", 8);
+
+   return checkResult("TestTriggerBatch");
+}
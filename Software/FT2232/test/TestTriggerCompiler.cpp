@@ -0,0 +1,232 @@
+//============================================================================
+// Name        : TestTriggerCompiler.cpp
+// Author      : pgo
+// Checks the trigger expression parser and compiler
+//============================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "EncodeLuts.h"
+#include "TriggerModel.h"
+#include "TriggerCompiler.h"
+#include "Check.h"
+
+using namespace Analyser;
+
+/**
+ * Expected stage of a parsed expression with a single pattern
+ */
+struct ExpectedStage {
+   const char *pattern;
+   unsigned    count;
+   bool        contiguous;
+};
+
+/**
+ * Check that an expression parses to single pattern stages
+ *
+ * @param text       Expression
+ * @param expected   Expected stages
+ */
+static void checkParse(const char *text, const std::vector<ExpectedStage> &expected) {
+   try {
+      TriggerExpression expression(text, 16);
+      const auto &stages = expression.getStages();
+      CHECK(stages.size() == expected.size(), "'%s': %u stages, expected %u", text, (unsigned)stages.size(), (unsigned)expected.size());
+      for (unsigned stageNum=0; stageNum<std::min(stages.size(), expected.size()); stageNum++) {
+         const TriggerExpression::Stage &stage = stages[stageNum];
+         CHECK((stage.condition.type == TriggerExpression::Node::Pattern) && (stage.condition.pattern == expected[stageNum].pattern),
+               "'%s': stage %u pattern '%s', expected '%s'", text, stageNum, stage.condition.pattern.c_str(), expected[stageNum].pattern);
+         CHECK(stage.count == expected[stageNum].count,
+               "'%s': stage %u count %u, expected %u", text, stageNum, stage.count, expected[stageNum].count);
+         CHECK(stage.contiguous == expected[stageNum].contiguous,
+               "'%s': stage %u contiguous %d, expected %d", text, stageNum, stage.contiguous, expected[stageNum].contiguous);
+      }
+   } catch (MyException &e) {
+      CHECK(false, "'%s': unexpected error %s", text, e.what());
+   }
+}
+
+/**
+ * Check that an expression is rejected by the parser
+ *
+ * @param text  Expression
+ */
+static void checkSyntaxError(const char *text) {
+   try {
+      TriggerExpression expression(text, 16);
+      CHECK(false, "'%s': accepted", text);
+   } catch (MyException &) {
+   }
+}
+
+/**
+ * Format compiled steps for messages and comparison e.g. "And 3 c {!XXXXXXXXXXXXXXLL}"
+ *
+ * @param steps Compiled steps
+ *
+ * @return Steps as string
+ */
+static std::string toString(const std::vector<CompiledStep> &steps) {
+   std::string result;
+   for (const CompiledStep &step:steps) {
+      result += (step.operation == Operation::And)?"And ":"Or ";
+      result += std::to_string(step.count)+(step.contiguous?" c {":" {");
+      for (const CompiledPattern &pattern:step.patterns) {
+         result += (pattern.inverted?" !":" ")+pattern.pattern;
+      }
+      result += " } ";
+   }
+   return result;
+}
+
+/**
+ * Check the steps produced by the compiler
+ *
+ * @param text       Expression
+ * @param expected   Expected steps as formatted by toString()
+ */
+static void checkCompile(const char *text, const char *expected) {
+   try {
+      const std::string steps = toString(TriggerExpression(text, 16).compile(16, 2));
+      CHECK(steps == expected, "'%s': compiled to '%s', expected '%s'", text, steps.c_str(), expected);
+   } catch (MyException &e) {
+      CHECK(false, "'%s': unexpected error %s", text, e.what());
+   }
+}
+
+/**
+ * Check that an expression parses but does not fit the hardware
+ *
+ * @param text         Expression
+ * @param maxSteps     Number of trigger steps available
+ * @param maxPatterns  Number of patterns in each trigger step
+ */
+static void checkDoesNotFit(const char *text, unsigned maxSteps, unsigned maxPatterns) {
+   TriggerExpression expression(text, 16);
+   try {
+      expression.compile(maxSteps, maxPatterns);
+      CHECK(false, "'%s': fits %u steps of %u patterns", text, maxSteps, maxPatterns);
+   } catch (MyException &) {
+   }
+}
+
+/// Expressions compiled for each FPGA variant and checked with TriggerModel
+static const char *const modelExpressions[] = {
+      "D0",
+      "D3 rising",
+      "D2 falling || D5 change",
+      "!(D1 && D2)",
+      "D1 || D2 || !D3",
+      "D0..3 == 0b1010",
+      "D0..3 != 5 && D4 low",
+      "D0..7 == \"XXHLRXXX\"",
+      "(D3 rising && D0..7 == 0x5A) x 3 then D4 low contiguous x 8",
+      "D0 x 5 then D0 x 7 then D1 || D2",
+      "D6 contiguous x 4 then !D6 x 2 then D6 rising",
+      "(D0 && D1) || (D2 && D3)",
+      "D0 then D1 then D2 then D3 then D4 then D5 then D6 then D7",
+      "any x 20 then D0 high",
+};
+
+/**
+ * Compile expressions for an FPGA variant, evaluate the LUT image with TriggerModel
+ * and compare with the reference evaluator of the expression
+ *
+ * @tparam Encoding  Trigger encoding of FPGA variant
+ *
+ * @param name       Name of variant
+ * @param trials     Number of sample sequences for each expression
+ */
+template<typename Encoding>
+static void checkAgainstModel(const char *name, unsigned trials) {
+   using Sample = typename Encoding::Sample;
+
+   unsigned found = 0;
+   unsigned total = 0;
+   for (const char *text:modelExpressions) {
+      try {
+         const TriggerExpression expression(text, Encoding::SAMPLE_WIDTH);
+         const auto setup = compileTrigger<Encoding>(text, SampleRate_100ns, 1000, 100, false);
+
+         TriggerModel<Encoding> model(setup.getLutImage());
+
+         std::mt19937          random(total);
+         std::vector<uint32_t> samples;
+         std::vector<Sample>   hardwareSamples;
+         for (unsigned trial=0; trial<trials; trial++) {
+            expression.makeTestSamples(samples, 500, random);
+            hardwareSamples.assign(samples.begin(), samples.end());
+
+            const long expected = expression.findTrigger(samples.data(), samples.size());
+            const long actual   = model.findTrigger(hardwareSamples.data(), hardwareSamples.size());
+            CHECK(actual == expected, "%s '%s': trial %u triggers at %ld, expected %ld", name, text, trial, actual, expected);
+            if (expected >= 0) {
+               found++;
+            }
+            total++;
+         }
+      } catch (MyException &e) {
+         CHECK(false, "%s '%s': unexpected error %s", name, text, e.what());
+      }
+   }
+   // Make sure the trials are not trivial
+   CHECK((found > total/4) && (found < total), "%s: %u of %u trials triggered", name, found, total);
+}
+
+int main() {
+   checkParse("D3 rising",               {{"XXXXXXXXXXXXRXXX", 1, false}});
+   checkParse("D5",                      {{"XXXXXXXXXXHXXXXX", 1, false}});
+   checkParse("any",                     {{"XXXXXXXXXXXXXXXX", 1, false}});
+   checkParse("D0..7 == 0x5A",           {{"XXXXXXXXLHLHHLHL", 1, false}});
+   checkParse("D0..3 == 0b1010",         {{"XXXXXXXXXXXXHLHL", 1, false}});
+   checkParse("D0..3 == 10",             {{"XXXXXXXXXXXXHLHL", 1, false}});
+   checkParse("D0..3 == \"HLRF\"",       {{"XXXXXXXXXXXXHLRF", 1, false}});
+   checkParse("D4 low contiguous x 8",   {{"XXXXXXXXXXXLXXXX", 8, true}});
+   checkParse("D4 low x 8 contiguous",   {{"XXXXXXXXXXXLXXXX", 8, true}});
+   checkParse("d1 HIGH THEN D2 Low",     {{"XXXXXXXXXXXXXXHX", 1, false}, {"XXXXXXXXXXXXXLXX", 1, false}});
+   checkParse("D0 F then D1 C x 100000", {{"XXXXXXXXXXXXXXXF", 1, false}, {"XXXXXXXXXXXXXXCX", 100000, false}});
+
+   checkSyntaxError("");
+   checkSyntaxError("#");
+   checkSyntaxError("x 3");
+   checkSyntaxError("D3 sideways");
+   checkSyntaxError("D16 high");
+   checkSyntaxError("D0..16 == 0");
+   checkSyntaxError("(D1 high");
+   checkSyntaxError("D1 high)");
+   checkSyntaxError("D1 high x");
+   checkSyntaxError("D1 high x 0");
+   checkSyntaxError("D1 &&");
+   checkSyntaxError("D1 then");
+   checkSyntaxError("D0 == 2");
+   checkSyntaxError("D0..3 == 0x1F");
+   checkSyntaxError("D0..3 == \"HL\"");
+
+   // Conditions are folded into patterns, equivalent steps merged and large counts split
+   checkCompile("D1 && D2",                  "And 1 { XXXXXXXXXXXXXHHX } ");
+   checkCompile("D1 || D2",                  "And 1 { !XXXXXXXXXXXXXLLX } ");
+   checkCompile("!(D1 && D2)",               "And 1 { !XXXXXXXXXXXXXHHX } ");
+   checkCompile("D0..1 != 2",                "And 1 { !XXXXXXXXXXXXXXHL } ");
+   checkCompile("D0..7 == 0x5A || D3 falling && D4 change",
+                                             "Or 1 { XXXXXXXXLHLHHLHL XXXXXXXXXXXCFXXX } ");
+   checkCompile("D0 x 3 then D0 x 2",        "And 5 { XXXXXXXXXXXXXXXH } ");
+   checkCompile("D0 high x 100000",          "And 65535 { XXXXXXXXXXXXXXXH } And 34465 { XXXXXXXXXXXXXXXH } ");
+   checkCompile("(D3 rising && D0..7 == 0x5A) x 100 then D4 low contiguous x 8",
+                                             "And 100 { XXXXXXXXLHLHRLHL } And 8 c { XXXXXXXXXXXLXXXX } ");
+
+   checkDoesNotFit("D0 && D1 && D2 || D3 && D4 && D5 || D6 && D7 && D8", 16, 2);
+   checkDoesNotFit("D1 high x 70000 contiguous", 16, 2);
+   checkDoesNotFit("D0 then D1 then D0 then D1 then D0", 4, 2);
+
+   checkAgainstModel<TriggerEncoding<16, 16, 2, 16>>("16,16,2,16", 100);
+   checkAgainstModel<TriggerEncoding<16, 16, 4, 16>>("16,16,4,16", 100);
+   checkAgainstModel<TriggerEncoding<32, 16, 2, 16>>("32,16,2,16", 100);
+   checkAgainstModel<TriggerEncoding<32, 16, 4, 16>>("32,16,4,16", 100);
+
+   return checkResult("TestTriggerCompiler");
+}
@@ -10,82 +10,8 @@
 
 #include "EncodeLuts.h"
 
-#include "Lfsr16.h"
-
 namespace Analyser {
 
-static const uint16_t lutEncoding[] = {
-      0b1111111111111111,  // XX
-      0b1010101010101010,  // XH
-      0b0101010101010101,  // XL
-      0b0010001000100010,  // XR
-      0b0100010001000100,  // XF
-      0b0110011001100110,  // XC
-      0b1111000011110000,  // HX
-      0b1010000010100000,  // HH
-      0b0101000001010000,  // HL
-      0b0010000000100000,  // HR
-      0b0100000001000000,  // HF
-      0b0110000001100000,  // HC
-      0b0000111100001111,  // LX
-      0b0000101000001010,  // LH
-      0b0000010100000101,  // LL
-      0b0000001000000010,  // LR
-      0b0000010000000100,  // LF
-      0b0000011000000110,  // LC
-      0b0000000011110000,  // RX
-      0b0000000010100000,  // RH
-      0b0000000001010000,  // RL
-      0b0000000000100000,  // RR
-      0b0000000001000000,  // RF
-      0b0000000001100000,  // RC
-      0b0000111100000000,  // FX
-      0b0000101000000000,  // FH
-      0b0000010100000000,  // FL
-      0b0000001000000000,  // FR
-      0b0000010000000000,  // FF
-      0b0000011000000000,  // FC
-      0b0000111111110000,  // CX
-      0b0000101010100000,  // CH
-      0b0000010101010000,  // CL
-      0b0000001000100000,  // CR
-      0b0000010001000000,  // CF
-      0b0000011001100000,  // CC
-};
-
-unsigned triggerValueIndex(PinTriggerEncoding value) {
-   switch (value) {
-      default:
-      case 'X' :
-         return 0;
-      case '1' :
-      case 'H' :
-         return 1;
-      case '0' :
-      case 'L' :
-         return 2;
-      case 'R' :
-         return 3;
-      case 'F' :
-         return 4;
-      case 'C' :
-         return 5;
-   }
-}
-
-/**
- * Get the LUT value for half a LUT pattern matcher
- * This encodes one bit of two pattern matchers
- *
- * @param triggerValue1
- * @param triggerValue0
- * @return
- */
-uint16_t getPatternMatchHalfLutValues(PinTriggerEncoding triggerValue1, PinTriggerEncoding triggerValue0) {
-   unsigned index = 6*triggerValueIndex(triggerValue1)+triggerValueIndex(triggerValue0);
-   return lutEncoding[index];
-}
-
 /**
  * Get the LUT values for the pattern matchers in a trigger step
  *
@@ -93,22 +19,7 @@ uint16_t getPatternMatchHalfLutValues(PinTriggerEncoding triggerValue1, PinTrigg
  * @param lutValues
  */
 void getTriggerStepPatternMatcherLutValues(TriggerStep &trigger, uint32_t lutValues[LUTS_PER_TRIGGER_STEP_FOR_PATTERNS]) {
-
-   int lutIndex = 0;
-
-   for(int bitNum=SAMPLE_WIDTH-1; bitNum>=PATTERN_MATCHER_BITS_PER_LUT-1; bitNum-=PATTERN_MATCHER_BITS_PER_LUT) {
-      for(int condition=MAX_TRIGGER_PATTERNS-1; condition>=PARTIAL_PATTERN_MATCHERS_PER_LUT-1; condition-=PARTIAL_PATTERN_MATCHERS_PER_LUT) {
-         uint32_t value = 0;
-         value  = getPatternMatchHalfLutValues(
-               trigger.getPattern(condition)[bitNum],
-               trigger.getPattern(condition)[bitNum-1]);
-         value <<= 16;
-         value |= getPatternMatchHalfLutValues(
-               trigger.getPattern(condition-1)[bitNum],
-               trigger.getPattern(condition-1)[bitNum-1]);
-         lutValues[lutIndex++] = value;
-      }
-   }
+   trigger.getTriggerStepPatternMatcherLutValues(lutValues);
 }
 
 /**
@@ -118,39 +29,7 @@ void getTriggerStepPatternMatcherLutValues(TriggerStep &trigger, uint32_t lutVal
  * @param lutValues
  */
 void getTriggerPatternMatcherLutValues(TriggerSetup setup, uint32_t lutValues[LUTS_FOR_TRIGGER_PATTERNS]) {
-   unsigned lutIndex = 0;
-   for(int step=MAX_TRIGGER_STEPS-1; step >=0; step-- ) {
-      getTriggerStepPatternMatcherLutValues(setup.triggers[step],  lutValues+lutIndex);
-      lutIndex += LUTS_PER_TRIGGER_STEP_FOR_PATTERNS;
-   }
-}
-
-/**
- * Get the LUT values for the combiner in a trigger step
- *
- * @param trigger
- * @param lutValues
- */
-void getTriggerStepCombinerLutValues(TriggerStep &trigger, uint32_t lutValues[LUTS_PER_TRIGGER_STEP_FOR_COMBINERS]) {
-   uint16_t result = 0;
-
-   for (unsigned value=0; value<(1<<MAX_TRIGGER_PATTERNS); value++) {
-      bool bitValue;
-      switch(trigger.getOperation()) {
-         case Operation::And: bitValue = 1; break;
-         case Operation::Or:  bitValue = 0; break;
-      }
-      for (unsigned patternNum=0; patternNum<MAX_TRIGGER_PATTERNS; patternNum++) {
-         bool term = (value&(1<<patternNum));
-         term = trigger.getPolarities(patternNum)(term, trigger.getOperation());
-         switch(trigger.getOperation()) {
-            case Operation::And: bitValue = bitValue && term; break;
-            case Operation::Or:  bitValue = bitValue || term; break;
-         }
-      }
-      result |= bitValue<<value;
-   }
-   lutValues[0] = result;
+   setup.getTriggerPatternMatcherLutValues(lutValues);
 }
 
 /**
@@ -160,53 +39,9 @@ void getTriggerStepCombinerLutValues(TriggerStep &trigger, uint32_t lutValues[LU
  * @param lutValues
  */
 void getTriggerCombinerLutValues(TriggerSetup setup, uint32_t lutValues[LUTS_FOR_TRIGGER_COMBINERS]) {
-   unsigned lutIndex = 0;
-   for(int step=MAX_TRIGGER_STEPS-1; step >=0; step-- ) {
-      getTriggerStepCombinerLutValues(setup.triggers[step],  lutValues+lutIndex);
-      lutIndex += LUTS_PER_TRIGGER_STEP_FOR_COMBINERS;
-   }
+   setup.getTriggerCombinerLutValues(lutValues);
 }
 
-///**
-// * Does two steps at a time because of interleaved values in LUTs
-// *
-// * @param t1
-// * @param t0
-// * @param lutValues
-// */
-//void getTriggerStepPairCountLutValues(TriggerStep t1, TriggerStep t0, uint32_t lutValues[2*LUTS_PER_TRIGGER_STEP_FOR_COUNTS]) {
-//   static constexpr unsigned BIT_MASK = (1U<<COUNT_MATCHER_BITS_PER_LUT)-1;
-//   unsigned lutIndex=0;
-//
-//   for (unsigned bits=NUM_MATCH_COUNTER_BITS; bits>=COUNT_MATCHER_BITS_PER_LUT; bits -= COUNT_MATCHER_BITS_PER_LUT) {
-//      unsigned partial1, partial0;
-//      partial1 = t1.triggerCount>>(bits-COUNT_MATCHER_BITS_PER_LUT);
-//      partial0 = t0.triggerCount>>(bits-COUNT_MATCHER_BITS_PER_LUT);
-//      partial1 = partial1&BIT_MASK;
-//      partial0 = partial0&BIT_MASK;
-//      partial1 = 1U<<partial1;
-//      partial0 = 1U<<partial0;
-////      partial1 = 1U<<((t1.triggerCount>>(bits-COUNT_MATCHER_BITS_PER_LUT))&BIT_MASK);
-////      partial0 = 1U<<((t0.triggerCount>>(bits-COUNT_MATCHER_BITS_PER_LUT))&BIT_MASK);
-//      lutValues[lutIndex++] = (partial1<<16)|partial0;
-//   }
-//}
-//
-///**
-// * Get the LUT values for the trigger count comparators for all trigger steps
-// *
-// * @param trigger
-// * @param lutValues
-// */
-//void getTriggerCountLutValues(TriggerSetup setup, uint32_t lutValues[LUTS_FOR_TRIGGER_COUNTS]) {
-//   unsigned lutIndex = 0;
-//   // Process the Triggers in pairs
-//   for(int step=MAX_TRIGGER_STEPS-1; step >= 1; step-=2 ) {
-//      getTriggerStepPairCountLutValues(setup.triggers[step], setup.triggers[step-1],  lutValues+lutIndex);
-//      lutIndex += 2*LUTS_PER_TRIGGER_STEP_FOR_COUNTS;
-//   }
-//}
-
 /**
  * Get the LUT values for the trigger count comparators for all trigger steps
  *
@@ -214,21 +49,7 @@ void getTriggerCombinerLutValues(TriggerSetup setup, uint32_t lutValues[LUTS_FOR
  * @param lutValues
  */
 void getTriggerCountLutValues(TriggerSetup setup, uint32_t lutValues[LUTS_FOR_TRIGGER_COUNTS]) {
-
-   // Clear LUTs initially
-   for(int index=0; index<LUTS_FOR_TRIGGER_COUNTS; index++) {
-      lutValues[index] = 0;
-   }
-   // Shuffle Trigger values for LUTS
-   // This is basically a transpose
-   for(int step=0; step < MAX_TRIGGER_STEPS; step++ ) {
-      // The bits for each step appear at the this location in the SR
-      uint32_t bitmask = 1<<step;
-      uint32_t count   = Lfsr16::encode(setup.getTrigger(step).getCount());
-      for(int bit=0; bit<NUM_MATCH_COUNTER_BITS; bit++ ) {
-          lutValues[(NUM_MATCH_COUNTER_BITS-1)-bit] |= (count&(1<<bit))?bitmask:0;
-      }
-   }
+   setup.getTriggerCountLutValues(lutValues);
 }
 
 /**
@@ -238,16 +59,7 @@ void getTriggerCountLutValues(TriggerSetup setup, uint32_t lutValues[LUTS_FOR_TR
  * @param lutValues
  */
 void getTriggerFlagLutValues(TriggerSetup setup, uint32_t lutValues[LUTS_FOR_TRIGGERS_FLAGS]) {
-   unsigned lutIndex = 0;
-   uint32_t flags = 0;
-   // Process each trigger
-   for(int step=0; step < MAX_TRIGGER_STEPS; step++ ) {
-      if (setup.triggers[step].isContiguous()) {
-         flags |= (1<<step);
-      }
-   }
-   lutValues[lutIndex++] = (1<<setup.lastActiveTriggerCount);
-   lutValues[lutIndex++] = flags;
+   setup.getTriggerFlagLutValues(lutValues);
 }
 
 /**
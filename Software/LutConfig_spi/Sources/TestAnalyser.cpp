@@ -184,7 +184,7 @@ void testIndividualTriggerPattern() {
    }
 }
 
-TriggerStep triggersdontcare[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggersdontcare[MAX_TRIGGER_STEPS] = {
       // Pattern 0 Pattern 1      Polarity 0          Polarity 1          Count
       {   "XX",     "XX",    Polarity::Normal,   Polarity::Normal,  Operation::And, false, 1},
       {   "XX",     "XX",    Polarity::Normal,   Polarity::Normal,  Operation::And, false, 2},
@@ -192,7 +192,7 @@ TriggerStep triggersdontcare[MAX_TRIGGER_STEPS] = {
       {   "XX",     "XX",    Polarity::Normal,   Polarity::Normal,  Operation::And, false, 4},
 };
 
-TriggerStep triggers1[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggers1[MAX_TRIGGER_STEPS] = {
       // Pattern 0 Pattern 1      Polarity 0          Polarity 1          Count
       {   "XX",     "XX",    Polarity::Normal,   Polarity::Disabled,  Operation::And, false, 4},
       {   "X0",     "X0",    Polarity::Normal,   Polarity::Disabled,  Operation::And, false, 3},
@@ -200,7 +200,7 @@ TriggerStep triggers1[MAX_TRIGGER_STEPS] = {
       {   "XC",     "XC",    Polarity::Normal,   Polarity::Disabled,  Operation::And, false, 7},
 };
 
-TriggerStep triggers2[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggers2[MAX_TRIGGER_STEPS] = {
       // Pattern 0 Pattern 1      Polarity 0          Polarity 1          Count
       {   "XX",     "XX",    Polarity::Disabled,   Polarity::Normal,  Operation::And, false, 100},
       {   "X0",     "X1",    Polarity::Disabled,   Polarity::Normal,  Operation::And, false, 100},
@@ -208,7 +208,7 @@ TriggerStep triggers2[MAX_TRIGGER_STEPS] = {
       {   "XC",     "XF",    Polarity::Disabled,   Polarity::Normal,  Operation::And, false, 100},
 };
 
-TriggerStep triggers3[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggers3[MAX_TRIGGER_STEPS] = {
       // Pattern 0 Pattern 1      Polarity 0          Polarity 1          Count
       {   "XX",     "XX",    Polarity::Normal,     Polarity::Normal,  Operation::And, false, 100},
       {   "X0",     "1X",    Polarity::Normal,     Polarity::Normal,  Operation::And, false, 100},
@@ -216,7 +216,7 @@ TriggerStep triggers3[MAX_TRIGGER_STEPS] = {
       {   "XC",     "FX",    Polarity::Normal,     Polarity::Normal,  Operation::And, false, 100},
 };
 
-TriggerStep triggers4[MAX_TRIGGER_STEPS] = {
+constexpr TriggerStep triggers4[MAX_TRIGGER_STEPS] = {
       // Pattern 0 Pattern 1      Polarity 0          Polarity 1          Count
       {   "XX",     "XX",    Polarity::Normal,     Polarity::Normal,  Operation::Or, false, 100},
       {   "X0",     "1X",    Polarity::Normal,     Polarity::Normal,  Operation::Or, false, 100},
@@ -226,7 +226,7 @@ TriggerStep triggers4[MAX_TRIGGER_STEPS] = {
 
 void printTriggers(TriggerSetup triggers) {
    for (unsigned step=0; step<MAX_TRIGGER_STEPS; step++) {
-      USBDM::console.write("  -- ").writeln(triggers.triggers[step].toString());
+      USBDM::console.write("  -- ").writeln(triggers.getTrigger(step).toString());
    }
 }
 
@@ -316,7 +316,7 @@ void loadLuts() {
 
    initHardware();
 
-   TriggerSetup setup = {triggers1, 4};
+   TriggerSetup setup = {triggers1, MAX_TRIGGER_STEPS-1};
 
    printTriggers(setup);
 
@@ -48,17 +48,17 @@ architecture Behavioral of LogicAnalyser is
    attribute ASYNC_REG                   : string;
    attribute IOB                         : string;
 
-   -- SDRAM FIFO data contains 2 flags + sample value
+   -- SDRAM FIFO data contains 2 flags + sample value (or RLE word)
    signal write_fifo_din                 : std_logic_vector(SampleDataType'left+2 downto 0) := (others => '0');
    signal write_fifo_dout                : std_logic_vector(SampleDataType'left+2 downto 0) := (others => '0');
 
-   alias  preTrigger_sample              : std_logic      is write_fifo_din(SampleDataType'left+2);
-   alias  trigger_sample                 : std_logic      is write_fifo_din(SampleDataType'left+1);
-   alias  currentSample                  : SampleDataType is write_fifo_din(SampleDataType'left downto 0);
+   signal preTrigger_sample              : std_logic      := '0';
+   signal trigger_sample                 : std_logic      := '0';
 
    -- Sampling
    -- iob_sample -> currentSample -> lastSample
    signal iob_sample                     : SampleDataType := (others => '0');
+   signal currentSample                  : SampleDataType := (others => '0');
    signal lastSample                     : SampleDataType := (others => '0');
 
    attribute IOB of iob_sample           : signal is "true";
@@ -74,7 +74,7 @@ architecture Behavioral of LogicAnalyser is
    signal sdram_rd_data_ready            : std_logic      := '0';
    signal sdram_rd_data                  : sdram_phy_DataType := (others => '0');
 
-   -- Count of captured data
+   -- Count of captured data (SDRAM words i.e. samples or RLE words)
    signal capture_counter                : sdram_AddrType := (others => '0');
 
    -- Required pre-trigger captured data
@@ -110,12 +110,30 @@ architecture Behavioral of LogicAnalyser is
       s_write_pretrig3,
       s_write_capture2, -- Writing 24-bit capture value
       s_write_capture3,
+      s_write_channels2,-- Writing 32-bit channel mask
+      s_write_channels3,
+      s_write_channels4,
+      s_write_offset2,  -- Writing 24-bit read offset value
+      s_write_offset3,
+      s_seek1,          -- Moving read address - waiting for SDRAM reads to finish
+      s_seek2,          -- Moving read address - waiting for read FIFO reset
       s_load_luts1,     -- Writing LUT config data
       s_load_luts2, 
+      s_update_luts1,   -- Partial LUT update - getting recirculate count
+      s_update_luts2,   -- Partial LUT update - recirculating LUT chain
+      s_update_luts3,   -- Partial LUT update - getting load count
+      s_update_luts4,
+      s_update_luts5,
       s_read_version,   -- Read design version
+      s_read_config,    -- Read hardware configuration
       s_read_buffer1,   -- Reading SDRAM
       s_read_buffer2,
-      s_read_status     -- Reading Status values
+      s_read_status,    -- Reading Status values
+      s_read_fill1,     -- Reading ring buffer write count - waiting for snapshot
+      s_read_fill2,
+      s_read_snapshot1, -- Reading status snapshot - waiting for write count snapshot
+      s_read_snapshot2,
+      s_notify          -- Sending unsolicited status on capture completion
    );
    signal iState                         : InterfaceState := s_cmd;
    signal nextIState                     : InterfaceState := s_cmd;
@@ -125,7 +143,8 @@ architecture Behavioral of LogicAnalyser is
       t_preTrig,     -- Capturing data to create pre-trig data
       t_armed,       -- Looking for trigger while capturing
       t_running,     -- Capturing after trigger
-      t_complete     -- Buffer filled (not capturing)
+      t_complete,    -- Buffer filled (not capturing)
+      t_streaming    -- Capturing continuously to SDRAM ring buffer
    );
 
    signal tState                         : TriggerState := t_idle;
@@ -136,21 +155,171 @@ architecture Behavioral of LogicAnalyser is
    signal command                        : AnalyserCmdType;
 
    signal wr_trigger_luts                : std_logic    := '0';
+   signal recirculate_trigger_luts       : std_logic    := '0';
    signal trigger_bus_busy               : std_logic    := '0';
    signal triggerFound                   : std_logic    := '0';
+   signal trigger_step                   : TriggerRangeType := (others => '0');
+   signal match_count                    : MatchCounterType := (others => '0');
 
 --       7        6       5      4       3       2        1       0
 --   +-------+-------+-------+-------+-------+-------+-------+-------+
---   |               |    PRESCALE   |    PRESCALE   | CLEAR | START |
---   |               |     DECADE    |    DIVIDER    |   *   | ACQ * |
+--   |STREAM |NOTIFY |    PRESCALE   |    PRESCALE   | CLEAR | START |
+--   |       |       |     DECADE    |    DIVIDER    |   *   | ACQ * |
 --   +-------+-------+-------+-------+-------+-------+-------+-------+
 --     * self-clearing bits
+--     NOTIFY - send status to host without request when capture completes
+--     STREAM - START ACQ captures continuously to the SDRAM ring buffer until CLEAR
 
-   signal controlRegister                : std_logic_vector(5 downto 0) := (others => '0');
+   signal controlRegister                : std_logic_vector(7 downto 0) := (others => '0');
    alias  controlReg_start_acq           : std_logic        is controlRegister(0);
    alias  controlReg_clear               : std_logic        is controlRegister(1);
    alias  selectDivider                  : std_logic_vector is controlRegister(3 downto 2);
    alias  selectDecade                   : std_logic_vector is controlRegister(5 downto 4);
+   alias  controlReg_notify              : std_logic        is controlRegister(6);
+   alias  controlReg_stream              : std_logic        is controlRegister(7);
+
+--       7        6       5      4       3       2        1       0
+--   +-------+-------+-------+-------+-------+-------+-------+-------+
+--   |                                       | PACK  |    CAPTURE    |
+--   |                                       |       |     MODE      |
+--   +-------+-------+-------+-------+-------+-------+-------+-------+
+--     CAPTURE MODE - C_MODE_RAW, C_MODE_RLE, C_MODE_TRANSITION
+--     PACK         - C_MODE_PACK Read back only the channels in the channel mask
+
+   signal modeRegister                   : std_logic_vector(7 downto 0) := (others => '0');
+   alias  captureMode                    : std_logic_vector is modeRegister(1 downto 0);
+   alias  modeReg_pack                   : std_logic        is modeRegister(2);
+
+   signal write_mode_reg                 : std_logic := '0';
+
+   -- Channel enable mask (C_WR_CHANNELS, 32-bit low byte first)
+   -- Only enabled channels are monitored for changes in C_MODE_TRANSITION
+   -- and read back with C_MODE_PACK
+   signal channelRegister                : std_logic_vector(31 downto 0) := (others => '1');
+   alias  channelMask                    : SampleDataType is channelRegister(SampleDataType'range);
+
+   signal write_channels                 : std_logic := '0';
+
+   -- Run-length encoding of captured samples (C_MODE_RLE)
+   -- Each run of identical samples is written as 2 words: value, repeat count
+   constant RLE_MAX_COUNT                : unsigned(15 downto 0) := (others => '1');
+   signal rle_enable                     : std_logic      := '0';
+   signal rle_valid                      : std_logic      := '0';
+   signal rle_value                      : SampleDataType := (others => '0');
+   signal rle_count                      : unsigned(15 downto 0) := (others => '0');
+   signal rle_trigger                    : std_logic      := '0';
+   signal rle_count_pending              : std_logic      := '0';
+   signal rle_pending_count              : unsigned(15 downto 0) := (others => '0');
+   signal rle_wr                         : std_logic      := '0';
+   signal rle_word                       : SampleDataType := (others => '0');
+   signal rle_word_trigger               : std_logic      := '0';
+
+   -- Transitional capture (C_MODE_TRANSITION)
+   -- Each change of the enabled channels is written as 2 words: value, ticks since previous change
+   constant TR_MAX_DELTA                 : unsigned(15 downto 0) := (others => '1');
+   signal transition_enable              : std_logic      := '0';
+   signal tr_valid                       : std_logic      := '0';
+   signal tr_value                       : SampleDataType := (others => '0');
+   signal tr_ticks                       : unsigned(15 downto 0) := (others => '0');
+   signal tr_trigger_held                : std_logic      := '0';
+   signal tr_delta_pending               : std_logic      := '0';
+   signal tr_pending_delta               : unsigned(15 downto 0) := (others => '0');
+   signal tr_wr                          : std_logic      := '0';
+   signal tr_word                        : SampleDataType := (others => '0');
+   signal tr_word_trigger                : std_logic      := '0';
+
+   -- Packed readback (C_MODE_PACK)
+   -- Samples read from the SDRAM are reduced to channels 0-3 or 0-7 (as needed
+   -- for the channel mask) and packed into SDRAM words before the read FIFO.
+   -- The first sample is in the least significant bits.
+   constant PACK_NONE                    : std_logic_vector(1 downto 0) := "00";
+   constant PACK_8                       : std_logic_vector(1 downto 0) := "01";
+   constant PACK_4                       : std_logic_vector(1 downto 0) := "10";
+   signal readback_pack                  : std_logic_vector(1 downto 0) := PACK_NONE;
+   signal pack1                          : std_logic_vector(1 downto 0) := PACK_NONE;
+   signal sdram_pack                     : std_logic_vector(1 downto 0) := PACK_NONE;
+   signal pack_word                      : sdram_phy_DataType := (others => '0');
+   signal pack_slot                      : unsigned(1 downto 0) := (others => '0');
+   signal read_fifo_din                  : sdram_phy_DataType := (others => '0');
+   signal read_fifo_wr_en                : std_logic := '0';
+
+   attribute ASYNC_REG of pack1          : signal is "TRUE";
+   attribute ASYNC_REG of sdram_pack     : signal is "TRUE";
+
+   -- Trigger sample while armed (starts a new run or event)
+   signal capture_trigger                : std_logic      := '0';
+
+   -- Word written to SDRAM FIFO (counts towards pre-trigger and capture amounts)
+   -- In C_MODE_RLE and C_MODE_TRANSITION there are 2 words for each run or event
+   signal capture_tick                   : std_logic      := '0';
+
+   -- Streaming (SDRAM used as ring buffer drained by host)
+   signal sdram_streaming                : std_logic := '0';
+   signal streaming1                     : std_logic := '0';
+   signal streaming2                     : std_logic := '0';
+
+   attribute ASYNC_REG of streaming1     : signal is "TRUE";
+   attribute ASYNC_REG of streaming2     : signal is "TRUE";
+
+   -- Ring buffer overrun (sticky in SDRAM clock domain)
+   signal sdram_overrun                  : std_logic := '0';
+   signal overrun1                       : std_logic := '0';
+   signal overrun                        : std_logic := '0';
+
+   attribute ASYNC_REG of overrun1       : signal is "TRUE";
+   attribute ASYNC_REG of overrun        : signal is "TRUE";
+
+   -- Ring buffer write count snapshot for C_RD_FILL
+   -- The snapshot is taken in the SDRAM clock domain on the rising edge of fill_request
+   -- and is stable before s_read_fill2 reads it (FILL_SNAPSHOT_DELAY clocks later)
+   constant FILL_SNAPSHOT_DELAY          : natural := 12;
+   signal sdram_wr_count                 : sdram_AddrType := (others => '0');
+   signal fill_snapshot                  : sdram_AddrType := (others => '0');
+   signal snapshot_fill                  : std_logic := '0';
+   signal fill_request                   : std_logic := '0';
+   signal fill_request1                  : std_logic := '0';
+   signal fill_request2                  : std_logic := '0';
+   signal fill_request3                  : std_logic := '0';
+   signal load_fill_count                : std_logic := '0';
+
+   attribute ASYNC_REG of fill_request1  : signal is "TRUE";
+   attribute ASYNC_REG of fill_request2  : signal is "TRUE";
+
+   -- Status snapshot for C_RD_SNAPSHOT
+   -- The write count is taken as for C_RD_FILL. The other values are latched with
+   -- it at the end of s_read_snapshot1 so all are sent from the same instant.
+   --   0      status (as C_RD_STATUS)
+   --   1      trigger step
+   --   2..3   match counter (LFSR value)
+   --   4..6   capture counter
+   --   7..9   pre-trigger fill
+   --   10..12 SDRAM write count
+   constant SNAPSHOT_BYTES               : natural := 13;
+   type SnapshotBytesType is array (0 to SNAPSHOT_BYTES-1) of DataBusType;
+   signal status_snapshot                : SnapshotBytesType := (others => (others => '0'));
+   signal latch_snapshot                 : std_logic := '0';
+   signal load_snapshot_count            : std_logic := '0';
+
+   -- Random access readback (C_WR_READ_OFFSET)
+   -- The read address is moved to readOffset words from the start of the capture.
+   -- SEEK_DELAY clocks are allowed for SDRAM reads in progress to reach the read FIFO
+   -- before the move and again for the read FIFO reset that discards them.
+   constant SEEK_DELAY                   : natural := 16;
+   signal readOffset                     : sdram_AddrType := (others => '0');
+   signal seek_read                      : std_logic := '0';
+   signal seek_request                   : std_logic := '0';
+   signal seek_request1                  : std_logic := '0';
+   signal seek_request2                  : std_logic := '0';
+   signal sdram_rd_seek                  : std_logic := '0';
+   signal read_fifo_reset                : std_logic := '0';
+   signal load_seek_count                : std_logic := '0';
+
+   attribute ASYNC_REG of seek_request1  : signal is "TRUE";
+   attribute ASYNC_REG of seek_request2  : signal is "TRUE";
+
+   -- Completion status waiting to be sent to host
+   signal notify_pending                 : std_logic := '0';
+   signal notify_sent                    : std_logic := '0';
 
    signal sdram_wr                       : std_logic := '0';
    signal r_isEmpty                      : std_logic := '0';
@@ -163,6 +332,18 @@ architecture Behavioral of LogicAnalyser is
    signal decrement_data_count           : std_logic := '0';
    signal write_data_count            : std_logic := '0';
    signal write_data_count_high           : std_logic := '0';
+   signal load_config_count              : std_logic := '0';
+
+   -- Hardware configuration returned by C_RD_CONFIG
+   -- Key (as ConfigData.vhd) followed by size of trigger hardware
+   type ConfigBytesType is array (0 to 7) of DataBusType;
+   constant CONFIG_BYTES : ConfigBytesType := (
+      x"A5", x"5E", x"12", x"34",
+      std_logic_vector(to_unsigned(SAMPLE_WIDTH,           DataBusType'length)),
+      std_logic_vector(to_unsigned(MAX_TRIGGER_STEPS,      DataBusType'length)),
+      std_logic_vector(to_unsigned(MAX_TRIGGER_PATTERNS,   DataBusType'length)),
+      std_logic_vector(to_unsigned(NUM_MATCH_COUNTER_BITS, DataBusType'length))
+   );
 
    signal write_control_reg              : std_logic := '0';
 
@@ -198,6 +379,9 @@ architecture Behavioral of LogicAnalyser is
    signal write_capture_high             : std_logic := '0';
    signal write_capture_mid              : std_logic := '0';
    signal write_capture_low              : std_logic := '0';
+   signal write_offset_high              : std_logic := '0';
+   signal write_offset_mid               : std_logic := '0';
+   signal write_offset_low               : std_logic := '0';
 
 begin
 
@@ -247,6 +431,133 @@ begin
    -- Mark this sample as trigger sample
    trigger_sample    <= '1' when (triggerFound = '1') else '0';
 
+   -- Run-length encoding needs 2 clocks to write a run so is not used at 10 ns
+   -- or when streaming
+   rle_enable <= '1' when (captureMode = C_MODE_RLE(1 downto 0)) and
+                          ((selectDivider /= "00") or (selectDecade /= "00")) and
+                          (controlReg_stream = '0') else '0';
+
+   transition_enable <= '1' when (captureMode = C_MODE_TRANSITION(1 downto 0)) and
+                                 (controlReg_stream = '0') else '0';
+
+   -- Sample, RLE or transition words -> SDRAM FIFO
+   write_fifo_din <= preTrigger_sample & rle_word_trigger & rle_word when (rle_enable = '1') else
+                     preTrigger_sample & tr_word_trigger  & tr_word  when (transition_enable = '1') else
+                     preTrigger_sample & trigger_sample   & currentSample;
+   fifo_wr_en     <= rle_wr when (rle_enable = '1') else
+                     tr_wr  when (transition_enable = '1') else
+                     doSample;
+   capture_tick   <= fifo_wr_en;
+
+   -- Packing only applies to raw samples read back after a capture
+   readback_pack <= PACK_NONE when (modeReg_pack = '0') or (captureMode /= C_MODE_RAW(1 downto 0)) or
+                                   (controlReg_stream = '1') else
+                    PACK_4    when (unsigned(channelRegister(31 downto 4)) = 0) else
+                    PACK_8    when (unsigned(channelRegister(31 downto 8)) = 0) else
+                    PACK_NONE;
+
+   -- Trigger sample starts a new run or event
+   capture_trigger <= '1' when (tState = t_armed) and (triggerFound = '1') else '0';
+
+   -- Run-length encoder
+   -- A run ends when the sample changes, the repeat count saturates or at the trigger
+   -- The run is written as its value (with trigger flag) followed by the repeat count
+   -- (run length-1) on the next clock.
+   -- The pre-trigger flag is applied by the capture state machine and always falls on
+   -- a value word as the pre-trigger amount is even.
+   RleEncoder_proc:
+   process(clock_100MHz)
+   begin
+      if rising_edge(clock_100MHz) then
+         rle_wr <= '0';
+
+         if (rle_count_pending = '1') then
+            -- Second word of run
+            rle_wr            <= '1';
+            rle_word          <= std_logic_vector(resize(rle_pending_count, SampleDataType'length));
+            rle_word_trigger  <= '0';
+            rle_count_pending <= '0';
+         end if;
+
+         if (sampling = '0') then
+            rle_valid <= '0';
+         elsif (doSample = '1') then
+            if (rle_valid = '1') and (currentSample = rle_value) and
+               (rle_count /= RLE_MAX_COUNT) and (capture_trigger = '0') then
+               -- Extend run
+               rle_count <= rle_count + 1;
+            else
+               if (rle_valid = '1') then
+                  -- First word of finished run
+                  rle_wr            <= '1';
+                  rle_word          <= rle_value;
+                  rle_word_trigger  <= rle_trigger;
+                  rle_pending_count <= rle_count;
+                  rle_count_pending <= '1';
+               end if;
+               -- Start new run
+               rle_valid   <= '1';
+               rle_value   <= currentSample;
+               rle_count   <= (others => '0');
+               rle_trigger <= capture_trigger;
+            end if;
+         end if;
+      end if;
+   end process;
+
+   -- Transition encoder
+   -- An event is written when an enabled channel changes, the tick count saturates
+   -- or at the trigger. The first sample is always an event (ticks = 0).
+   -- The event is written as the sample value (with trigger flag) followed by the
+   -- number of ticks since the previous event on the next clock.
+   -- At 10 ns a change on the clock after an event is written a tick late
+   -- (as is the trigger).
+   TransitionEncoder_proc:
+   process(clock_100MHz)
+   variable trigger : std_logic;
+   begin
+      if rising_edge(clock_100MHz) then
+         tr_wr <= '0';
+
+         if (tr_delta_pending = '1') then
+            -- Second word of event
+            tr_wr            <= '1';
+            tr_word          <= std_logic_vector(resize(tr_pending_delta, SampleDataType'length));
+            tr_word_trigger  <= '0';
+            tr_delta_pending <= '0';
+         end if;
+
+         if (sampling = '0') then
+            tr_valid        <= '0';
+            tr_trigger_held <= '0';
+         elsif (doSample = '1') then
+            trigger := capture_trigger or tr_trigger_held;
+            if (tr_delta_pending = '0') and
+               ((tr_valid = '0') or (unsigned((currentSample xor tr_value) and channelMask) /= 0) or
+                (tr_ticks = TR_MAX_DELTA) or (trigger = '1')) then
+               -- First word of event
+               tr_wr            <= '1';
+               tr_word          <= currentSample;
+               tr_word_trigger  <= trigger;
+               tr_delta_pending <= '1';
+               if (tr_valid = '0') then
+                  tr_pending_delta <= (others => '0');
+               else
+                  tr_pending_delta <= tr_ticks;
+               end if;
+               tr_valid         <= '1';
+               tr_value         <= currentSample;
+               tr_ticks         <= to_unsigned(1, tr_ticks'length);
+               tr_trigger_held  <= '0';
+            else
+               -- Trigger is held until an event can be written
+               tr_ticks         <= tr_ticks + 1;
+               tr_trigger_held  <= trigger;
+            end if;
+         end if;
+      end if;
+   end process;
+
    CaptureStateMachine:
    process(clock_100MHz)
 
@@ -263,6 +574,21 @@ begin
             controlRegister <= host_receive_data(controlRegister'left downto controlRegister'right);
          end if;
 
+         if (write_mode_reg = '1') then
+            modeRegister <= host_receive_data;
+         end if;
+
+         if (write_channels = '1') then
+            channelRegister <= host_receive_data & channelRegister(31 downto 8);
+         end if;
+
+         if (notify_sent = '1') then
+            notify_pending <= '0';
+         end if;
+
+         overrun1 <= sdram_overrun;
+         overrun  <= overrun1;
+
          if (write_pretrig_high = '1') then
             preTrigger_amount(preTrigger_amount'left downto 16) <= host_receive_data(preTrigger_amount'left-16 downto 0);
          end if;
@@ -287,6 +613,18 @@ begin
             capture_amount(7 downto 0) <= host_receive_data;
          end if;
 
+         if (write_offset_high = '1') then
+            readOffset(readOffset'left downto 16) <= host_receive_data(readOffset'left-16 downto 0);
+         end if;
+
+         if (write_offset_mid  = '1') then
+            readOffset(15 downto 8) <= host_receive_data;
+         end if;
+
+         if (write_offset_low  = '1') then
+            readOffset(7 downto 0) <= host_receive_data;
+         end if;
+
          case (tState) is
             when t_idle =>
                -- Idle
@@ -294,7 +632,11 @@ begin
 
                if (controlReg_start_acq = '1') then
                   clear_counter <= '1';
-                  tState        <= t_preTrig;
+                  if (controlReg_stream = '1') then
+                     tState     <= t_streaming;
+                  else
+                     tState     <= t_preTrig;
+                  end if;
                end if;
 
             when t_preTrig =>
@@ -304,7 +646,7 @@ begin
                -- Read pointer is held so read pointer trails write pointer
                sampling  <= '1';
 
-               if (doSample = '1') then
+               if (capture_tick = '1') then
                   -- Count pre-trigger capture
                   next_count := std_logic_vector(unsigned(capture_counter) + 1);
                   capture_counter <= next_count;
@@ -323,9 +665,11 @@ begin
                -- Capture count is held at pre-trigger value
                armed     <= '1';
                sampling  <= '1';
-               if (doSample = '1') then
+               if (capture_tick = '1') then
                   -- No longer pre-trigger threshold
                   preTrigger_sample <= '0';
+               end if;
+               if (doSample = '1') then
                   if (triggerFound = '1') then
                      -- Found trigger
                      tState <= t_running;
@@ -338,12 +682,14 @@ begin
                -- current pre-trigger and capture points in sync
 
                sampling <= '1';
-               if (doSample = '1') then
+               if (capture_tick = '1') then
                   -- Count post-trigger capture
                   capture_counter <= std_logic_vector(unsigned(capture_counter) + 1);
                   if (capture_counter = capture_amount) then
                      -- Captured required amount of data
                      tState <= t_complete;
+                     -- Tell host if requested
+                     notify_pending <= controlReg_notify;
                   end if;
                end if;
 
@@ -354,22 +700,36 @@ begin
                   tState           <= t_idle;
                   controlReg_clear <= '0';
                end if;
+
+            when t_streaming =>
+               -- Capturing continuously to SDRAM ring buffer
+               -- Read pointer only advances as the host reads data
+               -- Samples are discarded (overrun) if the ring buffer fills
+               controlReg_start_acq <= '0';
+               sampling             <= '1';
+               if (controlReg_clear = '1') then
+                  tState           <= t_idle;
+                  controlReg_clear <= '0';
+               end if;
          end case;
       end if;
    end process;
 
    -- SDRAM -> Read path
+   -- Data read ahead is discarded when the read address is moved (not when streaming)
+   read_fifo_reset <= sdram_counter_clear or (sdram_rd_seek and not sdram_streaming);
+
 	read_fifo_inst:
    entity work.read_fifo
    port map(
-		rst            => sdram_counter_clear,
+		rst            => read_fifo_reset,
 
       -- 110 MHz clock domain (SDRAM)
       wr_clk         => clock_110MHz,
-		wr_en          => sdram_rd_data_ready,
+		wr_en          => read_fifo_wr_en,
 		full           => read_fifo_full,
       prog_full      => read_fifo_near_full,
-		din            => sdram_rd_data,
+		din            => read_fifo_din,
 
       -- 100 MHz clock domain (Read data path)
       rd_clk         => clock_100MHz,
@@ -386,7 +746,7 @@ begin
 
       -- 100 MHz clock domain (Sample data)
       wr_clk         => clock_100MHz,
-		wr_en          => doSample,
+		wr_en          => fifo_wr_en,
 		full           => open,
 		din            => write_fifo_din,
 
@@ -399,6 +759,46 @@ begin
       dout           => write_fifo_dout
 	);
 
+   -- SDRAM -> Read FIFO with optional packing (C_MODE_PACK)
+   -- A packed word is written to the FIFO when all its slots are filled.
+   -- The SDRAM is read ahead so the final word of a readback is always completed.
+   ReadPacker_proc:
+   process(clock_110MHz)
+   begin
+      if rising_edge(clock_110MHz) then
+         pack1           <= readback_pack;
+         sdram_pack      <= pack1;
+         read_fifo_wr_en <= '0';
+
+         if (read_fifo_reset = '1') then
+            pack_slot <= (others => '0');
+         elsif (sdram_rd_data_ready = '1') then
+            case (sdram_pack) is
+               when PACK_8 =>
+                  pack_word <= sdram_rd_data(7 downto 0) & pack_word(15 downto 8);
+                  if (pack_slot = 1) then
+                     read_fifo_din   <= sdram_rd_data(7 downto 0) & pack_word(15 downto 8);
+                     read_fifo_wr_en <= '1';
+                     pack_slot       <= (others => '0');
+                  else
+                     pack_slot       <= pack_slot + 1;
+                  end if;
+               when PACK_4 =>
+                  pack_word <= sdram_rd_data(3 downto 0) & pack_word(15 downto 4);
+                  if (pack_slot = 3) then
+                     read_fifo_din   <= sdram_rd_data(3 downto 0) & pack_word(15 downto 4);
+                     read_fifo_wr_en <= '1';
+                  end if;
+                  pack_slot <= pack_slot + 1;
+               when others =>
+                  read_fifo_din   <= sdram_rd_data;
+                  read_fifo_wr_en <= '1';
+                  pack_slot       <= (others => '0');
+            end case;
+         end if;
+      end if;
+   end process;
+
    -- Read from SDRAM -> FIFO
    -- This crosses clock domains so needs sync
    fifo_sdramProc:
@@ -412,6 +812,22 @@ begin
          clear_counter1       <= clear_counter;
          clear_counter2       <= clear_counter1;
          sdram_counter_clear  <= clear_counter2;
+
+         -- Stays set after streaming stops so the host can drain the ring buffer
+         streaming1           <= controlReg_stream;
+         streaming2           <= streaming1;
+         sdram_streaming      <= streaming2;
+
+         seek_request1        <= seek_request;
+         seek_request2        <= seek_request1;
+         sdram_rd_seek        <= seek_request2;
+
+         fill_request1        <= fill_request;
+         fill_request2        <= fill_request1;
+         fill_request3        <= fill_request2;
+         if (fill_request2 = '1') and (fill_request3 = '0') then
+            fill_snapshot     <= sdram_wr_count;
+         end if;
       end if;
    end process;
 
@@ -424,6 +840,11 @@ begin
       initializing         => initializing,
       cmd_counter_clear    => sdram_counter_clear,
 
+      -- Streaming
+      cmd_streaming        => sdram_streaming,
+      wr_count             => sdram_wr_count,
+      overrun              => sdram_overrun,
+
       -- Write port
       cmd_wr               => sdram_wr,
       cmd_pretrigger_value => write_fifo_dout(SampleDataType'left+2),
@@ -433,6 +854,8 @@ begin
 
       -- Read port
       cmd_rd               => sdram_rd,
+      cmd_rd_seek          => sdram_rd_seek,
+      cmd_rd_offset        => readOffset,
       cmd_rd_data          => sdram_rd_data,
       cmd_rd_accepted      => sdram_rd_accepted,
       cmd_rd_data_ready    => sdram_rd_data_ready,
@@ -472,10 +895,13 @@ begin
          currentSample  => currentSample,
          lastSample     => lastSample,
          triggerFound   => triggerFound,
+         currentStep    => trigger_step,
+         currentCount   => match_count,
 
          -- Bus interface (LUTs)
          wr_luts        => wr_trigger_luts,
          dataIn         => host_receive_data,
+         recirculate    => recirculate_trigger_luts,
          rd_luts        => '0',
          dataOut        => open,
          bus_busy       => trigger_bus_busy
@@ -486,12 +912,49 @@ begin
 
    begin
       if rising_edge(clock_100MHz) then
-         iState <= nextIState;
+         iState       <= nextIState;
+         fill_request <= snapshot_fill;
+         seek_request <= seek_read;
+         if (latch_snapshot = '1') then
+            status_snapshot(0)  <= "000"&overrun&"0"&std_logic_vector(to_unsigned(TriggerState'pos(tState),3));
+            status_snapshot(1)  <= "0000"&std_logic_vector(trigger_step);
+            status_snapshot(2)  <= std_logic_vector(match_count(7 downto 0));
+            status_snapshot(3)  <= std_logic_vector(match_count(15 downto 8));
+            status_snapshot(4)  <= capture_counter(7 downto 0);
+            status_snapshot(5)  <= capture_counter(15 downto 8);
+            status_snapshot(6)  <= capture_counter(23 downto 16);
+            case (tState) is
+               when t_preTrig =>
+                  -- Still filling
+                  status_snapshot(7)  <= capture_counter(7 downto 0);
+                  status_snapshot(8)  <= capture_counter(15 downto 8);
+                  status_snapshot(9)  <= capture_counter(23 downto 16);
+               when t_armed | t_running | t_complete =>
+                  status_snapshot(7)  <= preTrigger_amount(7 downto 0);
+                  status_snapshot(8)  <= preTrigger_amount(15 downto 8);
+                  status_snapshot(9)  <= preTrigger_amount(23 downto 16);
+               when others =>
+                  status_snapshot(7)  <= (others => '0');
+                  status_snapshot(8)  <= (others => '0');
+                  status_snapshot(9)  <= (others => '0');
+            end case;
+            status_snapshot(10) <= fill_snapshot(7 downto 0);
+            status_snapshot(11) <= fill_snapshot(15 downto 8);
+            status_snapshot(12) <= fill_snapshot(23 downto 16);
+         end if;
          if (write_data_count = '1') then
             data_count(15 downto 8) <= (others => '0');
             data_count( 7 downto 0) <= unsigned(host_receive_data);
          elsif (write_data_count_high = '1') then
             data_count(15 downto 8) <= unsigned(host_receive_data);
+         elsif (load_config_count = '1') then
+            data_count <= to_unsigned(CONFIG_BYTES'length, data_count'length);
+         elsif (load_fill_count = '1') then
+            data_count <= to_unsigned(FILL_SNAPSHOT_DELAY+3, data_count'length);
+         elsif (load_seek_count = '1') then
+            data_count <= to_unsigned(SEEK_DELAY, data_count'length);
+         elsif (load_snapshot_count = '1') then
+            data_count <= to_unsigned(FILL_SNAPSHOT_DELAY+SNAPSHOT_BYTES, data_count'length);
          elsif (decrement_data_count = '1') then
             data_count <= data_count-1;
          end if;
@@ -511,21 +974,33 @@ begin
       read_fifo_data, read_fifo_empty,
       host_receive_data_available, host_transmit_data_ready, host_receive_data,
       controlRegister, tState,
-      data_count
+      data_count,
+      notify_pending,
+      overrun, fill_snapshot,
+      status_snapshot
    )
 
 --   wr_control     >value
+--   wr_mode        >value
+--   wr_channels    >mask0 >mask1 >mask2 >mask3
 --   wr_pretrigSize >value_low >value_mid >value_high 
 --   wr_catureSize  >value_low >value_mid >value_high 
+--   wr_readOffset  >value_low >value_mid >value_high 
 --   wr_load_luts   >size_low  >size_high >values...
+--   wr_update_luts >recirc_low >recirc_high >size_low >size_high >values...
 --   rd_buffer      >size_low  >size_high <values...
 --   rd_status      >--------  <value
 --   rd_version     >--------  <value
+--   rd_config      >--------  <key0 <key1 <key2 <key3 <width <steps <patterns <counterBits
+--   rd_fill        >--------  <count_low <count_mid <count_high
+--   rd_snapshot    >--------  <status <step <match_low <match_high <capture x3 <pretrig x3 <count x3
+--   (notify)                  <value  (sent without request when capture completes)
 
    begin
       -- Default to not accept new data
       host_receive_data_request  <= '0';
       wr_trigger_luts            <= '0';
+      recirculate_trigger_luts   <= '0';
 
       -- Default to not reading SDRAM
       host_transmit_data_request <= '0';
@@ -535,12 +1010,22 @@ begin
 
       write_data_count_high       <= '0';
       write_data_count        <= '0';
+      load_config_count          <= '0';
+      load_fill_count            <= '0';
+      load_seek_count            <= '0';
+      seek_read                  <= '0';
+      snapshot_fill              <= '0';
+      load_snapshot_count        <= '0';
+      latch_snapshot             <= '0';
       decrement_data_count       <= '0';
 
       save_command               <= '0';
       clear_command              <= '0';
 
       write_control_reg          <= '0';
+      write_mode_reg             <= '0';
+      write_channels             <= '0';
+      notify_sent                <= '0';
 
       read_sdram                 <= '0';
       read_fifo_rd_en            <= '0';
@@ -555,18 +1040,28 @@ begin
       write_pretrig_mid          <= '0';
       write_pretrig_low          <= '0';
 
+      write_offset_high          <= '0';
+      write_offset_mid           <= '0';
+      write_offset_low           <= '0';
+
       case (iState) is
          --======================================================================
          when s_cmd =>
-            -- Available to accept commands from host
-            host_receive_data_request <= '1';
-
-            if (host_receive_data_available = '1') and (host_receive_data /= C_NOP) then
-               -- Save command and start processing
-               nextIState    <= s_size;
-               save_command  <= '1';
-            else
+            if (notify_pending = '1') then
+               -- Completion status takes priority over next command
+               nextIState    <= s_notify;
                clear_command <= '1';
+            else
+               -- Available to accept commands from host
+               host_receive_data_request <= '1';
+
+               if (host_receive_data_available = '1') and (host_receive_data /= C_NOP) then
+                  -- Save command and start processing
+                  nextIState    <= s_size;
+                  save_command  <= '1';
+               else
+                  clear_command <= '1';
+               end if;
             end if;
 
          --======================================================================
@@ -580,11 +1075,24 @@ begin
                      write_data_count   <= '1';
                      nextIState         <= s_load_luts1;
 
+                  when ACmd_UPDATE_LUTS =>
+                     write_data_count   <= '1';
+                     nextIState         <= s_update_luts1;
+
                   when ACmd_WR_CONTROL =>
                      write_control_reg  <= '1';
                      clear_command      <= '1';
                      nextIState         <= s_cmd;
 
+                  when ACmd_WR_MODE =>
+                     write_mode_reg     <= '1';
+                     clear_command      <= '1';
+                     nextIState         <= s_cmd;
+
+                  when ACmd_WR_CHANNELS =>
+                     write_channels     <= '1';
+                     nextIState         <= s_write_channels2;
+
                   when ACmd_WR_PRETRIG =>
                      write_pretrig_low  <= '1';
                      nextIState         <= s_write_pretrig2;
@@ -593,6 +1101,10 @@ begin
                      write_capture_low  <= '1';
                      nextIState         <= s_write_capture2;
 
+                  when ACmd_WR_READ_OFFSET =>
+                     write_offset_low   <= '1';
+                     nextIState         <= s_write_offset2;
+
                   when ACmd_RD_BUFFER =>
                      write_data_count   <= '1';
                      nextIState         <= s_read_buffer1;
@@ -603,6 +1115,18 @@ begin
                   when ACmd_RD_VERSION =>
                      nextIState <= s_read_version;
 
+                  when ACmd_RD_CONFIG =>
+                     load_config_count  <= '1';
+                     nextIState         <= s_read_config;
+
+                  when ACmd_RD_FILL =>
+                     load_fill_count    <= '1';
+                     nextIState         <= s_read_fill1;
+
+                  when ACmd_RD_SNAPSHOT =>
+                     load_snapshot_count <= '1';
+                     nextIState          <= s_read_snapshot1;
+
                   when others =>
                      clear_command <= '1';
                      nextIState <= s_cmd;
@@ -647,6 +1171,71 @@ begin
                nextIState           <= s_cmd;
             end if;
 
+         --======================================================================
+         when s_write_channels2 =>
+            -- Available to accept channel mask value from host
+            host_receive_data_request <= '1';
+
+            if (host_receive_data_available = '1') then
+               write_channels       <= '1';
+               nextIState           <= s_write_channels3;
+            end if;
+
+         when s_write_channels3 =>
+            -- Available to accept channel mask value from host
+            host_receive_data_request <= '1';
+
+            if (host_receive_data_available = '1') then
+               write_channels       <= '1';
+               nextIState           <= s_write_channels4;
+            end if;
+
+         when s_write_channels4 =>
+            -- Available to accept channel mask value from host
+            host_receive_data_request <= '1';
+
+            if (host_receive_data_available = '1') then
+               write_channels       <= '1';
+               nextIState           <= s_cmd;
+            end if;
+
+         --======================================================================
+         when s_write_offset2 =>
+            -- Available to accept read offset value from host
+            host_receive_data_request <= '1';
+
+            if (host_receive_data_available = '1') then
+               write_offset_mid     <= '1';
+               nextIState           <= s_write_offset3;
+            end if;
+
+         when s_write_offset3 =>
+            -- Available to accept read offset value from host
+            host_receive_data_request <= '1';
+
+            if (host_receive_data_available = '1') then
+               write_offset_high    <= '1';
+               load_seek_count      <= '1';
+               nextIState           <= s_seek1;
+            end if;
+
+         -- Read address is only moved when no SDRAM reads are in progress
+         -- (read_sdram is not asserted outside s_read_buffer2)
+         when s_seek1 =>
+            decrement_data_count <= '1';
+            if (data_count = 1) then
+               seek_read         <= '1';
+               load_seek_count   <= '1';
+               nextIState        <= s_seek2;
+            end if;
+
+         when s_seek2 =>
+            decrement_data_count <= '1';
+            if (data_count = 1) then
+               nextIState        <= s_cmd;
+               clear_command     <= '1';
+            end if;
+
          --================================================================
          when s_load_luts1 =>
             -- Available to accept count high value from host
@@ -673,17 +1262,66 @@ begin
                end if;
             end if;
 
+         --================================================================
+         -- Partial LUT update
+         -- The LUT chain is advanced by recirc bytes without change
+         -- followed by size bytes from the host (as for s_load_luts2)
+         when s_update_luts1 =>
+            -- Available to accept recirculate count high value from host
+            host_receive_data_request <= '1';
+
+            if (host_receive_data_available = '1') then
+               write_data_count_high <= '1';
+               nextIState            <= s_update_luts2;
+            end if;
+
+         when s_update_luts2 =>
+            if (data_count = 0) then
+               nextIState <= s_update_luts3;
+            elsif (trigger_bus_busy = '0') then
+               -- Shift a byte around the LUT chain
+               wr_trigger_luts          <= '1';
+               recirculate_trigger_luts <= '1';
+               decrement_data_count     <= '1';
+            end if;
+
+         when s_update_luts3 =>
+            -- Available to accept load count low value from host
+            host_receive_data_request <= '1';
+
+            if (host_receive_data_available = '1') then
+               write_data_count <= '1';
+               nextIState       <= s_update_luts4;
+            end if;
+
+         when s_update_luts4 =>
+            -- Available to accept load count high value from host
+            host_receive_data_request <= '1';
+
+            if (host_receive_data_available = '1') then
+               write_data_count_high <= '1';
+               nextIState            <= s_update_luts5;
+            end if;
+
+         when s_update_luts5 =>
+            if (data_count = 0) then
+               nextIState    <= s_cmd;
+               clear_command <= '1';
+            else
+               nextIState    <= s_load_luts2;
+            end if;
+
          --================================================================
          when s_read_status =>
 
 --       7        6       5      4       3       2        1       0
 --   +-------+-------+-------+-------+-------+-------+-------+-------+
---   |                                       |         State         |
---   |                                       |                       |
+--   |                       |OVERRUN|       |         State         |
+--   |                       |       |       |                       |
 --   +-------+-------+-------+-------+-------+-------+-------+-------+
 
             host_transmit_data <=
-               "00000"&
+               "000"&overrun&"0"&
                std_logic_vector(to_unsigned(TriggerState'pos(tState),3));
 
             -- Check FT2232 is ready
@@ -694,6 +1332,27 @@ begin
                clear_command              <= '1';
             end if;
 
+         --================================================================
+         when s_notify =>
+
+--       7        6       5      4       3       2        1       0
+--   +-------+-------+-------+-------+-------+-------+-------+-------+
+--   |                       |OVERRUN|NOTIFY |         State         |
+--   |                       |       |  =1   |                       |
+--   +-------+-------+-------+-------+-------+-------+-------+-------+
+
+            host_transmit_data <=
+               "000"&overrun&"1"&
+               std_logic_vector(to_unsigned(TriggerState'pos(tState),3));
+
+            -- Check FT2232 is ready
+            if (host_transmit_data_ready = '1') then
+               -- Send data and clear request
+               host_transmit_data_request <= '1';
+               notify_sent                <= '1';
+               nextIState                 <= s_cmd;
+            end if;
+
          --================================================================
          when s_read_version =>
 
@@ -703,7 +1362,7 @@ begin
 --   |                                                               |
 --   +-------+-------+-------+-------+-------+-------+-------+-------+
 
-            host_transmit_data <= "00000010";
+            host_transmit_data <= "00001011";
 
             -- Check FT2232 is ready
             if (host_transmit_data_ready = '1') then
@@ -713,6 +1372,77 @@ begin
                clear_command              <= '1';
             end if;
 
+         --================================================================
+         when s_read_config =>
+            -- Bytes are sent in CONFIG_BYTES order as data_count counts down
+            host_transmit_data <= CONFIG_BYTES(CONFIG_BYTES'length-to_integer(data_count));
+
+            -- Check FT2232 is ready
+            if (host_transmit_data_ready = '1') then
+               host_transmit_data_request <= '1';
+               if (data_count = 1) then
+                  nextIState              <= s_cmd;
+                  clear_command           <= '1';
+               else
+                  decrement_data_count    <= '1';
+               end if;
+            end if;
+
+         --================================================================
+         -- Number of samples written to the ring buffer (modulo 2**24)
+         -- The host works out the fill level from the number of samples it has read
+         when s_read_fill1 =>
+            -- Request snapshot of write count and wait until stable
+            snapshot_fill        <= '1';
+            decrement_data_count <= '1';
+            if (data_count = 4) then
+               nextIState        <= s_read_fill2;
+            end if;
+
+         when s_read_fill2 =>
+            case (to_integer(data_count)) is
+               when 3      => host_transmit_data <= fill_snapshot(7 downto 0);
+               when 2      => host_transmit_data <= fill_snapshot(15 downto 8);
+               when others => host_transmit_data <= fill_snapshot(23 downto 16);
+            end case;
+
+            -- Check FT2232 is ready
+            if (host_transmit_data_ready = '1') then
+               host_transmit_data_request <= '1';
+               if (data_count = 1) then
+                  nextIState              <= s_cmd;
+                  clear_command           <= '1';
+               else
+                  decrement_data_count    <= '1';
+               end if;
+            end if;
+
+         --================================================================
+         -- Capture progress in a single transfer (see status_snapshot)
+         when s_read_snapshot1 =>
+            -- Request snapshot of write count and wait until stable
+            snapshot_fill        <= '1';
+            decrement_data_count <= '1';
+            if (data_count = SNAPSHOT_BYTES+1) then
+               latch_snapshot    <= '1';
+               nextIState        <= s_read_snapshot2;
+            end if;
+
+         when s_read_snapshot2 =>
+            -- Bytes are sent in status_snapshot order as data_count counts down
+            host_transmit_data <= status_snapshot(SNAPSHOT_BYTES-to_integer(data_count));
+
+            -- Check FT2232 is ready
+            if (host_transmit_data_ready = '1') then
+               host_transmit_data_request <= '1';
+               if (data_count = 1) then
+                  nextIState              <= s_cmd;
+                  clear_command           <= '1';
+               else
+                  decrement_data_count    <= '1';
+               end if;
+            end if;
+
          --================================================================
          when s_read_buffer1 =>
             -- Available to accept count high value from host
@@ -108,26 +108,42 @@ package LogicAnalyserPackage is
    constant C_WR_CONTROL    : DataBusType := "00000010" or C_RECEIVE_MODE;
    constant C_WR_PRETRIG    : DataBusType := "00000011" or C_RECEIVE_MODE;
    constant C_WR_CAPTURE    : DataBusType := "00000100" or C_RECEIVE_MODE;
+   constant C_LUT_UPDATE    : DataBusType := "00000101" or C_RECEIVE_MODE;
+   constant C_WR_MODE       : DataBusType := "00000110" or C_RECEIVE_MODE;
+   constant C_WR_CHANNELS   : DataBusType := "00000111" or C_RECEIVE_MODE;
+   constant C_WR_READ_OFFSET: DataBusType := "00001000" or C_RECEIVE_MODE;
 
    constant C_RD_VERSION    : DataBusType := "00000000" or C_TRANSMIT_MODE;
    constant C_RD_BUFFER     : DataBusType := "00000001" or C_TRANSMIT_MODE;
    constant C_RD_STATUS     : DataBusType := "00000010" or C_TRANSMIT_MODE;
+   constant C_RD_CONFIG     : DataBusType := "00000011" or C_TRANSMIT_MODE;
+   constant C_RD_FILL       : DataBusType := "00000100" or C_TRANSMIT_MODE;
+   constant C_RD_SNAPSHOT   : DataBusType := "00000101" or C_TRANSMIT_MODE;
 
    type AnalyserCmdType is (
       ACmd_NOP, 
       ACmd_LOAD_LUTS, 
+      ACmd_UPDATE_LUTS, 
       ACmd_WR_CONTROL, 
       ACmd_RD_BUFFER, 
       ACmd_WR_PRETRIG, 
       ACmd_WR_CAPTURE, 
       ACmd_RD_STATUS,
-      ACmd_RD_VERSION
+      ACmd_RD_VERSION,
+      ACmd_RD_CONFIG,
+      ACmd_RD_FILL,
+      ACmd_WR_MODE,
+      ACmd_WR_CHANNELS,
+      ACmd_WR_READ_OFFSET,
+      ACmd_RD_SNAPSHOT
    );
 
    --==============================================================
    --
    constant C_CONTROL_START_ACQ     : DataBusType := "00000001";
    constant C_CONTROL_CLEAR         : DataBusType := "00000010";
+   constant C_CONTROL_NOTIFY        : DataBusType := "01000000";
+   constant C_CONTROL_STREAM        : DataBusType := "10000000";
    
    constant C_CONTROL_DIV1          : DataBusType := "00000000";
    constant C_CONTROL_DIV2          : DataBusType := "00000100";
@@ -152,6 +168,15 @@ package LogicAnalyserPackage is
    constant C_CONTROL_S_20us  : DataBusType := C_CONTROL_DIVx1000 or C_CONTROL_DIV2;
    constant C_CONTROL_S_50us  : DataBusType := C_CONTROL_DIVx1000 or C_CONTROL_DIV5;
    constant C_CONTROL_S_100us : DataBusType := C_CONTROL_DIVx1000 or C_CONTROL_DIV10;
+
+   --==============================================================
+   -- Capture mode register (C_WR_MODE)
+   --
+   constant C_MODE_CAPTURE_MASK     : DataBusType := "00000011";
+   constant C_MODE_RAW              : DataBusType := "00000000";
+   constant C_MODE_RLE              : DataBusType := "00000001";
+   constant C_MODE_TRANSITION       : DataBusType := "00000010";
+   constant C_MODE_PACK             : DataBusType := "00000100";
    
    -------------------------------------------------------------
    -- Maps readable command names (for debug) to physical values
@@ -170,12 +195,19 @@ package body LogicAnalyserPackage is
       case (command) is
          when C_NOP        => return ACmd_NOP;
          when C_LUT_CONFIG => return ACmd_LOAD_LUTS;
+         when C_LUT_UPDATE => return ACmd_UPDATE_LUTS;
          when C_WR_CONTROL => return ACmd_WR_CONTROL;
          when C_WR_PRETRIG => return ACmd_WR_PRETRIG;
          when C_WR_CAPTURE => return ACmd_WR_CAPTURE;
          when C_RD_BUFFER  => return ACmd_RD_BUFFER;
          when C_RD_STATUS  => return ACmd_RD_STATUS;
          when C_RD_VERSION => return ACmd_RD_VERSION;
+         when C_RD_CONFIG  => return ACmd_RD_CONFIG;
+         when C_RD_FILL    => return ACmd_RD_FILL;
+         when C_WR_MODE    => return ACmd_WR_MODE;
+         when C_WR_CHANNELS => return ACmd_WR_CHANNELS;
+         when C_WR_READ_OFFSET => return ACmd_WR_READ_OFFSET;
+         when C_RD_SNAPSHOT => return ACmd_RD_SNAPSHOT;
          when others       => return ACmd_NOP;
       end case;
    end function;
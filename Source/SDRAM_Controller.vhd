@@ -14,6 +14,11 @@ entity SDRAM_Controller is
       clock_110MHz_n       : in    std_logic;
       cmd_counter_clear    : in    std_logic;
 
+      -- Streaming - SDRAM is used as a ring buffer drained by reads
+      cmd_streaming        : in    std_logic;
+      wr_count             : out   sdram_AddrType;  -- Number of words written (wraps)
+      overrun              : out   std_logic;       -- Writes discarded as ring was full
+
       -- Interface to issue reads or write data
       cmd_wr               : in    std_logic;
       cmd_pretrigger_value : in    std_logic;
@@ -22,6 +27,8 @@ entity SDRAM_Controller is
       cmd_wr_accepted      : out   std_logic;
 
       cmd_rd               : in    std_logic;
+      cmd_rd_seek          : in    std_logic := '0';  -- Move read address to cmd_rd_offset from start of capture
+      cmd_rd_offset        : in    sdram_AddrType := (others => '0');
       cmd_rd_data          : out   sdram_DataType;
       cmd_rd_accepted      : out   std_logic;
       cmd_rd_data_ready    : out   std_logic;
@@ -50,9 +57,25 @@ architecture Behavioral of SDRAM_Controller is
    signal rd_address              : sdram_AddrType := (others => '0');
    signal increment_rd_address    : std_logic;
 
+   -- Address of start of capture (first pre-trigger word)
+   -- This follows the read address while armed but is not advanced by reads
+   signal rd_base                 : sdram_AddrType := (others => '0');
+
    signal wr_address              : sdram_AddrType := (others => '0');
    signal increment_wr_address    : std_logic;
 
+   -- Streaming ring buffer
+   -- Writes are discarded (and overrun set) when the ring is full
+   -- Reads are only done when data is available
+   -- The margin covers writes already in progress when ring_full is asserted
+   constant RING_MARGIN           : natural := 16;
+   signal ring_level              : unsigned(SDRAM_ADDR_WIDTH-1 downto 0) := (others => '0');
+   signal ring_full               : std_logic := '0';
+   signal ring_overrun            : std_logic := '0';
+   signal drop_write              : std_logic;
+   signal wr_request              : std_logic;
+   signal rd_request              : std_logic;
+
    ----------------------------------------------------------------
    -- Ensures that outputs and inputs are registered in the IOB.
    -- RAS, CAS, WE, DQM, ADDR, BA = OFF                         
@@ -314,7 +337,17 @@ begin
    end process;
 
    cmd_rd_accepted <= cmd_rd_accepted_sm;
-   cmd_wr_accepted <= cmd_wr_accepted_sm;
+   cmd_wr_accepted <= cmd_wr_accepted_sm or drop_write;
+
+   -- Requests as seen by the state machine
+   wr_request <= cmd_wr and not ring_full;
+   rd_request <= cmd_rd when ((cmd_streaming = '0') or (rd_address /= wr_address)) else '0';
+
+   -- Discard write data when the ring is full (only when streaming)
+   drop_write <= cmd_wr and ring_full;
+
+   wr_count   <= wr_address;
+   overrun    <= ring_overrun;
 
    Sdram_Sync_proc1n:
    process (clock_110MHz_n)
@@ -398,14 +431,26 @@ begin
             wr_address <= std_logic_vector(unsigned(wr_address) + 1);
          end if;
 
-         if (cmd_pretrigger_value = '1') then
-            armed := '1';
+         if (cmd_counter_clear = '1') then
+            armed := '0';
          elsif (cmd_trigger_value = '1') then
+            -- May also be the first word after the pre-trigger (C_MODE_TRANSITION)
             armed := '0';
+         elsif (cmd_pretrigger_value = '1') then
+            armed := '1';
          end if;
          
+         if (cmd_counter_clear = '1') then
+            rd_base <= (others => '0');
+         elsif (increment_wr_address = '1') and (armed = '1') then
+            rd_base <= std_logic_vector(unsigned(rd_base) + 1);
+         end if;
+
          if (cmd_counter_clear = '1') then
             rd_address        <= (others => '0');
+         elsif (cmd_rd_seek = '1') and (cmd_streaming = '0') then
+            -- Random access to capture (no reads are in progress)
+            rd_address <= std_logic_vector(unsigned(rd_base) + unsigned(cmd_rd_offset));
          elsif (increment_rd_address = '1') or 
                ((increment_wr_address = '1') and (armed = '1')) then
             -- Increment on reads from the RAM
@@ -415,6 +460,20 @@ begin
             rd_address <= std_logic_vector(unsigned(rd_address) + 1);
          end if;
 
+         -- Ring buffer fill level (words not yet read from SDRAM)
+         ring_level <= unsigned(wr_address) - unsigned(rd_address);
+         if (cmd_streaming = '1') and (ring_level >= (2**SDRAM_ADDR_WIDTH)-RING_MARGIN) then
+            ring_full <= '1';
+         else
+            ring_full <= '0';
+         end if;
+
+         -- Sticky until counters cleared
+         if (cmd_counter_clear = '1') then
+            ring_overrun <= '0';
+         elsif (drop_write = '1') then
+            ring_overrun <= '1';
+         end if;
 
       end if;
    end process;
@@ -428,7 +487,7 @@ begin
    main_proc:
    process(
       state, initialisation_counter,
-      wr_address, rd_address, cmd_wr, cmd_rd, wr_back_to_back_ok, 
+      wr_address, rd_address, wr_request, rd_request, wr_back_to_back_ok, 
       rd_back_to_back_ok, forcing_refresh, pending_refresh, write_pending)
 
    begin
@@ -535,7 +594,7 @@ begin
                -- This tasks tRFC (66ns), so 6 idle cycles are needed @ 100MHz
                ----------------------------------------------------------------
                next_state <= s_refresh;
-            elsif ((cmd_wr = '1') or (cmd_rd = '1')) then
+            elsif ((wr_request = '1') or (rd_request = '1')) then
                ----------------------------------
                -- Start the read or write cycle.
                -- First task is to open the row
@@ -548,7 +607,7 @@ begin
          ---------------------------------------------
          when s_active =>
             command            <= C_ACTIVE;
-            if ((cmd_wr = '1') or (write_pending = '1')) then
+            if ((wr_request = '1') or (write_pending = '1')) then
                -- Give preference to new writes or a pending one still to do
                next_state           <= s_pre_write1;
                sdram_row_address_sm <= cmd_wr_row;
@@ -587,7 +646,7 @@ begin
          when s_read2 =>
             next_state <= s_read2;
 
-            if ((cmd_rd = '1') and (rd_back_to_back_ok = '1')) then
+            if ((rd_request = '1') and (rd_back_to_back_ok = '1')) then
                -- We can do a read now
                command              <= C_READ;
                sdram_ba_sm          <= cmd_rd_bank;
@@ -602,12 +661,12 @@ begin
                next_state <= s_read_exit;
             end if;
             
-            if ((cmd_rd = '1') and (rd_back_to_back_ok = '0')) then
+            if ((rd_request = '1') and (rd_back_to_back_ok = '0')) then
                -- Must change row/bank for read
                next_state <= s_read_exit;
             end if;
 
-            if ((cmd_wr = '1') and (cmd_rd = '0')) then
+            if ((wr_request = '1') and (rd_request = '0')) then
                -- Might as well do the read next
                next_state <= s_read_exit;
             end if;
@@ -652,7 +711,7 @@ begin
             increment_wr_address    <= '1';
             next_write_pending      <= '0';
 
-            if (cmd_wr = '1') then
+            if (wr_request = '1') then
                -- Always accept a word to write if available
                cmd_wr_accepted_sm   <= '1';
                next_write_pending   <= '1';
@@ -674,14 +733,14 @@ begin
                increment_wr_address    <= '1';
                next_write_pending      <= '0';
 
-               if (cmd_wr = '1') then
+               if (wr_request = '1') then
                   -- Accept new data if available
                   cmd_wr_accepted_sm   <= '1';
                   next_write_pending   <= '1';
                end if;
             end if;
 
-            if (cmd_wr = '1') and (write_pending = '0') then
+            if (wr_request = '1') and (write_pending = '0') then
                -- Accept new data if available and needed
                cmd_wr_accepted_sm      <= '1';
                next_write_pending      <= '1';
@@ -703,14 +762,14 @@ begin
                increment_wr_address    <= '1';
                next_write_pending      <= '0';
 
-               if (cmd_wr = '1') then
+               if (wr_request = '1') then
                   -- Accept new data if available
                   cmd_wr_accepted_sm   <= '1';
                   next_write_pending   <= '1';
                end if;
             end if;
 
-            if (cmd_wr = '1') and (write_pending = '0') then
+            if (wr_request = '1') and (write_pending = '0') then
                -- Accept new data if available and needed
                cmd_wr_accepted_sm      <= '1';
                next_write_pending      <= '1';
@@ -721,7 +780,7 @@ begin
                next_state   <= s_precharge;
             end if;
 
-            if ((write_pending = '0') and (cmd_rd = '1')) then
+            if ((write_pending = '0') and (rd_request = '1')) then
                -- Might as well do the read
                next_state   <= s_precharge;
             end if;
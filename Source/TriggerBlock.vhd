@@ -50,6 +50,7 @@ entity TriggerBlock is
       -- Bus interface
       wr_luts        : in   std_logic;
       dataIn         : in   DataBusType;
+      recirculate    : in   std_logic;
 
       rd_luts        : in   std_logic;
       dataOut        : out  DataBusType;
@@ -63,8 +64,11 @@ entity TriggerBlock is
       currentSample  : in  SampleDataType;  -- Current sample data
       lastSample     : in  SampleDataType;  -- Previous sample data
       
-      triggerFound   : out std_logic        -- Trigger output
+      triggerFound   : out std_logic;       -- Trigger output
 
+      -- Trigger progress (for status snapshot)
+      currentStep    : out TriggerRangeType;  -- Current step in trigger sequence
+      currentCount   : out MatchCounterType   -- Match counter for current step (LFSR)
   );
 end TriggerBlock;
 
@@ -95,6 +99,9 @@ signal lut_config_in  : std_logic;  -- Serial in for LUT shift register (MSB fir
 signal lut_config_out : std_logic;  -- Serial out for LUT shift register
 
 begin
+
+   currentStep  <= triggerStep;
+   currentCount <= matchCount;
    
    TriggerBusInterface_inst:
    entity work.TriggerBusInterface 
@@ -103,6 +110,7 @@ begin
                         
       dataIn            => dataIn ,
       wr                => wr_luts,
+      recirculate       => recirculate,
                         
       dataOut           => dataOut,
       rd                => rd_luts,
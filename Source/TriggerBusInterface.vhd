@@ -11,6 +11,7 @@ entity TriggerBusInterface is
 
       wr             : in   std_logic;
       dataIn         : in   DataBusType;
+      recirculate    : in   std_logic;  -- With wr, shift LUT chain output back into chain (dataIn ignored)
 
       rd             : in   std_logic;
       dataOut        : out  DataBusType;
@@ -31,9 +32,11 @@ signal state : StateType := s_idle;
 
 signal bitCount          : integer range 0 to DataBusType'length-1;
 signal dataShiftRegister : DataBusType := (others => '0');
+signal recirculating     : std_logic   := '0';
 
 begin
-   lut_config_in <= dataShiftRegister(dataShiftRegister'left);
+   -- Recirculating leaves the LUT contents unchanged while advancing the chain
+   lut_config_in <= lut_config_out when (recirculating = '1') else dataShiftRegister(dataShiftRegister'left);
       
    ReadProc:
    process(rd, dataShiftRegister)
@@ -56,6 +59,7 @@ begin
                if (wr = '1') then
                   state             <= s_write;
                   dataShiftRegister <= dataIn;
+                  recirculating     <= recirculate;
                   lut_config_ce     <= '1';-- after 10 ps;
                   bitCount          <= 0;
                   busy              <= '1';
@@ -39,6 +39,7 @@ BEGIN
 
       wr      => wr,
       dataIn  => dataIn,
+      recirculate => '0',
 
       rd      => rd,
       dataOut => dataOut,